@@ -0,0 +1,47 @@
+#!/usr/bin/env python3
+# 用--emit-cpp把脚本翻译成C++, 编译后执行, 比较标准输出和期望输出文件
+# 用法: check_emit_cpp.py [--status N] expected.out build_dir zero script
+#                         compiler [args...]
+# 生成的代码只依赖标准库和zero/aot/runtime.hpp
+
+import os
+import subprocess
+import sys
+
+import check_output
+
+RUNTIME_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                           os.pardir, 'zero')
+
+
+def main(argv):
+    options = []
+    if len(argv) > 1 and argv[0] == '--status':
+        options = argv[:2]
+        argv = argv[2:]
+    if len(argv) < 5:
+        print('usage: check_emit_cpp.py [--status N] expected.out '
+              'build_dir zero script compiler [args...]')
+        return 2
+    expected, build_dir, zero, script = argv[:4]
+    compiler = argv[4:]
+
+    name = os.path.splitext(os.path.basename(script))[0]
+    source = os.path.join(build_dir, name + '.cpp')
+    program = os.path.join(build_dir, name + '.aot')
+    emit = subprocess.run([zero, '--emit-cpp', source, script])
+    if emit.returncode != 0:
+        print(f'--emit-cpp exit status {emit.returncode}')
+        return 1
+    build = subprocess.run(compiler + ['-std=c++17', '-O1',
+                                       '-I', RUNTIME_DIR,
+                                       source, '-o', program])
+    if build.returncode != 0:
+        print(f'compiling {source} failed')
+        return 1
+
+    return check_output.main(options + [expected, program])
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv[1:]))
@@ -0,0 +1,71 @@
+#!/usr/bin/env python3
+# 执行命令, 比较标准输出和期望输出文件, 并检查退出码
+# 用法: check_output.py [--status N] [--max-rss MB] [--input file]
+#                        expected.out command [args...]
+# 期望输出中的{number}匹配任意数字, 用于clock()这类每次不同的输出
+# --max-rss检查命令的峰值内存, 用于发现随执行时间增长的泄漏
+# --input把文件内容作为命令的标准输入, 用于测试REPL
+
+import difflib
+import re
+import resource
+import subprocess
+import sys
+
+NUMBER = r'-?\d+(\.\d+)?'
+
+
+def matches(expected, actual):
+    if len(expected) != len(actual):
+        return False
+    for want, got in zip(expected, actual):
+        pattern = NUMBER.join(re.escape(part)
+                              for part in want.split('{number}'))
+        if re.fullmatch(pattern, got) is None:
+            return False
+    return True
+
+
+def main(argv):
+    status = 0
+    max_rss = None
+    stdin = None
+    while len(argv) > 1 and argv[0] in ('--status', '--max-rss', '--input'):
+        if argv[0] == '--status':
+            status = int(argv[1])
+        elif argv[0] == '--max-rss':
+            max_rss = int(argv[1])
+        else:
+            stdin = open(argv[1], 'rb')
+        argv = argv[2:]
+    if len(argv) < 2:
+        print('usage: check_output.py [--status N] [--max-rss MB] '
+              '[--input file] expected.out command [args...]')
+        return 2
+
+    with open(argv[0], encoding='utf-8') as f:
+        expected = f.read().splitlines()
+    result = subprocess.run(argv[1:], stdin=stdin, stdout=subprocess.PIPE)
+    actual = result.stdout.decode('utf-8', errors='replace').splitlines()
+
+    ok = True
+    if not matches(expected, actual):
+        sys.stdout.writelines(
+            line + '\n'
+            for line in difflib.unified_diff(
+                expected, actual, argv[0], 'stdout', lineterm=''))
+        ok = False
+    if result.returncode != status:
+        print(f'exit status {result.returncode}, expected {status}')
+        ok = False
+    if max_rss is not None:
+        # Linux上ru_maxrss以KB为单位, 只执行了一个子进程
+        rss = resource.getrusage(resource.RUSAGE_CHILDREN).ru_maxrss // 1024
+        if rss > max_rss:
+            print(f'peak memory {rss} MB, expected at most {max_rss} MB')
+            ok = False
+    return 0 if ok else 1
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv[1:]))
@@ -60,4 +60,23 @@ add(five, ten);
         expect(token.lexeme == expected[i++]);
         // std::cout << token.lexeme << " : " << i++ << '\n';
     }
+
+    // 词位直接指向源码, 数字在词法分析时解析
+    expect(tokens[3].lexeme.data() == input.data() + input.find('5'));
+    expect(tokens[3].number == 5);
+    expect(tokens[8].number == 10);
+
+    // 同名标识符驻留为同一个符号
+    expect(tokens[13].symbol == tokens[19].symbol);
+    expect(tokens[13].symbol != tokens[15].symbol);
+    expect(SymbolTable::instance().name(tokens[11].symbol) == "add");
+
+    // 带小数点的数字是浮点数, 超出int64范围的整数也按浮点数处理
+    std::string numbers = "1.5 42 99999999999999999999";
+    auto number_tokens = Lexer(numbers).scan_tokens();
+    expect(number_tokens[0].type == token_type::DECIMAL);
+    expect(number_tokens[0].decimal == 1.5);
+    expect(number_tokens[1].type == token_type::NUMBER);
+    expect(number_tokens[1].number == 42);
+    expect(number_tokens[2].type == token_type::DECIMAL);
 }
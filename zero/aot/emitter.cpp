@@ -0,0 +1,616 @@
+#include "emitter.hpp"
+
+#include "fmt/core.h"
+#include "interpreter.hpp"
+#include "literal.hpp"
+#include "symbol.hpp"
+#include "typed_emitter.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+namespace zero::aot {
+
+namespace {
+const char *operation(token_type op) {
+    switch (op) {
+        case token_type::PLUS:
+            return "rt::add";
+        case token_type::MINUS:
+            return "rt::subtract";
+        case token_type::STAR:
+            return "rt::multiply";
+        case token_type::SLASH:
+            return "rt::divide";
+        case token_type::EQUAL_EQUAL:
+            return "rt::equal";
+        case token_type::NOT_EQUAL:
+            return "rt::not_equal";
+        case token_type::GREATER:
+            return "rt::greater";
+        case token_type::GREATER_EQUAL:
+            return "rt::greater_equal";
+        case token_type::LESS:
+            return "rt::less";
+        default:
+            return "rt::less_equal";
+    }
+}
+
+// 找出栈帧中被闭包捕获的槽位, 不进入嵌套函数的函数体
+void find_captured(const Stmt &stmt, std::vector<bool> &boxed) {
+    if (const auto *function = dynamic_cast<const Function *>(&stmt)) {
+        for (const auto &capture : function->captures) {
+            if (capture.is_local) {
+                boxed[capture.index] = true;
+            }
+        }
+    } else if (const auto *block = dynamic_cast<const Block *>(&stmt)) {
+        for (const auto &s : block->statements) {
+            find_captured(*s, boxed);
+        }
+    } else if (const auto *if_stmt = dynamic_cast<const If *>(&stmt)) {
+        find_captured(*if_stmt->then_branch, boxed);
+        if (if_stmt->else_branch != nullptr) {
+            find_captured(*if_stmt->else_branch, boxed);
+        }
+    } else if (const auto *while_stmt = dynamic_cast<const While *>(&stmt)) {
+        find_captured(*while_stmt->body, boxed);
+    }
+}
+} // namespace
+
+std::string Emitter::emit(const std::unique_ptr<Program> &program,
+                          const std::string &source_name) {
+    // 顶层函数预先编号, 特化的代码按编号直接调用
+    for (const auto &stmt : program->get_statements()) {
+        if (auto *function = dynamic_cast<Function *>(stmt.get())) {
+            function_id(function);
+            if (function->depth == GLOBAL_DEPTH
+                && function->typed != nullptr) {
+                typed_[function->slot] = function;
+            }
+        }
+    }
+    std::string typed_definitions = emit_typed();
+
+    indent_ = 1;
+    for (const auto &stmt : program->get_statements()) {
+        compile(*stmt);
+    }
+    auto script = std::move(body_);
+
+    // 函数体中遇到的嵌套函数加入pending_, 直到所有函数都生成完
+    while (!pending_.empty()) {
+        const auto *function = pending_.back();
+        pending_.pop_back();
+        compile_function(*function);
+    }
+
+    std::string output = fmt::format(
+        "// 由zero --emit-cpp从{}生成\n"
+        "// 编译: g++ -std=c++17 -O2 -I <zero源码目录> <本文件>\n\n"
+        "#include \"aot/runtime.hpp\"\n\n"
+        "namespace rt = zero::aot;\n\n"
+        "namespace {{\n\n",
+        source_name);
+    output += fmt::format("rt::Value g[{}];\n\n", interpreter_.num_globals());
+    if (!constants_.empty()) {
+        output += constants_ + "\n";
+    }
+
+    // 声明所有函数, 定义之间可以互相引用
+    std::string infos;
+    for (std::size_t id = 0; id < functions_.size(); id++) {
+        const auto *function = functions_[id];
+        output += fmt::format(
+            "rt::Value f{}(rt::Closure &self, rt::Value *arguments);\n", id);
+        if (specialized_.count(function) != 0) {
+            std::string params;
+            for (std::size_t i = 0; i < function->param_types.size(); i++) {
+                if (i != 0) {
+                    params += ", ";
+                }
+                params += TypedEmitter::cpp_type(function->param_types[i]);
+            }
+            output += fmt::format("{} t{}({});\n",
+                                  TypedEmitter::cpp_type(
+                                      function->return_type),
+                                  id,
+                                  params);
+        }
+
+        auto memo = std::string{"nullptr"};
+        if (function->memo != nullptr) {
+            infos += fmt::format("rt::Memo memo{};\n", id);
+            memo = fmt::format("&memo{}", id);
+        }
+        infos += fmt::format("const rt::FunctionInfo f{}_info{{{}, {}, f{}, "
+                             "{}}};\n",
+                             id,
+                             string_literal(function->name.lexeme),
+                             function->params.size(),
+                             id,
+                             memo);
+    }
+    output += "\n" + infos + "\n";
+    output += typed_definitions;
+    output += definitions_;
+
+    output += "void script() {\n" + script + "}\n\n";
+    output += "} // namespace\n\n";
+
+    // 原生函数放在解释器分配的槽位中
+    output += "int main() {\n";
+    const std::pair<const char *, const char *> natives[] = {
+        {"print", "rt::PRINT"},
+        {"clock", "rt::CLOCK"},
+        {"read_file", "rt::READ_FILE"},
+    };
+    for (const auto &[name, native] : natives) {
+        auto slot = interpreter_.lookup_global(
+            SymbolTable::instance().intern(name));
+        if (slot.has_value()) {
+            output += fmt::format("    g[{}] = &{};\n", *slot, native);
+        }
+    }
+    // 与解释器相同, 运行时出错时退出码为1
+    output += "    try {\n"
+              "        script();\n"
+              "    } catch (const rt::RuntimeError &error) {\n"
+              "        rt::report(error);\n"
+              "        return 1;\n"
+              "    }\n"
+              "    return 0;\n"
+              "}\n";
+
+    return output;
+}
+
+std::string Emitter::emit_typed() {
+    // 特化的代码调用的函数也必须能生成特化版本, 有函数不能生成时重新生成
+    for (const auto &[slot, function] : typed_) {
+        specialized_.insert(function);
+    }
+    while (true) {
+        std::unordered_map<unsigned int, const Function *> callees;
+        for (const auto &[slot, function] : typed_) {
+            if (specialized_.count(function) != 0) {
+                callees[slot] = function;
+            }
+        }
+
+        TypedEmitter emitter{ids_, callees};
+        std::string definitions;
+        std::vector<const Function *> failed;
+        for (const auto *function : functions_) {
+            if (specialized_.count(function) != 0
+                && !emitter.emit(*function, definitions)) {
+                failed.push_back(function);
+            }
+        }
+        if (failed.empty()) {
+            return definitions;
+        }
+        for (const auto *function : failed) {
+            specialized_.erase(function);
+        }
+    }
+}
+
+std::string Emitter::compile(Expr &expr) {
+    expr.accept(*this);
+    return std::move(code_);
+}
+
+void Emitter::compile(Stmt &stmt) { stmt.accept(*this); }
+
+void Emitter::compile_scope(const std::string &header,
+                            const std::vector<std::unique_ptr<Stmt>> &stmts) {
+    // 槽位在离开块后恢复成之前的变量
+    std::vector<std::string> names;
+    if (!frames_.empty()) {
+        names = frames_.back().names;
+    }
+    line(header.empty() ? "{" : header + " {");
+    indent_++;
+    for (const auto &stmt : stmts) {
+        compile(*stmt);
+    }
+    indent_--;
+    line("}");
+    if (!frames_.empty()) {
+        frames_.back().names = std::move(names);
+    }
+}
+
+void Emitter::compile_scope(const std::string &header, Stmt &stmt) {
+    auto *block = dynamic_cast<Block *>(&stmt);
+    if (block != nullptr && block->num_slots == 0) {
+        compile_scope(header, block->statements);
+        return;
+    }
+    line(header.empty() ? "{" : header + " {");
+    indent_++;
+    compile(stmt);
+    indent_--;
+    line("}");
+}
+
+std::string Emitter::compile_call(Call &call, bool tail_call) {
+    // 被调用者和参数从左到右求值
+    auto values = compile(*call.callee);
+    for (const auto &argument : call.arguments) {
+        values += ", " + compile(*argument);
+    }
+    return fmt::format("rt::{}<{}>({{{}}}, {})",
+                       tail_call ? "tail_call" : "call",
+                       call.arguments.size(),
+                       values,
+                       call.paren.line);
+}
+
+std::string Emitter::binary(const Token &op, Expr &left, Expr &right) {
+    auto l = compile(left);
+    auto r = compile(right);
+    return fmt::format("{}({{{}, {}}}, {})", operation(op.type), l, r, op.line);
+}
+
+void Emitter::compile_function(const Function &function) {
+    auto id = ids_.at(&function);
+    body_.clear();
+    indent_ = 1;
+    frames_.clear();
+    push_frame(function.body,
+               std::max<std::size_t>(function.num_slots,
+                                     function.params.size()));
+
+    if (function.captures.empty()) {
+        line("static_cast<void>(self);");
+    }
+    if (function.params.empty()) {
+        line("static_cast<void>(arguments);");
+    }
+
+    // 参数类型与注解一致时先执行特化版本
+    if (specialized_.count(&function) != 0) {
+        std::string condition;
+        std::string arguments;
+        for (std::size_t i = 0; i < function.params.size(); i++) {
+            // 注解为double的参数可以传入整数, as_number转换成浮点数
+            auto type = function.param_types[i];
+            auto name = type == static_type::INT      ? "int"
+                      : type == static_type::DOUBLE ? "number"
+                                                    : "bool";
+            if (i != 0) {
+                condition += " && ";
+                arguments += ", ";
+            }
+            condition += fmt::format("arguments[{}].is_{}()", i, name);
+            arguments += fmt::format("arguments[{}].as_{}()", i, name);
+        }
+        if (!condition.empty()) {
+            line(fmt::format("if ({}) {{", condition));
+            indent_++;
+        }
+        line("try {");
+        line(fmt::format("    return t{}({});", id, arguments));
+        line("} catch (const rt::Deoptimize &) {");
+        line("}");
+        if (!condition.empty()) {
+            indent_--;
+            line("}");
+        }
+    }
+
+    // 参数直接引用调用者的参数数组, 被捕获的参数复制到Box中
+    for (std::size_t i = 0; i < function.params.size(); i++) {
+        auto &frame = frames_.back();
+        auto name = fmt::format("l{}_{}", i, num_names_++);
+        if (frame.boxed[i]) {
+            line(fmt::format("rt::Box {} = rt::box(arguments[{}]);", name, i));
+        } else {
+            line(fmt::format(
+                "[[maybe_unused]] rt::Value &{} = arguments[{}];", name, i));
+        }
+        frame.names[i] = std::move(name);
+    }
+    for (const auto &stmt : function.body) {
+        compile(*stmt);
+    }
+    line("return {};");
+    frames_.pop_back();
+
+    definitions_ += fmt::format(
+        "rt::Value f{}(rt::Closure &self, rt::Value *arguments) {{\n", id);
+    definitions_ += body_;
+    definitions_ += "}\n\n";
+    body_.clear();
+}
+
+void Emitter::push_frame(const std::vector<std::unique_ptr<Stmt>> &stmts,
+                         std::size_t num_slots) {
+    Frame frame;
+    frame.names.resize(num_slots);
+    frame.boxed.resize(num_slots);
+    for (const auto &stmt : stmts) {
+        find_captured(*stmt, frame.boxed);
+    }
+    frames_.push_back(std::move(frame));
+}
+
+std::string Emitter::declare(unsigned int slot,
+                             const std::string &initializer) {
+    auto &frame = frames_.back();
+    auto name = fmt::format("l{}_{}", slot, num_names_++);
+    if (frame.boxed[slot]) {
+        line(fmt::format("rt::Box {} = rt::box({});", name, initializer));
+    } else if (initializer.empty()) {
+        line(fmt::format("rt::Value {};", name));
+    } else {
+        line(fmt::format("rt::Value {} = {};", name, initializer));
+    }
+    frame.names[slot] = name;
+    return name;
+}
+
+std::string Emitter::variable(int depth, unsigned int slot) const {
+    if (depth == GLOBAL_DEPTH) {
+        return fmt::format("g[{}]", slot);
+    }
+    if (depth == UPVALUE_DEPTH) {
+        return fmt::format("(*self.upvalues[{}])", slot);
+    }
+    if (depth == SELF_DEPTH) {
+        return "rt::Value{self.shared_from_this()}";
+    }
+    const auto &frame = frames_.back();
+    if (frame.boxed[slot]) {
+        return fmt::format("(*{})", frame.names[slot]);
+    }
+    return frame.names[slot];
+}
+
+std::string Emitter::constant(const Value &value) {
+    if (value.is_nil()) {
+        return "rt::Value{}";
+    }
+    if (value.is_bool()) {
+        return value.as_bool() ? "rt::Value{true}" : "rt::Value{false}";
+    }
+    if (value.is_int()) {
+        return fmt::format("rt::Value{{{}}}", int_literal(value.as_int()));
+    }
+    if (value.is_double()) {
+        return fmt::format("rt::Value{{{}}}",
+                           double_literal(value.as_double()));
+    }
+    // 字符串常量只创建一次
+    assert(value.is_string() && "unexpected literal");
+    auto text = value.as_string();
+    auto name = fmt::format("k{}", num_constants_++);
+    constants_ += fmt::format("const rt::Value {}{{std::string{{{}, {}}}}};\n",
+                              name,
+                              string_literal(text),
+                              text.size());
+    return name;
+}
+
+unsigned int Emitter::function_id(const Function *function) {
+    auto found = ids_.find(function);
+    if (found != ids_.end()) {
+        return found->second;
+    }
+    auto id = static_cast<unsigned int>(functions_.size());
+    ids_.emplace(function, id);
+    functions_.push_back(function);
+    pending_.push_back(function);
+    return id;
+}
+
+void Emitter::line(const std::string &text) {
+    body_.append(indent_ * 4, ' ');
+    body_ += text;
+    body_ += '\n';
+}
+
+Value Emitter::visit_binary_expr(Binary *expr) {
+    code_ = binary(expr->op, *expr->left, *expr->right);
+
+    return {};
+}
+
+Value Emitter::visit_grouping_expr(Grouping *expr) {
+    code_ = compile(*expr->expr);
+
+    return {};
+}
+
+Value Emitter::visit_literal_expr(Literal *expr) {
+    code_ = constant(expr->value);
+
+    return {};
+}
+
+Value Emitter::visit_logical_expr(Logical *expr) {
+    // 右操作数放在lambda中, 只在需要时求值
+    auto left = compile(*expr->left);
+    auto right = compile(*expr->right);
+    code_ = fmt::format("rt::{}({}, [&]() -> rt::Value {{ return {}; }})",
+                        expr->op.type == token_type::OR ? "logical_or"
+                                                        : "logical_and",
+                        left,
+                        right);
+
+    return {};
+}
+
+Value Emitter::visit_unary_expr(Unary *expr) {
+    auto right = compile(*expr->right);
+    if (expr->op.type == token_type::NOT) {
+        code_ = fmt::format("rt::Value{{!rt::is_truthy({})}}", right);
+    } else {
+        code_ = fmt::format("rt::negate({}, {})", right, expr->op.line);
+    }
+
+    return {};
+}
+
+Value Emitter::visit_variable_expr(Variable *expr) {
+    code_ = variable(expr->depth, expr->slot);
+
+    return {};
+}
+
+Value Emitter::visit_assign_expr(Assign *expr) {
+    auto value = compile(*expr->value);
+    code_ = fmt::format("({} = {})", variable(expr->depth, expr->slot), value);
+
+    return {};
+}
+
+Value Emitter::visit_call_expr(Call *expr) {
+    code_ = compile_call(*expr, false);
+
+    return {};
+}
+
+Value Emitter::visit_inline_call_expr(InlineCall *expr) {
+    // 普通的调用已经由C++编译器内联, 按原来的调用执行
+    code_ = compile_call(*expr->call, false);
+
+    return {};
+}
+
+Value Emitter::visit_increment_expr(Increment *expr) {
+    code_ = fmt::format("rt::increment({}, {}, {})",
+                        variable(expr->depth, expr->slot),
+                        int_literal(expr->delta),
+                        expr->op.line);
+
+    return {};
+}
+
+Value Emitter::visit_compare_expr(Compare *expr) {
+    code_ = binary(expr->op, *expr->variable, *expr->bound);
+
+    return {};
+}
+
+Value Emitter::visit_promote_expr(Promote *expr) {
+    code_ = fmt::format("rt::promote({})", compile(*expr->expr));
+
+    return {};
+}
+
+Completion Emitter::visit_block_stmt(Block *stmt) {
+    if (stmt->num_slots == 0) {
+        compile_scope("", stmt->statements);
+        return Completion::NORMAL;
+    }
+
+    // 不在函数中的块有自己的栈帧, 与解释器相同占用一层调用深度
+    push_frame(stmt->statements, stmt->num_slots);
+    line("{");
+    indent_++;
+    line("rt::CallDepth depth{0};");
+    for (const auto &s : stmt->statements) {
+        compile(*s);
+    }
+    indent_--;
+    line("}");
+    frames_.pop_back();
+
+    return Completion::NORMAL;
+}
+
+Completion Emitter::visit_expression_stmt(Expression *stmt) {
+    line(fmt::format("static_cast<void>({});", compile(*stmt->expression)));
+
+    return Completion::NORMAL;
+}
+
+Completion Emitter::visit_var_stmt(Var *stmt) {
+    std::string initializer;
+    if (stmt->initializer != nullptr) {
+        initializer = compile(*stmt->initializer);
+    }
+    if (stmt->depth == GLOBAL_DEPTH) {
+        line(fmt::format("g[{}] = {};",
+                         stmt->slot,
+                         initializer.empty() ? "rt::Value{}" : initializer));
+    } else {
+        declare(stmt->slot, initializer);
+    }
+
+    return Completion::NORMAL;
+}
+
+Completion Emitter::visit_if_stmt(If *stmt) {
+    auto condition = compile(*stmt->condition);
+    compile_scope(fmt::format("if (rt::is_truthy({}))", condition),
+                  *stmt->then_branch);
+    if (stmt->else_branch != nullptr) {
+        compile_scope("else", *stmt->else_branch);
+    }
+
+    return Completion::NORMAL;
+}
+
+Completion Emitter::visit_while_stmt(While *stmt) {
+    auto condition = compile(*stmt->condition);
+    compile_scope(fmt::format("while (rt::is_truthy({}))", condition),
+                  *stmt->body);
+
+    return Completion::NORMAL;
+}
+
+Completion Emitter::visit_function_stmt(Function *stmt) {
+    auto id = function_id(stmt);
+    if (stmt->depth == GLOBAL_DEPTH) {
+        line(fmt::format("g[{}] = rt::make_closure(f{}_info, {{}});",
+                         stmt->slot,
+                         id));
+        return Completion::NORMAL;
+    }
+
+    // 被捕获的函数名先声明, 函数可以捕获它自己
+    const auto &frame = frames_.back();
+    std::string name;
+    if (frame.boxed[stmt->slot]) {
+        name = declare(stmt->slot, "");
+    }
+    std::string upvalues;
+    for (const auto &capture : stmt->captures) {
+        if (!upvalues.empty()) {
+            upvalues += ", ";
+        }
+        upvalues += capture.is_local
+                      ? frames_.back().names[capture.index]
+                      : fmt::format("self.upvalues[{}]", capture.index);
+    }
+    auto closure
+        = fmt::format("rt::make_closure(f{}_info, {{{}}})", id, upvalues);
+    if (name.empty()) {
+        declare(stmt->slot, closure);
+    } else {
+        line(fmt::format("*{} = {};", name, closure));
+    }
+
+    return Completion::NORMAL;
+}
+
+Completion Emitter::visit_return_stmt(Return *stmt) {
+    if (stmt->value == nullptr) {
+        line("return {};");
+    } else if (stmt->tail_call) {
+        auto &call = static_cast<Call &>(*stmt->value);
+        line(fmt::format("return {};", compile_call(call, true)));
+    } else {
+        line(fmt::format("return {};", compile(*stmt->value)));
+    }
+
+    return Completion::NORMAL;
+}
+
+} // namespace zero::aot
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "ast/expr.hpp"
+#include "ast/program.hpp"
+#include "ast/stmt.hpp"
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace zero {
+class Interpreter;
+} // namespace zero
+
+namespace zero::aot {
+
+// 把优化和静态解析之后的Program翻译成独立的C++源码, 使用aot/runtime.hpp
+// 每个函数翻译成一个C++函数, 局部变量是C++的局部变量,
+// 被闭包捕获的槽位用共享的Box保存; 值是带类型标签的rt::Value
+// 被Specializer特化的函数额外生成一个参数和返回值都是原生类型的版本
+class Emitter : public ExprVisitor, public StmtVisitor {
+public:
+    // 全局变量的槽位由解释器分配, 原生函数也在其中
+    explicit Emitter(Interpreter &interpreter) : interpreter_{interpreter} {}
+
+public:
+    // source_name只用于生成的注释
+    std::string emit(const std::unique_ptr<Program> &program,
+                     const std::string &source_name);
+    std::size_t num_functions() const { return functions_.size(); }
+    std::size_t num_specialized() const { return specialized_.size(); }
+
+public:
+    // Expr抽象类方法, 生成的C++表达式保存在code_中
+    Value visit_binary_expr(Binary *expr) override;
+    Value visit_grouping_expr(Grouping *expr) override;
+    Value visit_literal_expr(Literal *expr) override;
+    Value visit_logical_expr(Logical *expr) override;
+    Value visit_unary_expr(Unary *expr) override;
+    Value visit_variable_expr(Variable *expr) override;
+    Value visit_assign_expr(Assign *expr) override;
+    Value visit_call_expr(Call *expr) override;
+    Value visit_inline_call_expr(InlineCall *expr) override;
+    Value visit_increment_expr(Increment *expr) override;
+    Value visit_compare_expr(Compare *expr) override;
+    Value visit_promote_expr(Promote *expr) override;
+
+    // Stmt抽象类方法, 生成的C++语句追加到body_中
+    Completion visit_block_stmt(Block *stmt) override;
+    Completion visit_expression_stmt(Expression *stmt) override;
+    Completion visit_var_stmt(Var *stmt) override;
+    Completion visit_if_stmt(If *stmt) override;
+    Completion visit_while_stmt(While *stmt) override;
+    Completion visit_function_stmt(Function *stmt) override;
+    Completion visit_return_stmt(Return *stmt) override;
+
+private:
+    // 一个栈帧中各个槽位当前对应的C++变量
+    struct Frame {
+        std::vector<std::string> names;
+        std::vector<bool> boxed; // 被闭包捕获的槽位
+    };
+
+    std::string compile(Expr &expr);
+    void compile(Stmt &stmt);
+    // 语句放在以header开头的C++块中, 块中声明的变量离开块后不再可见
+    void compile_scope(const std::string &header,
+                       const std::vector<std::unique_ptr<Stmt>> &stmts);
+    void compile_scope(const std::string &header, Stmt &stmt);
+    std::string compile_call(Call &call, bool tail_call);
+    std::string binary(const Token &op, Expr &left, Expr &right);
+    void compile_function(const Function &function);
+    // 生成所有特化版本的定义
+    std::string emit_typed();
+
+    // 开始一个新的栈帧, 找出其中被闭包捕获的槽位
+    void push_frame(const std::vector<std::unique_ptr<Stmt>> &stmts,
+                    std::size_t num_slots);
+    // 为槽位声明新的C++变量, 返回变量名
+    std::string declare(unsigned int slot, const std::string &initializer);
+    // 变量的左值表达式
+    std::string variable(int depth, unsigned int slot) const;
+    std::string constant(const Value &value);
+    unsigned int function_id(const Function *function);
+    void line(const std::string &text);
+
+private:
+    Interpreter &interpreter_;
+    std::unordered_map<const Function *, unsigned int> ids_;
+    std::vector<const Function *> functions_; // 按编号排列
+    std::vector<const Function *> pending_;   // 还没有生成函数体的函数
+    // 每个全局槽位中最后声明的特化函数, 特化的代码只能调用它们
+    std::unordered_map<unsigned int, const Function *> typed_;
+    std::unordered_set<const Function *> specialized_; // 生成了特化版本的函数
+
+    std::string constants_;   // 字符串常量的定义
+    unsigned int num_constants_{0};
+    std::string definitions_; // 所有函数的定义
+    std::string body_;        // 正在生成的函数体
+    std::string code_;        // 表达式生成的C++代码
+    unsigned int indent_{0};
+    unsigned int num_names_{0};
+    std::vector<Frame> frames_;
+};
+
+} // namespace zero::aot
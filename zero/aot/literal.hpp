@@ -0,0 +1,54 @@
+#pragma once
+
+#include "fmt/core.h"
+
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace zero::aot {
+
+// 生成的C++代码中的常量
+
+inline std::string int_literal(int64_t i) {
+    // -9223372036854775808不是合法的整数字面量
+    if (i == INT64_MIN) {
+        return "INT64_MIN";
+    }
+    return fmt::format("INT64_C({})", i);
+}
+
+inline std::string double_literal(double d) {
+    if (std::isnan(d)) {
+        return std::signbit(d) ? "-NAN" : "NAN";
+    }
+    if (std::isinf(d)) {
+        return d > 0 ? "HUGE_VAL" : "-HUGE_VAL";
+    }
+    // 最短的能还原出原值的表示, 没有小数点和指数时补上".0"
+    auto text = fmt::format("{}", d);
+    if (text.find_first_of(".e") == std::string::npos) {
+        text += ".0";
+    }
+    return text;
+}
+
+inline std::string string_literal(std::string_view text) {
+    std::string result = "\"";
+    for (unsigned char c : text) {
+        if (c == '"' || c == '\\') {
+            result += '\\';
+            result += static_cast<char>(c);
+        } else if (c < 0x20 || c >= 0x7f) {
+            // 固定三位八进制, 不会与后面的数字连在一起
+            result += fmt::format("\\{:03o}", c);
+        } else {
+            result += static_cast<char>(c);
+        }
+    }
+    result += '"';
+    return result;
+}
+
+} // namespace zero::aot
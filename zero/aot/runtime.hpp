@@ -0,0 +1,656 @@
+#pragma once
+
+// --emit-cpp生成的C++代码使用的运行时, 只依赖标准库, 生成的代码用
+// g++ -std=c++17 -I zero out.cpp编译
+// 值的语义与解释器相同: 整数运算溢出时提升为double, 错误信息和行号一致
+
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace zero::aot {
+
+class Value;
+struct Closure;
+
+// 与解释器相同, 更深的调用报告栈溢出
+constexpr unsigned int MAX_CALL_DEPTH = 4096;
+
+// 运行时错误, 由main按解释器的格式输出
+struct RuntimeError {
+    unsigned int line;
+    std::string message;
+};
+
+// 特化的代码整数溢出, 除以0, 被调用的全局函数被重新赋值时抛出,
+// 由普通版本重新执行整个调用, 特化的函数没有副作用
+struct Deoptimize {};
+
+struct Object {
+    virtual ~Object() = default;
+};
+
+struct String : Object {
+    explicit String(std::string text) : text{std::move(text)} {}
+
+    std::string text;
+};
+
+using Code = Value (*)(Closure &self, Value *arguments);
+using NativeCode = Value (*)(const Value *arguments);
+
+struct Native {
+    NativeCode code;
+};
+
+class Memo;
+
+// 每个函数声明对应一个
+struct FunctionInfo {
+    const char *name;
+    std::size_t arity;
+    Code code;
+    Memo *memo; // 记忆化的函数才有
+};
+
+enum class value_type : uint8_t {
+    NIL,
+    BOOL,
+    INT,
+    DOUBLE,
+    STRING,
+    FUNCTION,
+    NATIVE_FUNCTION,
+    TAIL_CALL, // 函数执行了尾调用, 被调用者和参数保存在pending_call中
+};
+
+class Value {
+public:
+    Value() = default;
+    Value(std::nullptr_t) {}
+    Value(bool b) : type_{value_type::BOOL} { as_.b = b; }
+    Value(int i) : Value{static_cast<int64_t>(i)} {}
+    Value(int64_t i) : type_{value_type::INT} { as_.i = i; }
+    Value(double d) : type_{value_type::DOUBLE} { as_.d = d; }
+    Value(const char *text) : Value{std::string{text}} {}
+    Value(std::string text)
+        : type_{value_type::STRING},
+          object_{std::make_shared<String>(std::move(text))} {}
+    Value(std::shared_ptr<Closure> closure);
+    Value(const Native *native) : type_{value_type::NATIVE_FUNCTION} {
+        as_.native = native;
+    }
+
+    static Value tail_call() {
+        Value value;
+        value.type_ = value_type::TAIL_CALL;
+        return value;
+    }
+
+public:
+    value_type type() const { return type_; }
+    bool is_nil() const { return type_ == value_type::NIL; }
+    bool is_bool() const { return type_ == value_type::BOOL; }
+    bool is_int() const { return type_ == value_type::INT; }
+    bool is_double() const { return type_ == value_type::DOUBLE; }
+    bool is_number() const { return is_int() || is_double(); }
+    bool is_string() const { return type_ == value_type::STRING; }
+    bool is_function() const { return type_ == value_type::FUNCTION; }
+    bool is_native_function() const {
+        return type_ == value_type::NATIVE_FUNCTION;
+    }
+    bool is_tail_call() const { return type_ == value_type::TAIL_CALL; }
+
+    bool as_bool() const { return as_.b; }
+    int64_t as_int() const { return as_.i; }
+    double as_double() const { return as_.d; }
+    double as_number() const {
+        return is_int() ? static_cast<double>(as_.i) : as_.d;
+    }
+    const std::string &as_string() const {
+        return static_cast<const String *>(object_.get())->text;
+    }
+    Closure &as_function() const;
+    const Native *as_native_function() const { return as_.native; }
+    const Object *as_object() const { return object_.get(); }
+
+private:
+    value_type type_{value_type::NIL};
+    union {
+        bool b;
+        int64_t i;
+        double d;
+        const Native *native;
+    } as_{};
+    std::shared_ptr<Object> object_;
+};
+
+// 被闭包捕获的变量, 声明它的栈帧和所有捕获它的闭包共享
+using Box = std::shared_ptr<Value>;
+
+inline Box box(Value value = {}) {
+    return std::make_shared<Value>(std::move(value));
+}
+
+// 函数体引用自己时通过shared_from_this取得, 不捕获自己, 不会形成引用环
+struct Closure : Object, std::enable_shared_from_this<Closure> {
+    Closure(const FunctionInfo *info, std::vector<Box> upvalues)
+        : info{info}, upvalues{std::move(upvalues)} {}
+
+    const FunctionInfo *info;
+    std::vector<Box> upvalues; // 按Function::captures的顺序
+};
+
+inline Value::Value(std::shared_ptr<Closure> closure)
+    : type_{value_type::FUNCTION}, object_{std::move(closure)} {}
+
+inline Closure &Value::as_function() const {
+    return *static_cast<Closure *>(object_.get());
+}
+
+inline Value make_closure(const FunctionInfo &info, std::vector<Box> upvalues) {
+    return Value{std::make_shared<Closure>(&info, std::move(upvalues))};
+}
+
+// 二元运算的两个操作数, 花括号初始化保证从左到右求值
+struct Operands {
+    Value left;
+    Value right;
+};
+
+// 与解释器的stringify相同: 浮点数是最短的能还原出原值的表示,
+// 指数在[-4, 16)之间时不用科学计数法, 整数值带上".0"
+inline std::string format_double(double d) {
+    if (std::isnan(d)) {
+        return std::signbit(d) ? "-nan" : "nan";
+    }
+    if (std::isinf(d)) {
+        return d > 0 ? "inf" : "-inf";
+    }
+
+    char buffer[32];
+    auto end = std::to_chars(
+                   buffer, buffer + sizeof buffer, d,
+                   std::chars_format::scientific)
+                   .ptr;
+    std::string text{buffer, end};
+    std::string sign;
+    if (text[0] == '-') {
+        sign = "-";
+        text.erase(0, 1);
+    }
+    auto e = text.find('e');
+    int exponent = std::stoi(text.substr(e + 1));
+    std::string digits = text.substr(0, e);
+    if (digits.size() > 1) {
+        digits.erase(1, 1); // 小数点
+    }
+
+    std::string result;
+    if (exponent < -4 || exponent >= 16) {
+        result = digits.substr(0, 1);
+        if (digits.size() > 1) {
+            result += "." + digits.substr(1);
+        }
+        auto magnitude = std::to_string(exponent < 0 ? -exponent : exponent);
+        if (magnitude.size() < 2) {
+            magnitude = "0" + magnitude;
+        }
+        result += (exponent < 0 ? "e-" : "e+") + magnitude;
+    } else if (exponent < 0) {
+        result = "0." + std::string(-exponent - 1, '0') + digits;
+    } else if (static_cast<std::size_t>(exponent) + 1 >= digits.size()) {
+        result = digits + std::string(exponent + 1 - digits.size(), '0')
+               + ".0";
+    } else {
+        result = digits.substr(0, exponent + 1) + "."
+               + digits.substr(exponent + 1);
+    }
+    return sign + result;
+}
+
+inline std::string stringify(const Value &value) {
+    switch (value.type()) {
+        case value_type::NIL:
+            return "nil";
+        case value_type::BOOL:
+            return value.as_bool() ? "true" : "false";
+        case value_type::INT:
+            return std::to_string(value.as_int());
+        case value_type::DOUBLE:
+            return format_double(value.as_double());
+        case value_type::STRING:
+            return value.as_string();
+        case value_type::FUNCTION:
+            return std::string{"<fn "} + value.as_function().info->name + ">";
+        case value_type::NATIVE_FUNCTION:
+            return "<native fn>";
+        default:
+            return "Error in 'stringify': object type not supported.";
+    }
+}
+
+inline bool is_truthy(const Value &value) {
+    if (value.is_nil()) {
+        return false;
+    }
+    if (value.is_bool()) {
+        return value.as_bool();
+    }
+    return true;
+}
+
+inline bool is_equal(const Value &a, const Value &b) {
+    if (a.type() != b.type()) {
+        // 整数和浮点数按数值比较
+        if (a.is_number() && b.is_number()) {
+            return a.as_number() == b.as_number();
+        }
+        return false;
+    }
+
+    switch (a.type()) {
+        case value_type::NIL:
+            return true;
+        case value_type::BOOL:
+            return a.as_bool() == b.as_bool();
+        case value_type::INT:
+            return a.as_int() == b.as_int();
+        case value_type::DOUBLE:
+            return a.as_double() == b.as_double();
+        case value_type::STRING:
+            return a.as_string() == b.as_string();
+        case value_type::NATIVE_FUNCTION:
+            return a.as_native_function() == b.as_native_function();
+        default:
+            // 函数按引用比较
+            return a.as_object() == b.as_object();
+    }
+}
+
+// 动态类型的运算, 检查操作数类型, 错误信息与解释器相同
+inline void check_number_operand(const Value &operand, unsigned int line) {
+    if (!operand.is_number()) {
+        throw RuntimeError{line, "Operand must be a number."};
+    }
+}
+
+inline void check_number_operands(const Operands &operands,
+                                  unsigned int line) {
+    if (!operands.left.is_number() || !operands.right.is_number()) {
+        throw RuntimeError{line, "Operands must be numbers."};
+    }
+}
+
+inline Value add(const Operands &operands, unsigned int line) {
+    const auto &[a, b] = operands;
+    if (a.is_int() && b.is_int()) {
+        int64_t result;
+        if (!__builtin_add_overflow(a.as_int(), b.as_int(), &result)) {
+            return result;
+        }
+    }
+    if (a.is_number() && b.is_number()) {
+        return a.as_number() + b.as_number();
+    }
+    if (a.is_string() && b.is_string()) {
+        return a.as_string() + b.as_string();
+    }
+    throw RuntimeError{line, "Operands must be two numbers or two strings."};
+}
+
+inline Value subtract(const Operands &operands, unsigned int line) {
+    check_number_operands(operands, line);
+    const auto &[a, b] = operands;
+    int64_t result;
+    if (a.is_int() && b.is_int()
+        && !__builtin_sub_overflow(a.as_int(), b.as_int(), &result)) {
+        return result;
+    }
+    return a.as_number() - b.as_number();
+}
+
+inline Value multiply(const Operands &operands, unsigned int line) {
+    check_number_operands(operands, line);
+    const auto &[a, b] = operands;
+    int64_t result;
+    if (a.is_int() && b.is_int()
+        && !__builtin_mul_overflow(a.as_int(), b.as_int(), &result)) {
+        return result;
+    }
+    return a.as_number() * b.as_number();
+}
+
+inline Value divide(const Operands &operands, unsigned int line) {
+    check_number_operands(operands, line);
+    const auto &[a, b] = operands;
+    if (a.is_int() && b.is_int()) {
+        if (b.as_int() == 0) {
+            throw RuntimeError{line, "Division by zero."};
+        }
+        if (!(a.as_int() == INT64_MIN && b.as_int() == -1)) {
+            return a.as_int() / b.as_int();
+        }
+    }
+    return a.as_number() / b.as_number();
+}
+
+inline Value negate(const Value &operand, unsigned int line) {
+    check_number_operand(operand, line);
+    if (operand.is_int() && operand.as_int() != INT64_MIN) {
+        return -operand.as_int();
+    }
+    return -operand.as_number();
+}
+
+// 注解为double的参数, 返回值和变量处的转换
+inline Value promote(const Value &value) {
+    if (value.is_int()) {
+        return static_cast<double>(value.as_int());
+    }
+    return value;
+}
+
+// 循环优化生成的归纳变量更新
+inline Value increment(Value &variable, int64_t delta, unsigned int line) {
+    check_number_operand(variable, line);
+    return variable = add({variable, delta}, line);
+}
+
+#define ZERO_AOT_COMPARE(name, op)                                             \
+    inline Value name(const Operands &operands, unsigned int line) {           \
+        check_number_operands(operands, line);                                 \
+        const auto &[a, b] = operands;                                         \
+        if (a.is_int() && b.is_int()) {                                        \
+            return a.as_int() op b.as_int();                                   \
+        }                                                                      \
+        return a.as_number() op b.as_number();                                 \
+    }
+ZERO_AOT_COMPARE(less, <)
+ZERO_AOT_COMPARE(less_equal, <=)
+ZERO_AOT_COMPARE(greater, >)
+ZERO_AOT_COMPARE(greater_equal, >=)
+#undef ZERO_AOT_COMPARE
+
+inline Value equal(const Operands &operands, unsigned int) {
+    return is_equal(operands.left, operands.right);
+}
+
+inline Value not_equal(const Operands &operands, unsigned int) {
+    return !is_equal(operands.left, operands.right);
+}
+
+// 右操作数只在需要时求值
+template <typename Right>
+Value logical_and(Value left, Right right) {
+    if (!is_truthy(left)) {
+        return left;
+    }
+    return right();
+}
+
+template <typename Right>
+Value logical_or(Value left, Right right) {
+    if (is_truthy(left)) {
+        return left;
+    }
+    return right();
+}
+
+// 参数都是值类型的调用结果, 键是参数的类型和内容
+class Memo {
+public:
+    static bool key(const Value *arguments, std::size_t n, std::string &key) {
+        for (std::size_t i = 0; i < n; i++) {
+            const auto &argument = arguments[i];
+            key += static_cast<char>(argument.type());
+            switch (argument.type()) {
+                case value_type::NIL:
+                    break;
+                case value_type::BOOL:
+                    key += argument.as_bool() ? '1' : '0';
+                    break;
+                case value_type::INT: {
+                    auto i = argument.as_int();
+                    key.append(reinterpret_cast<const char *>(&i), sizeof i);
+                    break;
+                }
+                case value_type::DOUBLE: {
+                    auto d = argument.as_double();
+                    key.append(reinterpret_cast<const char *>(&d), sizeof d);
+                    break;
+                }
+                case value_type::STRING: {
+                    auto size = argument.as_string().size();
+                    key.append(reinterpret_cast<const char *>(&size),
+                               sizeof size);
+                    key += argument.as_string();
+                    break;
+                }
+                default:
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    const Value *find(const std::string &key) const {
+        auto found = table_.find(key);
+        return found == table_.end() ? nullptr : &found->second;
+    }
+
+    void insert(std::string key, Value result) {
+        table_.emplace(std::move(key), std::move(result));
+    }
+
+private:
+    std::unordered_map<std::string, Value> table_;
+};
+
+// 函数调用深度, 超过限制时报告栈溢出
+inline unsigned int call_depth = 0;
+
+class CallDepth {
+public:
+    explicit CallDepth(unsigned int line) {
+        if (call_depth == MAX_CALL_DEPTH) {
+            throw RuntimeError{line, "Stack overflow."};
+        }
+        call_depth++;
+    }
+    ~CallDepth() { call_depth--; }
+
+    CallDepth(const CallDepth &) = delete;
+    CallDepth &operator=(const CallDepth &) = delete;
+};
+
+// 特化的函数之间的调用深度, 与解释器相同, 普通版本进入的最外层调用不计入,
+// 超过限制时退回普通版本, 由它报告栈溢出
+inline unsigned int typed_depth = 0;
+
+class TypedDepth {
+public:
+    TypedDepth() {
+        if (typed_depth > MAX_CALL_DEPTH) {
+            throw Deoptimize{};
+        }
+        typed_depth++;
+    }
+    ~TypedDepth() { typed_depth--; }
+
+    TypedDepth(const TypedDepth &) = delete;
+    TypedDepth &operator=(const TypedDepth &) = delete;
+};
+
+// 尾调用的被调用者和参数, 由call取走后执行
+struct PendingCall {
+    Value callee;
+    std::vector<Value> arguments;
+};
+inline PendingCall pending_call;
+
+// 执行函数体, 尾调用在这里循环执行, 不再嵌套C++调用
+inline Value execute(Closure &closure, Value *arguments) {
+    Value result = closure.info->code(closure, arguments);
+    if (!result.is_tail_call()) {
+        return result;
+    }
+    Value callee;
+    std::vector<Value> values;
+    while (result.is_tail_call()) {
+        callee = std::move(pending_call.callee);
+        values = std::move(pending_call.arguments);
+        auto &next = callee.as_function();
+        result = next.info->code(next, values.data());
+    }
+    return result;
+}
+
+// values[0]是被调用者, 之后是参数
+inline Value call_values(Value *values,
+                         std::size_t num_arguments,
+                         unsigned int line) {
+    const auto &callee = values[0];
+    auto *arguments = values + 1;
+    if (callee.is_native_function()) {
+        return callee.as_native_function()->code(arguments);
+    }
+    if (!callee.is_function()) {
+        throw RuntimeError{line, "Can only call functions and classes."};
+    }
+
+    auto &closure = callee.as_function();
+    const auto *info = closure.info;
+    CallDepth depth{line};
+    if (num_arguments != info->arity) {
+        throw RuntimeError{line,
+                           "Expected " + std::to_string(info->arity)
+                               + " arguments but got "
+                               + std::to_string(num_arguments) + "."};
+    }
+    if (info->memo == nullptr) {
+        return execute(closure, arguments);
+    }
+
+    // 函数体可能修改参数, 先算出记忆表的键
+    std::string key;
+    if (!Memo::key(arguments, num_arguments, key)) {
+        return execute(closure, arguments);
+    }
+    if (const Value *result = info->memo->find(key)) {
+        return *result;
+    }
+    Value result = execute(closure, arguments);
+    info->memo->insert(std::move(key), result);
+    return result;
+}
+
+template <std::size_t N>
+Value call(std::array<Value, N + 1> values, unsigned int line) {
+    return call_values(values.data(), N, line);
+}
+
+// return语句中的调用, 被调用者是函数时由外层的call执行
+template <std::size_t N>
+Value tail_call(std::array<Value, N + 1> values, unsigned int line) {
+    auto &callee = values[0];
+    if (!callee.is_function()) {
+        return call_values(values.data(), N, line);
+    }
+    auto arity = callee.as_function().info->arity;
+    if (N != arity) {
+        throw RuntimeError{line,
+                           "Expected " + std::to_string(arity)
+                               + " arguments but got " + std::to_string(N)
+                               + "."};
+    }
+    pending_call.callee = std::move(callee);
+    pending_call.arguments.assign(std::make_move_iterator(values.begin() + 1),
+                                  std::make_move_iterator(values.end()));
+    return Value::tail_call();
+}
+
+// 特化代码中的整数运算, 结果与普通版本不同时退回普通版本
+inline int64_t checked_add(int64_t a, int64_t b) {
+    int64_t result;
+    if (__builtin_add_overflow(a, b, &result)) {
+        throw Deoptimize{};
+    }
+    return result;
+}
+
+inline int64_t checked_subtract(int64_t a, int64_t b) {
+    int64_t result;
+    if (__builtin_sub_overflow(a, b, &result)) {
+        throw Deoptimize{};
+    }
+    return result;
+}
+
+inline int64_t checked_multiply(int64_t a, int64_t b) {
+    int64_t result;
+    if (__builtin_mul_overflow(a, b, &result)) {
+        throw Deoptimize{};
+    }
+    return result;
+}
+
+inline int64_t checked_divide(int64_t a, int64_t b) {
+    if (b == 0 || (a == INT64_MIN && b == -1)) {
+        throw Deoptimize{};
+    }
+    return a / b;
+}
+
+inline int64_t checked_negate(int64_t a) {
+    if (a == INT64_MIN) {
+        throw Deoptimize{};
+    }
+    return -a;
+}
+
+// 特化代码调用的全局函数必须仍然是编译时的函数
+inline void expect_function(const Value &callee, const FunctionInfo &info) {
+    if (!callee.is_function() || callee.as_function().info != &info) {
+        throw Deoptimize{};
+    }
+}
+
+// 原生函数
+inline Value print(const Value *arguments) {
+    auto text = stringify(arguments[0]);
+    text += '\n';
+    std::fwrite(text.data(), 1, text.size(), stdout);
+    return 0;
+}
+
+inline Value clock(const Value *) {
+    return static_cast<double>(std::time(nullptr));
+}
+
+inline Value read_file(const Value *arguments) {
+    if (!arguments[0].is_string()) {
+        return {};
+    }
+    std::printf("reading %s ...\n", arguments[0].as_string().c_str());
+    // 与解释器相同, 不读取真实的文件
+    return "example text";
+}
+
+inline const Native PRINT{print};
+inline const Native CLOCK{clock};
+inline const Native READ_FILE{read_file};
+
+inline void report(const RuntimeError &error) {
+    std::printf("[Line %u] %s\n", error.line, error.message.c_str());
+}
+
+} // namespace zero::aot
@@ -0,0 +1,469 @@
+#include "typed_emitter.hpp"
+
+#include "fmt/core.h"
+#include "literal.hpp"
+
+#include <algorithm>
+
+namespace zero::aot {
+
+namespace {
+bool is_specializable(static_type type) {
+    return type == static_type::INT || type == static_type::DOUBLE
+        || type == static_type::BOOL;
+}
+
+bool is_numeric(static_type type) {
+    return type == static_type::INT || type == static_type::DOUBLE;
+}
+
+// 括号只影响解析
+Expr &unwrap(Expr &expr) {
+    Expr *inner = &expr;
+    while (auto *grouping = dynamic_cast<Grouping *>(inner)) {
+        inner = grouping->expr.get();
+    }
+    return *inner;
+}
+
+const char *checked_operation(token_type op) {
+    switch (op) {
+        case token_type::PLUS:
+            return "rt::checked_add";
+        case token_type::MINUS:
+            return "rt::checked_subtract";
+        case token_type::STAR:
+            return "rt::checked_multiply";
+        default:
+            return "rt::checked_divide";
+    }
+}
+
+const char *cpp_operator(token_type op) {
+    switch (op) {
+        case token_type::PLUS:
+            return "+";
+        case token_type::MINUS:
+            return "-";
+        case token_type::STAR:
+            return "*";
+        case token_type::SLASH:
+            return "/";
+        case token_type::EQUAL_EQUAL:
+            return "==";
+        case token_type::NOT_EQUAL:
+            return "!=";
+        case token_type::GREATER:
+            return ">";
+        case token_type::GREATER_EQUAL:
+            return ">=";
+        case token_type::LESS:
+            return "<";
+        default:
+            return "<=";
+    }
+}
+} // namespace
+
+const char *TypedEmitter::cpp_type(static_type type) {
+    switch (type) {
+        case static_type::INT:
+            return "int64_t";
+        case static_type::DOUBLE:
+            return "double";
+        default:
+            return "bool";
+    }
+}
+
+bool TypedEmitter::emit(const Function &function, std::string &definition) {
+    function_ = &function;
+    auto size = std::max<std::size_t>(function.num_slots,
+                                      function.params.size());
+    names_.assign(size, "");
+    types_.assign(size, static_type::ANY);
+    num_names_ = 0;
+    body_.clear();
+    indent_ = 1;
+
+    std::string params;
+    for (std::size_t i = 0; i < function.params.size(); i++) {
+        names_[i] = fmt::format("l{}_{}", i, num_names_++);
+        types_[i] = function.param_types[i];
+        if (i != 0) {
+            params += ", ";
+        }
+        params += fmt::format("{} {}", cpp_type(types_[i]), names_[i]);
+    }
+
+    try {
+        line("rt::TypedDepth depth;");
+        for (const auto &stmt : function.body) {
+            compile(*stmt);
+        }
+        // 没有执行到return时普通版本返回nil
+        line("throw rt::Deoptimize{};");
+    } catch (const Unsupported &) {
+        return false;
+    }
+
+    definition += fmt::format("{} t{}({}) {{\n",
+                              cpp_type(function.return_type),
+                              ids_.at(&function),
+                              params);
+    definition += body_;
+    definition += "}\n\n";
+    return true;
+}
+
+static_type TypedEmitter::compile(Expr &expr, std::string &code) {
+    expr.accept(*this);
+    code = std::move(code_);
+    return type_;
+}
+
+void TypedEmitter::compile(Stmt &stmt) { stmt.accept(*this); }
+
+void TypedEmitter::compile_scope(
+    const std::string &header,
+    const std::vector<std::unique_ptr<Stmt>> &stmts) {
+    // 块中声明的变量离开块后不再可见, 槽位恢复成之前的变量
+    auto names = names_;
+    line(header.empty() ? "{" : header + " {");
+    indent_++;
+    for (const auto &stmt : stmts) {
+        compile(*stmt);
+    }
+    indent_--;
+    line("}");
+    names_ = std::move(names);
+}
+
+void TypedEmitter::compile_scope(const std::string &header, Stmt &stmt) {
+    if (auto *block = dynamic_cast<Block *>(&stmt)) {
+        // 函数中的块使用函数的栈帧, 特化的函数中也没有被捕获的变量
+        if (block->num_slots != 0 || block->has_captured) {
+            throw Unsupported{};
+        }
+        compile_scope(header, block->statements);
+        return;
+    }
+    auto names = names_;
+    line(header.empty() ? "{" : header + " {");
+    indent_++;
+    compile(stmt);
+    indent_--;
+    line("}");
+    names_ = std::move(names);
+}
+
+std::string TypedEmitter::compile_condition(Expr &expr) {
+    std::string code;
+    if (compile(expr, code) != static_type::BOOL) {
+        throw Unsupported{};
+    }
+    return code;
+}
+
+const std::string &TypedEmitter::local(int depth, unsigned int slot) const {
+    // 只能访问局部变量, 与Specializer相同
+    if (depth != LOCAL_DEPTH || !is_specializable(types_[slot])
+        || names_[slot].empty()) {
+        throw Unsupported{};
+    }
+    return names_[slot];
+}
+
+void TypedEmitter::line(const std::string &text) {
+    body_.append(indent_ * 4, ' ');
+    body_ += text;
+    body_ += '\n';
+}
+
+void TypedEmitter::compile_call(Call &call) {
+    // 只能调用特化的全局函数, 参数类型与注解完全相同
+    auto *variable = dynamic_cast<Variable *>(call.callee.get());
+    if (variable == nullptr || variable->depth != GLOBAL_DEPTH) {
+        throw Unsupported{};
+    }
+    auto found = callees_.find(variable->slot);
+    if (found == callees_.end()
+        || found->second->params.size() != call.arguments.size()) {
+        throw Unsupported{};
+    }
+    const auto *callee = found->second;
+
+    std::string arguments;
+    for (std::size_t i = 0; i < call.arguments.size(); i++) {
+        std::string argument;
+        if (compile(*call.arguments[i], argument) != callee->param_types[i]) {
+            throw Unsupported{};
+        }
+        if (i != 0) {
+            arguments += ", ";
+        }
+        arguments += argument;
+    }
+
+    // 全局变量被重新赋值时退回普通版本
+    auto id = ids_.at(callee);
+    code_ = fmt::format("(rt::expect_function(g[{}], f{}_info), t{}({}))",
+                        variable->slot,
+                        id,
+                        id,
+                        arguments);
+    type_ = callee->return_type;
+}
+
+void TypedEmitter::compile_binary(const Token &op, Expr &left, Expr &right) {
+    std::string codes[2];
+    static_type types[2];
+    types[0] = compile(unwrap(left), codes[0]);
+    types[1] = compile(unwrap(right), codes[1]);
+
+    auto type = op.type;
+    bool comparison = type != token_type::PLUS && type != token_type::MINUS
+                   && type != token_type::STAR && type != token_type::SLASH;
+    if (types[0] == static_type::BOOL && types[1] == static_type::BOOL
+        && (type == token_type::EQUAL_EQUAL
+            || type == token_type::NOT_EQUAL)) {
+        code_ = fmt::format(
+            "({} {} {})", codes[0], cpp_operator(type), codes[1]);
+        type_ = static_type::BOOL;
+        return;
+    }
+    if (!is_numeric(types[0]) || !is_numeric(types[1])) {
+        throw Unsupported{};
+    }
+    if (types[0] == static_type::INT && types[1] == static_type::INT) {
+        if (comparison) {
+            code_ = fmt::format(
+                "({} {} {})", codes[0], cpp_operator(type), codes[1]);
+            type_ = static_type::BOOL;
+        } else {
+            code_ = fmt::format(
+                "{}({}, {})", checked_operation(type), codes[0], codes[1]);
+            type_ = static_type::INT;
+        }
+        return;
+    }
+
+    // 整数和浮点数运算时整数先转换成浮点数
+    for (auto i = 0; i < 2; i++) {
+        if (types[i] == static_type::INT) {
+            codes[i] = fmt::format("static_cast<double>({})", codes[i]);
+        }
+    }
+    code_ = fmt::format("({} {} {})", codes[0], cpp_operator(type), codes[1]);
+    type_ = comparison ? static_type::BOOL : static_type::DOUBLE;
+}
+
+Value TypedEmitter::visit_binary_expr(Binary *expr) {
+    compile_binary(expr->op, *expr->left, *expr->right);
+
+    return {};
+}
+
+Value TypedEmitter::visit_grouping_expr(Grouping *expr) {
+    type_ = compile(*expr->expr, code_);
+
+    return {};
+}
+
+Value TypedEmitter::visit_literal_expr(Literal *expr) {
+    const auto &value = expr->value;
+    if (value.is_int()) {
+        code_ = int_literal(value.as_int());
+        type_ = static_type::INT;
+    } else if (value.is_double()) {
+        code_ = double_literal(value.as_double());
+        type_ = static_type::DOUBLE;
+    } else if (value.is_bool()) {
+        code_ = value.as_bool() ? "true" : "false";
+        type_ = static_type::BOOL;
+    } else {
+        throw Unsupported{};
+    }
+
+    return {};
+}
+
+Value TypedEmitter::visit_logical_expr(Logical *expr) {
+    auto left = compile_condition(*expr->left);
+    auto right = compile_condition(*expr->right);
+    code_ = fmt::format("({} {} {})",
+                        left,
+                        expr->op.type == token_type::OR ? "||" : "&&",
+                        right);
+    type_ = static_type::BOOL;
+
+    return {};
+}
+
+Value TypedEmitter::visit_unary_expr(Unary *expr) {
+    std::string right;
+    auto type = compile(*expr->right, right);
+    if (expr->op.type == token_type::NOT) {
+        if (type != static_type::BOOL) {
+            throw Unsupported{};
+        }
+        code_ = fmt::format("(!{})", right);
+    } else if (type == static_type::INT) {
+        code_ = fmt::format("rt::checked_negate({})", right);
+    } else if (type == static_type::DOUBLE) {
+        code_ = fmt::format("(-{})", right);
+    } else {
+        throw Unsupported{};
+    }
+    type_ = type;
+
+    return {};
+}
+
+Value TypedEmitter::visit_variable_expr(Variable *expr) {
+    code_ = local(expr->depth, expr->slot);
+    type_ = types_[expr->slot];
+
+    return {};
+}
+
+Value TypedEmitter::visit_assign_expr(Assign *expr) {
+    const auto &name = local(expr->depth, expr->slot);
+    auto type = types_[expr->slot];
+    std::string value;
+    if (compile(*expr->value, value) != type) {
+        throw Unsupported{};
+    }
+    code_ = fmt::format("({} = {})", name, value);
+    type_ = type;
+
+    return {};
+}
+
+Value TypedEmitter::visit_call_expr(Call *expr) {
+    compile_call(*expr);
+
+    return {};
+}
+
+Value TypedEmitter::visit_inline_call_expr(InlineCall *expr) {
+    // 特化的调用已经足够快, 按原来的调用执行
+    compile_call(*expr->call);
+
+    return {};
+}
+
+Value TypedEmitter::visit_increment_expr(Increment *expr) {
+    const auto &name = local(expr->depth, expr->slot);
+    auto type = types_[expr->slot];
+    if (type == static_type::INT) {
+        code_ = fmt::format("({} = rt::checked_add({}, {}))",
+                            name,
+                            name,
+                            int_literal(expr->delta));
+    } else if (type == static_type::DOUBLE) {
+        code_ = fmt::format(
+            "({} += {})",
+            name,
+            double_literal(static_cast<double>(expr->delta)));
+    } else {
+        throw Unsupported{};
+    }
+    type_ = type;
+
+    return {};
+}
+
+Value TypedEmitter::visit_compare_expr(Compare *expr) {
+    compile_binary(expr->op, *expr->variable, *expr->bound);
+
+    return {};
+}
+
+Value TypedEmitter::visit_promote_expr(Promote *expr) {
+    std::string code;
+    auto type = compile(*expr->expr, code);
+    if (type == static_type::INT) {
+        code_ = fmt::format("static_cast<double>({})", code);
+        type_ = static_type::DOUBLE;
+    } else if (type == static_type::DOUBLE) {
+        code_ = std::move(code);
+        type_ = type;
+    } else {
+        throw Unsupported{};
+    }
+
+    return {};
+}
+
+Completion TypedEmitter::visit_block_stmt(Block *stmt) {
+    compile_scope("", *stmt);
+
+    return Completion::NORMAL;
+}
+
+Completion TypedEmitter::visit_expression_stmt(Expression *stmt) {
+    std::string expression;
+    compile(*stmt->expression, expression);
+    line(fmt::format("static_cast<void>({});", expression));
+
+    return Completion::NORMAL;
+}
+
+Completion TypedEmitter::visit_var_stmt(Var *stmt) {
+    // 变量的类型由注解或者初始值确定
+    if (stmt->depth != LOCAL_DEPTH || stmt->initializer == nullptr) {
+        throw Unsupported{};
+    }
+    std::string initializer;
+    auto initializer_type = compile(*stmt->initializer, initializer);
+    auto type = stmt->type == static_type::ANY ? initializer_type : stmt->type;
+    if (!is_specializable(type) || initializer_type != type) {
+        throw Unsupported{};
+    }
+
+    auto name = fmt::format("l{}_{}", stmt->slot, num_names_++);
+    line(fmt::format("{} {} = {};", cpp_type(type), name, initializer));
+    names_[stmt->slot] = std::move(name);
+    types_[stmt->slot] = type;
+
+    return Completion::NORMAL;
+}
+
+Completion TypedEmitter::visit_if_stmt(If *stmt) {
+    compile_scope(fmt::format("if ({})", compile_condition(*stmt->condition)),
+                  *stmt->then_branch);
+    if (stmt->else_branch != nullptr) {
+        compile_scope("else", *stmt->else_branch);
+    }
+
+    return Completion::NORMAL;
+}
+
+Completion TypedEmitter::visit_while_stmt(While *stmt) {
+    compile_scope(
+        fmt::format("while ({})", compile_condition(*stmt->condition)),
+        *stmt->body);
+
+    return Completion::NORMAL;
+}
+
+Completion
+TypedEmitter::visit_function_stmt([[maybe_unused]] Function *stmt) {
+    throw Unsupported{};
+}
+
+Completion TypedEmitter::visit_return_stmt(Return *stmt) {
+    if (stmt->value == nullptr) {
+        throw Unsupported{};
+    }
+    std::string value;
+    if (compile(*stmt->value, value) != function_->return_type) {
+        throw Unsupported{};
+    }
+    line(fmt::format("return {};", value));
+
+    return Completion::NORMAL;
+}
+
+} // namespace zero::aot
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "ast/expr.hpp"
+#include "ast/stmt.hpp"
+#include "ast/type.hpp"
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace zero::aot {
+
+// 为Specializer特化的函数生成参数和返回值都是原生类型的C++函数,
+// 类型规则与Specializer相同; 整数溢出, 除以0, 被调用的全局函数被重新赋值时
+// 抛出rt::Deoptimize, 由普通版本重新执行
+class TypedEmitter : public ExprVisitor, public StmtVisitor {
+public:
+    // ids: 函数的编号, callees: 全局槽位中可以直接调用的特化函数
+    TypedEmitter(const std::unordered_map<const Function *, unsigned int> &ids,
+                 const std::unordered_map<unsigned int, const Function *>
+                     &callees)
+        : ids_{ids}, callees_{callees} {}
+
+public:
+    // 生成函数的定义, 不能生成时返回false
+    bool emit(const Function &function, std::string &definition);
+
+    // 特化版本的C++类型
+    static const char *cpp_type(static_type type);
+
+public:
+    // Expr抽象类方法, 生成的C++表达式和类型保存在code_和type_中
+    Value visit_binary_expr(Binary *expr) override;
+    Value visit_grouping_expr(Grouping *expr) override;
+    Value visit_literal_expr(Literal *expr) override;
+    Value visit_logical_expr(Logical *expr) override;
+    Value visit_unary_expr(Unary *expr) override;
+    Value visit_variable_expr(Variable *expr) override;
+    Value visit_assign_expr(Assign *expr) override;
+    Value visit_call_expr(Call *expr) override;
+    Value visit_inline_call_expr(InlineCall *expr) override;
+    Value visit_increment_expr(Increment *expr) override;
+    Value visit_compare_expr(Compare *expr) override;
+    Value visit_promote_expr(Promote *expr) override;
+
+    // Stmt抽象类方法, 生成的C++语句追加到body_中
+    Completion visit_block_stmt(Block *stmt) override;
+    Completion visit_expression_stmt(Expression *stmt) override;
+    Completion visit_var_stmt(Var *stmt) override;
+    Completion visit_if_stmt(If *stmt) override;
+    Completion visit_while_stmt(While *stmt) override;
+    Completion visit_function_stmt(Function *stmt) override;
+    Completion visit_return_stmt(Return *stmt) override;
+
+private:
+    // 遇到不能生成的代码时抛出
+    struct Unsupported {};
+
+    static_type compile(Expr &expr, std::string &code);
+    void compile(Stmt &stmt);
+    // 语句放在以header开头的C++块中
+    void compile_scope(const std::string &header,
+                       const std::vector<std::unique_ptr<Stmt>> &stmts);
+    void compile_scope(const std::string &header, Stmt &stmt);
+    // 条件必须是bool
+    std::string compile_condition(Expr &expr);
+    void compile_call(Call &call);
+    void compile_binary(const Token &op, Expr &left, Expr &right);
+    // 局部变量的C++变量名
+    const std::string &local(int depth, unsigned int slot) const;
+    void line(const std::string &text);
+
+private:
+    const std::unordered_map<const Function *, unsigned int> &ids_;
+    const std::unordered_map<unsigned int, const Function *> &callees_;
+    const Function *function_{nullptr};
+    // 各个槽位当前对应的C++变量和类型
+    std::vector<std::string> names_;
+    std::vector<static_type> types_;
+    unsigned int num_names_{0};
+
+    std::string body_;
+    std::string code_;
+    static_type type_{static_type::ANY};
+    unsigned int indent_{0};
+};
+
+} // namespace zero::aot
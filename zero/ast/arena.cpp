@@ -0,0 +1,35 @@
+#include "arena.hpp"
+
+#include <cstring>
+
+namespace zero {
+
+std::string_view Arena::copy(std::string_view str) {
+    if (str.empty()) {
+        return {};
+    }
+    auto *chars = static_cast<char *>(allocate(str.size(), 1));
+    std::memcpy(chars, str.data(), str.size());
+
+    return {chars, str.size()};
+}
+
+void *Arena::allocate_chunk(std::size_t size, std::size_t alignment) {
+    // 超过一块大小的请求(比如很长的源码)单独分配一块, 不浪费当前块的剩余空间
+    auto chunk_size = size + alignment;
+    if (chunk_size > CHUNK_SIZE) {
+        chunks_.emplace_back(new std::byte[chunk_size]);
+        auto *chunk = chunks_.back().get();
+        auto address = reinterpret_cast<uintptr_t>(chunk);
+        used_ += size;
+        return chunk + (alignment - address % alignment) % alignment;
+    }
+
+    chunks_.emplace_back(new std::byte[CHUNK_SIZE]);
+    next_ = chunks_.back().get();
+    end_ = next_ + CHUNK_SIZE;
+
+    return allocate(size, alignment);
+}
+
+} // namespace zero
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace zero {
+
+// 每个Program一个的内存池, 保存源码和所有AST节点
+// 节点依次分配在大块内存中, 同一个函数的节点在内存中相邻;
+// 释放节点时不归还内存, Program销毁时整块释放
+class Arena {
+public:
+    static constexpr std::size_t CHUNK_SIZE = 64 * 1024;
+
+    Arena() = default;
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+public:
+    void *allocate(std::size_t size, std::size_t alignment) {
+        auto address = reinterpret_cast<uintptr_t>(next_);
+        auto padding = (alignment - address % alignment) % alignment;
+        if (next_ == nullptr
+            || size + padding > static_cast<std::size_t>(end_ - next_)) {
+            return allocate_chunk(size, alignment);
+        }
+        void *result = next_ + padding;
+        next_ += padding + size;
+        used_ += size;
+        return result;
+    }
+    // 复制一份字符串, 返回的视图和内存池的生命周期相同
+    std::string_view copy(std::string_view str);
+
+    // 已分配给节点和字符串的字节数
+    std::size_t used() const { return used_; }
+    std::size_t num_chunks() const { return chunks_.size(); }
+
+    // 当前线程中新创建的AST节点分配在这个内存池中
+    static Arena *current() { return current_; }
+
+    // 在作用域内把arena设为当前内存池
+    class Scope {
+    public:
+        explicit Scope(Arena &arena) : previous_{current_} {
+            current_ = &arena;
+        }
+        ~Scope() { current_ = previous_; }
+
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+    private:
+        Arena *previous_;
+    };
+
+private:
+    void *allocate_chunk(std::size_t size, std::size_t alignment);
+
+private:
+    std::vector<std::unique_ptr<std::byte[]>> chunks_;
+    std::byte *next_{nullptr};
+    std::byte *end_{nullptr};
+    std::size_t used_{0};
+
+    inline static thread_local Arena *current_{nullptr};
+};
+
+// AST节点的基类, 节点通过当前的内存池分配
+// 析构函数仍然会执行, 释放节点中的Value和容器
+struct ArenaNode {
+    // 没有Arena::Scope时分配的节点无法释放, release构建中也直接终止
+    static void *operator new(std::size_t size) {
+        auto *arena = Arena::current();
+        if (arena == nullptr) {
+            std::fputs("AST nodes must be created inside an Arena::Scope\n",
+                       stderr);
+            std::abort();
+        }
+        return arena->allocate(size, alignof(std::max_align_t));
+    }
+    // 内存随内存池一起释放
+    static void operator delete([[maybe_unused]] void *pointer) {}
+};
+
+} // namespace zero
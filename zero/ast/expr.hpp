@@ -1,8 +1,9 @@
 #pragma once
 
+#include "arena.hpp"
 #include "token.hpp"
+#include "value.hpp"
 
-#include <any>
 #include <memory>
 #include <vector>
 
@@ -15,112 +16,285 @@ struct Unary;
 struct Variable;
 struct Assign;
 struct Call;
+struct InlineCall;
+struct Increment;
+struct Compare;
+struct Promote;
+struct IncrementLocal;
+struct Function;
+
+// Resolver标记变量所在的位置
+constexpr int GLOBAL_DEPTH = -1; // 全局变量, slot为全局槽位
+constexpr int LOCAL_DEPTH = 0;   // 当前栈帧中的局部变量
+constexpr int UPVALUE_DEPTH = 1; // 闭包捕获的变量, slot为捕获列表中的下标
+// 局部函数在函数体中引用自己的名字, 直接取正在执行的函数, 不捕获
+// 捕获会让闭包通过捕获列表引用自己, 引用计数永远不会归零
+constexpr int SELF_DEPTH = 2;
 
 struct ExprVisitor {
-    virtual std::any visit_binary_expr(Binary *expr) = 0;
-    virtual std::any visit_grouping_expr(Grouping *expr) = 0;
-    virtual std::any visit_literal_expr(Literal *expr) = 0;
-    virtual std::any visit_logical_expr(Logical *expr) = 0;
-    virtual std::any visit_unary_expr(Unary *expr) = 0;
-    virtual std::any visit_variable_expr(Variable *expr) = 0;
-    virtual std::any visit_assign_expr(Assign *expr) = 0;
-    virtual std::any visit_call_expr(Call *expr) = 0;
+    virtual Value visit_binary_expr(Binary *expr) = 0;
+    virtual Value visit_grouping_expr(Grouping *expr) = 0;
+    virtual Value visit_literal_expr(Literal *expr) = 0;
+    virtual Value visit_logical_expr(Logical *expr) = 0;
+    virtual Value visit_unary_expr(Unary *expr) = 0;
+    virtual Value visit_variable_expr(Variable *expr) = 0;
+    virtual Value visit_assign_expr(Assign *expr) = 0;
+    virtual Value visit_call_expr(Call *expr) = 0;
+    virtual Value visit_inline_call_expr(InlineCall *expr) = 0;
+    virtual Value visit_increment_expr(Increment *expr) = 0;
+    virtual Value visit_compare_expr(Compare *expr) = 0;
+    virtual Value visit_promote_expr(Promote *expr) = 0;
+    // Fuser合并的节点, 默认按合并前的节点处理, 只有树遍历解释器专门执行
+    virtual Value visit_increment_local_expr(IncrementLocal *expr);
     virtual ~ExprVisitor() = default;
 };
 
-struct Expr {
-    virtual std::any accept(ExprVisitor &visitor) = 0;
+// 优化时会通过基类指针替换和释放节点, 析构函数需要是虚函数
+// 节点分配在Program的内存池中
+struct Expr : ArenaNode {
+    virtual Value accept(ExprVisitor &visitor) = 0;
+    virtual ~Expr() = default;
+};
+
+// 树遍历解释器按执行时观察到的操作数类型把二元运算节点改写成的特化版本,
+// 特化的节点只检查操作数类型是否与之前相同; 类型变化后改写成通用节点
+enum class binary_node : uint8_t {
+    UNINITIALIZED, // 还没有执行过
+    GENERIC,       // 按操作符分派并检查操作数类型
+    INT_ADD,
+    INT_SUBTRACT,
+    INT_MULTIPLY,
+    INT_EQUAL,
+    INT_NOT_EQUAL,
+    INT_LESS,
+    INT_LESS_EQUAL,
+    INT_GREATER,
+    INT_GREATER_EQUAL,
+    DOUBLE_ADD,
+    DOUBLE_SUBTRACT,
+    DOUBLE_MULTIPLY,
+    DOUBLE_DIVIDE,
+    DOUBLE_LESS,
+    DOUBLE_LESS_EQUAL,
+    DOUBLE_GREATER,
+    DOUBLE_GREATER_EQUAL,
+    STRING_CONCAT,
+};
+
+// 二元运算的操作数, 局部变量和常量直接读取, 不需要经过visitor求值
+enum class operand_node : uint8_t {
+    EXPR,     // 需要求值的表达式
+    LOCAL,    // 当前栈帧中的局部变量
+    CONSTANT, // 字面量
 };
 
 struct Binary : Expr {
     Binary(std::unique_ptr<Expr> left, Token op, std::unique_ptr<Expr> right)
         : left(std::move(left)), op(std::move(op)), right(std::move(right)) {};
 
-    std::any accept(ExprVisitor &visitor) override {
+    Value accept(ExprVisitor &visitor) override {
         return visitor.visit_binary_expr(this);
     }
 
-    const std::unique_ptr<Expr> left;
+    std::unique_ptr<Expr> left;
     const Token op;
-    const std::unique_ptr<Expr> right;
+    std::unique_ptr<Expr> right;
+    // 由树遍历解释器在执行时改写
+    binary_node node{binary_node::UNINITIALIZED};
+    operand_node left_operand{operand_node::EXPR};
+    operand_node right_operand{operand_node::EXPR};
 };
 
 struct Grouping : Expr {
     explicit Grouping(std::unique_ptr<Expr> expr) : expr(std::move(expr)) {};
 
-    std::any accept(ExprVisitor &visitor) override {
+    Value accept(ExprVisitor &visitor) override {
         return visitor.visit_grouping_expr(this);
     }
 
-    const std::unique_ptr<Expr> expr;
+    std::unique_ptr<Expr> expr;
 };
 
 struct Literal : Expr {
-    explicit Literal(std::any value) : value(std::move(value)) {};
-    std::any accept(ExprVisitor &visitor) override {
+    explicit Literal(Value value) : value(std::move(value)) {};
+    Value accept(ExprVisitor &visitor) override {
         return visitor.visit_literal_expr(this);
     }
 
-    const std::any value;
+    const Value value;
 };
 
 struct Logical : Expr {
     Logical(std::unique_ptr<Expr> left, Token op, std::unique_ptr<Expr> right)
         : left(std::move(left)), op(std::move(op)), right(std::move(right)) {};
 
-    std::any accept(ExprVisitor &visitor) override {
+    Value accept(ExprVisitor &visitor) override {
         return visitor.visit_logical_expr(this);
     }
 
-    const std::unique_ptr<Expr> left;
+    std::unique_ptr<Expr> left;
     const Token op;
-    const std::unique_ptr<Expr> right;
+    std::unique_ptr<Expr> right;
 };
 
 struct Unary : Expr {
     Unary(Token op, std::unique_ptr<Expr> right)
         : op(std::move(op)), right(std::move(right)) {};
-    std::any accept(ExprVisitor &visitor) override {
+    Value accept(ExprVisitor &visitor) override {
         return visitor.visit_unary_expr(this);
     }
 
     const Token op;
-    const std::unique_ptr<Expr> right;
+    std::unique_ptr<Expr> right;
 };
 
 struct Variable : Expr {
     explicit Variable(Token name) : name(std::move(name)) {};
 
-    std::any accept(ExprVisitor &visitor) override {
+    Value accept(ExprVisitor &visitor) override {
         return visitor.visit_variable_expr(this);
     }
 
     const Token name;
+    // 由Resolver填写: 变量所在的位置, 以及变量在该位置中的槽位
+    int depth{GLOBAL_DEPTH};
+    unsigned int slot{0};
 };
 
 struct Assign : Expr {
     Assign(Token name, std::unique_ptr<Expr> value)
         : name(std::move(name)), value(std::move(value)) {};
 
-    std::any accept(ExprVisitor &visitor) override {
+    Value accept(ExprVisitor &visitor) override {
         return visitor.visit_assign_expr(this);
     }
 
     const Token name;
-    const std::unique_ptr<Expr> value;
+    std::unique_ptr<Expr> value;
+    // 由Resolver填写, 同Variable
+    int depth{GLOBAL_DEPTH};
+    unsigned int slot{0};
 };
 
 struct Call : Expr {
     Call(std::unique_ptr<Expr> callee,
+         Token paren,
          std::vector<std::unique_ptr<Expr>> arguments)
-        : callee{std::move(callee)}, arguments{std::move(arguments)} {};
+        : callee{std::move(callee)}, paren{std::move(paren)},
+          arguments{std::move(arguments)} {};
 
-    std::any accept(ExprVisitor &visitor) override {
+    Value accept(ExprVisitor &visitor) override {
         return visitor.visit_call_expr(this);
     }
 
-    const std::unique_ptr<Expr> callee;
-    const std::vector<std::unique_ptr<Expr>> arguments;
+    std::unique_ptr<Expr> callee;
+    const Token paren; // 右括号, 用于报告错误的行号
+    std::vector<std::unique_ptr<Expr>> arguments;
+};
+
+// 内联展开的函数调用, 由优化器生成
+// 执行时全局变量仍然是被内联的函数, 就直接对函数的返回表达式求值,
+// 否则说明全局变量被重新赋值了, 按原来的call正常调用
+struct InlineCall : Expr {
+    InlineCall(std::unique_ptr<Call> call,
+               Function *function,
+               std::unique_ptr<Expr> body)
+        : call{std::move(call)}, function{function}, body{std::move(body)} {};
+
+    Value accept(ExprVisitor &visitor) override {
+        return visitor.visit_inline_call_expr(this);
+    }
+
+    std::unique_ptr<Call> call; // 原来的调用, 被调用者是全局变量
+    Function *function;         // 被内联的全局函数, 加载预编译程序时最后填写
+    std::unique_ptr<Expr> body; // 返回表达式的副本, 参数是其中的局部变量
+    // 由Resolver填写: 参数需要的槽位数
+    unsigned int num_slots{0};
+};
+
+// 归纳变量的更新 name = name + delta, 由循环优化生成
+// 优化器保证变量是当前栈帧中始终为数值的局部变量, 不需要再按运算符分派
+struct Increment : Expr {
+    Increment(Token name, Token op, int64_t delta)
+        : name{std::move(name)}, op{std::move(op)}, delta{delta} {};
+
+    Value accept(ExprVisitor &visitor) override {
+        return visitor.visit_increment_expr(this);
+    }
+
+    const Token name;
+    const Token op; // 原来的+或-, 用于报告错误
+    const int64_t delta;
+    // 由Resolver填写, 同Variable
+    int depth{GLOBAL_DEPTH};
+    unsigned int slot{0};
+};
+
+// 归纳变量与循环不变量的比较, 由循环优化生成
+// 归纳变量是当前栈帧中的局部变量, 总是在左边, 比较规则与Binary相同
+struct Compare : Expr {
+    Compare(std::unique_ptr<Variable> variable,
+            Token op,
+            std::unique_ptr<Expr> bound)
+        : variable{std::move(variable)}, op{std::move(op)},
+          bound{std::move(bound)} {};
+
+    Value accept(ExprVisitor &visitor) override {
+        return visitor.visit_compare_expr(this);
+    }
+
+    std::unique_ptr<Variable> variable;
+    const Token op; // < <= > >=
+    std::unique_ptr<Expr> bound; // Literal或Variable
+    // 由树遍历解释器在执行时改写
+    binary_node node{binary_node::UNINITIALIZED};
+};
+
+// 注解为double的参数, 返回值和变量处把整数转换为double, 由类型检查插入
+// 其他类型的值不变, 类型不一致的错误由类型检查报告
+struct Promote : Expr {
+    explicit Promote(std::unique_ptr<Expr> expr) : expr{std::move(expr)} {};
+
+    Value accept(ExprVisitor &visitor) override {
+        return visitor.visit_promote_expr(this);
+    }
+
+    std::unique_ptr<Expr> expr;
 };
 
+// 局部变量与常量或另一个局部变量的比较, 由Fuser从if/while的条件中提取
+struct LocalComparison {
+    unsigned int slot; // 左操作数的槽位
+    Token op;          // < <= > >= == !=
+    operand_node right; // LOCAL或CONSTANT
+    unsigned int right_slot;
+    Value constant;
+    // 由树遍历解释器在执行时改写
+    binary_node node{binary_node::UNINITIALIZED};
+};
+
+// 局部变量 = 同一个局部变量 +/- 常量, 由Fuser在Resolver之后生成
+// 与Increment不同, 变量不一定是数值, 运算规则与Binary相同
+struct IncrementLocal : Expr {
+    IncrementLocal(std::unique_ptr<Assign> original,
+                   Token op,
+                   Value constant)
+        : original{std::move(original)}, op{std::move(op)},
+          constant{std::move(constant)} {};
+
+    Value accept(ExprVisitor &visitor) override {
+        return visitor.visit_increment_local_expr(this);
+    }
+
+    std::unique_ptr<Assign> original;
+    const Token op; // + -
+    const Value constant;
+    // 由树遍历解释器在执行时改写
+    binary_node node{binary_node::UNINITIALIZED};
+};
+
+inline Value ExprVisitor::visit_increment_local_expr(IncrementLocal *expr) {
+    return expr->original->accept(*this);
+}
+
 } // namespace zero
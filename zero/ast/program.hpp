@@ -1,5 +1,11 @@
+#pragma once
+
+#include "arena.hpp"
 #include "stmt.hpp"
 
+#include <memory>
+#include <vector>
+
 namespace zero {
 
 class Program {
@@ -9,7 +15,14 @@ public:
 
     auto &get_statements() { return statements_; };
 
+    // 内存池保存源码和AST节点, Token的词位指向其中的源码
+    void set_arena(std::unique_ptr<Arena> arena) { arena_ = std::move(arena); }
+    Arena &get_arena() { return *arena_; }
+    const Arena &get_arena() const { return *arena_; }
+
 private:
+    // 节点的析构函数在释放内存池之前执行, arena_需要声明在statements_之前
+    std::unique_ptr<Arena> arena_;
     std::vector<std::unique_ptr<Stmt>> statements_;
 };
 } // namespace zero
@@ -1,12 +1,20 @@
 #pragma once
 
 #include "expr.hpp"
+#include "type.hpp"
 
-#include <any>
+#include <cstdint>
 #include <memory>
 #include <vector>
 
 namespace zero {
+class MemoTable;
+namespace typed {
+class TypedFunction;
+} // namespace typed
+namespace jit {
+class JitFunction;
+} // namespace jit
 struct Block;
 struct Expression;
 // struct Print;
@@ -15,68 +23,94 @@ struct If;
 struct While;
 struct Function;
 struct Return;
+struct IfCompare;
+struct WhileCompare;
+struct ReturnIf;
+
+// 语句执行完成后的状态, 通过返回值通知外层, 不再使用异常
+enum class Completion {
+    NORMAL, // 正常执行完
+    RETURN, // 执行了return语句, 返回值保存在解释器中
+    TAIL_CALL, // 执行了尾调用, 被调用的函数和参数保存在解释器中
+};
 
 class StmtVisitor {
 public:
-    virtual std::any visit_block_stmt(Block *stmt) = 0;
-    virtual std::any visit_expression_stmt(Expression *stmt) = 0;
-    // virtual std::any visit_print_stmt(Print *stmt) = 0;
-    virtual std::any visit_var_stmt(Var *stmt) = 0;
-    virtual std::any visit_if_stmt(If *stmt) = 0;
-    virtual std::any visit_while_stmt(While *stmt) = 0;
-    virtual std::any visit_function_stmt(Function *stmt) = 0;
-    virtual std::any visit_return_stmt(Return *stmt) = 0;
+    virtual Completion visit_block_stmt(Block *stmt) = 0;
+    virtual Completion visit_expression_stmt(Expression *stmt) = 0;
+    // virtual Completion visit_print_stmt(Print *stmt) = 0;
+    virtual Completion visit_var_stmt(Var *stmt) = 0;
+    virtual Completion visit_if_stmt(If *stmt) = 0;
+    virtual Completion visit_while_stmt(While *stmt) = 0;
+    virtual Completion visit_function_stmt(Function *stmt) = 0;
+    virtual Completion visit_return_stmt(Return *stmt) = 0;
+    // Fuser合并的节点, 默认按合并前的节点处理, 只有树遍历解释器专门执行
+    virtual Completion visit_if_compare_stmt(IfCompare *stmt);
+    virtual Completion visit_while_compare_stmt(WhileCompare *stmt);
+    virtual Completion visit_return_if_stmt(ReturnIf *stmt);
     virtual ~StmtVisitor() = default;
 };
 
-class Stmt {
+// 节点分配在Program的内存池中
+class Stmt : public ArenaNode {
 public:
-    virtual std::any accept(StmtVisitor &visitor) = 0;
+    virtual Completion accept(StmtVisitor &visitor) = 0;
+    virtual ~Stmt() = default;
 };
 
 struct Block : Stmt {
     explicit Block(std::vector<std::unique_ptr<Stmt>> statements)
         : statements(std::move(statements)) {};
 
-    std::any accept(StmtVisitor &visitor) override {
+    Completion accept(StmtVisitor &visitor) override {
         return visitor.visit_block_stmt(this);
     }
 
-    const std::vector<std::unique_ptr<Stmt>> statements;
+    std::vector<std::unique_ptr<Stmt>> statements;
+    // 由Resolver填写: 块需要的栈帧槽位数, 为0时直接使用所在的栈帧
+    // 只有不在函数中的最外层块才需要自己的栈帧
+    unsigned int num_slots{0};
+    // 由Resolver填写: 块中的变量被闭包捕获时, 离开块要关闭这些捕获
+    bool has_captured{false};
+    unsigned int first_slot{0}; // 块中第一个变量的槽位
 };
 
 struct Expression : Stmt {
     explicit Expression(std::unique_ptr<Expr> expression)
         : expression(std::move(expression)) {};
 
-    std::any accept(StmtVisitor &visitor) override {
+    Completion accept(StmtVisitor &visitor) override {
         return visitor.visit_expression_stmt(this);
     }
 
-    const std::unique_ptr<Expr> expression;
+    std::unique_ptr<Expr> expression;
 };
 
 // struct Print : Stmt {
 //     explicit Print(std::unique_ptr<Expr> expression)
 //         : expression(std::move(expression)) {};
 //
-//     std::any accept(StmtVisitor &visitor) override {
+//     Completion accept(StmtVisitor &visitor) override {
 //         return visitor.visit_print_stmt(this);
 //     }
 //
-//     const std::unique_ptr<Expr> expression;
+//     std::unique_ptr<Expr> expression;
 // };
 
 struct Var : Stmt {
     Var(Token name, std::unique_ptr<Expr> initializer)
         : name(std::move(name)), initializer(std::move(initializer)) {};
 
-    std::any accept(StmtVisitor &visitor) override {
+    Completion accept(StmtVisitor &visitor) override {
         return visitor.visit_var_stmt(this);
     }
 
     const Token name;
-    const std::unique_ptr<Expr> initializer;
+    std::unique_ptr<Expr> initializer;
+    static_type type{static_type::ANY}; // 类型注解
+    // 由Resolver填写: 全局变量depth为GLOBAL_DEPTH, 局部变量为LOCAL_DEPTH
+    int depth{GLOBAL_DEPTH};
+    unsigned int slot{0};
 };
 
 struct If : Stmt {
@@ -86,20 +120,20 @@ struct If : Stmt {
         : condition(std::move(condition)), then_branch(std::move(then_branch)),
           else_branch(std::move(else_branch)) {};
 
-    std::any accept(StmtVisitor &visitor) override {
+    Completion accept(StmtVisitor &visitor) override {
         return visitor.visit_if_stmt(this);
     }
 
-    const std::unique_ptr<Expr> condition;
-    const std::unique_ptr<Stmt> then_branch;
-    const std::unique_ptr<Stmt> else_branch;
+    std::unique_ptr<Expr> condition;
+    std::unique_ptr<Stmt> then_branch;
+    std::unique_ptr<Stmt> else_branch;
 };
 
 struct While : Stmt {
     While(std::unique_ptr<Expr> condition, std::unique_ptr<Stmt> body)
         : condition(std::move(condition)), body(std::move(body)) {};
 
-    std::any accept(StmtVisitor &visitor) override {
+    Completion accept(StmtVisitor &visitor) override {
         return visitor.visit_while_stmt(this);
     }
 
@@ -107,6 +141,15 @@ struct While : Stmt {
     std::unique_ptr<Stmt> body;
 };
 
+// 闭包捕获的变量
+// is_local为真时是外层栈帧中的局部变量, index为它的槽位
+// 否则是外层函数已经捕获的变量, index为外层函数捕获列表中的下标
+struct Capture {
+    bool is_local;
+    unsigned int index;
+    uint32_t name; // 变量名的符号id
+};
+
 struct Function : Stmt {
     Function(Token name,
              std::vector<Token> params,
@@ -114,25 +157,106 @@ struct Function : Stmt {
         : name(std::move(name)), params(std::move(params)),
           body(std::move(body)) {};
 
-    std::any accept(StmtVisitor &visitor) override {
+    Completion accept(StmtVisitor &visitor) override {
         return visitor.visit_function_stmt(this);
     }
 
     const Token name;
     const std::vector<Token> params;
-    const std::vector<std::unique_ptr<Stmt>> body;
+    std::vector<std::unique_ptr<Stmt>> body;
+    // 类型注解, 没有注解时为ANY
+    std::vector<static_type> param_types;
+    static_type return_type{static_type::ANY};
+    // 由Resolver填写: 函数名的位置, 同Var
+    int depth{GLOBAL_DEPTH};
+    unsigned int slot{0};
+    // 由Resolver填写: 函数栈帧的槽位数(参数 + 函数体中所有块的局部变量)
+    unsigned int num_slots{0};
+    // 由Resolver填写: 创建闭包时需要捕获的变量
+    std::vector<Capture> captures;
+    // 由Resolver填写: 局部函数名在作用域中被重新赋值或者重复声明
+    bool rebound{false};
+    // 声明前有@memoize注解
+    bool memoize{false};
+    // 纯函数分析确定可以记忆化时创建, 闭包和字节码函数共用同一个记忆表
+    std::shared_ptr<MemoTable> memo;
+    // 参数和返回值都有数值类型注解时创建的特化版本, 不需要装箱和类型检查
+    std::shared_ptr<typed::TypedFunction> typed;
+    // 树遍历解释器中调用次数足够多时编译的机器码, 不能编译时为空
+    std::shared_ptr<jit::JitFunction> jit;
+    bool jit_compiled{false};
 };
 
 struct Return : Stmt {
     Return(Token keyword, std::unique_ptr<Expr> value)
         : keyword(std::move(keyword)), value(std::move(value)) {};
 
-    std::any accept(StmtVisitor &visitor) override {
+    Completion accept(StmtVisitor &visitor) override {
         return visitor.visit_return_stmt(this);
     }
 
     const Token keyword;
-    const std::unique_ptr<Expr> value;
+    std::unique_ptr<Expr> value;
+    // 由Resolver标记: 返回值是对变量的调用, 可以复用当前栈帧
+    bool tail_call{false};
+};
+
+// 以下节点由Fuser在Resolver之后合并常见的语句生成, 一次分派执行,
+// original保存合并前的语句
+
+// 条件是局部变量比较的if语句
+struct IfCompare : Stmt {
+    IfCompare(std::unique_ptr<If> original, LocalComparison condition)
+        : original{std::move(original)}, condition{std::move(condition)} {};
+
+    Completion accept(StmtVisitor &visitor) override {
+        return visitor.visit_if_compare_stmt(this);
+    }
+
+    std::unique_ptr<If> original;
+    LocalComparison condition;
+};
+
+// 条件是局部变量比较的while语句
+struct WhileCompare : Stmt {
+    WhileCompare(std::unique_ptr<While> original, LocalComparison condition)
+        : original{std::move(original)}, condition{std::move(condition)} {};
+
+    Completion accept(StmtVisitor &visitor) override {
+        return visitor.visit_while_compare_stmt(this);
+    }
+
+    std::unique_ptr<While> original;
+    LocalComparison condition;
+};
+
+// if (局部变量比较) return value; 没有else分支
+struct ReturnIf : Stmt {
+    ReturnIf(std::unique_ptr<If> original,
+             LocalComparison condition,
+             Return *result)
+        : original{std::move(original)}, condition{std::move(condition)},
+          result{result} {};
+
+    Completion accept(StmtVisitor &visitor) override {
+        return visitor.visit_return_if_stmt(this);
+    }
+
+    std::unique_ptr<If> original;
+    LocalComparison condition;
+    Return *result; // original中的return语句
 };
 
+inline Completion StmtVisitor::visit_if_compare_stmt(IfCompare *stmt) {
+    return stmt->original->accept(*this);
+}
+
+inline Completion StmtVisitor::visit_while_compare_stmt(WhileCompare *stmt) {
+    return stmt->original->accept(*this);
+}
+
+inline Completion StmtVisitor::visit_return_if_stmt(ReturnIf *stmt) {
+    return stmt->original->accept(*this);
+}
+
 } // namespace zero
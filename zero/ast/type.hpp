@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+namespace zero {
+
+// 类型注解, ANY表示没有注解或者编译时无法确定
+enum class static_type : uint8_t {
+    ANY,
+    NIL, // 只用于字面量nil, 不能写在注解中
+    BOOL,
+    INT,
+    DOUBLE,
+    STRING,
+};
+
+// 注解中的类型名
+inline std::optional<static_type> lookup_type(std::string_view name) {
+    if (name == "int") {
+        return static_type::INT;
+    }
+    if (name == "double") {
+        return static_type::DOUBLE;
+    }
+    if (name == "bool") {
+        return static_type::BOOL;
+    }
+    if (name == "string") {
+        return static_type::STRING;
+    }
+    return std::nullopt;
+}
+
+inline const char *type_name(static_type type) {
+    switch (type) {
+        case static_type::NIL:
+            return "nil";
+        case static_type::BOOL:
+            return "bool";
+        case static_type::INT:
+            return "int";
+        case static_type::DOUBLE:
+            return "double";
+        case static_type::STRING:
+            return "string";
+        default:
+            return "any";
+    }
+}
+
+} // namespace zero
@@ -0,0 +1,125 @@
+#include "chunk.hpp"
+
+#include "fmt/core.h"
+
+namespace zero::bytecode {
+
+const char *opcode_name(opcode op) {
+    static const char *names[] = {
+#define ZERO_OPCODE_NAME(name, operand_bytes, stack_effect) #name,
+        ZERO_OPCODES(ZERO_OPCODE_NAME)
+#undef ZERO_OPCODE_NAME
+    };
+    return names[static_cast<uint8_t>(op)];
+}
+
+unsigned int operand_bytes(opcode op) {
+    static const unsigned int bytes[] = {
+#define ZERO_OPCODE_BYTES(name, operand_bytes, stack_effect) operand_bytes,
+        ZERO_OPCODES(ZERO_OPCODE_BYTES)
+#undef ZERO_OPCODE_BYTES
+    };
+    return bytes[static_cast<uint8_t>(op)];
+}
+
+int stack_effect(opcode op) {
+    static const int effects[] = {
+#define ZERO_OPCODE_EFFECT(name, operand_bytes, stack_effect) stack_effect,
+        ZERO_OPCODES(ZERO_OPCODE_EFFECT)
+#undef ZERO_OPCODE_EFFECT
+    };
+    return effects[static_cast<uint8_t>(op)];
+}
+
+void Chunk::write(uint8_t byte, unsigned int line) {
+    code.push_back(byte);
+    lines.push_back(line);
+}
+
+std::size_t Chunk::add_constant(Value value) {
+    constants.push_back(std::move(value));
+    return constants.size() - 1;
+}
+
+void Chunk::disassemble() const {
+    fmt::println("== {} ==", name);
+    for (std::size_t offset = 0; offset < code.size();) {
+        offset = disassemble_instruction(offset);
+    }
+
+    for (const auto &function : functions) {
+        function->disassemble();
+    }
+}
+
+std::size_t Chunk::disassemble_instruction(std::size_t offset) const {
+    auto op = static_cast<opcode>(code[offset]);
+    auto line = (offset > 0 && lines[offset] == lines[offset - 1])
+                    ? std::string("   |")
+                    : fmt::format("{:4}", lines[offset]);
+
+    switch (operand_bytes(op)) {
+        case 1:
+            fmt::println("{:04} {} {:<16} {}",
+                         offset,
+                         line,
+                         opcode_name(op),
+                         code[offset + 1]);
+            return offset + 2;
+        case 2: {
+            auto operand = (code[offset + 1] << 8) | code[offset + 2];
+            if (op == opcode::COMPARE_LOCAL) {
+                fmt::println("{:04} {} {:<16} {} {}",
+                             offset,
+                             line,
+                             opcode_name(op),
+                             code[offset + 1],
+                             opcode_name(static_cast<opcode>(code[offset + 2])));
+            } else if (op == opcode::CONSTANT) {
+                fmt::println("{:04} {} {:<16} {} ({})",
+                             offset,
+                             line,
+                             opcode_name(op),
+                             operand,
+                             stringify(constants[operand]));
+            } else {
+                fmt::println("{:04} {} {:<16} {}",
+                             offset,
+                             line,
+                             opcode_name(op),
+                             operand);
+            }
+            return offset + 3;
+        }
+        case 3: {
+            auto constant = (code[offset + 2] << 8) | code[offset + 3];
+            fmt::println("{:04} {} {:<16} {} {} ({})",
+                         offset,
+                         line,
+                         opcode_name(op),
+                         code[offset + 1],
+                         constant,
+                         stringify(constants[constant]));
+            return offset + 4;
+        }
+        case 6: {
+            auto slot = (code[offset + 1] << 8) | code[offset + 2];
+            auto constant = (code[offset + 3] << 8) | code[offset + 4];
+            auto jump = (code[offset + 5] << 8) | code[offset + 6];
+            fmt::println("{:04} {} {:<16} {} {} ({}) -> {}",
+                         offset,
+                         line,
+                         opcode_name(op),
+                         slot,
+                         constant,
+                         stringify(constants[constant]),
+                         offset + 7 + jump);
+            return offset + 7;
+        }
+        default:
+            fmt::println("{:04} {} {}", offset, line, opcode_name(op));
+            return offset + 1;
+    }
+}
+
+} // namespace zero::bytecode
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "opcode.hpp"
+#include "value.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace zero::bytecode {
+
+// 创建闭包时捕获的变量
+// is_local为真时index是外层函数栈帧中的槽位, 否则是外层函数捕获列表中的下标
+struct CaptureSlot {
+    bool is_local;
+    uint8_t index;
+};
+
+// 一段编译好的字节码, 对应脚本的顶层代码或者一个函数体
+class Chunk {
+public:
+    explicit Chunk(std::string name) : name{std::move(name)} {}
+
+public:
+    void write(uint8_t byte, unsigned int line);
+    // 添加常量, 返回常量池中的索引
+    std::size_t add_constant(Value value);
+
+    // 打印字节码, 包括嵌套的函数
+    void disassemble() const;
+    std::size_t disassemble_instruction(std::size_t offset) const;
+
+public:
+    const std::string name;
+    std::vector<uint8_t> code;
+    std::vector<unsigned int> lines; // 每个字节对应的源码行号
+    std::vector<Value> constants;    // 常量池
+    unsigned int max_stack{0};       // 执行时最多占用的栈槽位数(包括局部变量)
+    std::vector<std::unique_ptr<Chunk>> functions; // 嵌套定义的函数
+    std::vector<CaptureSlot> captures; // CLOSURE指令按顺序捕获的变量
+};
+
+} // namespace zero::bytecode
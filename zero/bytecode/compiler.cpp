@@ -0,0 +1,539 @@
+#include "compiler.hpp"
+
+#include "function.hpp"
+
+#include <fmt/base.h>
+
+#include <cstdint>
+
+namespace zero::bytecode {
+
+std::unique_ptr<Chunk>
+Compiler::compile(const std::unique_ptr<Program> &program) {
+    auto script = std::make_unique<Chunk>("<script>");
+    FunctionState state{nullptr, script.get(), {}, 0, 0};
+    current_ = &state;
+
+    compile(program->get_statements());
+    emit_op(opcode::NIL);
+    emit_op(opcode::RETURN);
+
+    current_ = nullptr;
+    return script;
+}
+
+void Compiler::compile(Expr &expr) { expr.accept(*this); }
+
+void Compiler::compile(Stmt &stmt) { stmt.accept(*this); }
+
+void Compiler::compile(const std::vector<std::unique_ptr<Stmt>> &stmts) {
+    for (const auto &stmt : stmts) {
+        compile(*stmt);
+    }
+}
+
+void Compiler::emit_byte(uint8_t byte) { current_->chunk->write(byte, line_); }
+
+void Compiler::emit_op(opcode op) {
+    emit_byte(static_cast<uint8_t>(op));
+    adjust_stack(stack_effect(op));
+}
+
+void Compiler::emit_op(opcode op, uint8_t operand) {
+    emit_op(op);
+    emit_byte(operand);
+}
+
+void Compiler::emit_op_short(opcode op, std::size_t operand) {
+    if (operand > UINT16_MAX) {
+        compile_error(fmt::format("Too many {} operands.", opcode_name(op)));
+    }
+    emit_op(op);
+    emit_byte(static_cast<uint8_t>((operand >> 8) & 0xff));
+    emit_byte(static_cast<uint8_t>(operand & 0xff));
+}
+
+std::size_t Compiler::make_constant(Value value) {
+    auto constant = current_->chunk->add_constant(std::move(value));
+    // 常量下标是16位操作数, 每个chunk只报告一次
+    if (constant > UINT16_MAX) {
+        if (constant == UINT16_MAX + 1) {
+            compile_error(
+                fmt::format("Too many constants in one chunk (limit {}).",
+                            UINT16_MAX + 1));
+        }
+        return 0;
+    }
+
+    return constant;
+}
+
+void Compiler::emit_constant(Value value) {
+    emit_op_short(opcode::CONSTANT, make_constant(std::move(value)));
+}
+
+std::size_t Compiler::emit_jump(opcode op) {
+    emit_op_short(op, UINT16_MAX);
+    return current_->chunk->code.size() - 2;
+}
+
+void Compiler::patch_jump(std::size_t offset) {
+    auto &code = current_->chunk->code;
+    // 跳过偏移量本身的两个字节
+    auto jump = code.size() - offset - 2;
+    if (jump > UINT16_MAX) {
+        compile_error("Too much code to jump over.");
+    }
+
+    code[offset] = static_cast<uint8_t>((jump >> 8) & 0xff);
+    code[offset + 1] = static_cast<uint8_t>(jump & 0xff);
+}
+
+void Compiler::emit_loop(std::size_t loop_start) {
+    // LOOP指令本身占3个字节
+    auto offset = current_->chunk->code.size() - loop_start + 3;
+    if (offset > UINT16_MAX) {
+        compile_error("Loop body too large.");
+    }
+    emit_op_short(opcode::LOOP, offset);
+}
+
+void Compiler::adjust_stack(int delta) {
+    current_->stack_depth += delta;
+    auto depth = static_cast<unsigned int>(current_->stack_depth);
+    if (depth > current_->chunk->max_stack) {
+        current_->chunk->max_stack = depth;
+    }
+}
+
+void Compiler::begin_scope() { current_->scope_depth++; }
+
+void Compiler::end_scope() {
+    current_->scope_depth--;
+
+    auto &locals = current_->locals;
+    while (!locals.empty() && locals.back().depth > current_->scope_depth) {
+        emit_op(locals.back().captured ? opcode::CLOSE_UPVALUE : opcode::POP);
+        locals.pop_back();
+    }
+}
+
+void Compiler::add_local(symbol_id name) {
+    if (current_->locals.size() > UINT8_MAX) {
+        compile_error("Too many local variables in function.");
+        return;
+    }
+    current_->locals.push_back(Local{name, current_->scope_depth, false});
+}
+
+uint8_t Compiler::local_index(unsigned int slot) const {
+    return static_cast<uint8_t>(current_->slot_base + slot);
+}
+
+bool Compiler::is_declared(unsigned int slot) const {
+    return current_->slot_base + slot < current_->locals.size();
+}
+
+void Compiler::compile_error(const std::string &msg) {
+    fmt::println("[Line {}] Error: {}", line_, msg);
+    has_compile_error_ = true;
+}
+
+Value Compiler::visit_binary_expr(Binary *expr) {
+    compile(*expr->left);
+    compile(*expr->right);
+
+    line_ = expr->op.line;
+    switch (expr->op.type) {
+        case token_type::NOT_EQUAL:
+            emit_op(opcode::NOT_EQUAL);
+            break;
+        case token_type::EQUAL_EQUAL:
+            emit_op(opcode::EQUAL);
+            break;
+        case token_type::GREATER:
+            emit_op(opcode::GREATER);
+            break;
+        case token_type::GREATER_EQUAL:
+            emit_op(opcode::GREATER_EQUAL);
+            break;
+        case token_type::LESS:
+            emit_op(opcode::LESS);
+            break;
+        case token_type::LESS_EQUAL:
+            emit_op(opcode::LESS_EQUAL);
+            break;
+        case token_type::MINUS:
+            emit_op(opcode::SUBTRACT);
+            break;
+        case token_type::PLUS:
+            emit_op(opcode::ADD);
+            break;
+        case token_type::SLASH:
+            emit_op(opcode::DIVIDE);
+            break;
+        case token_type::STAR:
+            emit_op(opcode::MULTIPLY);
+            break;
+        default:
+            compile_error("Unknown binary operator.");
+            break;
+    }
+
+    return {};
+}
+
+Value Compiler::visit_grouping_expr(Grouping *expr) {
+    compile(*expr->expr);
+
+    return {};
+}
+
+Value Compiler::visit_literal_expr(Literal *expr) {
+    const auto &value = expr->value;
+    if (value.is_nil()) {
+        emit_op(opcode::NIL);
+    } else if (value.is_bool()) {
+        emit_op(value.as_bool() ? opcode::TRUE : opcode::FALSE);
+    } else {
+        emit_constant(value);
+    }
+
+    return {};
+}
+
+Value Compiler::visit_logical_expr(Logical *expr) {
+    // 短路求值: 左操作数已经决定结果时, 跳过右操作数并保留左操作数
+    compile(*expr->left);
+
+    line_ = expr->op.line;
+    auto end_jump = emit_jump(expr->op.type == token_type::OR
+                                  ? opcode::JUMP_IF_TRUE
+                                  : opcode::JUMP_IF_FALSE);
+    emit_op(opcode::POP);
+    compile(*expr->right);
+    patch_jump(end_jump);
+
+    return {};
+}
+
+Value Compiler::visit_unary_expr(Unary *expr) {
+    compile(*expr->right);
+
+    line_ = expr->op.line;
+    switch (expr->op.type) {
+        case token_type::NOT:
+            emit_op(opcode::NOT);
+            break;
+        case token_type::MINUS:
+            emit_op(opcode::NEGATE);
+            break;
+        default:
+            compile_error("Unknown unary operator.");
+            break;
+    }
+
+    return {};
+}
+
+Value Compiler::visit_variable_expr(Variable *expr) {
+    line_ = expr->name.line;
+    if (expr->depth == GLOBAL_DEPTH) {
+        emit_op_short(opcode::GET_GLOBAL, expr->slot);
+    } else if (expr->depth == UPVALUE_DEPTH) {
+        emit_op(opcode::GET_UPVALUE, static_cast<uint8_t>(expr->slot));
+    } else if (expr->depth == SELF_DEPTH) {
+        emit_op(opcode::GET_SELF);
+    } else {
+        emit_op(opcode::GET_LOCAL, local_index(expr->slot));
+    }
+
+    return {};
+}
+
+Value Compiler::visit_assign_expr(Assign *expr) {
+    compile(*expr->value);
+
+    line_ = expr->name.line;
+    if (expr->depth == GLOBAL_DEPTH) {
+        emit_op_short(opcode::SET_GLOBAL, expr->slot);
+    } else if (expr->depth == UPVALUE_DEPTH) {
+        emit_op(opcode::SET_UPVALUE, static_cast<uint8_t>(expr->slot));
+    } else {
+        emit_op(opcode::SET_LOCAL, local_index(expr->slot));
+    }
+
+    return {};
+}
+
+Value Compiler::visit_call_expr(Call *expr) {
+    // 参数中的调用不在尾部位置
+    auto op = tail_call_ ? opcode::TAIL_CALL : opcode::CALL;
+    tail_call_ = false;
+
+    compile(*expr->callee);
+    for (const auto &argument : expr->arguments) {
+        compile(*argument);
+    }
+
+    line_ = expr->paren.line;
+    auto num_arguments = expr->arguments.size();
+    if (num_arguments > UINT8_MAX) {
+        compile_error("Can't have more than 255 arguments.");
+    }
+    emit_op(op, static_cast<uint8_t>(num_arguments));
+    // 调用结束后参数和被调用者出栈, 压入返回值
+    adjust_stack(-static_cast<int>(num_arguments));
+
+    return {};
+}
+
+Value Compiler::visit_increment_expr(Increment *expr) {
+    line_ = expr->name.line;
+    auto constant = make_constant(expr->delta);
+
+    emit_op(opcode::INCREMENT_LOCAL, local_index(expr->slot));
+    emit_byte(static_cast<uint8_t>((constant >> 8) & 0xff));
+    emit_byte(static_cast<uint8_t>(constant & 0xff));
+
+    return {};
+}
+
+Value Compiler::visit_compare_expr(Compare *expr) {
+    compile(*expr->bound);
+
+    line_ = expr->op.line;
+    auto op = opcode::LESS_EQUAL;
+    switch (expr->op.type) {
+        case token_type::GREATER:
+            op = opcode::GREATER;
+            break;
+        case token_type::GREATER_EQUAL:
+            op = opcode::GREATER_EQUAL;
+            break;
+        case token_type::LESS:
+            op = opcode::LESS;
+            break;
+        default:
+            break;
+    }
+    emit_op(opcode::COMPARE_LOCAL, local_index(expr->variable->slot));
+    emit_byte(static_cast<uint8_t>(op));
+
+    return {};
+}
+
+Value Compiler::visit_promote_expr(Promote *expr) {
+    compile(*expr->expr);
+    emit_op(opcode::PROMOTE);
+
+    return {};
+}
+
+Value Compiler::visit_inline_call_expr(InlineCall *expr) {
+    const auto *callee = static_cast<const Variable *>(expr->call->callee.get());
+    auto constant = make_constant(ZeroFunction{expr->function});
+    if (callee->slot > UINT16_MAX) {
+        compile_error("Too many INLINE_GUARD operands.");
+    }
+
+    line_ = expr->call->paren.line;
+    emit_op(opcode::INLINE_GUARD);
+    for (auto operand : {static_cast<std::size_t>(callee->slot), constant}) {
+        emit_byte(static_cast<uint8_t>((operand >> 8) & 0xff));
+        emit_byte(static_cast<uint8_t>(operand & 0xff));
+    }
+    emit_byte(0xff);
+    emit_byte(0xff);
+    auto call_jump = current_->chunk->code.size() - 2;
+    auto depth = current_->stack_depth;
+
+    // 参数成为新作用域中的局部变量, 局部变量的下标就是栈上的位置,
+    // 参数之下还没有出栈的临时值用没有名字的局部变量占位
+    begin_scope();
+    auto &locals = current_->locals;
+    auto first_local = locals.size();
+    while (locals.size() < static_cast<std::size_t>(depth)) {
+        add_local(UNNAMED);
+    }
+    auto first_param = locals.size();
+    const auto &params = expr->function->params;
+    for (std::size_t i = 0; i < params.size(); i++) {
+        compile(*expr->call->arguments[i]);
+        add_local(params[i].symbol);
+    }
+    // 返回表达式在只包含参数的栈帧中解析, 参数的槽位从0开始
+    auto slot_base = current_->slot_base;
+    current_->slot_base = first_param;
+    compile(*expr->body);
+    current_->slot_base = slot_base;
+
+    // 结果存到第一个参数的位置, 其余参数和结果的副本出栈
+    line_ = expr->call->paren.line;
+    if (!params.empty()) {
+        emit_op(opcode::SET_LOCAL, static_cast<uint8_t>(first_param));
+        for (std::size_t i = 0; i < params.size(); i++) {
+            emit_op(opcode::POP);
+        }
+    }
+    locals.resize(first_local);
+    current_->scope_depth--;
+    auto end_jump = emit_jump(opcode::JUMP);
+
+    patch_jump(call_jump);
+    current_->stack_depth = depth;
+    compile(*expr->call);
+    patch_jump(end_jump);
+
+    return {};
+}
+
+Completion Compiler::visit_block_stmt(Block *stmt) {
+    begin_scope();
+    compile(stmt->statements);
+    end_scope();
+
+    return Completion::NORMAL;
+}
+
+Completion Compiler::visit_expression_stmt(Expression *stmt) {
+    compile(*stmt->expression);
+    emit_op(opcode::POP);
+
+    return Completion::NORMAL;
+}
+
+Completion Compiler::visit_var_stmt(Var *stmt) {
+    if (stmt->initializer != nullptr) {
+        compile(*stmt->initializer);
+    } else {
+        emit_op(opcode::NIL);
+    }
+
+    line_ = stmt->name.line;
+    if (stmt->depth == GLOBAL_DEPTH) {
+        emit_op_short(opcode::DEFINE_GLOBAL, stmt->slot);
+        return Completion::NORMAL;
+    }
+
+    // 同一作用域中重复声明的变量复用原来的槽位
+    if (is_declared(stmt->slot)) {
+        emit_op(opcode::SET_LOCAL, local_index(stmt->slot));
+        emit_op(opcode::POP);
+    } else {
+        // 初始值留在栈上, 成为局部变量
+        add_local(stmt->name.symbol);
+    }
+
+    return Completion::NORMAL;
+}
+
+Completion Compiler::visit_if_stmt(If *stmt) {
+    compile(*stmt->condition);
+
+    auto then_jump = emit_jump(opcode::JUMP_IF_FALSE);
+    auto depth = current_->stack_depth;
+    emit_op(opcode::POP);
+    compile(*stmt->then_branch);
+    auto else_jump = emit_jump(opcode::JUMP);
+
+    patch_jump(then_jump);
+    current_->stack_depth = depth;
+    emit_op(opcode::POP);
+    if (stmt->else_branch != nullptr) {
+        compile(*stmt->else_branch);
+    }
+    patch_jump(else_jump);
+
+    return Completion::NORMAL;
+}
+
+Completion Compiler::visit_while_stmt(While *stmt) {
+    auto loop_start = current_->chunk->code.size();
+    compile(*stmt->condition);
+
+    auto exit_jump = emit_jump(opcode::JUMP_IF_FALSE);
+    auto depth = current_->stack_depth;
+    emit_op(opcode::POP);
+    compile(*stmt->body);
+    emit_loop(loop_start);
+
+    patch_jump(exit_jump);
+    current_->stack_depth = depth;
+    emit_op(opcode::POP);
+
+    return Completion::NORMAL;
+}
+
+Completion Compiler::visit_function_stmt(Function *stmt) {
+    line_ = stmt->name.line;
+    auto chunk = std::make_unique<Chunk>(std::string(stmt->name.lexeme));
+    const Chunk *function_chunk = chunk.get();
+
+    // 参数依次存放在栈帧的开头
+    FunctionState state{current_, chunk.get(), {}, 1, 0};
+    current_ = &state;
+    for (const auto &param : stmt->params) {
+        add_local(param.symbol);
+        adjust_stack(1);
+    }
+    compile(stmt->body);
+    emit_op(opcode::NIL);
+    emit_op(opcode::RETURN);
+    current_ = state.enclosing;
+
+    // 局部函数先占用槽位再创建闭包, 这样函数可以捕获自己用于递归
+    bool redeclared = false;
+    if (stmt->depth != GLOBAL_DEPTH) {
+        redeclared = is_declared(stmt->slot);
+        if (!redeclared) {
+            add_local(stmt->name.symbol);
+        }
+    }
+
+    for (const auto &capture : stmt->captures) {
+        auto index = capture.index;
+        if (capture.is_local) {
+            index = local_index(capture.index);
+            current_->locals[index].captured = true;
+        }
+        chunk->captures.push_back(
+            CaptureSlot{capture.is_local, static_cast<uint8_t>(index)});
+    }
+
+    current_->chunk->functions.push_back(std::move(chunk));
+    auto function = ZeroFunction{stmt, function_chunk};
+    if (stmt->captures.empty()) {
+        emit_constant(function);
+    } else {
+        emit_op_short(opcode::CLOSURE, make_constant(function));
+    }
+
+    if (stmt->depth == GLOBAL_DEPTH) {
+        emit_op_short(opcode::DEFINE_GLOBAL, stmt->slot);
+    } else if (redeclared) {
+        emit_op(opcode::SET_LOCAL, local_index(stmt->slot));
+        emit_op(opcode::POP);
+    }
+
+    return Completion::NORMAL;
+}
+
+Completion Compiler::visit_return_stmt(Return *stmt) {
+    if (stmt->value != nullptr) {
+        // 尾调用复用当前栈帧时不会执行之后的RETURN
+        tail_call_ = stmt->tail_call;
+        compile(*stmt->value);
+    } else {
+        emit_op(opcode::NIL);
+    }
+
+    line_ = stmt->keyword.line;
+    emit_op(opcode::RETURN);
+    // RETURN之后的代码不会执行, 保持栈深度与return之前一致
+    adjust_stack(1);
+
+    return Completion::NORMAL;
+}
+
+} // namespace zero::bytecode
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "ast/expr.hpp"
+#include "ast/program.hpp"
+#include "ast/stmt.hpp"
+#include "chunk.hpp"
+#include "symbol.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace zero::bytecode {
+
+// 把经过Resolver解析的AST编译成字节码
+// 局部变量存放在操作数栈上, 局部变量和全局变量都沿用Resolver分配的槽位
+class Compiler : public ExprVisitor, public StmtVisitor {
+public:
+    std::unique_ptr<Chunk> compile(const std::unique_ptr<Program> &program);
+
+    bool has_error() const { return has_compile_error_; }
+
+public:
+    // Expr抽象类方法
+    Value visit_binary_expr(Binary *expr) override;
+    Value visit_grouping_expr(Grouping *expr) override;
+    Value visit_literal_expr(Literal *expr) override;
+    Value visit_logical_expr(Logical *expr) override;
+    Value visit_unary_expr(Unary *expr) override;
+    Value visit_variable_expr(Variable *expr) override;
+    Value visit_assign_expr(Assign *expr) override;
+    Value visit_call_expr(Call *expr) override;
+    Value visit_inline_call_expr(InlineCall *expr) override;
+    Value visit_increment_expr(Increment *expr) override;
+    Value visit_compare_expr(Compare *expr) override;
+    Value visit_promote_expr(Promote *expr) override;
+
+    // Stmt抽象类方法
+    Completion visit_block_stmt(Block *stmt) override;
+    Completion visit_expression_stmt(Expression *stmt) override;
+    Completion visit_var_stmt(Var *stmt) override;
+    Completion visit_if_stmt(If *stmt) override;
+    Completion visit_while_stmt(While *stmt) override;
+    Completion visit_function_stmt(Function *stmt) override;
+    Completion visit_return_stmt(Return *stmt) override;
+
+private:
+    // 占位用的局部变量名, 不会和任何符号相同
+    static constexpr symbol_id UNNAMED = UINT32_MAX;
+
+    struct Local {
+        symbol_id name;
+        int depth;     // 所在作用域的深度
+        bool captured; // 是否被闭包捕获, 离开作用域时需要搬到堆上
+    };
+
+    // 正在编译的函数
+    struct FunctionState {
+        FunctionState *enclosing;
+        Chunk *chunk;
+        std::vector<Local> locals; // 局部变量在栈帧中的位置即下标
+        int scope_depth{0};
+        int stack_depth{0}; // 当前操作数栈深度, 用于计算max_stack
+        // Resolver分配的槽位0在locals中的下标
+        // 内联调用的参数之前有还没有出栈的临时值
+        std::size_t slot_base{0};
+    };
+
+    void compile(Expr &expr);
+    void compile(Stmt &stmt);
+    void compile(const std::vector<std::unique_ptr<Stmt>> &stmts);
+
+    void emit_byte(uint8_t byte);
+    void emit_op(opcode op);
+    void emit_op(opcode op, uint8_t operand);
+    void emit_op_short(opcode op, std::size_t operand);
+    // 加入常量池, 返回常量的下标
+    std::size_t make_constant(Value value);
+    void emit_constant(Value value);
+    // 发出跳转指令, 返回待回填的偏移位置
+    std::size_t emit_jump(opcode op);
+    void patch_jump(std::size_t offset);
+    void emit_loop(std::size_t loop_start);
+    void adjust_stack(int delta);
+
+    void begin_scope();
+    void end_scope();
+    void add_local(symbol_id name);
+    // Resolver分配的槽位对应的局部变量下标
+    uint8_t local_index(unsigned int slot) const;
+    // 声明的局部变量是否复用同一作用域中已有的槽位
+    bool is_declared(unsigned int slot) const;
+
+    void compile_error(const std::string &msg);
+
+private:
+    FunctionState *current_{};
+    unsigned int line_{0}; // 当前节点对应的源码行号
+    bool has_compile_error_{false};
+    // 下一个编译的调用是return语句的返回值, 使用TAIL_CALL
+    bool tail_call_{false};
+};
+
+} // namespace zero::bytecode
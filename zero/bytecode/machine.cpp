@@ -0,0 +1,484 @@
+#include "machine.hpp"
+
+#include "interpreter.hpp"
+#include "memo.hpp"
+#include "typed/code.hpp"
+#include "numeric.hpp"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+
+namespace zero::bytecode {
+
+Machine::Machine(Interpreter &interpreter)
+    : interpreter_{interpreter}, stack_(STACK_MAX), frames_(FRAMES_MAX) {
+    stack_top_ = stack_.data();
+}
+
+void Machine::run(const Chunk &script) {
+    reset_stack();
+    if (script.max_stack > STACK_MAX) {
+        throw RuntimeError(Token{token_type::END, "", 0},
+                           "Stack overflow.");
+    }
+
+    frames_[0] =
+        CallFrame{&script, script.code.data(), stack_.data(), nullptr};
+    frame_count_ = 1;
+
+    try {
+        execute();
+    } catch (const RuntimeError &) {
+        reset_stack();
+        throw;
+    }
+}
+
+void Machine::reset_stack() {
+    // 栈顶之上的槽位中不会保留堆对象, 只需要清理栈顶之下的部分
+    open_upvalues_.close(stack_.data());
+    for (Value *slot = stack_.data(); slot < stack_top_; slot++) {
+        *slot = nullptr;
+    }
+    stack_top_ = stack_.data();
+    frame_count_ = 0;
+    memo_keys_.clear();
+}
+
+bool Machine::call_typed(const ZeroFunction &function,
+                         Value *callee,
+                         Value *globals) {
+    const auto *typed = function.get_declaration()->typed.get();
+    Value result;
+    if (typed == nullptr || !typed->call(callee + 1, globals, result)) {
+        return false;
+    }
+    *callee = std::move(result);
+
+    return true;
+}
+
+void Machine::runtime_error(const CallFrame &frame, const std::string &msg) {
+    auto offset = static_cast<std::size_t>(frame.ip - frame.chunk->code.data());
+    auto line = offset > 0 ? frame.chunk->lines[offset - 1] : 0;
+
+    throw RuntimeError(Token{token_type::END, "", line}, msg);
+}
+
+void Machine::execute() {
+    CallFrame *frame = &frames_[frame_count_ - 1];
+    const uint8_t *ip = frame->ip;
+    Value *slots = frame->slots;
+    const Value *upvalues = frame->upvalues;
+    Value *top = stack_top_;
+    Value *globals = &interpreter_.get_globals()->get(0);
+
+#define READ_BYTE() (*ip++)
+#define READ_SHORT() (ip += 2, static_cast<uint16_t>((ip[-2] << 8) | ip[-1]))
+#define PUSH(value) (*top++ = (value))
+#define POP() (std::move(*--top))
+#define PEEK(distance) (top[-1 - (distance)])
+// 抛出错误前同步寄存器中的状态
+#define RUNTIME_ERROR(msg)                                                     \
+    do {                                                                       \
+        frame->ip = ip;                                                        \
+        stack_top_ = top;                                                      \
+        runtime_error(*frame, msg);                                            \
+    } while (0)
+// 数值运算, 结果覆盖左操作数
+#define BINARY_NUMBER_OP(function)                                             \
+    do {                                                                       \
+        Value &left = PEEK(1);                                                 \
+        const Value &right = PEEK(0);                                          \
+        if (!is_number(left) || !is_number(right)) {                           \
+            RUNTIME_ERROR("Operands must be numbers.");                        \
+        }                                                                      \
+        left = function(left, right);                                          \
+        --top;                                                                 \
+    } while (0)
+
+#if defined(__GNUC__)
+    // 使用GCC/Clang的computed goto扩展分发指令
+#    pragma GCC diagnostic push
+#    pragma GCC diagnostic ignored "-Wpedantic"
+    static void *dispatch_table[] = {
+#    define ZERO_OPCODE_LABEL(name, operand_bytes, stack_effect) &&op_##name,
+        ZERO_OPCODES(ZERO_OPCODE_LABEL)
+#    undef ZERO_OPCODE_LABEL
+    };
+#    define DISPATCH() goto *dispatch_table[READ_BYTE()]
+#    define TARGET(name) op_##name
+    DISPATCH();
+#else
+#    define DISPATCH() goto dispatch
+#    define TARGET(name) case opcode::name
+dispatch:
+    switch (static_cast<opcode>(READ_BYTE())) {
+#endif
+
+    TARGET(CONSTANT) : {
+        PUSH(frame->chunk->constants[READ_SHORT()]);
+        DISPATCH();
+    }
+    TARGET(NIL) : {
+        PUSH(nullptr);
+        DISPATCH();
+    }
+    TARGET(TRUE) : {
+        PUSH(true);
+        DISPATCH();
+    }
+    TARGET(FALSE) : {
+        PUSH(false);
+        DISPATCH();
+    }
+    TARGET(POP) : {
+        *--top = nullptr;
+        DISPATCH();
+    }
+    TARGET(GET_LOCAL) : {
+        PUSH(slots[READ_BYTE()]);
+        DISPATCH();
+    }
+    TARGET(SET_LOCAL) : {
+        slots[READ_BYTE()] = PEEK(0);
+        DISPATCH();
+    }
+    TARGET(GET_UPVALUE) : {
+        PUSH(upvalues[READ_BYTE()].as_upvalue().get());
+        DISPATCH();
+    }
+    TARGET(GET_SELF) : {
+        PUSH(slots[-1]);
+        DISPATCH();
+    }
+    TARGET(SET_UPVALUE) : {
+        upvalues[READ_BYTE()].as_upvalue().get() = PEEK(0);
+        DISPATCH();
+    }
+    TARGET(GET_GLOBAL) : {
+        PUSH(globals[READ_SHORT()]);
+        DISPATCH();
+    }
+    TARGET(SET_GLOBAL) : {
+        globals[READ_SHORT()] = PEEK(0);
+        DISPATCH();
+    }
+    TARGET(DEFINE_GLOBAL) : {
+        globals[READ_SHORT()] = POP();
+        DISPATCH();
+    }
+    // computed goto跳出作用域时不会调用局部变量的析构函数
+    // 指令中不能用局部Value持有堆对象, 直接在栈上比较
+    TARGET(EQUAL) : {
+        bool equal = is_equal(PEEK(1), PEEK(0));
+        *--top = nullptr;
+        PEEK(0) = equal;
+        DISPATCH();
+    }
+    TARGET(NOT_EQUAL) : {
+        bool equal = is_equal(PEEK(1), PEEK(0));
+        *--top = nullptr;
+        PEEK(0) = !equal;
+        DISPATCH();
+    }
+    TARGET(GREATER) : {
+        BINARY_NUMBER_OP(greater_numbers);
+        DISPATCH();
+    }
+    TARGET(GREATER_EQUAL) : {
+        BINARY_NUMBER_OP(greater_equal_numbers);
+        DISPATCH();
+    }
+    TARGET(LESS) : {
+        BINARY_NUMBER_OP(less_numbers);
+        DISPATCH();
+    }
+    TARGET(LESS_EQUAL) : {
+        BINARY_NUMBER_OP(less_equal_numbers);
+        DISPATCH();
+    }
+    TARGET(COMPARE_LOCAL) : {
+        // 局部变量与栈顶比较, 结果覆盖栈顶
+        const Value &left = slots[READ_BYTE()];
+        auto op = static_cast<opcode>(READ_BYTE());
+        Value &right = PEEK(0);
+        if (!is_number(left) || !is_number(right)) {
+            RUNTIME_ERROR("Operands must be numbers.");
+        }
+        switch (op) {
+            case opcode::GREATER:
+                right = greater_numbers(left, right);
+                break;
+            case opcode::GREATER_EQUAL:
+                right = greater_equal_numbers(left, right);
+                break;
+            case opcode::LESS:
+                right = less_numbers(left, right);
+                break;
+            default:
+                right = less_equal_numbers(left, right);
+                break;
+        }
+        DISPATCH();
+    }
+    TARGET(ADD) : {
+        Value &left = PEEK(1);
+        const Value &right = PEEK(0);
+        if (is_number(left) && is_number(right)) {
+            left = add_numbers(left, right);
+            --top;
+        } else if (left.is_string() && right.is_string()) {
+            left = concat(left, right);
+            *--top = nullptr;
+        } else {
+            RUNTIME_ERROR("Operands must be two numbers or two strings.");
+        }
+        DISPATCH();
+    }
+    TARGET(SUBTRACT) : {
+        BINARY_NUMBER_OP(subtract_numbers);
+        DISPATCH();
+    }
+    TARGET(MULTIPLY) : {
+        BINARY_NUMBER_OP(multiply_numbers);
+        DISPATCH();
+    }
+    TARGET(DIVIDE) : {
+        if (is_integer_division_by_zero(PEEK(1), PEEK(0))) {
+            RUNTIME_ERROR("Division by zero.");
+        }
+        BINARY_NUMBER_OP(divide_numbers);
+        DISPATCH();
+    }
+    TARGET(NOT) : {
+        PEEK(0) = !is_truthy(PEEK(0));
+        DISPATCH();
+    }
+    TARGET(NEGATE) : {
+        Value &operand = PEEK(0);
+        if (!is_number(operand)) {
+            RUNTIME_ERROR("Operand must be a number.");
+        }
+        operand = negate_number(operand);
+        DISPATCH();
+    }
+    TARGET(PROMOTE) : {
+        PEEK(0) = promote_number(PEEK(0));
+        DISPATCH();
+    }
+    TARGET(INCREMENT_LOCAL) : {
+        Value &local = slots[READ_BYTE()];
+        const Value &delta = frame->chunk->constants[READ_SHORT()];
+        if (!is_number(local)) {
+            RUNTIME_ERROR("Operand must be a number.");
+        }
+        local = add_numbers(local, delta);
+        PUSH(local);
+        DISPATCH();
+    }
+    TARGET(JUMP) : {
+        auto offset = READ_SHORT();
+        ip += offset;
+        DISPATCH();
+    }
+    TARGET(JUMP_IF_FALSE) : {
+        auto offset = READ_SHORT();
+        if (!is_truthy(PEEK(0))) {
+            ip += offset;
+        }
+        DISPATCH();
+    }
+    TARGET(JUMP_IF_TRUE) : {
+        auto offset = READ_SHORT();
+        if (is_truthy(PEEK(0))) {
+            ip += offset;
+        }
+        DISPATCH();
+    }
+    TARGET(LOOP) : {
+        auto offset = READ_SHORT();
+        ip -= offset;
+        DISPATCH();
+    }
+    TARGET(CALL) : {
+    call_function:
+        auto num_arguments = READ_BYTE();
+        Value *callee = top - num_arguments - 1;
+
+        if (callee->is_function()) {
+            auto &function = callee->as_function();
+            const Chunk *chunk = function.get_chunk();
+            if (chunk == nullptr) {
+                RUNTIME_ERROR("Can only call functions and classes.");
+            }
+            if (num_arguments != function.arity()) {
+                RUNTIME_ERROR(
+                    fmt::format("Expected {} arguments but got {}.",
+                                function.arity(),
+                                num_arguments));
+            }
+            if (frame_count_ == FRAMES_MAX
+                || top + chunk->max_stack > stack_.data() + STACK_MAX) {
+                RUNTIME_ERROR("Stack overflow.");
+            }
+
+            if (call_typed(function, callee, globals)) {
+                while (top > callee + 1) {
+                    *--top = nullptr;
+                }
+                DISPATCH();
+            }
+
+            // 记忆表命中时结果直接替换被调用的函数和参数
+            auto *memo = function.get_declaration()->memo.get();
+            if (memo != nullptr) {
+                if (const Value *result = memo->find(callee + 1)) {
+                    *callee = *result;
+                    while (top > callee + 1) {
+                        *--top = nullptr;
+                    }
+                    DISPATCH();
+                }
+                memo_keys_.insert(memo_keys_.end(), callee + 1, top);
+            }
+
+            frame->ip = ip;
+            frame = &frames_[frame_count_++];
+            *frame = CallFrame{chunk,
+                               chunk->code.data(),
+                               callee + 1,
+                               function.get_upvalues(),
+                               memo};
+            ip = frame->ip;
+            slots = frame->slots;
+            upvalues = frame->upvalues;
+            DISPATCH();
+        }
+
+        if (callee->is_native_function()) {
+            std::vector<Value> arguments(callee + 1, top);
+            frame->ip = ip;
+            stack_top_ = top;
+            Value result = callee->as_native_function().call(
+                interpreter_, std::move(arguments));
+            while (top > callee) {
+                *--top = nullptr;
+            }
+            PUSH(std::move(result));
+            DISPATCH();
+        }
+
+        RUNTIME_ERROR("Can only call functions and classes.");
+    }
+    TARGET(TAIL_CALL) : {
+        // 调用原生函数或者调用出错时按普通调用处理, 之后的RETURN返回结果
+        Value *callee = top - ip[0] - 1;
+        if (!callee->is_function()
+            || callee->as_function().get_chunk() == nullptr
+            || ip[0] != callee->as_function().arity()) {
+            goto call_function;
+        }
+
+        // 关闭当前栈帧中被捕获的变量, 被调用的函数和参数搬到当前函数的位置
+        auto num_arguments = READ_BYTE();
+        const Chunk *chunk = callee->as_function().get_chunk();
+        open_upvalues_.close(slots);
+        Value *base = slots - 1;
+        std::move(callee, top, base);
+        while (top > base + num_arguments + 1) {
+            *--top = nullptr;
+        }
+        if (top + chunk->max_stack > stack_.data() + STACK_MAX) {
+            RUNTIME_ERROR("Stack overflow.");
+        }
+
+        // 尾调用的结果就是当前调用的结果, 保留当前调用的记忆表
+        *frame = CallFrame{chunk,
+                           chunk->code.data(),
+                           base + 1,
+                           base->as_function().get_upvalues(),
+                           frame->memo};
+        ip = frame->ip;
+        slots = frame->slots;
+        upvalues = frame->upvalues;
+        DISPATCH();
+    }
+    TARGET(CLOSURE) : {
+        // 复制函数原型, 再按顺序捕获外层的局部变量或者外层捕获的变量
+        const auto &prototype = frame->chunk->constants[READ_SHORT()];
+        Value closure{prototype.as_function()};
+        auto &function = closure.as_function();
+        for (const auto &capture : function.get_chunk()->captures) {
+            function.add_upvalue(capture.is_local
+                                     ? open_upvalues_.capture(
+                                         slots + capture.index)
+                                     : upvalues[capture.index]);
+        }
+        PUSH(std::move(closure));
+        DISPATCH();
+    }
+    TARGET(CLOSE_UPVALUE) : {
+        open_upvalues_.close(top - 1);
+        *--top = nullptr;
+        DISPATCH();
+    }
+    TARGET(INLINE_GUARD) : {
+        // 全局变量仍然是被内联的函数时执行内联的代码, 否则跳到原来的调用
+        const auto &callee = globals[READ_SHORT()];
+        const auto &inlined = frame->chunk->constants[READ_SHORT()];
+        auto offset = READ_SHORT();
+        if (!callee.is_function()
+            || callee.as_function().get_declaration()
+                   != inlined.as_function().get_declaration()) {
+            ip += offset;
+        }
+        DISPATCH();
+    }
+    TARGET(RETURN) : {
+        Value result = POP();
+        if (frame->memo != nullptr) {
+            auto key = memo_keys_.size() - frame->memo->arity();
+            frame->memo->insert(memo_keys_.data() + key, result);
+            memo_keys_.resize(key);
+        }
+        // 关闭仍指向当前栈帧的捕获变量, 再释放参数, 局部变量以及被调用的函数
+        open_upvalues_.close(slots);
+        Value *base = frame_count_ == 1 ? slots : slots - 1;
+        while (top > base) {
+            *--top = nullptr;
+        }
+
+        frame_count_--;
+        if (frame_count_ == 0) {
+            stack_top_ = top;
+            return;
+        }
+
+        PUSH(std::move(result));
+        frame = &frames_[frame_count_ - 1];
+        ip = frame->ip;
+        slots = frame->slots;
+        upvalues = frame->upvalues;
+        DISPATCH();
+    }
+
+#if defined(__GNUC__)
+#    pragma GCC diagnostic pop
+#else
+    }
+#endif
+
+#undef READ_BYTE
+#undef READ_SHORT
+#undef PUSH
+#undef POP
+#undef PEEK
+#undef RUNTIME_ERROR
+#undef BINARY_NUMBER_OP
+#undef DISPATCH
+#undef TARGET
+}
+
+} // namespace zero::bytecode
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "chunk.hpp"
+#include "function.hpp"
+#include "limits.hpp"
+#include "value.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace zero {
+class Interpreter;
+class MemoTable;
+} // namespace zero
+
+namespace zero::bytecode {
+
+// 基于栈的字节码虚拟机
+// 全局变量和原生函数与树遍历解释器共用, 由Interpreter持有
+class Machine {
+public:
+    explicit Machine(Interpreter &interpreter);
+
+public:
+    // 执行脚本, 运行时错误以RuntimeError抛出
+    void run(const Chunk &script);
+
+private:
+    struct CallFrame {
+        const Chunk *chunk;
+        const uint8_t *ip;
+        Value *slots; // 栈帧起始位置, 依次存放参数和局部变量
+        const Value *upvalues; // 闭包捕获的变量, 顶层代码为空
+        // 返回时记录结果的记忆表, 参数保存在memo_keys_的末尾
+        MemoTable *memo{nullptr};
+    };
+
+    void execute();
+    [[noreturn]] void runtime_error(const CallFrame &frame,
+                                    const std::string &msg);
+    // 清空操作数栈和调用栈
+    void reset_stack();
+    // 函数有类型特化的版本并且参数类型与注解一致时直接执行,
+    // 结果替换callee处的函数
+    static bool
+    call_typed(const ZeroFunction &function, Value *callee, Value *globals);
+
+private:
+    static constexpr std::size_t STACK_MAX = 1 << 18;
+    // 与其他执行方式的调用深度上限相同, 另有一个栈帧执行顶层代码
+    static constexpr std::size_t FRAMES_MAX = MAX_CALL_DEPTH + 1;
+
+    Interpreter &interpreter_;
+    std::vector<Value> stack_;
+    Value *stack_top_;
+    std::vector<CallFrame> frames_;
+    std::size_t frame_count_{0};
+    OpenUpvalues open_upvalues_;
+    // 正在执行的记忆化调用的参数, 函数体可能修改栈上的参数
+    std::vector<Value> memo_keys_;
+};
+
+} // namespace zero::bytecode
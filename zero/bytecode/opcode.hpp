@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+
+namespace zero::bytecode {
+
+// X(名称, 操作数字节数, 对操作数栈深度的影响)
+// CALL和TAIL_CALL的栈影响与参数个数有关, 由编译器单独计算
+// INLINE_GUARD的操作数依次为全局槽位, 被内联函数的常量下标和跳转偏移
+// INCREMENT_LOCAL的操作数为局部变量槽位和增量的常量下标
+// COMPARE_LOCAL的操作数为局部变量槽位和比较用的操作码
+// GET_SELF读取栈帧下方正在执行的函数
+#define ZERO_OPCODES(X)                                                        \
+    X(CONSTANT, 2, 1)                                                          \
+    X(NIL, 0, 1)                                                               \
+    X(TRUE, 0, 1)                                                              \
+    X(FALSE, 0, 1)                                                             \
+    X(POP, 0, -1)                                                              \
+    X(GET_LOCAL, 1, 1)                                                         \
+    X(SET_LOCAL, 1, 0)                                                         \
+    X(GET_UPVALUE, 1, 1)                                                       \
+    X(SET_UPVALUE, 1, 0)                                                       \
+    X(GET_SELF, 0, 1)                                                          \
+    X(GET_GLOBAL, 2, 1)                                                        \
+    X(SET_GLOBAL, 2, 0)                                                        \
+    X(DEFINE_GLOBAL, 2, -1)                                                    \
+    X(EQUAL, 0, -1)                                                            \
+    X(NOT_EQUAL, 0, -1)                                                        \
+    X(GREATER, 0, -1)                                                          \
+    X(GREATER_EQUAL, 0, -1)                                                    \
+    X(LESS, 0, -1)                                                             \
+    X(LESS_EQUAL, 0, -1)                                                       \
+    X(COMPARE_LOCAL, 2, 0)                                                     \
+    X(ADD, 0, -1)                                                              \
+    X(SUBTRACT, 0, -1)                                                         \
+    X(MULTIPLY, 0, -1)                                                         \
+    X(DIVIDE, 0, -1)                                                           \
+    X(NOT, 0, 0)                                                               \
+    X(NEGATE, 0, 0)                                                            \
+    X(PROMOTE, 0, 0)                                                           \
+    X(INCREMENT_LOCAL, 3, 1)                                                   \
+    X(JUMP, 2, 0)                                                              \
+    X(JUMP_IF_FALSE, 2, 0)                                                     \
+    X(JUMP_IF_TRUE, 2, 0)                                                      \
+    X(LOOP, 2, 0)                                                              \
+    X(CALL, 1, 0)                                                              \
+    X(TAIL_CALL, 1, 0)                                                         \
+    X(INLINE_GUARD, 6, 0)                                                      \
+    X(CLOSURE, 2, 1)                                                           \
+    X(CLOSE_UPVALUE, 0, -1)                                                    \
+    X(RETURN, 0, -1)
+
+enum class opcode : uint8_t {
+#define ZERO_OPCODE_ENUM(name, operand_bytes, stack_effect) name,
+    ZERO_OPCODES(ZERO_OPCODE_ENUM)
+#undef ZERO_OPCODE_ENUM
+};
+
+// 操作码对应的名称, 用于反汇编
+const char *opcode_name(opcode op);
+// 操作数占用的字节数
+unsigned int operand_bytes(opcode op);
+// 执行后操作数栈深度的变化
+int stack_effect(opcode op);
+
+} // namespace zero::bytecode
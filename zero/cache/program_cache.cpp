@@ -0,0 +1,187 @@
+#include "program_cache.hpp"
+
+#include "fmt/core.h"
+#include "interpreter.hpp"
+#include "serializer.hpp"
+#include "symbol.hpp"
+#include "utils/file_utils.hpp"
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <system_error>
+
+#if defined(__linux__)
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#endif
+
+namespace zero::cache {
+
+namespace {
+// 只读映射的缓存文件, 不支持mmap的平台整体读入内存
+class MappedFile {
+public:
+    explicit MappedFile(const std::string &path) {
+#if defined(__linux__)
+        auto fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return;
+        }
+        struct stat status {};
+        if (fstat(fd, &status) == 0 && status.st_size > 0) {
+            auto size = static_cast<std::size_t>(status.st_size);
+            void *address
+                = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (address != MAP_FAILED) {
+                address_ = address;
+                data_ = static_cast<const char *>(address);
+                size_ = size;
+            }
+        }
+        close(fd);
+#else
+        if (utils::file_exists(path)) {
+            buffer_ = utils::read_file(path);
+            data_ = buffer_.data();
+            size_ = buffer_.size();
+        }
+#endif
+    }
+
+    ~MappedFile() {
+#if defined(__linux__)
+        if (address_ != nullptr) {
+            munmap(address_, size_);
+        }
+#endif
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    const char *data() const { return data_; }
+    std::size_t size() const { return size_; }
+
+private:
+    void *address_{nullptr};
+    std::string buffer_;
+    const char *data_{nullptr};
+    std::size_t size_{0};
+};
+
+// 临时文件名的后缀, 区分同时写入同一个缓存文件的进程
+long process_id() {
+#if defined(__linux__)
+    return static_cast<long>(getpid());
+#else
+    return 0;
+#endif
+}
+} // namespace
+
+std::string ProgramCache::default_directory() {
+    if (const auto *directory = std::getenv("ZERO_CACHE_DIR")) {
+        return directory;
+    }
+    if (const auto *cache_home = std::getenv("XDG_CACHE_HOME");
+        cache_home != nullptr && *cache_home != '\0') {
+        return (std::filesystem::path{cache_home} / "zero").string();
+    }
+    if (const auto *home = std::getenv("HOME");
+        home != nullptr && *home != '\0') {
+        return (std::filesystem::path{home} / ".cache" / "zero").string();
+    }
+
+    return "";
+}
+
+std::unique_ptr<Program>
+ProgramCache::load(const std::string &source, Interpreter &interpreter) const {
+    if (directory_.empty()) {
+        return nullptr;
+    }
+    MappedFile file{path(source)};
+    if (file.data() == nullptr) {
+        return nullptr;
+    }
+
+    std::vector<std::string_view> globals;
+    Deserializer deserializer{file.data(), file.size()};
+    auto program = deserializer.deserialize(source, globals);
+    if (program == nullptr) {
+        return nullptr;
+    }
+
+    // 语法树中的全局槽位在保存时确定, 解释器中已有的全局变量(内置函数)
+    // 必须在相同的槽位, 其余的全局变量还没有声明
+    auto &symbols = SymbolTable::instance();
+    auto num_declared = interpreter.num_globals();
+    if (globals.size() < num_declared) {
+        return nullptr;
+    }
+    for (unsigned int slot = 0; slot < globals.size(); slot++) {
+        auto name = symbols.intern(globals[slot]);
+        auto declared = interpreter.lookup_global(name);
+        if (slot < num_declared ? declared != slot : declared.has_value()) {
+            return nullptr;
+        }
+    }
+    for (auto slot = num_declared; slot < globals.size(); slot++) {
+        interpreter.declare_global(symbols.intern(globals[slot]));
+    }
+
+    return program;
+}
+
+bool ProgramCache::store(const std::string &source,
+                         const std::unique_ptr<Program> &program,
+                         const Interpreter &interpreter) const {
+    if (directory_.empty()) {
+        return false;
+    }
+
+    auto &symbols = SymbolTable::instance();
+    std::vector<std::string_view> globals;
+    for (auto name : interpreter.global_names()) {
+        globals.push_back(symbols.name(name));
+    }
+    std::string data;
+    Serializer serializer;
+    if (!serializer.serialize(program, globals, source, data)) {
+        return false;
+    }
+
+    // 先写入临时文件再重命名, 并发执行的进程不会读到写了一半的文件
+    std::error_code error;
+    std::filesystem::create_directories(directory_, error);
+    if (error) {
+        return false;
+    }
+    auto target = path(source);
+    auto temporary = fmt::format("{}.{}.tmp", target, process_id());
+    {
+        std::ofstream output{temporary, std::ios::out | std::ios::binary};
+        output.write(data.data(), static_cast<std::streamsize>(data.size()));
+        if (!output) {
+            std::filesystem::remove(temporary, error);
+            return false;
+        }
+    }
+    std::filesystem::rename(temporary, target, error);
+    if (error) {
+        std::filesystem::remove(temporary, error);
+        return false;
+    }
+
+    return true;
+}
+
+std::string ProgramCache::path(const std::string &source) const {
+    auto name = fmt::format("{:016x}.zpc", hash(source));
+    return (std::filesystem::path{directory_} / name).string();
+}
+
+} // namespace zero::cache
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "ast/program.hpp"
+
+#include <memory>
+#include <string>
+
+namespace zero {
+class Interpreter;
+} // namespace zero
+
+namespace zero::cache {
+
+// 预编译程序的缓存目录, 以源码内容的哈希为文件名
+// 源码没有变化时跳过词法解析, 语法解析, 优化和静态解析, 直接加载语法树
+class ProgramCache {
+public:
+    // directory为空时不使用缓存
+    explicit ProgramCache(std::string directory)
+        : directory_{std::move(directory)} {}
+
+public:
+    // 默认目录: $ZERO_CACHE_DIR, $XDG_CACHE_HOME/zero或者~/.cache/zero
+    static std::string default_directory();
+
+    // 加载source的预编译程序, 并按保存时的顺序声明全局变量
+    // 缓存不存在, 已过期, 损坏或者全局变量不一致时返回nullptr
+    std::unique_ptr<Program> load(const std::string &source,
+                                  Interpreter &interpreter) const;
+    // 保存静态解析之后的程序, 失败时不影响执行
+    bool store(const std::string &source,
+               const std::unique_ptr<Program> &program,
+               const Interpreter &interpreter) const;
+    // source对应的缓存文件
+    std::string path(const std::string &source) const;
+
+private:
+    std::string directory_;
+};
+
+} // namespace zero::cache
@@ -0,0 +1,764 @@
+#include "serializer.hpp"
+
+#include "ast/arena.hpp"
+#include "fmt/core.h"
+#include "symbol.hpp"
+
+#include <cstring>
+
+#if defined(__linux__)
+#    include <sys/stat.h>
+#endif
+
+// 由meson定义为项目版本
+#ifndef ZERO_VERSION
+#    define ZERO_VERSION "unknown"
+#endif
+
+namespace zero::cache {
+
+namespace {
+constexpr char MAGIC[8] = {'z', 'e', 'r', 'o', 'a', 's', 't', '\0'};
+
+void put_u32(std::string &output, uint32_t value) {
+    for (auto i = 0; i < 4; i++) {
+        output += static_cast<char>((value >> (8 * i)) & 0xff);
+    }
+}
+
+void put_u64(std::string &output, uint64_t value) {
+    for (auto i = 0; i < 8; i++) {
+        output += static_cast<char>((value >> (8 * i)) & 0xff);
+    }
+}
+
+uint64_t read_u64(const char *data) {
+    uint64_t value = 0;
+    for (auto i = 0; i < 8; i++) {
+        value |= static_cast<uint64_t>(static_cast<uint8_t>(data[i]))
+              << (8 * i);
+    }
+    return value;
+}
+
+uint32_t read_u32(const char *data) {
+    uint32_t value = 0;
+    for (auto i = 0; i < 4; i++) {
+        value |= static_cast<uint32_t>(static_cast<uint8_t>(data[i]))
+              << (8 * i);
+    }
+    return value;
+}
+} // namespace
+
+uint64_t hash(std::string_view source) {
+    // 64位FNV-1a
+    uint64_t result = 14695981039346656037ull;
+    for (unsigned char c : source) {
+        result ^= c;
+        result *= 1099511628211ull;
+    }
+    return result;
+}
+
+uint64_t build_id() {
+    static const uint64_t id = [] {
+        std::string identity = ZERO_VERSION;
+#if defined(__VERSION__)
+        identity += " ";
+        identity += __VERSION__;
+#endif
+#if defined(__linux__)
+        // 优化过程改变后版本号不一定改变, 用可执行文件区分每次构建
+        struct stat status {};
+        if (stat("/proc/self/exe", &status) == 0) {
+            identity += fmt::format(" {} {}.{}",
+                                    status.st_size,
+                                    status.st_mtim.tv_sec,
+                                    status.st_mtim.tv_nsec);
+        }
+#endif
+        return hash(identity);
+    }();
+    return id;
+}
+
+bool Serializer::serialize(const std::unique_ptr<Program> &program,
+                           const std::vector<std::string_view> &globals,
+                           std::string_view source,
+                           std::string &output) {
+    try {
+        put(static_cast<uint32_t>(globals.size()));
+        for (auto name : globals) {
+            write(name);
+        }
+        write(program->get_statements());
+    } catch (const Unsupported &) {
+        return false;
+    }
+    // 被内联的函数必须在同一个程序中
+    for (bool written : written_) {
+        if (!written) {
+            return false;
+        }
+    }
+    if (strings_.size() + nodes_.size() > UINT32_MAX - HEADER_SIZE) {
+        return false;
+    }
+
+    auto strings_offset = static_cast<uint32_t>(HEADER_SIZE);
+    auto nodes_offset = static_cast<uint32_t>(HEADER_SIZE + strings_.size());
+    output.assign(MAGIC, sizeof MAGIC);
+    put_u32(output, FORMAT_VERSION);
+    put_u32(output, 0); // 保留
+    put_u64(output, build_id());
+    put_u64(output, hash(source));
+    put_u64(output, source.size());
+    put_u32(output, strings_offset);
+    put_u32(output, static_cast<uint32_t>(strings_.size()));
+    put_u32(output, nodes_offset);
+    put_u32(output, static_cast<uint32_t>(nodes_.size()));
+    put_u64(output, hash(strings_ + nodes_));
+    output += strings_;
+    output += nodes_;
+    return true;
+}
+
+void Serializer::write(Expr *expr) {
+    if (expr == nullptr) {
+        write(node_tag::NONE);
+        return;
+    }
+    expr->accept(*this);
+}
+
+void Serializer::write(Stmt *stmt) {
+    if (stmt == nullptr) {
+        write(node_tag::NONE);
+        return;
+    }
+    stmt->accept(*this);
+}
+
+void Serializer::write(const std::vector<std::unique_ptr<Stmt>> &stmts) {
+    put(static_cast<uint32_t>(stmts.size()));
+    for (const auto &stmt : stmts) {
+        write(stmt.get());
+    }
+}
+
+void Serializer::write(const Token &token) {
+    // 只保存词位, 标识符的符号id在加载时重新驻留
+    put(static_cast<uint8_t>(token.type));
+    put(static_cast<uint32_t>(token.line));
+    write(token.lexeme);
+}
+
+void Serializer::write(std::string_view str) {
+    // 相同的字符串只保存一次
+    auto found = string_offsets_.find(str);
+    uint32_t offset;
+    if (found != string_offsets_.end()) {
+        offset = found->second;
+    } else {
+        offset = static_cast<uint32_t>(strings_.size());
+        strings_ += str;
+        string_offsets_.emplace(str, offset);
+    }
+    put(offset);
+    put(static_cast<uint32_t>(str.size()));
+}
+
+void Serializer::write(const Value &value) {
+    if (value.is_nil()) {
+        put(static_cast<uint8_t>(literal_tag::NIL));
+    } else if (value.is_bool()) {
+        put(static_cast<uint8_t>(literal_tag::BOOL));
+        put(static_cast<uint8_t>(value.as_bool() ? 1 : 0));
+    } else if (value.is_int()) {
+        put(static_cast<uint8_t>(literal_tag::INT));
+        put(static_cast<uint64_t>(value.as_int()));
+    } else if (value.is_double()) {
+        put(static_cast<uint8_t>(literal_tag::DOUBLE));
+        uint64_t bits;
+        auto d = value.as_double();
+        std::memcpy(&bits, &d, sizeof bits);
+        put(bits);
+    } else if (value.is_string()) {
+        put(static_cast<uint8_t>(literal_tag::STRING));
+        write(value.as_string());
+    } else {
+        throw Unsupported{};
+    }
+}
+
+void Serializer::put(uint32_t value) {
+    // LEB128变长编码, 槽位, 行号和字符串偏移大多只需要一两个字节
+    while (value >= 0x80) {
+        nodes_ += static_cast<char>((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    nodes_ += static_cast<char>(value);
+}
+
+void Serializer::put(uint64_t value) { put_u64(nodes_, value); }
+
+uint32_t Serializer::function_id(const Function *function) {
+    auto id = static_cast<uint32_t>(function_ids_.size());
+    auto [found, inserted] = function_ids_.emplace(function, id);
+    if (inserted) {
+        written_.push_back(false);
+    }
+    return found->second;
+}
+
+Value Serializer::visit_binary_expr(Binary *expr) {
+    write(node_tag::BINARY);
+    write(expr->left.get());
+    write(expr->op);
+    write(expr->right.get());
+
+    return {};
+}
+
+Value Serializer::visit_grouping_expr(Grouping *expr) {
+    write(node_tag::GROUPING);
+    write(expr->expr.get());
+
+    return {};
+}
+
+Value Serializer::visit_literal_expr(Literal *expr) {
+    write(node_tag::LITERAL);
+    write(expr->value);
+
+    return {};
+}
+
+Value Serializer::visit_logical_expr(Logical *expr) {
+    write(node_tag::LOGICAL);
+    write(expr->left.get());
+    write(expr->op);
+    write(expr->right.get());
+
+    return {};
+}
+
+Value Serializer::visit_unary_expr(Unary *expr) {
+    write(node_tag::UNARY);
+    write(expr->op);
+    write(expr->right.get());
+
+    return {};
+}
+
+Value Serializer::visit_variable_expr(Variable *expr) {
+    write(node_tag::VARIABLE);
+    write(expr->name);
+    put(static_cast<uint32_t>(expr->depth - GLOBAL_DEPTH));
+    put(static_cast<uint32_t>(expr->slot));
+
+    return {};
+}
+
+Value Serializer::visit_assign_expr(Assign *expr) {
+    write(node_tag::ASSIGN);
+    write(expr->name);
+    write(expr->value.get());
+    put(static_cast<uint32_t>(expr->depth - GLOBAL_DEPTH));
+    put(static_cast<uint32_t>(expr->slot));
+
+    return {};
+}
+
+Value Serializer::visit_call_expr(Call *expr) {
+    write(node_tag::CALL);
+    write(expr->callee.get());
+    write(expr->paren);
+    put(static_cast<uint32_t>(expr->arguments.size()));
+    for (const auto &argument : expr->arguments) {
+        write(argument.get());
+    }
+
+    return {};
+}
+
+Value Serializer::visit_inline_call_expr(InlineCall *expr) {
+    write(node_tag::INLINE_CALL);
+    write(expr->call.get());
+    put(function_id(expr->function));
+    write(expr->body.get());
+    put(static_cast<uint32_t>(expr->num_slots));
+
+    return {};
+}
+
+Value Serializer::visit_increment_expr(Increment *expr) {
+    write(node_tag::INCREMENT);
+    write(expr->name);
+    write(expr->op);
+    put(static_cast<uint64_t>(expr->delta));
+    put(static_cast<uint32_t>(expr->depth - GLOBAL_DEPTH));
+    put(static_cast<uint32_t>(expr->slot));
+
+    return {};
+}
+
+Value Serializer::visit_compare_expr(Compare *expr) {
+    write(node_tag::COMPARE);
+    write(expr->variable.get());
+    write(expr->op);
+    write(expr->bound.get());
+
+    return {};
+}
+
+Value Serializer::visit_promote_expr(Promote *expr) {
+    write(node_tag::PROMOTE);
+    write(expr->expr.get());
+
+    return {};
+}
+
+Completion Serializer::visit_block_stmt(Block *stmt) {
+    write(node_tag::BLOCK);
+    write(stmt->statements);
+    put(static_cast<uint32_t>(stmt->num_slots));
+    put(static_cast<uint8_t>(stmt->has_captured ? 1 : 0));
+    put(static_cast<uint32_t>(stmt->first_slot));
+
+    return Completion::NORMAL;
+}
+
+Completion Serializer::visit_expression_stmt(Expression *stmt) {
+    write(node_tag::EXPRESSION);
+    write(stmt->expression.get());
+
+    return Completion::NORMAL;
+}
+
+Completion Serializer::visit_var_stmt(Var *stmt) {
+    write(node_tag::VAR);
+    write(stmt->name);
+    write(stmt->initializer.get());
+    put(static_cast<uint8_t>(stmt->type));
+    put(static_cast<uint32_t>(stmt->depth - GLOBAL_DEPTH));
+    put(static_cast<uint32_t>(stmt->slot));
+
+    return Completion::NORMAL;
+}
+
+Completion Serializer::visit_if_stmt(If *stmt) {
+    write(node_tag::IF);
+    write(stmt->condition.get());
+    write(stmt->then_branch.get());
+    write(stmt->else_branch.get());
+
+    return Completion::NORMAL;
+}
+
+Completion Serializer::visit_while_stmt(While *stmt) {
+    write(node_tag::WHILE);
+    write(stmt->condition.get());
+    write(stmt->body.get());
+
+    return Completion::NORMAL;
+}
+
+Completion Serializer::visit_function_stmt(Function *stmt) {
+    auto id = function_id(stmt);
+    written_[id] = true;
+
+    write(node_tag::FUNCTION);
+    put(id);
+    write(stmt->name);
+    put(static_cast<uint32_t>(stmt->params.size()));
+    for (std::size_t i = 0; i < stmt->params.size(); i++) {
+        write(stmt->params[i]);
+        put(static_cast<uint8_t>(stmt->param_types[i]));
+    }
+    put(static_cast<uint8_t>(stmt->return_type));
+    write(stmt->body);
+    put(static_cast<uint32_t>(stmt->depth - GLOBAL_DEPTH));
+    put(static_cast<uint32_t>(stmt->slot));
+    put(static_cast<uint32_t>(stmt->num_slots));
+    put(static_cast<uint32_t>(stmt->captures.size()));
+    for (const auto &capture : stmt->captures) {
+        put(static_cast<uint8_t>(capture.is_local ? 1 : 0));
+        put(static_cast<uint32_t>(capture.index));
+        write(SymbolTable::instance().name(capture.name));
+    }
+    put(static_cast<uint8_t>(stmt->memoize ? 1 : 0));
+
+    return Completion::NORMAL;
+}
+
+Completion Serializer::visit_return_stmt(Return *stmt) {
+    write(node_tag::RETURN);
+    write(stmt->keyword);
+    write(stmt->value.get());
+    put(static_cast<uint8_t>(stmt->tail_call ? 1 : 0));
+
+    return Completion::NORMAL;
+}
+
+std::unique_ptr<Program>
+Deserializer::deserialize(std::string_view source,
+                          std::vector<std::string_view> &globals) {
+    // 文件头
+    if (size_ < HEADER_SIZE || std::memcmp(data_, MAGIC, sizeof MAGIC) != 0
+        || read_u32(data_ + 8) != FORMAT_VERSION
+        || read_u64(data_ + 16) != build_id()
+        || read_u64(data_ + 24) != hash(source)
+        || read_u64(data_ + 32) != source.size()) {
+        return nullptr;
+    }
+    std::size_t strings_offset = read_u32(data_ + 40);
+    std::size_t strings_size = read_u32(data_ + 44);
+    std::size_t nodes_offset = read_u32(data_ + 48);
+    std::size_t nodes_size = read_u32(data_ + 52);
+    if (strings_offset + strings_size > size_
+        || nodes_offset + nodes_size > size_
+        || strings_offset + strings_size != nodes_offset) {
+        return nullptr;
+    }
+    // 损坏的文件可能仍然是格式正确的语法树, 例如槽位被改写, 不能只靠格式检查
+    if (hash({data_ + strings_offset, strings_size + nodes_size})
+        != read_u64(data_ + 56)) {
+        return nullptr;
+    }
+
+    // 字符串表复制一次, 之后词位都直接引用内存池中的字符串
+    auto arena = std::make_unique<Arena>();
+    Arena::Scope arena_scope{*arena};
+    strings_ = arena->copy({data_ + strings_offset, strings_size});
+    position_ = nodes_offset;
+    end_ = nodes_offset + nodes_size;
+
+    std::vector<std::unique_ptr<Stmt>> statements;
+    try {
+        auto num_globals = get_u32();
+        globals.clear();
+        for (uint32_t i = 0; i < num_globals; i++) {
+            globals.push_back(read_string());
+        }
+        statements = read_stmts();
+        if (position_ != end_) {
+            throw Corrupted{};
+        }
+        // 被内联的函数可能在调用之后声明, 最后统一填写
+        for (auto [call, id] : fixups_) {
+            if (id >= functions_.size() || functions_[id] == nullptr) {
+                throw Corrupted{};
+            }
+            call->function = functions_[id];
+        }
+    } catch (const Corrupted &) {
+        return nullptr;
+    }
+
+    auto program = std::make_unique<Program>(std::move(statements));
+    program->set_arena(std::move(arena));
+    return program;
+}
+
+std::unique_ptr<Expr> Deserializer::read_expr() {
+    auto tag = static_cast<node_tag>(get_u8());
+    switch (tag) {
+        case node_tag::NONE:
+            return nullptr;
+        case node_tag::BINARY: {
+            auto left = expect_expr();
+            auto op = read_token();
+            return std::make_unique<Binary>(
+                std::move(left), std::move(op), expect_expr());
+        }
+        case node_tag::GROUPING:
+            return std::make_unique<Grouping>(expect_expr());
+        case node_tag::LITERAL:
+            return std::make_unique<Literal>(read_value());
+        case node_tag::LOGICAL: {
+            auto left = expect_expr();
+            auto op = read_token();
+            return std::make_unique<Logical>(
+                std::move(left), std::move(op), expect_expr());
+        }
+        case node_tag::UNARY: {
+            auto op = read_token();
+            return std::make_unique<Unary>(std::move(op), expect_expr());
+        }
+        case node_tag::VARIABLE: {
+            auto variable = std::make_unique<Variable>(read_token());
+            variable->depth = static_cast<int>(get_u32()) + GLOBAL_DEPTH;
+            variable->slot = get_u32();
+            return variable;
+        }
+        case node_tag::ASSIGN: {
+            auto name = read_token();
+            auto assign
+                = std::make_unique<Assign>(std::move(name), expect_expr());
+            assign->depth = static_cast<int>(get_u32()) + GLOBAL_DEPTH;
+            assign->slot = get_u32();
+            return assign;
+        }
+        case node_tag::CALL: {
+            auto callee = expect_expr();
+            auto paren = read_token();
+            auto num_arguments = get_u32();
+            std::vector<std::unique_ptr<Expr>> arguments;
+            for (uint32_t i = 0; i < num_arguments; i++) {
+                arguments.push_back(expect_expr());
+            }
+            return std::make_unique<Call>(
+                std::move(callee), std::move(paren), std::move(arguments));
+        }
+        case node_tag::INLINE_CALL: {
+            auto call = expect_expr();
+            if (dynamic_cast<Call *>(call.get()) == nullptr) {
+                throw Corrupted{};
+            }
+            auto id = get_u32();
+            auto inline_call = std::make_unique<InlineCall>(
+                std::unique_ptr<Call>{static_cast<Call *>(call.release())},
+                nullptr,
+                expect_expr());
+            inline_call->num_slots = get_u32();
+            fixups_.emplace_back(inline_call.get(), id);
+            return inline_call;
+        }
+        case node_tag::INCREMENT: {
+            auto name = read_token();
+            auto op = read_token();
+            auto delta = static_cast<int64_t>(get_u64());
+            auto increment = std::make_unique<Increment>(
+                std::move(name), std::move(op), delta);
+            increment->depth = static_cast<int>(get_u32()) + GLOBAL_DEPTH;
+            increment->slot = get_u32();
+            return increment;
+        }
+        case node_tag::COMPARE: {
+            auto variable = expect_expr();
+            if (dynamic_cast<Variable *>(variable.get()) == nullptr) {
+                throw Corrupted{};
+            }
+            auto op = read_token();
+            return std::make_unique<Compare>(
+                std::unique_ptr<Variable>{
+                    static_cast<Variable *>(variable.release())},
+                std::move(op),
+                expect_expr());
+        }
+        case node_tag::PROMOTE:
+            return std::make_unique<Promote>(expect_expr());
+        default:
+            throw Corrupted{};
+    }
+}
+
+std::unique_ptr<Expr> Deserializer::expect_expr() {
+    auto expr = read_expr();
+    if (expr == nullptr) {
+        throw Corrupted{};
+    }
+    return expr;
+}
+
+std::unique_ptr<Stmt> Deserializer::read_stmt() {
+    auto tag = static_cast<node_tag>(get_u8());
+    switch (tag) {
+        case node_tag::NONE:
+            return nullptr;
+        case node_tag::BLOCK: {
+            auto block = std::make_unique<Block>(read_stmts());
+            block->num_slots = get_u32();
+            block->has_captured = get_u8() != 0;
+            block->first_slot = get_u32();
+            return block;
+        }
+        case node_tag::EXPRESSION:
+            return std::make_unique<Expression>(expect_expr());
+        case node_tag::VAR: {
+            auto name = read_token();
+            auto var = std::make_unique<Var>(std::move(name), read_expr());
+            var->type = read_type();
+            var->depth = static_cast<int>(get_u32()) + GLOBAL_DEPTH;
+            var->slot = get_u32();
+            return var;
+        }
+        case node_tag::IF: {
+            auto condition = expect_expr();
+            auto then_branch = read_stmt();
+            if (then_branch == nullptr) {
+                throw Corrupted{};
+            }
+            return std::make_unique<If>(
+                std::move(condition), std::move(then_branch), read_stmt());
+        }
+        case node_tag::WHILE: {
+            auto condition = expect_expr();
+            auto body = read_stmt();
+            if (body == nullptr) {
+                throw Corrupted{};
+            }
+            return std::make_unique<While>(std::move(condition),
+                                           std::move(body));
+        }
+        case node_tag::FUNCTION: {
+            auto id = get_u32();
+            auto name = read_token();
+            auto num_params = get_u32();
+            std::vector<Token> params;
+            std::vector<static_type> param_types;
+            for (uint32_t i = 0; i < num_params; i++) {
+                params.push_back(read_token());
+                param_types.push_back(read_type());
+            }
+            auto return_type = read_type();
+            auto function = std::make_unique<Function>(
+                std::move(name), std::move(params), read_stmts());
+            function->param_types = std::move(param_types);
+            function->return_type = return_type;
+            function->depth = static_cast<int>(get_u32()) + GLOBAL_DEPTH;
+            function->slot = get_u32();
+            function->num_slots = get_u32();
+            auto num_captures = get_u32();
+            for (uint32_t i = 0; i < num_captures; i++) {
+                Capture capture{};
+                capture.is_local = get_u8() != 0;
+                capture.index = get_u32();
+                capture.name = SymbolTable::instance().intern(read_string());
+                function->captures.push_back(capture);
+            }
+            function->memoize = get_u8() != 0;
+
+            if (id >= functions_.size()) {
+                // 编号按首次引用分配, 不会超过函数个数太多
+                if (id > end_) {
+                    throw Corrupted{};
+                }
+                functions_.resize(id + 1, nullptr);
+            }
+            functions_[id] = function.get();
+            return function;
+        }
+        case node_tag::RETURN: {
+            auto keyword = read_token();
+            auto stmt
+                = std::make_unique<Return>(std::move(keyword), read_expr());
+            stmt->tail_call = get_u8() != 0;
+            if (stmt->tail_call
+                && dynamic_cast<Call *>(stmt->value.get()) == nullptr) {
+                throw Corrupted{};
+            }
+            return stmt;
+        }
+        default:
+            throw Corrupted{};
+    }
+}
+
+std::vector<std::unique_ptr<Stmt>> Deserializer::read_stmts() {
+    auto num_stmts = get_u32();
+    // 每条语句至少占一个字节, 防止错误的长度分配过多内存
+    if (num_stmts > end_ - position_) {
+        throw Corrupted{};
+    }
+    std::vector<std::unique_ptr<Stmt>> stmts;
+    stmts.reserve(num_stmts);
+    for (uint32_t i = 0; i < num_stmts; i++) {
+        auto stmt = read_stmt();
+        if (stmt == nullptr) {
+            throw Corrupted{};
+        }
+        stmts.push_back(std::move(stmt));
+    }
+    return stmts;
+}
+
+Token Deserializer::read_token() {
+    auto type = get_u8();
+    if (type > static_cast<uint8_t>(token_type::END)) {
+        throw Corrupted{};
+    }
+    Token token{static_cast<token_type>(type), {}, 0};
+    token.line = get_u32();
+    token.lexeme = read_string();
+    if (token.type == token_type::IDENTIFIER) {
+        token.symbol = SymbolTable::instance().intern(token.lexeme);
+    }
+    return token;
+}
+
+std::string_view Deserializer::read_string() {
+    std::size_t offset = get_u32();
+    std::size_t size = get_u32();
+    if (offset + size > strings_.size()) {
+        throw Corrupted{};
+    }
+    return strings_.substr(offset, size);
+}
+
+Value Deserializer::read_value() {
+    switch (static_cast<literal_tag>(get_u8())) {
+        case literal_tag::NIL:
+            return nullptr;
+        case literal_tag::BOOL:
+            return get_u8() != 0;
+        case literal_tag::INT:
+            return static_cast<int64_t>(get_u64());
+        case literal_tag::DOUBLE: {
+            auto bits = get_u64();
+            double d;
+            std::memcpy(&d, &bits, sizeof d);
+            return d;
+        }
+        case literal_tag::STRING: {
+            // 与解析器相同, 相同的字符串常量共享同一个堆对象
+            auto &symbols = SymbolTable::instance();
+            return symbols.string_value(symbols.intern(read_string()));
+        }
+        default:
+            throw Corrupted{};
+    }
+}
+
+static_type Deserializer::read_type() {
+    auto type = get_u8();
+    if (type > static_cast<uint8_t>(static_type::STRING)) {
+        throw Corrupted{};
+    }
+    return static_cast<static_type>(type);
+}
+
+uint8_t Deserializer::get_u8() {
+    if (position_ + 1 > end_) {
+        throw Corrupted{};
+    }
+    return static_cast<uint8_t>(data_[position_++]);
+}
+
+uint32_t Deserializer::get_u32() {
+    uint32_t value = 0;
+    for (auto shift = 0; shift < 35; shift += 7) {
+        auto byte = get_u8();
+        if (shift == 28 && byte > 0x0f) {
+            throw Corrupted{};
+        }
+        value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return value;
+        }
+    }
+    throw Corrupted{};
+}
+
+uint64_t Deserializer::get_u64() {
+    if (position_ + 8 > end_) {
+        throw Corrupted{};
+    }
+    auto value = read_u64(data_ + position_);
+    position_ += 8;
+    return value;
+}
+
+} // namespace zero::cache
@@ -0,0 +1,170 @@
+#pragma once
+
+#include "ast/expr.hpp"
+#include "ast/program.hpp"
+#include "ast/stmt.hpp"
+#include "token.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace zero::cache {
+
+// 预编译程序的二进制格式, 定长整数都是小端序, 节点流中的32位整数使用
+// LEB128变长编码, 不包含指针, 可以直接映射到内存中读取:
+//   文件头     magic, 版本, 构建标识, 源码的哈希和长度,
+//              字符串表和节点流的偏移和长度, 字符串表和节点流的校验和
+//   字符串表   所有词位和字符串常量, 节点中以(偏移, 长度)引用
+//   节点流     全局变量名, 然后按先序排列的语句和表达式
+// 保存的是静态解析和死代码消除之后的语法树, 纯函数分析和类型特化在加载后重新执行
+// AST节点改变时必须增加版本号, 旧的缓存文件不再使用
+// 优化过程的改变由构建标识区分, 重新构建之后旧的缓存文件不再使用
+constexpr uint32_t FORMAT_VERSION = 4;
+constexpr std::size_t HEADER_SIZE = 64;
+
+// 节点流中每个节点的类型标记, NONE表示空指针
+enum class node_tag : uint8_t {
+    NONE,
+    // 语句
+    BLOCK,
+    EXPRESSION,
+    VAR,
+    IF,
+    WHILE,
+    FUNCTION,
+    RETURN,
+    // 表达式
+    BINARY,
+    GROUPING,
+    LITERAL,
+    LOGICAL,
+    UNARY,
+    VARIABLE,
+    ASSIGN,
+    CALL,
+    INLINE_CALL,
+    INCREMENT,
+    COMPARE,
+    PROMOTE,
+};
+
+// 字面量的类型标记
+enum class literal_tag : uint8_t {
+    NIL,
+    BOOL,
+    INT,
+    DOUBLE,
+    STRING,
+};
+
+// 把Program写成二进制格式
+class Serializer : public ExprVisitor, public StmtVisitor {
+public:
+    // globals是全局变量名, 下标即槽位; 程序中有不能保存的值时返回false
+    bool serialize(const std::unique_ptr<Program> &program,
+                   const std::vector<std::string_view> &globals,
+                   std::string_view source,
+                   std::string &output);
+
+public:
+    // Expr抽象类方法, 节点写入nodes_
+    Value visit_binary_expr(Binary *expr) override;
+    Value visit_grouping_expr(Grouping *expr) override;
+    Value visit_literal_expr(Literal *expr) override;
+    Value visit_logical_expr(Logical *expr) override;
+    Value visit_unary_expr(Unary *expr) override;
+    Value visit_variable_expr(Variable *expr) override;
+    Value visit_assign_expr(Assign *expr) override;
+    Value visit_call_expr(Call *expr) override;
+    Value visit_inline_call_expr(InlineCall *expr) override;
+    Value visit_increment_expr(Increment *expr) override;
+    Value visit_compare_expr(Compare *expr) override;
+    Value visit_promote_expr(Promote *expr) override;
+
+    // Stmt抽象类方法
+    Completion visit_block_stmt(Block *stmt) override;
+    Completion visit_expression_stmt(Expression *stmt) override;
+    Completion visit_var_stmt(Var *stmt) override;
+    Completion visit_if_stmt(If *stmt) override;
+    Completion visit_while_stmt(While *stmt) override;
+    Completion visit_function_stmt(Function *stmt) override;
+    Completion visit_return_stmt(Return *stmt) override;
+
+private:
+    // 遇到不能保存的节点或值时抛出
+    struct Unsupported {};
+
+    void write(Expr *expr);
+    void write(Stmt *stmt);
+    void write(const std::vector<std::unique_ptr<Stmt>> &stmts);
+    void write(const Token &token);
+    void write(std::string_view str);
+    void write(const Value &value);
+    void write(node_tag tag) { put(static_cast<uint8_t>(tag)); }
+    void put(uint8_t value) { nodes_ += static_cast<char>(value); }
+    void put(uint32_t value);
+    void put(uint64_t value);
+    // 函数的编号, 内联调用按编号引用被内联的函数
+    uint32_t function_id(const Function *function);
+
+private:
+    std::string strings_;
+    std::unordered_map<std::string_view, uint32_t> string_offsets_;
+    std::string nodes_;
+    std::unordered_map<const Function *, uint32_t> function_ids_;
+    std::vector<bool> written_; // 按编号, 函数是否已经写入
+};
+
+// 从二进制格式重建Program, 节点分配在新程序的内存池中,
+// 字符串表整体复制到内存池中, 词位直接引用其中的字符串
+class Deserializer {
+public:
+    Deserializer(const char *data, std::size_t size)
+        : data_{data}, size_{size} {}
+
+public:
+    // 文件头与source不匹配或者格式错误时返回nullptr
+    // globals返回全局变量名, 引用程序内存池中的字符串
+    std::unique_ptr<Program> deserialize(std::string_view source,
+                                         std::vector<std::string_view>
+                                             &globals);
+
+private:
+    // 格式错误时抛出
+    struct Corrupted {};
+
+    std::unique_ptr<Expr> read_expr();
+    std::unique_ptr<Stmt> read_stmt();
+    std::vector<std::unique_ptr<Stmt>> read_stmts();
+    // 读取非空的表达式
+    std::unique_ptr<Expr> expect_expr();
+    Token read_token();
+    std::string_view read_string();
+    Value read_value();
+    static_type read_type();
+    uint8_t get_u8();
+    uint32_t get_u32();
+    uint64_t get_u64();
+
+private:
+    const char *data_;
+    std::size_t size_;
+    std::size_t position_{0}; // 节点流中的读取位置
+    std::size_t end_{0};      // 节点流的结尾
+    std::string_view strings_;
+    std::vector<Function *> functions_; // 按编号
+    // 需要在读完所有节点后填写的内联调用
+    std::vector<std::pair<InlineCall *, uint32_t>> fixups_;
+};
+
+// 源码内容的哈希, 作为缓存的键, 也用作文件内容的校验和
+uint64_t hash(std::string_view source);
+// 当前构建的标识: 版本, 编译器, 以及可执行文件的大小和修改时间
+uint64_t build_id();
+
+} // namespace zero::cache
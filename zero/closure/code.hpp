@@ -0,0 +1,22 @@
+#pragma once
+
+#include "ast/stmt.hpp"
+#include "value.hpp"
+
+#include <functional>
+
+namespace zero::closure {
+
+class Runtime;
+
+// 编译好的表达式和语句, 执行时只需要调用, 不再经过visitor分派
+using ExprCode = std::function<Value(Runtime &)>;
+using StmtCode = std::function<Completion(Runtime &)>;
+
+// 编译好的函数体, 由ZeroFunction引用
+struct FunctionCode {
+    Function *declaration;
+    StmtCode body;
+};
+
+} // namespace zero::closure
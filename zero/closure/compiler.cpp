@@ -0,0 +1,578 @@
+#include "compiler.hpp"
+
+#include "numeric.hpp"
+#include "runtime.hpp"
+
+#include <utility>
+
+namespace zero::closure {
+
+namespace {
+// 变量的访问方式, 编译时按Resolver计算的位置选择
+struct LocalVariable {
+    Value &operator()(Runtime &runtime) const { return runtime.local(slot); }
+    uint32_t slot;
+};
+
+struct UpvalueVariable {
+    Value &operator()(Runtime &runtime) const {
+        return runtime.upvalue(slot);
+    }
+    uint32_t slot;
+};
+
+struct GlobalVariable {
+    Value &operator()(Runtime &runtime) const { return runtime.global(slot); }
+    uint32_t slot;
+};
+
+// make对三种访问方式生成各自的闭包
+template <typename Make>
+auto by_depth(int depth, unsigned int slot, Make make) {
+    switch (depth) {
+        case GLOBAL_DEPTH:
+            return make(GlobalVariable{slot});
+        case UPVALUE_DEPTH:
+            return make(UpvalueVariable{slot});
+        default:
+            return make(LocalVariable{slot});
+    }
+}
+
+// 二元运算操作数的读取方式
+// 局部变量和常量直接读取引用, 其他表达式求值到临时变量中
+struct LocalOperand {
+    const Value &operator()(Runtime &runtime, Value &) const {
+        return runtime.local(slot);
+    }
+    uint32_t slot;
+};
+
+struct ConstantOperand {
+    const Value &operator()(Runtime &, Value &) const { return value; }
+    Value value;
+};
+
+struct CodeOperand {
+    const Value &operator()(Runtime &runtime, Value &temporary) const {
+        temporary = code(runtime);
+        return temporary;
+    }
+    ExprCode code;
+};
+
+enum class operand_kind { LOCAL, CONSTANT, CODE };
+
+struct Operand {
+    operand_kind kind;
+    uint32_t slot;  // LOCAL
+    Value value;    // CONSTANT
+    ExprCode code;  // 所有操作数都编译一份, 不能直接读取时使用
+};
+
+// 二元运算, 出错时报告运算符所在的行
+struct Equal {
+    static Value
+    apply(const Value &left, const Value &right, Runtime &, unsigned int) {
+        return is_equal(left, right);
+    }
+};
+
+struct NotEqual {
+    static Value
+    apply(const Value &left, const Value &right, Runtime &, unsigned int) {
+        return !is_equal(left, right);
+    }
+};
+
+struct Add {
+    static Value apply(const Value &left,
+                       const Value &right,
+                       Runtime &runtime,
+                       unsigned int line) {
+        if (is_number(left) && is_number(right)) {
+            return add_numbers(left, right);
+        }
+        if (left.is_string() && right.is_string()) {
+            return concat(left, right);
+        }
+        runtime.runtime_error(line,
+                              "Operands must be two numbers or two strings.");
+    }
+};
+
+template <auto operation>
+struct Numeric {
+    static Value apply(const Value &left,
+                       const Value &right,
+                       Runtime &runtime,
+                       unsigned int line) {
+        if (!is_number(left) || !is_number(right)) {
+            runtime.runtime_error(line, "Operands must be numbers.");
+        }
+        return operation(left, right);
+    }
+};
+
+struct Divide {
+    static Value apply(const Value &left,
+                       const Value &right,
+                       Runtime &runtime,
+                       unsigned int line) {
+        if (!is_number(left) || !is_number(right)) {
+            runtime.runtime_error(line, "Operands must be numbers.");
+        }
+        if (is_integer_division_by_zero(left, right)) {
+            runtime.runtime_error(line, "Division by zero.");
+        }
+        return divide_numbers(left, right);
+    }
+};
+
+template <typename Operation, typename Left, typename Right>
+ExprCode binary_code(Left left, Right right, unsigned int line) {
+    return [left = std::move(left), right = std::move(right), line](
+               Runtime &runtime) {
+        Value left_value;
+        Value right_value;
+        const Value &a = left(runtime, left_value);
+        const Value &b = right(runtime, right_value);
+        return Operation::apply(a, b, runtime, line);
+    };
+}
+
+template <typename Operation, typename Left>
+ExprCode binary_code(Left left, const Operand &right, unsigned int line) {
+    switch (right.kind) {
+        case operand_kind::LOCAL:
+            return binary_code<Operation>(
+                std::move(left), LocalOperand{right.slot}, line);
+        case operand_kind::CONSTANT:
+            return binary_code<Operation>(
+                std::move(left), ConstantOperand{right.value}, line);
+        default:
+            return binary_code<Operation>(
+                std::move(left), CodeOperand{right.code}, line);
+    }
+}
+
+template <typename Operation>
+ExprCode binary_code(const Operand &left,
+                     const Operand &right,
+                     unsigned int line) {
+    // 右操作数有副作用时可能修改左操作数的变量, 这时左操作数需要先复制
+    if (left.kind == operand_kind::LOCAL && right.kind != operand_kind::CODE) {
+        return binary_code<Operation>(LocalOperand{left.slot}, right, line);
+    }
+    if (left.kind == operand_kind::CONSTANT) {
+        return binary_code<Operation>(ConstantOperand{left.value}, right, line);
+    }
+    return binary_code<Operation>(CodeOperand{left.code}, right, line);
+}
+
+// 括号只影响解析
+Expr &unwrap(Expr &expr) {
+    Expr *inner = &expr;
+    while (auto *grouping = dynamic_cast<Grouping *>(inner)) {
+        inner = grouping->expr.get();
+    }
+    return *inner;
+}
+} // namespace
+
+StmtCode Compiler::compile(const std::unique_ptr<Program> &program) {
+    return compile(program->get_statements());
+}
+
+ExprCode Compiler::compile(Expr &expr) {
+    expr.accept(*this);
+    return std::move(expr_code_);
+}
+
+StmtCode Compiler::compile(Stmt &stmt) {
+    stmt.accept(*this);
+    return std::move(stmt_code_);
+}
+
+StmtCode Compiler::compile(const std::vector<std::unique_ptr<Stmt>> &stmts) {
+    if (stmts.size() == 1) {
+        return compile(*stmts.front());
+    }
+
+    std::vector<StmtCode> codes;
+    codes.reserve(stmts.size());
+    for (const auto &stmt : stmts) {
+        codes.push_back(compile(*stmt));
+    }
+    return [codes = std::move(codes)](Runtime &runtime) {
+        for (const auto &code : codes) {
+            auto completion = code(runtime);
+            if (completion != Completion::NORMAL) {
+                return completion;
+            }
+        }
+        return Completion::NORMAL;
+    };
+}
+
+std::vector<ExprCode> Compiler::compile_arguments(Call &call) {
+    std::vector<ExprCode> arguments;
+    arguments.reserve(call.arguments.size());
+    for (const auto &argument : call.arguments) {
+        arguments.push_back(compile(*argument));
+    }
+
+    return arguments;
+}
+
+ExprCode Compiler::compile_call(Call &call) {
+    auto arguments = compile_arguments(call);
+    auto line = call.paren.line;
+
+    // 被调用者是变量时直接从槽位读取
+    auto *callee = dynamic_cast<Variable *>(call.callee.get());
+    if (callee != nullptr && callee->depth == SELF_DEPTH) {
+        return [arguments = std::move(arguments), line](Runtime &runtime) {
+            return runtime.call(runtime.self(), arguments, line);
+        };
+    }
+    if (callee != nullptr) {
+        return by_depth(
+            callee->depth, callee->slot, [&](auto variable) -> ExprCode {
+                return [variable, arguments = std::move(arguments), line](
+                           Runtime &runtime) {
+                    return runtime.call(variable(runtime), arguments, line);
+                };
+            });
+    }
+
+    return [callee = compile(*call.callee),
+            arguments = std::move(arguments),
+            line](Runtime &runtime) {
+        return runtime.call(callee(runtime), arguments, line);
+    };
+}
+
+ExprCode Compiler::compile_binary(token_type op,
+                                  Expr &left,
+                                  Expr &right,
+                                  unsigned int line) {
+    Operand operands[2];
+    Expr *exprs[2] = {&left, &right};
+    for (auto i = 0; i < 2; i++) {
+        auto &expr = unwrap(*exprs[i]);
+        auto &operand = operands[i];
+        operand.kind = operand_kind::CODE;
+        operand.code = compile(expr);
+        if (auto *variable = dynamic_cast<Variable *>(&expr);
+            variable != nullptr && variable->depth == LOCAL_DEPTH) {
+            operand.kind = operand_kind::LOCAL;
+            operand.slot = variable->slot;
+        } else if (auto *literal = dynamic_cast<Literal *>(&expr)) {
+            operand.kind = operand_kind::CONSTANT;
+            operand.value = literal->value;
+        }
+    }
+
+    const auto &l = operands[0];
+    const auto &r = operands[1];
+    switch (op) {
+        case token_type::EQUAL_EQUAL:
+            return binary_code<Equal>(l, r, line);
+        case token_type::NOT_EQUAL:
+            return binary_code<NotEqual>(l, r, line);
+        case token_type::GREATER:
+            return binary_code<Numeric<greater_numbers>>(l, r, line);
+        case token_type::GREATER_EQUAL:
+            return binary_code<Numeric<greater_equal_numbers>>(l, r, line);
+        case token_type::LESS:
+            return binary_code<Numeric<less_numbers>>(l, r, line);
+        case token_type::LESS_EQUAL:
+            return binary_code<Numeric<less_equal_numbers>>(l, r, line);
+        case token_type::PLUS:
+            return binary_code<Add>(l, r, line);
+        case token_type::MINUS:
+            return binary_code<Numeric<subtract_numbers>>(l, r, line);
+        case token_type::STAR:
+            return binary_code<Numeric<multiply_numbers>>(l, r, line);
+        default:
+            return binary_code<Divide>(l, r, line);
+    }
+}
+
+Value Compiler::visit_binary_expr(Binary *expr) {
+    expr_code_ = compile_binary(
+        expr->op.type, *expr->left, *expr->right, expr->op.line);
+
+    return {};
+}
+
+Value Compiler::visit_grouping_expr(Grouping *expr) {
+    expr_code_ = compile(*expr->expr);
+
+    return {};
+}
+
+Value Compiler::visit_literal_expr(Literal *expr) {
+    expr_code_ = [value = expr->value](Runtime &) { return value; };
+
+    return {};
+}
+
+Value Compiler::visit_logical_expr(Logical *expr) {
+    auto left = compile(*expr->left);
+    auto right = compile(*expr->right);
+    if (expr->op.type == token_type::OR) {
+        expr_code_ = [left = std::move(left),
+                      right = std::move(right)](Runtime &runtime) {
+            Value value = left(runtime);
+            return is_truthy(value) ? value : right(runtime);
+        };
+    } else {
+        expr_code_ = [left = std::move(left),
+                      right = std::move(right)](Runtime &runtime) {
+            Value value = left(runtime);
+            return is_truthy(value) ? right(runtime) : value;
+        };
+    }
+
+    return {};
+}
+
+Value Compiler::visit_unary_expr(Unary *expr) {
+    auto right = compile(*expr->right);
+    if (expr->op.type == token_type::NOT) {
+        expr_code_ = [right = std::move(right)](Runtime &runtime) {
+            return Value{!is_truthy(right(runtime))};
+        };
+        return {};
+    }
+
+    expr_code_ = [right = std::move(right),
+                  line = expr->op.line](Runtime &runtime) {
+        Value value = right(runtime);
+        if (!is_number(value)) {
+            runtime.runtime_error(line, "Operand must be a number.");
+        }
+        return negate_number(value);
+    };
+
+    return {};
+}
+
+Value Compiler::visit_variable_expr(Variable *expr) {
+    if (expr->depth == SELF_DEPTH) {
+        expr_code_ = [](Runtime &runtime) { return runtime.self(); };
+        return {};
+    }
+    expr_code_ = by_depth(expr->depth, expr->slot, [](auto variable) {
+        return ExprCode{
+            [variable](Runtime &runtime) -> Value { return variable(runtime); }};
+    });
+
+    return {};
+}
+
+Value Compiler::visit_assign_expr(Assign *expr) {
+    auto value = compile(*expr->value);
+    expr_code_ = by_depth(expr->depth, expr->slot, [&](auto variable) {
+        return ExprCode{
+            [variable, value = std::move(value)](Runtime &runtime) {
+                Value result = value(runtime);
+                variable(runtime) = result;
+                return result;
+            }};
+    });
+
+    return {};
+}
+
+Value Compiler::visit_call_expr(Call *expr) {
+    expr_code_ = compile_call(*expr);
+
+    return {};
+}
+
+Value Compiler::visit_inline_call_expr(InlineCall *expr) {
+    // 全局变量仍然是被内联的函数时对返回表达式求值, 否则按原来的调用执行
+    expr_code_ = [call = compile_call(*expr->call),
+                  arguments = compile_arguments(*expr->call),
+                  body = compile(*expr->body),
+                  function = expr->function,
+                  slot = static_cast<const Variable &>(*expr->call->callee).slot,
+                  num_slots = expr->num_slots,
+                  line = expr->call->paren.line](Runtime &runtime) {
+        const auto &callee = runtime.global(slot);
+        if (!callee.is_function()
+            || callee.as_function().get_declaration() != function) {
+            return call(runtime);
+        }
+        return runtime.inline_call(num_slots, arguments, body, line);
+    };
+
+    return {};
+}
+
+Value Compiler::visit_increment_expr(Increment *expr) {
+    // 直接在变量的槽位上计算
+    expr_code_ = by_depth(expr->depth, expr->slot, [&](auto variable) {
+        return ExprCode{[variable,
+                         delta = Value{expr->delta},
+                         line = expr->op.line](Runtime &runtime) {
+            Value &value = variable(runtime);
+            if (!is_number(value)) {
+                runtime.runtime_error(line, "Operand must be a number.");
+            }
+            value = add_numbers(value, delta);
+            return value;
+        }};
+    });
+
+    return {};
+}
+
+Value Compiler::visit_compare_expr(Compare *expr) {
+    expr_code_ = compile_binary(
+        expr->op.type, *expr->variable, *expr->bound, expr->op.line);
+
+    return {};
+}
+
+Value Compiler::visit_promote_expr(Promote *expr) {
+    expr_code_ = [value = compile(*expr->expr)](Runtime &runtime) {
+        return promote_number(value(runtime));
+    };
+
+    return {};
+}
+
+Completion Compiler::visit_block_stmt(Block *stmt) {
+    auto body = compile(stmt->statements);
+    if (stmt->num_slots != 0) {
+        stmt_code_ = [body = std::move(body),
+                      num_slots = stmt->num_slots](Runtime &runtime) {
+            return runtime.execute_frame(body, num_slots);
+        };
+    } else if (stmt->has_captured) {
+        // 抛出异常时由函数栈帧统一关闭
+        stmt_code_ = [body = std::move(body),
+                      first_slot = stmt->first_slot](Runtime &runtime) {
+            auto completion = body(runtime);
+            runtime.close_upvalues(first_slot);
+            return completion;
+        };
+    } else {
+        stmt_code_ = std::move(body);
+    }
+
+    return Completion::NORMAL;
+}
+
+Completion Compiler::visit_expression_stmt(Expression *stmt) {
+    stmt_code_
+        = [expression = compile(*stmt->expression)](Runtime &runtime) {
+              expression(runtime);
+              return Completion::NORMAL;
+          };
+
+    return Completion::NORMAL;
+}
+
+Completion Compiler::visit_var_stmt(Var *stmt) {
+    ExprCode initializer = [](Runtime &) { return Value{}; };
+    if (stmt->initializer != nullptr) {
+        initializer = compile(*stmt->initializer);
+    }
+    stmt_code_ = by_depth(stmt->depth, stmt->slot, [&](auto variable) {
+        return StmtCode{[variable, initializer = std::move(initializer)](
+                            Runtime &runtime) {
+            variable(runtime) = initializer(runtime);
+            return Completion::NORMAL;
+        }};
+    });
+
+    return Completion::NORMAL;
+}
+
+Completion Compiler::visit_if_stmt(If *stmt) {
+    auto condition = compile(*stmt->condition);
+    auto then_branch = compile(*stmt->then_branch);
+    if (stmt->else_branch == nullptr) {
+        stmt_code_ = [condition = std::move(condition),
+                      then_branch = std::move(then_branch)](Runtime &runtime) {
+            if (is_truthy(condition(runtime))) {
+                return then_branch(runtime);
+            }
+            return Completion::NORMAL;
+        };
+        return Completion::NORMAL;
+    }
+
+    stmt_code_ = [condition = std::move(condition),
+                  then_branch = std::move(then_branch),
+                  else_branch = compile(*stmt->else_branch)](Runtime &runtime) {
+        if (is_truthy(condition(runtime))) {
+            return then_branch(runtime);
+        }
+        return else_branch(runtime);
+    };
+
+    return Completion::NORMAL;
+}
+
+Completion Compiler::visit_while_stmt(While *stmt) {
+    stmt_code_ = [condition = compile(*stmt->condition),
+                  body = compile(*stmt->body)](Runtime &runtime) {
+        while (is_truthy(condition(runtime))) {
+            auto completion = body(runtime);
+            if (completion != Completion::NORMAL) {
+                return completion;
+            }
+        }
+        return Completion::NORMAL;
+    };
+
+    return Completion::NORMAL;
+}
+
+Completion Compiler::visit_function_stmt(Function *stmt) {
+    functions_.push_back(FunctionCode{stmt, compile(stmt->body)});
+    stmt_code_ = [code = &functions_.back()](Runtime &runtime) {
+        runtime.define_function(*code);
+        return Completion::NORMAL;
+    };
+
+    return Completion::NORMAL;
+}
+
+Completion Compiler::visit_return_stmt(Return *stmt) {
+    if (stmt->tail_call) {
+        // 原生函数或者出错时按普通调用处理, 被调用者会再求值一次,
+        // 与树遍历解释器的行为一致
+        auto &call = static_cast<Call &>(*stmt->value);
+        stmt_code_ = [callee = compile(*call.callee),
+                      arguments = compile_arguments(call),
+                      code = compile(call),
+                      line = call.paren.line](Runtime &runtime) {
+            Value function = callee(runtime);
+            if (function.is_function()
+                && function.as_function().get_compiled() != nullptr) {
+                return runtime.tail_call(std::move(function), arguments, line);
+            }
+            return runtime.return_with(code(runtime));
+        };
+        return Completion::NORMAL;
+    }
+
+    if (stmt->value == nullptr) {
+        stmt_code_ = [](Runtime &runtime) { return runtime.return_with({}); };
+        return Completion::NORMAL;
+    }
+    stmt_code_ = [value = compile(*stmt->value)](Runtime &runtime) {
+        return runtime.return_with(value(runtime));
+    };
+
+    return Completion::NORMAL;
+}
+
+} // namespace zero::closure
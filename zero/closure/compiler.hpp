@@ -0,0 +1,68 @@
+#pragma once
+
+#include "ast/expr.hpp"
+#include "ast/program.hpp"
+#include "ast/stmt.hpp"
+#include "code.hpp"
+
+#include <deque>
+#include <memory>
+#include <vector>
+
+namespace zero::closure {
+
+// 把经过Resolver解析的AST编译成嵌套的闭包
+// 每个闭包在编译时就确定了变量的位置, 运算符和操作数的读取方式,
+// 执行时直接调用, 不再经过accept和visitor分派
+class Compiler : public ExprVisitor, public StmtVisitor {
+public:
+    // 函数体编译后添加到functions中, 函数对象引用其中的元素
+    explicit Compiler(std::deque<FunctionCode> &functions)
+        : functions_{functions} {}
+
+public:
+    StmtCode compile(const std::unique_ptr<Program> &program);
+
+public:
+    // Expr抽象类方法, 编译结果保存在expr_code_中
+    Value visit_binary_expr(Binary *expr) override;
+    Value visit_grouping_expr(Grouping *expr) override;
+    Value visit_literal_expr(Literal *expr) override;
+    Value visit_logical_expr(Logical *expr) override;
+    Value visit_unary_expr(Unary *expr) override;
+    Value visit_variable_expr(Variable *expr) override;
+    Value visit_assign_expr(Assign *expr) override;
+    Value visit_call_expr(Call *expr) override;
+    Value visit_inline_call_expr(InlineCall *expr) override;
+    Value visit_increment_expr(Increment *expr) override;
+    Value visit_compare_expr(Compare *expr) override;
+    Value visit_promote_expr(Promote *expr) override;
+
+    // Stmt抽象类方法, 编译结果保存在stmt_code_中
+    Completion visit_block_stmt(Block *stmt) override;
+    Completion visit_expression_stmt(Expression *stmt) override;
+    Completion visit_var_stmt(Var *stmt) override;
+    Completion visit_if_stmt(If *stmt) override;
+    Completion visit_while_stmt(While *stmt) override;
+    Completion visit_function_stmt(Function *stmt) override;
+    Completion visit_return_stmt(Return *stmt) override;
+
+private:
+    ExprCode compile(Expr &expr);
+    StmtCode compile(Stmt &stmt);
+    StmtCode compile(const std::vector<std::unique_ptr<Stmt>> &stmts);
+    std::vector<ExprCode> compile_arguments(Call &call);
+    ExprCode compile_call(Call &call);
+    // 比较和算术运算, 按操作数是否是局部变量或常量选择不同的闭包
+    ExprCode compile_binary(token_type op,
+                            Expr &left,
+                            Expr &right,
+                            unsigned int line);
+
+private:
+    std::deque<FunctionCode> &functions_;
+    ExprCode expr_code_;
+    StmtCode stmt_code_;
+};
+
+} // namespace zero::closure
@@ -0,0 +1,232 @@
+#include "runtime.hpp"
+
+#include "interpreter.hpp"
+#include "limits.hpp"
+#include "memo.hpp"
+#include "typed/code.hpp"
+#include "utils/native_stack.hpp"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+
+namespace zero::closure {
+
+Runtime::Runtime(Interpreter &interpreter)
+    : interpreter_{interpreter}, stack_(STACK_MAX) {
+    stack_top_ = stack_.data();
+}
+
+void Runtime::run(const StmtCode &script) {
+    // 全局变量只在解析时增加, 执行期间地址不变
+    globals_ = &interpreter_.get_globals()->get(0);
+    slots_ = nullptr;
+    upvalues_ = nullptr;
+    function_ = nullptr;
+    script(*this);
+}
+
+Runtime::FrameGuard::FrameGuard(Runtime *runtime,
+                                std::size_t num_slots,
+                                unsigned line)
+    : runtime{runtime}, frame{runtime->stack_top_} {
+    auto available = static_cast<std::size_t>(
+        runtime->stack_.data() + STACK_MAX - frame);
+    if (num_slots > available || runtime->call_depth_ == MAX_CALL_DEPTH
+        || utils::native_stack_exhausted()) {
+        throw RuntimeError(Token{token_type::END, "", line}, "Stack overflow.");
+    }
+    runtime->stack_top_ = frame + num_slots;
+    runtime->call_depth_++;
+}
+
+Runtime::FrameGuard::~FrameGuard() {
+    // 栈帧中被闭包捕获的变量搬到堆上
+    runtime->open_upvalues_.close(frame);
+    for (Value *slot = frame; slot < runtime->stack_top_; slot++) {
+        *slot = nullptr;
+    }
+    runtime->stack_top_ = frame;
+    runtime->call_depth_--;
+}
+
+void Runtime::runtime_error(unsigned int line, const std::string &msg) {
+    throw RuntimeError(Token{token_type::END, "", line}, msg);
+}
+
+Value Runtime::call(Value callee,
+                    const std::vector<ExprCode> &arguments,
+                    unsigned int line) {
+    auto num_arguments = arguments.size();
+
+    if (callee.is_function()) {
+        auto &function = callee.as_function();
+        if (function.get_compiled() == nullptr) {
+            runtime_error(line, "Can only call functions and classes.");
+        }
+        // 参数直接求值到新栈帧对应的槽位中
+        auto size = std::max<std::size_t>(function.frame_size(), num_arguments);
+        FrameGuard frame{this, size, line};
+        for (std::size_t i = 0; i < num_arguments; i++) {
+            frame.slots()[i] = arguments[i](*this);
+        }
+        if (num_arguments != function.arity()) {
+            runtime_error(line,
+                          fmt::format("Expected {} arguments but got {}.",
+                                      function.arity(),
+                                      num_arguments));
+        }
+        return call(function, frame.slots());
+    }
+
+    std::vector<Value> values(num_arguments);
+    for (std::size_t i = 0; i < num_arguments; i++) {
+        values[i] = arguments[i](*this);
+    }
+
+    if (callee.is_native_function()) {
+        return callee.as_native_function().call(interpreter_,
+                                                std::move(values));
+    }
+    runtime_error(line, "Can only call functions and classes.");
+}
+
+Value Runtime::call(const ZeroFunction &function, Value *frame) {
+    // 参数类型与注解一致时执行特化的版本
+    if (const auto *typed = function.get_declaration()->typed.get()) {
+        Value result;
+        if (typed->call(frame, globals_, result)) {
+            return result;
+        }
+    }
+
+    auto *memo = function.get_declaration()->memo.get();
+    if (memo == nullptr) {
+        return execute_function(function, frame);
+    }
+    if (const Value *result = memo->find(frame)) {
+        return *result;
+    }
+
+    // 函数体可能修改参数, 先复制一份作为记忆表的键
+    std::vector<Value> arguments(frame, frame + function.arity());
+    Value result = execute_function(function, frame);
+    memo->insert(arguments.data(), result);
+
+    return result;
+}
+
+Value Runtime::execute_function(const ZeroFunction &function, Value *frame) {
+    RegisterGuard guard{this};
+    Value callee; // 保持正在执行的尾调用函数存活
+    const ZeroFunction *current = &function;
+    while (true) {
+        slots_ = frame;
+        upvalues_ = current->get_upvalues();
+        function_ = current;
+
+        auto completion = current->get_compiled()->body(*this);
+        if (completion == Completion::RETURN) {
+            return std::move(return_value_);
+        }
+        if (completion != Completion::TAIL_CALL) {
+            return {};
+        }
+
+        const auto &next = tail_callee_.as_function();
+        reuse_frame(frame,
+                    std::max<std::size_t>(next.frame_size(), next.arity()));
+        callee = std::move(tail_callee_);
+        current = &callee.as_function();
+    }
+}
+
+Completion Runtime::tail_call(Value callee,
+                              const std::vector<ExprCode> &arguments,
+                              unsigned int line) {
+    // 参数依次求值到栈顶之上, 由execute_function搬到当前栈帧的开头
+    // 求值出错时由外层函数的FrameGuard清理这些槽位
+    auto num_arguments = arguments.size();
+    if (num_arguments > static_cast<std::size_t>(
+            stack_.data() + STACK_MAX - stack_top_)) {
+        runtime_error(line, "Stack overflow.");
+    }
+    for (const auto &argument : arguments) {
+        Value value = argument(*this);
+        *stack_top_++ = std::move(value);
+    }
+    auto &function = callee.as_function();
+    if (num_arguments != function.arity()) {
+        runtime_error(line,
+                      fmt::format("Expected {} arguments but got {}.",
+                                  function.arity(),
+                                  num_arguments));
+    }
+
+    tail_callee_ = std::move(callee);
+    return Completion::TAIL_CALL;
+}
+
+void Runtime::reuse_frame(Value *frame, std::size_t frame_size) {
+    // 当前函数已经执行完, 栈帧中被捕获的变量先搬到堆上
+    open_upvalues_.close(frame);
+
+    const auto &function = tail_callee_.as_function();
+    auto num_arguments = function.arity();
+    Value *arguments = stack_top_ - num_arguments;
+    std::move(arguments, stack_top_, frame);
+    for (Value *slot = frame + num_arguments; slot < stack_top_; slot++) {
+        *slot = nullptr;
+    }
+
+    auto available = static_cast<std::size_t>(
+        stack_.data() + STACK_MAX - frame);
+    if (frame_size > available) {
+        throw RuntimeError(function.get_declaration()->name,
+                           "Stack overflow.");
+    }
+    stack_top_ = frame + frame_size;
+}
+
+Value Runtime::inline_call(unsigned int num_slots,
+                           const std::vector<ExprCode> &arguments,
+                           const ExprCode &body,
+                           unsigned int line) {
+    FrameGuard frame{this, num_slots, line};
+    for (std::size_t i = 0; i < arguments.size(); i++) {
+        frame.slots()[i] = arguments[i](*this);
+    }
+    RegisterGuard guard{this};
+    slots_ = frame.slots();
+    upvalues_ = nullptr;
+
+    return body(*this);
+}
+
+Completion Runtime::execute_frame(const StmtCode &body,
+                                  unsigned int num_slots) {
+    FrameGuard frame{this, num_slots, 0};
+    RegisterGuard guard{this};
+    slots_ = frame.slots();
+    upvalues_ = nullptr;
+
+    return body(*this);
+}
+
+void Runtime::define_function(const FunctionCode &code) {
+    const auto *declaration = code.declaration;
+    auto function = ZeroFunction(code.declaration, &code);
+    for (const auto &capture : declaration->captures) {
+        function.add_upvalue(capture.is_local
+                                 ? open_upvalues_.capture(
+                                     slots_ + capture.index)
+                                 : upvalues_[capture.index]);
+    }
+    if (declaration->depth == GLOBAL_DEPTH) {
+        globals_[declaration->slot] = std::move(function);
+    } else {
+        slots_[declaration->slot] = std::move(function);
+    }
+}
+
+} // namespace zero::closure
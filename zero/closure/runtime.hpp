@@ -0,0 +1,131 @@
+#pragma once
+
+#include "code.hpp"
+#include "function.hpp"
+#include "value.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace zero {
+class Interpreter;
+} // namespace zero
+
+namespace zero::closure {
+
+// 编译好的闭包执行时的状态, 闭包通过这里访问变量, 调用函数和报告错误
+// 全局变量和原生函数与树遍历解释器共用, 由Interpreter持有
+class Runtime {
+public:
+    explicit Runtime(Interpreter &interpreter);
+
+public:
+    // 函数对象引用其中的元素, 使用deque保证添加元素时地址不变
+    std::deque<FunctionCode> &functions() { return functions_; }
+    // 执行顶层语句, 运行时错误以RuntimeError抛出
+    void run(const StmtCode &script);
+
+    // 变量访问, slot由Resolver计算
+    Value &local(uint32_t slot) { return slots_[slot]; }
+    Value &upvalue(uint32_t index) {
+        return upvalues_[index].as_upvalue().get();
+    }
+    Value &global(uint32_t slot) { return globals_[slot]; }
+    // 正在执行的函数
+    Value self() const { return Value{function_}; }
+
+    Value call(Value callee,
+               const std::vector<ExprCode> &arguments,
+               unsigned int line);
+    // 尾调用: 参数求值到栈顶之上, 函数保存在tail_callee_中
+    Completion tail_call(Value callee,
+                         const std::vector<ExprCode> &arguments,
+                         unsigned int line);
+    // 在新栈帧中对被内联函数的返回表达式求值
+    Value inline_call(unsigned int num_slots,
+                      const std::vector<ExprCode> &arguments,
+                      const ExprCode &body,
+                      unsigned int line);
+    // 返回值暂存在这里, 通过Completion::RETURN逐层通知到函数调用处
+    Completion return_with(Value value) {
+        return_value_ = std::move(value);
+        return Completion::RETURN;
+    }
+
+    // 不在函数中的块使用自己的栈帧
+    Completion execute_frame(const StmtCode &body, unsigned int num_slots);
+    // 槽位会被后面的块复用, 被捕获的变量需要搬到堆上
+    void close_upvalues(unsigned int first_slot) {
+        open_upvalues_.close(slots_ + first_slot);
+    }
+    void define_function(const FunctionCode &code);
+
+    [[noreturn]] void runtime_error(unsigned int line, const std::string &msg);
+
+private:
+    // 参数已经按槽位存放在frame中, 有记忆表时先查表
+    Value call(const ZeroFunction &function, Value *frame);
+    // 执行函数体, 尾调用在这里循环执行
+    Value execute_function(const ZeroFunction &function, Value *frame);
+    void reuse_frame(Value *frame, std::size_t frame_size);
+
+private:
+    // 在栈上分配一个栈帧, 离开作用域时清空并释放其中的槽位
+    class FrameGuard {
+    public:
+        FrameGuard(Runtime *runtime, std::size_t num_slots, unsigned line);
+        ~FrameGuard();
+
+        FrameGuard(const FrameGuard &) = delete;
+        FrameGuard &operator=(const FrameGuard &) = delete;
+
+        Value *slots() const { return frame; }
+
+    private:
+        Runtime *runtime;
+        Value *frame;
+    };
+
+    // 保存当前栈帧, 捕获列表和函数, 离开作用域时恢复
+    class RegisterGuard {
+    public:
+        explicit RegisterGuard(Runtime *runtime)
+            : runtime{runtime}, slots{runtime->slots_},
+              upvalues{runtime->upvalues_}, function{runtime->function_} {}
+        ~RegisterGuard() {
+            runtime->slots_ = slots;
+            runtime->upvalues_ = upvalues;
+            runtime->function_ = function;
+        }
+
+        RegisterGuard(const RegisterGuard &) = delete;
+        RegisterGuard &operator=(const RegisterGuard &) = delete;
+
+    private:
+        Runtime *runtime;
+        Value *slots;
+        const Value *upvalues;
+        const ZeroFunction *function;
+    };
+
+private:
+    static constexpr std::size_t STACK_MAX = 1 << 16;
+
+    Interpreter &interpreter_;
+    std::deque<FunctionCode> functions_;
+    std::vector<Value> stack_;
+    Value *stack_top_;
+    unsigned int call_depth_{0};
+    OpenUpvalues open_upvalues_;
+    Value *globals_{nullptr};
+    Value *slots_{nullptr};              // 当前栈帧
+    const Value *upvalues_{nullptr};     // 当前函数捕获的变量
+    const ZeroFunction *function_{nullptr}; // 当前执行的函数
+    Value return_value_; // return语句的返回值, 由函数调用取走
+    Value tail_callee_;  // 尾调用的函数, 由函数调用取走
+};
+
+} // namespace zero::closure
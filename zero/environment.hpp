@@ -1,31 +1,58 @@
 #pragma once
 
-#include "token.hpp"
+#include "function.hpp"
+#include "value.hpp"
 
-#include <any>
-#include <map>
-#include <memory>
+#include <vector>
 
 namespace zero {
+// 变量环境, 槽位由Resolver分配
+// 全局环境自己持有槽位; 函数调用的槽位位于解释器的栈上, 环境只引用它们
 class Environment {
 
 public:
     Environment() = default;
-    explicit Environment(Environment *enclosing) : enclosing{enclosing} {};
+    // 不在函数中的栈帧function为nullptr
+    Environment(Value *slots, const ZeroFunction *function)
+        : values{slots},
+          upvalues{function != nullptr ? function->get_upvalues() : nullptr},
+          function{function} {};
 
 public:
-    // 获取一个环境变量
-    std::any get(const Token &name);
-    // 给环境变量赋值
-    void assign(const Token &name, std::any value);
-    // 在当前环境定义一个变量/函数
-    void define(const std::string &name, std::any value);
+    // 获取当前环境中的变量
+    Value &get(unsigned int slot) { return values[slot]; }
+    // 获取当前函数捕获的变量
+    Value &get_upvalue(unsigned int slot) {
+        return upvalues[slot].as_upvalue().get();
+    }
+    const Value &upvalue(unsigned int slot) const { return upvalues[slot]; }
+    // 正在执行的函数自身, 第一次引用时才增加引用计数
+    Value &self() {
+        if (self_value.is_nil()) {
+            self_value = Value{function};
+        }
+        return self_value;
+    }
+    // 在当前环境的槽位中定义一个变量/函数
+    void define(unsigned int slot, Value value) {
+        values[slot] = std::move(value);
+    }
+    // 扩充槽位数量, 用于全局环境
+    void resize(unsigned int num_slots) {
+        if (num_slots > storage.size()) {
+            storage.resize(num_slots);
+            values = storage.data();
+        }
+    }
 
 private:
-    Environment *enclosing{};               // 外层的封闭环境
-    std::map<std::string, std::any> values; // 根据token的词位信息存储变量值
+    Value *values{};          // 按Resolver分配的槽位存储变量值
     // 例如, fn add(a, b) {...}; add(1, 2);
-    // values中会存放键值对 "a": 1, "b": 2
+    // values中依次存放 a: 1, b: 2
+    const Value *upvalues{};  // 闭包捕获的变量, 按Function::captures排列
+    const ZeroFunction *function{}; // 正在执行的函数, 不在函数中时为nullptr
+    Value self_value;               // 引用function的值
+    std::vector<Value> storage; // 全局环境的槽位
 };
 
 } // namespace zero
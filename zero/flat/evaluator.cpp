@@ -0,0 +1,581 @@
+#include "evaluator.hpp"
+
+#include "interpreter.hpp"
+#include "limits.hpp"
+#include "memo.hpp"
+#include "typed/code.hpp"
+#include "numeric.hpp"
+#include "utils/native_stack.hpp"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+
+namespace zero::flat {
+
+Evaluator::Evaluator(Interpreter &interpreter)
+    : interpreter_{interpreter}, stack_(STACK_MAX) {
+    stack_top_ = stack_.data();
+}
+
+void Evaluator::run(uint32_t statements, uint32_t size) {
+    // 全局变量只在解析时增加, 执行期间地址不变
+    globals_ = &interpreter_.get_globals()->get(0);
+    slots_ = nullptr;
+    upvalues_ = nullptr;
+    function_ = nullptr;
+    execute(statements, size);
+}
+
+Evaluator::FrameGuard::FrameGuard(Evaluator *evaluator,
+                                  std::size_t num_slots,
+                                  unsigned line)
+    : evaluator{evaluator}, frame{evaluator->stack_top_} {
+    auto available = static_cast<std::size_t>(
+        evaluator->stack_.data() + STACK_MAX - frame);
+    if (num_slots > available || evaluator->call_depth_ == MAX_CALL_DEPTH
+        || utils::native_stack_exhausted()) {
+        throw RuntimeError(Token{token_type::END, "", line}, "Stack overflow.");
+    }
+    evaluator->stack_top_ = frame + num_slots;
+    evaluator->call_depth_++;
+}
+
+Evaluator::FrameGuard::~FrameGuard() {
+    // 栈帧中被闭包捕获的变量搬到堆上
+    evaluator->open_upvalues_.close(frame);
+    for (Value *slot = frame; slot < evaluator->stack_top_; slot++) {
+        *slot = nullptr;
+    }
+    evaluator->stack_top_ = frame;
+    evaluator->call_depth_--;
+}
+
+void Evaluator::runtime_error(uint32_t index, const std::string &msg) {
+    throw RuntimeError(Token{token_type::END, "", tree_.lines[index]}, msg);
+}
+
+Value &Evaluator::variable(node_kind kind, uint32_t slot) {
+    switch (kind) {
+        case node_kind::GET_GLOBAL:
+        case node_kind::SET_GLOBAL:
+        case node_kind::INCREMENT_GLOBAL:
+            return globals_[slot];
+        case node_kind::GET_UPVALUE:
+        case node_kind::SET_UPVALUE:
+        case node_kind::INCREMENT_UPVALUE:
+            return upvalues_[slot].as_upvalue().get();
+        default:
+            return slots_[slot];
+    }
+}
+
+Value Evaluator::evaluate(uint32_t index) {
+    const Node &node = tree_.nodes[index];
+
+    // 分支中只保留简单的情况, 需要临时Value的运算放在单独的函数中,
+    // 避免递归求值的栈帧过大
+    switch (node.kind) {
+        case node_kind::CONSTANT:
+            return tree_.constants[node.a];
+        case node_kind::GET_LOCAL:
+            return slots_[node.a];
+        case node_kind::GET_UPVALUE:
+            return upvalues_[node.a].as_upvalue().get();
+        case node_kind::GET_GLOBAL:
+            return globals_[node.a];
+        case node_kind::GET_SELF:
+            return Value{function_};
+        case node_kind::SET_LOCAL:
+        case node_kind::SET_UPVALUE:
+        case node_kind::SET_GLOBAL:
+            return assign(node);
+        case node_kind::AND:
+        case node_kind::OR:
+            return logical(node);
+        case node_kind::NOT:
+            return !is_truthy(evaluate(node.a));
+        case node_kind::NEGATE:
+            return negate(node, index);
+        case node_kind::PROMOTE:
+            return promote_number(evaluate(node.a));
+        case node_kind::CALL:
+            return call(node, index);
+        case node_kind::INLINE_CALL:
+            return inline_call(node);
+        case node_kind::INCREMENT_LOCAL:
+        case node_kind::INCREMENT_UPVALUE:
+        case node_kind::INCREMENT_GLOBAL:
+            return increment(node, index);
+        default:
+            return binary(node, index);
+    }
+}
+
+Value Evaluator::assign(const Node &node) {
+    Value value = evaluate(node.b);
+    variable(node.kind, node.a) = value;
+
+    return value;
+}
+
+Value Evaluator::logical(const Node &node) {
+    Value left = evaluate(node.a);
+    bool truthy = is_truthy(left);
+    if (node.kind == node_kind::OR ? truthy : !truthy) {
+        return left;
+    }
+
+    return evaluate(node.b);
+}
+
+Value Evaluator::negate(const Node &node, uint32_t index) {
+    Value right = evaluate(node.a);
+    if (!is_number(right)) {
+        runtime_error(index, "Operand must be a number.");
+    }
+
+    return negate_number(right);
+}
+
+Value &Evaluator::increment(const Node &node, uint32_t index) {
+    // 直接在变量的槽位上计算, 作为语句时不需要复制结果
+    Value &value = variable(node.kind, node.a);
+    const Value &delta = tree_.constants[node.b];
+    int64_t result;
+    if (value.is_int() && delta.is_int()
+        && !add_overflow(value.as_int(), delta.as_int(), &result)) {
+        value = result;
+        return value;
+    }
+    if (!is_number(value)) {
+        runtime_error(index, "Operand must be a number.");
+    }
+    value = add_numbers(value, delta);
+
+    return value;
+}
+
+const Value *Evaluator::operand(uint8_t form, uint32_t index) const {
+    switch (form) {
+        case OPERAND_LOCAL:
+            return &slots_[index];
+        case OPERAND_GLOBAL:
+            return &globals_[index];
+        case OPERAND_CONSTANT:
+            return &tree_.constants[index];
+        default:
+            return nullptr;
+    }
+}
+
+Value Evaluator::binary(const Node &node, uint32_t index) {
+    // 变量和常量直接读取, 不复制也不递归求值
+    auto left_form = node.op & 3;
+    const Value *left = operand(left_form, node.a);
+    const Value *right = operand(node.op >> 2, node.b);
+    if (left != nullptr && right != nullptr) {
+        return binary(node.kind, *left, *right, index);
+    }
+
+    // 右操作数有副作用时可能修改左操作数的变量, 这时左操作数需要先复制
+    Value left_value;
+    Value right_value;
+    if (left == nullptr) {
+        left_value = evaluate(node.a);
+        left = &left_value;
+    } else if (right == nullptr && left_form != OPERAND_CONSTANT) {
+        left_value = *left;
+        left = &left_value;
+    }
+    if (right == nullptr) {
+        right_value = evaluate(node.b);
+        right = &right_value;
+    }
+    return binary(node.kind, *left, *right, index);
+}
+
+Value Evaluator::binary(node_kind kind,
+                        const Value &left,
+                        const Value &right,
+                        uint32_t index) {
+    // 两个整数的运算最常见, 不溢出时直接得到结果
+    if (left.is_int() && right.is_int()) {
+        auto a = left.as_int();
+        auto b = right.as_int();
+        int64_t result;
+        switch (kind) {
+            case node_kind::EQUAL:
+                return a == b;
+            case node_kind::NOT_EQUAL:
+                return a != b;
+            case node_kind::GREATER:
+                return a > b;
+            case node_kind::GREATER_EQUAL:
+                return a >= b;
+            case node_kind::LESS:
+                return a < b;
+            case node_kind::LESS_EQUAL:
+                return a <= b;
+            case node_kind::ADD:
+                if (!add_overflow(a, b, &result)) {
+                    return result;
+                }
+                break;
+            case node_kind::SUBTRACT:
+                if (!subtract_overflow(a, b, &result)) {
+                    return result;
+                }
+                break;
+            case node_kind::MULTIPLY:
+                if (!multiply_overflow(a, b, &result)) {
+                    return result;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    switch (kind) {
+        case node_kind::EQUAL:
+            return is_equal(left, right);
+        case node_kind::NOT_EQUAL:
+            return !is_equal(left, right);
+        case node_kind::ADD:
+            if (is_number(left) && is_number(right)) {
+                return add_numbers(left, right);
+            }
+            if (left.is_string() && right.is_string()) {
+                return concat(left, right);
+            }
+            runtime_error(index,
+                          "Operands must be two numbers or two strings.");
+        default:
+            break;
+    }
+
+    if (!is_number(left) || !is_number(right)) {
+        runtime_error(index, "Operands must be numbers.");
+    }
+    switch (kind) {
+        case node_kind::GREATER:
+            return greater_numbers(left, right);
+        case node_kind::GREATER_EQUAL:
+            return greater_equal_numbers(left, right);
+        case node_kind::LESS:
+            return less_numbers(left, right);
+        case node_kind::LESS_EQUAL:
+            return less_equal_numbers(left, right);
+        case node_kind::SUBTRACT:
+            return subtract_numbers(left, right);
+        case node_kind::MULTIPLY:
+            return multiply_numbers(left, right);
+        case node_kind::DIVIDE:
+            if (is_integer_division_by_zero(left, right)) {
+                runtime_error(index, "Division by zero.");
+            }
+            return divide_numbers(left, right);
+        default:
+            return {};
+    }
+}
+
+bool Evaluator::condition(uint32_t index) {
+    // 循环条件大多是两个整数变量或常量的比较, 直接得到bool
+    // 四个比较运算在node_kind中是连续的
+    const Node &node = tree_.nodes[index];
+    if (node.kind >= node_kind::GREATER && node.kind <= node_kind::LESS_EQUAL) {
+        const Value *left = operand(node.op & 3, node.a);
+        const Value *right = operand(node.op >> 2, node.b);
+        if (left != nullptr && right != nullptr && left->is_int()
+            && right->is_int()) {
+            auto a = left->as_int();
+            auto b = right->as_int();
+            switch (node.kind) {
+                case node_kind::GREATER:
+                    return a > b;
+                case node_kind::GREATER_EQUAL:
+                    return a >= b;
+                case node_kind::LESS:
+                    return a < b;
+                default:
+                    return a <= b;
+            }
+        }
+    }
+
+    return is_truthy(evaluate(index));
+}
+
+Value Evaluator::callee(const Node &call) {
+    // 被调用的函数可能在执行中被重新赋值, 总是复制一份保持它存活
+    const Value *callee = operand(call.op, call.a);
+    return callee != nullptr ? *callee : evaluate(call.a);
+}
+
+Value Evaluator::call(const Node &node, uint32_t index) {
+    Value callee = this->callee(node);
+    auto num_arguments = node.c;
+
+    if (callee.is_function()) {
+        auto &function = callee.as_function();
+        if (function.get_code() == nullptr) {
+            runtime_error(index, "Can only call functions and classes.");
+        }
+        // 参数直接求值到新栈帧对应的槽位中
+        auto size = std::max<std::size_t>(function.frame_size(), num_arguments);
+        FrameGuard frame{this, size, tree_.lines[index]};
+        for (auto i = 0u; i < num_arguments; i++) {
+            frame.slots()[i] = evaluate(tree_.lists[node.b + i]);
+        }
+        if (num_arguments != function.arity()) {
+            runtime_error(index,
+                          fmt::format("Expected {} arguments but got {}.",
+                                      function.arity(),
+                                      num_arguments));
+        }
+        return call(function, frame.slots());
+    }
+
+    std::vector<Value> arguments(num_arguments);
+    for (auto i = 0u; i < num_arguments; i++) {
+        arguments[i] = evaluate(tree_.lists[node.b + i]);
+    }
+
+    if (callee.is_native_function()) {
+        return callee.as_native_function().call(interpreter_,
+                                                std::move(arguments));
+    }
+    runtime_error(index, "Can only call functions and classes.");
+}
+
+Value Evaluator::call(const ZeroFunction &function, Value *frame) {
+    // 参数类型与注解一致时执行特化的版本
+    if (const auto *typed = function.get_declaration()->typed.get()) {
+        Value result;
+        if (typed->call(frame, globals_, result)) {
+            return result;
+        }
+    }
+
+    auto *memo = function.get_declaration()->memo.get();
+    if (memo == nullptr) {
+        return execute_function(function, frame);
+    }
+    if (const Value *result = memo->find(frame)) {
+        return *result;
+    }
+
+    // 函数体可能修改参数, 先复制一份作为记忆表的键
+    std::vector<Value> arguments(frame, frame + function.arity());
+    Value result = execute_function(function, frame);
+    memo->insert(arguments.data(), result);
+
+    return result;
+}
+
+Value Evaluator::execute_function(const ZeroFunction &function,
+                                  Value *frame) {
+    RegisterGuard guard{this};
+    Value callee; // 保持正在执行的尾调用函数存活
+    const ZeroFunction *current = &function;
+    while (true) {
+        slots_ = frame;
+        upvalues_ = current->get_upvalues();
+        function_ = current;
+        const auto *code = current->get_code();
+
+        auto completion = execute(code->body, code->size);
+        if (completion == Completion::RETURN) {
+            return std::move(return_value_);
+        }
+        if (completion != Completion::TAIL_CALL) {
+            return {};
+        }
+
+        const auto &next = tail_callee_.as_function();
+        reuse_frame(frame,
+                    std::max<std::size_t>(next.frame_size(), next.arity()));
+        callee = std::move(tail_callee_);
+        current = &callee.as_function();
+    }
+}
+
+Completion Evaluator::tail_call(uint32_t index, Value callee) {
+    // 参数依次求值到栈顶之上, 由execute_function搬到当前栈帧的开头
+    // 求值出错时由外层函数的FrameGuard清理这些槽位
+    const Node &call = tree_.nodes[index];
+    auto num_arguments = call.c;
+    if (num_arguments > static_cast<std::size_t>(
+            stack_.data() + STACK_MAX - stack_top_)) {
+        runtime_error(index, "Stack overflow.");
+    }
+    for (auto i = 0u; i < num_arguments; i++) {
+        Value value = evaluate(tree_.lists[call.b + i]);
+        *stack_top_++ = std::move(value);
+    }
+    auto &function = callee.as_function();
+    if (num_arguments != function.arity()) {
+        runtime_error(index,
+                      fmt::format("Expected {} arguments but got {}.",
+                                  function.arity(),
+                                  num_arguments));
+    }
+
+    tail_callee_ = std::move(callee);
+    return Completion::TAIL_CALL;
+}
+
+void Evaluator::reuse_frame(Value *frame, std::size_t frame_size) {
+    // 当前函数已经执行完, 栈帧中被捕获的变量先搬到堆上
+    open_upvalues_.close(frame);
+
+    const auto &function = tail_callee_.as_function();
+    auto num_arguments = function.arity();
+    Value *arguments = stack_top_ - num_arguments;
+    std::move(arguments, stack_top_, frame);
+    for (Value *slot = frame + num_arguments; slot < stack_top_; slot++) {
+        *slot = nullptr;
+    }
+
+    auto available = static_cast<std::size_t>(
+        stack_.data() + STACK_MAX - frame);
+    if (frame_size > available) {
+        throw RuntimeError(function.get_declaration()->name,
+                           "Stack overflow.");
+    }
+    stack_top_ = frame + frame_size;
+}
+
+Value Evaluator::inline_call(const Node &node) {
+    // 全局变量仍然是被内联的函数时对返回表达式求值, 否则按原来的调用执行
+    const auto &target = tree_.inlines[node.c];
+    const auto &function = globals_[target.slot];
+    if (!function.is_function()
+        || function.as_function().get_declaration() != target.function) {
+        return evaluate(node.a);
+    }
+
+    const Node &call = tree_.nodes[node.a];
+    FrameGuard frame{this, target.num_slots, tree_.lines[node.a]};
+    for (auto i = 0u; i < call.c; i++) {
+        frame.slots()[i] = evaluate(tree_.lists[call.b + i]);
+    }
+    RegisterGuard guard{this};
+    slots_ = frame.slots();
+    upvalues_ = nullptr;
+
+    return evaluate(node.b);
+}
+
+Completion Evaluator::execute(uint32_t statements, uint32_t size) {
+    for (auto i = 0u; i < size; i++) {
+        auto completion = execute(tree_.lists[statements + i]);
+        if (completion != Completion::NORMAL) {
+            return completion;
+        }
+    }
+
+    return Completion::NORMAL;
+}
+
+Completion Evaluator::execute(uint32_t index) {
+    const Node &node = tree_.nodes[index];
+
+    switch (node.kind) {
+        case node_kind::BLOCK:
+            return execute(node.a, node.b);
+        case node_kind::BLOCK_CLOSE: {
+            auto completion = execute(node.a, node.b);
+            // 槽位会被后面的块复用, 被捕获的变量需要搬到堆上
+            // 抛出异常时由函数栈帧统一关闭
+            open_upvalues_.close(slots_ + node.c);
+            return completion;
+        }
+        case node_kind::BLOCK_FRAME:
+            return execute_frame(node);
+        case node_kind::EXPRESSION:
+            evaluate(node.a);
+            return Completion::NORMAL;
+        case node_kind::INCREMENT_LOCAL:
+        case node_kind::INCREMENT_UPVALUE:
+        case node_kind::INCREMENT_GLOBAL:
+            increment(node, index);
+            return Completion::NORMAL;
+        case node_kind::DEFINE_LOCAL:
+            slots_[node.a] = node.b == NONE ? Value{} : evaluate(node.b);
+            return Completion::NORMAL;
+        case node_kind::DEFINE_GLOBAL:
+            globals_[node.a] = node.b == NONE ? Value{} : evaluate(node.b);
+            return Completion::NORMAL;
+        case node_kind::IF:
+            if (condition(node.a)) {
+                return execute(node.b);
+            }
+            if (node.c != NONE) {
+                return execute(node.c);
+            }
+            return Completion::NORMAL;
+        case node_kind::WHILE:
+            while (condition(node.a)) {
+                auto completion = execute(node.b);
+                if (completion != Completion::NORMAL) {
+                    return completion;
+                }
+            }
+            return Completion::NORMAL;
+        case node_kind::FUNCTION:
+            return define_function(tree_.functions[node.a]);
+        case node_kind::RETURN:
+            // 返回值暂存在求值器中, 通过Completion::RETURN逐层通知到函数调用处
+            return_value_ = node.a == NONE ? Value{} : evaluate(node.a);
+            return Completion::RETURN;
+        case node_kind::TAIL_RETURN:
+            return tail_return(node);
+        default:
+            return Completion::NORMAL;
+    }
+}
+
+Completion Evaluator::execute_frame(const Node &node) {
+    // 不在函数中的块使用自己的栈帧
+    FrameGuard frame{this, node.c, 0};
+    RegisterGuard guard{this};
+    slots_ = frame.slots();
+    upvalues_ = nullptr;
+
+    return execute(node.a, node.b);
+}
+
+Completion Evaluator::tail_return(const Node &node) {
+    Value callee = this->callee(tree_.nodes[node.a]);
+    if (callee.is_function() && callee.as_function().get_code() != nullptr) {
+        return tail_call(node.a, std::move(callee));
+    }
+
+    // 原生函数或者出错时按普通调用处理, 被调用者会再求值一次,
+    // 与树遍历解释器的行为一致
+    return_value_ = evaluate(node.a);
+    return Completion::RETURN;
+}
+
+Completion Evaluator::define_function(const FunctionCode &code) {
+    const auto *declaration = code.declaration;
+    auto function = ZeroFunction(code.declaration, &code);
+    for (const auto &capture : declaration->captures) {
+        function.add_upvalue(capture.is_local
+                                 ? open_upvalues_.capture(
+                                     slots_ + capture.index)
+                                 : upvalues_[capture.index]);
+    }
+    if (declaration->depth == GLOBAL_DEPTH) {
+        globals_[declaration->slot] = std::move(function);
+    } else {
+        slots_[declaration->slot] = std::move(function);
+    }
+
+    return Completion::NORMAL;
+}
+
+} // namespace zero::flat
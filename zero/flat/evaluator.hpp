@@ -0,0 +1,123 @@
+#pragma once
+
+#include "ast/stmt.hpp"
+#include "function.hpp"
+#include "tree.hpp"
+#include "value.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace zero {
+class Interpreter;
+} // namespace zero
+
+namespace zero::flat {
+
+// 扁平语法树的求值器, 按节点种类switch分派, 没有虚函数调用
+// 全局变量和原生函数与树遍历解释器共用, 由Interpreter持有
+class Evaluator {
+public:
+    explicit Evaluator(Interpreter &interpreter);
+
+public:
+    // 新的程序转换到这棵树中
+    Tree &tree() { return tree_; }
+    // 执行顶层语句, 运行时错误以RuntimeError抛出
+    void run(uint32_t statements, uint32_t size);
+
+private:
+    Value evaluate(uint32_t index);
+    Completion execute(uint32_t index);
+    Completion execute(uint32_t statements, uint32_t size);
+    Completion execute_frame(const Node &node);
+    Completion tail_return(const Node &node);
+
+    Value callee(const Node &call);
+    Value call(const Node &node, uint32_t index);
+    // 参数已经按槽位存放在frame中, 有记忆表时先查表
+    Value call(const ZeroFunction &function, Value *frame);
+    // 执行函数体, 尾调用在这里循环执行
+    Value execute_function(const ZeroFunction &function, Value *frame);
+    // 尾调用: 参数求值到栈顶之上, 函数保存在tail_callee_中
+    Completion tail_call(uint32_t index, Value callee);
+    void reuse_frame(Value *frame, std::size_t frame_size);
+    Value inline_call(const Node &node);
+    Completion define_function(const FunctionCode &code);
+
+    Value &variable(node_kind kind, uint32_t slot);
+    Value assign(const Node &node);
+    Value logical(const Node &node);
+    Value negate(const Node &node, uint32_t index);
+    Value &increment(const Node &node, uint32_t index);
+    Value binary(const Node &node, uint32_t index);
+    Value binary(node_kind kind,
+                 const Value &left,
+                 const Value &right,
+                 uint32_t index);
+    // 按二元运算的操作数形式直接读取变量或常量, 子节点返回nullptr
+    const Value *operand(uint8_t form, uint32_t index) const;
+    // if和while的条件, 整数比较不构造Value
+    bool condition(uint32_t index);
+
+    [[noreturn]] void runtime_error(uint32_t index, const std::string &msg);
+
+private:
+    // 在栈上分配一个栈帧, 离开作用域时清空并释放其中的槽位
+    class FrameGuard {
+    public:
+        FrameGuard(Evaluator *evaluator, std::size_t num_slots, unsigned line);
+        ~FrameGuard();
+
+        FrameGuard(const FrameGuard &) = delete;
+        FrameGuard &operator=(const FrameGuard &) = delete;
+
+        Value *slots() const { return frame; }
+
+    private:
+        Evaluator *evaluator;
+        Value *frame;
+    };
+
+    // 保存当前栈帧, 捕获列表和函数, 离开作用域时恢复
+    class RegisterGuard {
+    public:
+        explicit RegisterGuard(Evaluator *evaluator)
+            : evaluator{evaluator}, slots{evaluator->slots_},
+              upvalues{evaluator->upvalues_}, function{evaluator->function_} {}
+        ~RegisterGuard() {
+            evaluator->slots_ = slots;
+            evaluator->upvalues_ = upvalues;
+            evaluator->function_ = function;
+        }
+
+        RegisterGuard(const RegisterGuard &) = delete;
+        RegisterGuard &operator=(const RegisterGuard &) = delete;
+
+    private:
+        Evaluator *evaluator;
+        Value *slots;
+        const Value *upvalues;
+        const ZeroFunction *function;
+    };
+
+private:
+    static constexpr std::size_t STACK_MAX = 1 << 16;
+
+    Interpreter &interpreter_;
+    Tree tree_;
+    std::vector<Value> stack_;
+    Value *stack_top_;
+    unsigned int call_depth_{0};
+    OpenUpvalues open_upvalues_;
+    Value *globals_{nullptr};
+    Value *slots_{nullptr};              // 当前栈帧
+    const Value *upvalues_{nullptr};     // 当前函数捕获的变量
+    const ZeroFunction *function_{nullptr}; // 当前执行的函数
+    Value return_value_; // return语句的返回值, 由函数调用取走
+    Value tail_callee_;  // 尾调用的函数, 由函数调用取走
+};
+
+} // namespace zero::flat
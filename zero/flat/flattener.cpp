@@ -0,0 +1,353 @@
+#include "flattener.hpp"
+
+namespace zero::flat {
+
+namespace {
+// 变量按Resolver计算的位置选择节点种类
+node_kind by_depth(int depth,
+                   node_kind local,
+                   node_kind upvalue,
+                   node_kind global) {
+    switch (depth) {
+        case GLOBAL_DEPTH:
+            return global;
+        case UPVALUE_DEPTH:
+            return upvalue;
+        default:
+            return local;
+    }
+}
+
+node_kind binary_kind(token_type op) {
+    switch (op) {
+        case token_type::EQUAL_EQUAL:
+            return node_kind::EQUAL;
+        case token_type::NOT_EQUAL:
+            return node_kind::NOT_EQUAL;
+        case token_type::GREATER:
+            return node_kind::GREATER;
+        case token_type::GREATER_EQUAL:
+            return node_kind::GREATER_EQUAL;
+        case token_type::LESS:
+            return node_kind::LESS;
+        case token_type::LESS_EQUAL:
+            return node_kind::LESS_EQUAL;
+        case token_type::PLUS:
+            return node_kind::ADD;
+        case token_type::MINUS:
+            return node_kind::SUBTRACT;
+        case token_type::STAR:
+            return node_kind::MULTIPLY;
+        default:
+            return node_kind::DIVIDE;
+    }
+}
+} // namespace
+
+Flattener::Script Flattener::flatten(const std::unique_ptr<Program> &program) {
+    const auto &statements = program->get_statements();
+    auto first = flatten(statements);
+
+    return Script{first, static_cast<uint32_t>(statements.size())};
+}
+
+uint32_t Flattener::flatten(Expr &expr) {
+    expr.accept(*this);
+    return result_;
+}
+
+uint32_t Flattener::flatten(Stmt &stmt) {
+    stmt.accept(*this);
+    return result_;
+}
+
+uint32_t
+Flattener::flatten(const std::vector<std::unique_ptr<Stmt>> &stmts) {
+    std::vector<uint32_t> list;
+    list.reserve(stmts.size());
+    for (const auto &stmt : stmts) {
+        list.push_back(flatten(*stmt));
+    }
+
+    return tree_.add_list(list);
+}
+
+uint32_t Flattener::flatten_call(Call &call) {
+    operand_form form{};
+    auto callee = flatten_operand(*call.callee, form);
+    std::vector<uint32_t> arguments;
+    arguments.reserve(call.arguments.size());
+    for (const auto &argument : call.arguments) {
+        arguments.push_back(flatten(*argument));
+    }
+
+    emit(node_kind::CALL,
+         call.paren.line,
+         callee,
+         tree_.add_list(arguments),
+         static_cast<uint32_t>(arguments.size()));
+    tree_.nodes[result_].op = form;
+
+    return result_;
+}
+
+uint32_t Flattener::emit(
+    node_kind kind, unsigned int line, uint32_t a, uint32_t b, uint32_t c) {
+    result_ = tree_.add(Node{kind, 0, a, b, c}, line);
+    return result_;
+}
+
+uint32_t Flattener::flatten_operand(Expr &expr, operand_form &form) {
+    auto index = flatten(expr);
+    const Node node = tree_.nodes[index];
+    switch (node.kind) {
+        case node_kind::GET_LOCAL:
+            form = OPERAND_LOCAL;
+            break;
+        case node_kind::GET_GLOBAL:
+            form = OPERAND_GLOBAL;
+            break;
+        case node_kind::CONSTANT:
+            form = OPERAND_CONSTANT;
+            break;
+        default:
+            form = OPERAND_NODE;
+            return index;
+    }
+    // 叶子节点总是最后生成的, 直接去掉, 由二元运算节点记录它的槽位
+    tree_.nodes.pop_back();
+    tree_.lines.pop_back();
+
+    return node.a;
+}
+
+uint32_t Flattener::emit_binary(node_kind kind,
+                                unsigned int line,
+                                Expr &left,
+                                Expr &right) {
+    operand_form left_form{};
+    operand_form right_form{};
+    auto a = flatten_operand(left, left_form);
+    auto b = flatten_operand(right, right_form);
+    emit(kind, line, a, b);
+    tree_.nodes[result_].op =
+        static_cast<uint8_t>(left_form | right_form << 2);
+
+    return result_;
+}
+
+Value Flattener::visit_binary_expr(Binary *expr) {
+    emit_binary(binary_kind(expr->op.type),
+                expr->op.line,
+                *expr->left,
+                *expr->right);
+
+    return {};
+}
+
+Value Flattener::visit_grouping_expr(Grouping *expr) {
+    // 括号只影响解析, 不需要单独的节点
+    flatten(*expr->expr);
+
+    return {};
+}
+
+Value Flattener::visit_literal_expr(Literal *expr) {
+    emit(node_kind::CONSTANT, 0, tree_.add_constant(expr->value));
+
+    return {};
+}
+
+Value Flattener::visit_logical_expr(Logical *expr) {
+    auto left = flatten(*expr->left);
+    auto right = flatten(*expr->right);
+    auto kind = expr->op.type == token_type::OR ? node_kind::OR
+                                                : node_kind::AND;
+    emit(kind, expr->op.line, left, right);
+
+    return {};
+}
+
+Value Flattener::visit_unary_expr(Unary *expr) {
+    auto right = flatten(*expr->right);
+    auto kind = expr->op.type == token_type::NOT ? node_kind::NOT
+                                                 : node_kind::NEGATE;
+    emit(kind, expr->op.line, right);
+
+    return {};
+}
+
+Value Flattener::visit_variable_expr(Variable *expr) {
+    if (expr->depth == SELF_DEPTH) {
+        emit(node_kind::GET_SELF, expr->name.line);
+        return {};
+    }
+    emit(by_depth(expr->depth,
+                  node_kind::GET_LOCAL,
+                  node_kind::GET_UPVALUE,
+                  node_kind::GET_GLOBAL),
+         expr->name.line,
+         expr->slot);
+
+    return {};
+}
+
+Value Flattener::visit_assign_expr(Assign *expr) {
+    auto value = flatten(*expr->value);
+    emit(by_depth(expr->depth,
+                  node_kind::SET_LOCAL,
+                  node_kind::SET_UPVALUE,
+                  node_kind::SET_GLOBAL),
+         expr->name.line,
+         expr->slot,
+         value);
+
+    return {};
+}
+
+Value Flattener::visit_call_expr(Call *expr) {
+    flatten_call(*expr);
+
+    return {};
+}
+
+Value Flattener::visit_inline_call_expr(InlineCall *expr) {
+    auto call = flatten_call(*expr->call);
+    auto body = flatten(*expr->body);
+    const auto *callee = static_cast<const Variable *>(expr->call->callee.get());
+    tree_.inlines.push_back(
+        InlineTarget{expr->function, callee->slot, expr->num_slots});
+    emit(node_kind::INLINE_CALL,
+         expr->call->paren.line,
+         call,
+         body,
+         static_cast<uint32_t>(tree_.inlines.size() - 1));
+
+    return {};
+}
+
+Value Flattener::visit_increment_expr(Increment *expr) {
+    emit(by_depth(expr->depth,
+                  node_kind::INCREMENT_LOCAL,
+                  node_kind::INCREMENT_UPVALUE,
+                  node_kind::INCREMENT_GLOBAL),
+         expr->op.line,
+         expr->slot,
+         tree_.add_constant(expr->delta));
+
+    return {};
+}
+
+Value Flattener::visit_compare_expr(Compare *expr) {
+    // 与同样运算符的二元运算相同
+    emit_binary(binary_kind(expr->op.type),
+                expr->op.line,
+                *expr->variable,
+                *expr->bound);
+
+    return {};
+}
+
+Value Flattener::visit_promote_expr(Promote *expr) {
+    emit(node_kind::PROMOTE, 0, flatten(*expr->expr));
+
+    return {};
+}
+
+Completion Flattener::visit_block_stmt(Block *stmt) {
+    auto statements = flatten(stmt->statements);
+    auto size = static_cast<uint32_t>(stmt->statements.size());
+    if (stmt->num_slots != 0) {
+        emit(node_kind::BLOCK_FRAME, 0, statements, size, stmt->num_slots);
+    } else if (stmt->has_captured) {
+        emit(node_kind::BLOCK_CLOSE, 0, statements, size, stmt->first_slot);
+    } else {
+        emit(node_kind::BLOCK, 0, statements, size);
+    }
+
+    return Completion::NORMAL;
+}
+
+Completion Flattener::visit_expression_stmt(Expression *stmt) {
+    // 作为语句的赋值和自增不需要结果, 直接修改变量
+    auto expression = flatten(*stmt->expression);
+    auto &node = tree_.nodes[expression];
+    switch (node.kind) {
+        case node_kind::SET_LOCAL:
+            node.kind = node_kind::DEFINE_LOCAL;
+            break;
+        case node_kind::SET_GLOBAL:
+            node.kind = node_kind::DEFINE_GLOBAL;
+            break;
+        case node_kind::INCREMENT_LOCAL:
+        case node_kind::INCREMENT_UPVALUE:
+        case node_kind::INCREMENT_GLOBAL:
+            break;
+        default:
+            emit(node_kind::EXPRESSION, 0, expression);
+            break;
+    }
+
+    return Completion::NORMAL;
+}
+
+Completion Flattener::visit_var_stmt(Var *stmt) {
+    auto initializer = NONE;
+    if (stmt->initializer != nullptr) {
+        initializer = flatten(*stmt->initializer);
+    }
+    auto kind = stmt->depth == GLOBAL_DEPTH ? node_kind::DEFINE_GLOBAL
+                                            : node_kind::DEFINE_LOCAL;
+    emit(kind, stmt->name.line, stmt->slot, initializer);
+
+    return Completion::NORMAL;
+}
+
+Completion Flattener::visit_if_stmt(If *stmt) {
+    auto condition = flatten(*stmt->condition);
+    auto then_branch = flatten(*stmt->then_branch);
+    auto else_branch = NONE;
+    if (stmt->else_branch != nullptr) {
+        else_branch = flatten(*stmt->else_branch);
+    }
+    emit(node_kind::IF, 0, condition, then_branch, else_branch);
+
+    return Completion::NORMAL;
+}
+
+Completion Flattener::visit_while_stmt(While *stmt) {
+    auto condition = flatten(*stmt->condition);
+    auto body = flatten(*stmt->body);
+    emit(node_kind::WHILE, 0, condition, body);
+
+    return Completion::NORMAL;
+}
+
+Completion Flattener::visit_function_stmt(Function *stmt) {
+    auto body = flatten(stmt->body);
+    tree_.functions.push_back(FunctionCode{
+        stmt, body, static_cast<uint32_t>(stmt->body.size())});
+    emit(node_kind::FUNCTION,
+         stmt->name.line,
+         static_cast<uint32_t>(tree_.functions.size() - 1));
+
+    return Completion::NORMAL;
+}
+
+Completion Flattener::visit_return_stmt(Return *stmt) {
+    if (stmt->tail_call) {
+        auto call = flatten(*stmt->value);
+        emit(node_kind::TAIL_RETURN, stmt->keyword.line, call);
+        return Completion::NORMAL;
+    }
+
+    auto value = NONE;
+    if (stmt->value != nullptr) {
+        value = flatten(*stmt->value);
+    }
+    emit(node_kind::RETURN, stmt->keyword.line, value);
+
+    return Completion::NORMAL;
+}
+
+} // namespace zero::flat
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "ast/expr.hpp"
+#include "ast/program.hpp"
+#include "ast/stmt.hpp"
+#include "tree.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace zero::flat {
+
+// 把经过Resolver解析的AST转换成扁平语法树, 变量沿用Resolver分配的槽位
+class Flattener : public ExprVisitor, public StmtVisitor {
+public:
+    explicit Flattener(Tree &tree) : tree_{tree} {}
+
+public:
+    // 顶层语句列表的位置和语句个数
+    struct Script {
+        uint32_t statements;
+        uint32_t size;
+    };
+    Script flatten(const std::unique_ptr<Program> &program);
+
+public:
+    // Expr抽象类方法, 新节点的下标保存在result_中
+    Value visit_binary_expr(Binary *expr) override;
+    Value visit_grouping_expr(Grouping *expr) override;
+    Value visit_literal_expr(Literal *expr) override;
+    Value visit_logical_expr(Logical *expr) override;
+    Value visit_unary_expr(Unary *expr) override;
+    Value visit_variable_expr(Variable *expr) override;
+    Value visit_assign_expr(Assign *expr) override;
+    Value visit_call_expr(Call *expr) override;
+    Value visit_inline_call_expr(InlineCall *expr) override;
+    Value visit_increment_expr(Increment *expr) override;
+    Value visit_compare_expr(Compare *expr) override;
+    Value visit_promote_expr(Promote *expr) override;
+
+    // Stmt抽象类方法
+    Completion visit_block_stmt(Block *stmt) override;
+    Completion visit_expression_stmt(Expression *stmt) override;
+    Completion visit_var_stmt(Var *stmt) override;
+    Completion visit_if_stmt(If *stmt) override;
+    Completion visit_while_stmt(While *stmt) override;
+    Completion visit_function_stmt(Function *stmt) override;
+    Completion visit_return_stmt(Return *stmt) override;
+
+private:
+    uint32_t flatten(Expr &expr);
+    uint32_t flatten(Stmt &stmt);
+    // 子节点先转换, 然后列表连续存放
+    uint32_t flatten(const std::vector<std::unique_ptr<Stmt>> &stmts);
+    uint32_t flatten_call(Call &call);
+    // 局部变量, 全局变量和常量不生成节点, 返回槽位或常量下标
+    uint32_t flatten_operand(Expr &expr, operand_form &form);
+    uint32_t emit_binary(node_kind kind,
+                         unsigned int line,
+                         Expr &left,
+                         Expr &right);
+    uint32_t emit(node_kind kind,
+                  unsigned int line,
+                  uint32_t a = NONE,
+                  uint32_t b = NONE,
+                  uint32_t c = NONE);
+
+private:
+    Tree &tree_;
+    uint32_t result_{NONE};
+};
+
+} // namespace zero::flat
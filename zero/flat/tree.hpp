@@ -0,0 +1,135 @@
+#pragma once
+
+#include "value.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+namespace zero {
+struct Function;
+} // namespace zero
+
+namespace zero::flat {
+
+// 扁平语法树的节点种类
+// 变量按位置, 二元运算按运算符拆分成不同的种类, 求值时只需要一次switch
+enum class node_kind : uint8_t {
+    // 表达式
+    CONSTANT,          // a: 常量下标
+    GET_LOCAL,         // a: 槽位
+    GET_UPVALUE,       // a: 捕获列表中的下标
+    GET_GLOBAL,        // a: 全局槽位
+    GET_SELF,          // 正在执行的函数
+    SET_LOCAL,         // a: 槽位, b: 值
+    SET_UPVALUE,       // a: 捕获列表中的下标, b: 值
+    SET_GLOBAL,        // a: 全局槽位, b: 值
+    EQUAL,             // a: 左操作数, b: 右操作数, op: 操作数的形式
+                       // 以下二元运算相同, 比较运算也用于循环优化的Compare
+    NOT_EQUAL,
+    GREATER,
+    GREATER_EQUAL,
+    LESS,
+    LESS_EQUAL,
+    ADD,
+    SUBTRACT,
+    MULTIPLY,
+    DIVIDE,
+    AND,
+    OR,
+    NOT,               // a: 操作数
+    NEGATE,            // a: 操作数
+    PROMOTE,           // a: 操作数, 整数转换为double
+    CALL,              // a: 被调用者, b: 参数列表, c: 参数个数, op: 被调用者的形式
+    INLINE_CALL,       // a: 原来的CALL, b: 返回表达式, c: InlineTarget下标
+    INCREMENT_LOCAL,   // a: 槽位, b: 增量的常量下标, 也可以直接作为语句
+    INCREMENT_UPVALUE, // a: 捕获列表中的下标, b: 增量的常量下标
+    INCREMENT_GLOBAL,  // a: 全局槽位, b: 增量的常量下标
+    // 语句
+    BLOCK,             // a: 语句列表, b: 语句个数
+    BLOCK_CLOSE,       // 同BLOCK, c: 离开时关闭的第一个槽位
+    BLOCK_FRAME,       // 同BLOCK, c: 需要的栈帧槽位数
+    EXPRESSION,        // a: 表达式, 赋值语句直接转换为DEFINE_*
+    DEFINE_LOCAL,      // a: 槽位, b: 初始值, 没有时为NONE
+    DEFINE_GLOBAL,     // a: 全局槽位, b: 初始值, 没有时为NONE
+    IF,                // a: 条件, b: then分支, c: else分支, 没有时为NONE
+    WHILE,             // a: 条件, b: 循环体
+    FUNCTION,          // a: FunctionCode下标
+    RETURN,            // a: 返回值, 没有时为NONE
+    TAIL_RETURN,       // a: 尾调用的CALL
+};
+
+// 节点只有16字节, 子节点通过在Tree::nodes中的下标引用
+struct Node {
+    node_kind kind;
+    // 二元运算的操作数形式, 低2位是左操作数, 高2位是右操作数
+    // CALL的op是被调用者的形式
+    uint8_t op;
+    uint32_t a;
+    uint32_t b;
+    uint32_t c;
+};
+
+// 二元运算的操作数是局部变量, 全局变量或常量时不单独生成节点,
+// a和b直接保存槽位或常量下标, 求值时不需要分派
+enum operand_form : uint8_t {
+    OPERAND_NODE,     // 子节点的下标
+    OPERAND_LOCAL,    // 槽位
+    OPERAND_GLOBAL,   // 全局槽位
+    OPERAND_CONSTANT, // 常量下标
+};
+
+static_assert(sizeof(Node) == 16, "Node should be 16 bytes");
+
+// 没有子节点
+constexpr uint32_t NONE = UINT32_MAX;
+
+// 编译好的函数体, 由ZeroFunction引用
+struct FunctionCode {
+    Function *declaration;
+    uint32_t body; // 语句列表在Tree::lists中的位置
+    uint32_t size; // 语句个数
+};
+
+// 内联调用的检查信息
+struct InlineTarget {
+    const Function *function; // 被内联的全局函数
+    unsigned int slot;        // 函数所在的全局槽位
+    unsigned int num_slots;   // 参数需要的槽位数
+};
+
+// 一个VM中所有程序的扁平语法树, REPL中新的程序追加在后面
+// 节点和行号分开存放, 只有报告错误时才读取行号
+struct Tree {
+    uint32_t add(Node node, unsigned int line) {
+        nodes.push_back(node);
+        lines.push_back(line);
+        return static_cast<uint32_t>(nodes.size() - 1);
+    }
+    // 子节点列表连续存放, 返回第一个元素的位置
+    uint32_t add_list(const std::vector<uint32_t> &list) {
+        auto first = static_cast<uint32_t>(lists.size());
+        lists.insert(lists.end(), list.begin(), list.end());
+        return first;
+    }
+    uint32_t add_constant(Value value) {
+        constants.push_back(std::move(value));
+        return static_cast<uint32_t>(constants.size() - 1);
+    }
+    std::size_t bytes() const {
+        return nodes.size() * sizeof(Node) + lines.size() * sizeof(unsigned)
+             + lists.size() * sizeof(uint32_t)
+             + constants.size() * sizeof(Value);
+    }
+
+    std::vector<Node> nodes;
+    std::vector<unsigned int> lines;
+    std::vector<uint32_t> lists;
+    std::vector<Value> constants;
+    // 函数对象引用其中的元素, 使用deque保证添加元素时地址不变
+    std::deque<FunctionCode> functions;
+    std::vector<InlineTarget> inlines;
+};
+
+} // namespace zero::flat
@@ -2,35 +2,129 @@
 
 #include "ast/stmt.hpp"
 #include "interpreter.hpp"
+#include "jit/compiler.hpp"
+#include "memo.hpp"
+#include "typed/code.hpp"
+
+#include <algorithm>
 
 // ZeroFunction 应该放到Interpreter 类里面
 namespace zero {
 
 std::string ZeroFunction::to_string() {
-    return std::string("<fn " + declaration->name.lexeme + ">");
+    return "<fn " + std::string(declaration->name.lexeme) + ">";
+}
+
+std::size_t ZeroFunction::arity() const { return declaration->params.size(); }
+
+unsigned int ZeroFunction::frame_size() const {
+    return declaration->num_slots;
+}
+
+Value ZeroFunction::call(Interpreter &interpreter,
+                         std::vector<Value> arguments) {
+    auto size = std::max<std::size_t>(frame_size(), arguments.size());
+    Interpreter::FrameGuard frame{&interpreter, size, declaration->name};
+    std::move(arguments.begin(), arguments.end(), frame.slots());
+
+    return call(interpreter, frame.slots());
 }
 
-std::any ZeroFunction::call(Interpreter &interpreter,
-                            std::vector<std::any> arguments) {
-    // auto env = std::make_unique<Environment>(closure);
-    // 创建一个新的环境, 包含全局环境
-    auto env = Environment(interpreter.get_globals());
-    for (auto i = 0u; i < declaration->params.size(); i++) {
-        env.define(declaration->params[i].lexeme, arguments[i]);
+Value ZeroFunction::call(Interpreter &interpreter, Value *frame) {
+    // 参数类型与注解一致时执行特化的版本
+    if (const auto *typed = declaration->typed.get()) {
+        Value result;
+        if (typed->call(frame, &interpreter.get_globals()->get(0), result)) {
+            return result;
+        }
     }
 
-    try {
-        interpreter.execute_block(declaration->body, &env);
-    } catch (ZeroReturn &returnValue) {
-        return returnValue.value;
+    auto *memo = declaration->memo.get();
+    if (memo == nullptr && interpreter.jit_enabled_) {
+        // 机器码以解释器当前的调用深度和剩余栈空间执行, 栈溢出时退回解释器
+        if (calls < jit::HOT_THRESHOLD) {
+            calls++;
+        } else if (const auto *jit = jit::compile(*declaration)) {
+            auto available = static_cast<std::size_t>(
+                interpreter.stack_.data() + Interpreter::STACK_MAX
+                - interpreter.stack_top_);
+            Value result;
+            if (jit->call(frame,
+                          &interpreter.get_globals()->get(0),
+                          available,
+                          interpreter.call_depth_,
+                          result)) {
+                return result;
+            }
+        }
+    }
+    if (memo == nullptr) {
+        return execute(interpreter, frame);
+    }
+    if (const Value *result = memo->find(frame)) {
+        return *result;
     }
 
-    return {};
+    // 函数体可能修改参数, 先复制一份作为记忆表的键
+    std::vector<Value> arguments(frame, frame + arity());
+    Value result = execute(interpreter, frame);
+    memo->insert(arguments.data(), result);
+
+    return result;
+}
+
+Value ZeroFunction::execute(Interpreter &interpreter, Value *frame) {
+    // 尾调用复用同一个栈帧, 在这里循环执行被调用的函数, 不再嵌套C++调用
+    Value callee; // 保持正在执行的尾调用函数存活
+    const ZeroFunction *function = this;
+    while (true) {
+        // 局部变量在栈帧中, 外层函数的变量通过捕获列表访问
+        auto env = Environment(frame, function);
+
+        auto completion
+            = interpreter.execute_block(function->declaration->body, &env);
+        if (completion == Completion::RETURN) {
+            return std::move(interpreter.return_value_);
+        }
+        if (completion != Completion::TAIL_CALL) {
+            return {};
+        }
+
+        const auto &next = interpreter.tail_callee_.as_function();
+        interpreter.reuse_frame(
+            frame, std::max<std::size_t>(next.frame_size(), next.arity()));
+        callee = std::move(interpreter.tail_callee_);
+        function = &callee.as_function();
+    }
+}
+
+Value OpenUpvalues::capture(Value *slot) {
+    // 链表按地址从高到低排列, 找到第一个不高于slot的位置
+    Value *link = &head_;
+    while (!link->is_nil() && link->as_upvalue().location > slot) {
+        link = &link->as_upvalue().next;
+    }
+    if (!link->is_nil() && link->as_upvalue().location == slot) {
+        return *link;
+    }
+
+    Value upvalue{new Upvalue{slot}};
+    upvalue.as_upvalue().next = std::move(*link);
+    *link = upvalue;
+    return upvalue;
+}
+
+void OpenUpvalues::close(const Value *last) {
+    while (!head_.is_nil() && head_.as_upvalue().location >= last) {
+        Value upvalue = std::move(head_);
+        head_ = std::move(upvalue.as_upvalue().next);
+        upvalue.as_upvalue().close();
+    }
 }
 
 std::string NativeFunction::to_string() { return "<native fn>"; }
-std::any NativeFunction::call([[maybe_unused]] Interpreter &interpreter,
-                              std::vector<std::any> arguments) {
+Value NativeFunction::call([[maybe_unused]] Interpreter &interpreter,
+                           std::vector<Value> arguments) {
     return native_func(arguments);
 }
 
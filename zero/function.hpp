@@ -1,6 +1,7 @@
 #pragma once
 
-#include <any>
+#include "value.hpp"
+
 #include <functional>
 #include <string>
 #include <vector>
@@ -10,12 +11,20 @@ namespace zero {
 // 前置声明
 class Interpreter;
 class Function; // Statement
+namespace bytecode {
+class Chunk;
+} // namespace bytecode
+namespace flat {
+struct FunctionCode;
+} // namespace flat
+namespace closure {
+struct FunctionCode;
+} // namespace closure
 
 // 接口
-class Callable {
+class Callable : public Object {
 public:
-    virtual std::any call(Interpreter &interpreter,
-                          std::vector<std::any> arguments)
+    virtual Value call(Interpreter &interpreter, std::vector<Value> arguments)
         = 0;
     virtual std::string to_string() = 0;
 
@@ -23,37 +32,96 @@ public:
     virtual ~Callable() = default;
 };
 
+// 闭包捕获的变量
+// 变量所在的栈帧还存在时直接指向栈上的槽位, 栈帧退出时才把值搬到堆上
+class Upvalue : public Object {
+public:
+    explicit Upvalue(Value *slot) : location{slot} {}
+
+public:
+    Value &get() { return *location; }
+    void close() {
+        closed = std::move(*location);
+        location = &closed;
+    }
+
+public:
+    Value *location;
+    Value closed;
+    Value next; // 下一个仍然打开的捕获变量
+};
+
+// 仍然指向栈上槽位的捕获变量, 按槽位地址从高到低排列
+// 同一个槽位只对应一个Upvalue, 多个闭包共享对它的修改
+class OpenUpvalues {
+public:
+    Value capture(Value *slot);
+    // 关闭所有地址不低于last的捕获变量
+    void close(const Value *last);
+
+private:
+    Value head_;
+};
+
 // 普通函数
 class ZeroFunction : public Callable {
 public:
     explicit ZeroFunction(Function *declaration) : declaration{declaration} {};
+    // 字节码引擎使用, chunk为编译好的函数体
+    ZeroFunction(Function *declaration, const bytecode::Chunk *chunk)
+        : declaration{declaration}, chunk{chunk} {};
+    // 扁平语法树引擎使用, code为转换好的函数体
+    ZeroFunction(Function *declaration, const flat::FunctionCode *code)
+        : declaration{declaration}, code{code} {};
+    // 闭包编译引擎使用, compiled为编译好的函数体
+    ZeroFunction(Function *declaration, const closure::FunctionCode *compiled)
+        : declaration{declaration}, compiled{compiled} {};
 
 public:
     std::string to_string() override;
-    std::any call(Interpreter &interpreter,
-                  std::vector<std::any> arguments) override;
+    Value call(Interpreter &interpreter,
+               std::vector<Value> arguments) override;
+    // 参数已经按槽位存放在解释器栈上的frame中
+    // 函数有记忆表时先查表, 执行完再记录结果
+    // 开启JIT时调用次数足够多的函数编译成机器码执行
+    Value call(Interpreter &interpreter, Value *frame);
+
+    std::size_t arity() const;
+    // 栈帧需要的槽位数
+    unsigned int frame_size() const;
+    auto get_chunk() const { return chunk; }
+    auto get_code() const { return code; }
+    auto get_compiled() const { return compiled; }
+    auto get_declaration() const { return declaration; }
+
+    // 闭包按Function::captures的顺序捕获变量
+    void add_upvalue(Value upvalue) { upvalues.push_back(std::move(upvalue)); }
+    const Value *get_upvalues() const { return upvalues.data(); }
+
+private:
+    // 执行函数体
+    Value execute(Interpreter &interpreter, Value *frame);
 
 private:
     Function *declaration;
-    // Environment *closure;
+    const bytecode::Chunk *chunk{};
+    const flat::FunctionCode *code{};
+    const closure::FunctionCode *compiled{};
+    std::vector<Value> upvalues; // 只保存被捕获的变量, 而不是整个外层环境
+    unsigned int calls{0}; // 调用次数, 达到jit::HOT_THRESHOLD后不再增加
 };
 
 // 原生函数
-using NativeFuncType = std::function<std::any(const std::vector<std::any> &)>;
+using NativeFuncType = std::function<Value(const std::vector<Value> &)>;
 class NativeFunction : public Callable {
 public:
     explicit NativeFunction(NativeFuncType native_func)
         : native_func{std::move(native_func)} {}
     std::string to_string() override;
-    std::any call(Interpreter &interpreter,
-                  std::vector<std::any> arguments) override;
+    Value call(Interpreter &interpreter,
+               std::vector<Value> arguments) override;
 
 private:
     NativeFuncType native_func;
 };
-
-class ZeroReturn {
-public:
-    const std::any value;
-};
 } // namespace zero
@@ -1,11 +1,13 @@
 #include "interpreter.hpp"
 
+#include "numeric.hpp"
+
 #include "fmt/core.h"
 #include "function.hpp"
 #include "parser.hpp"
 #include "token.hpp"
 
-#include <any>
+#include <algorithm>
 #include <cassert>
 #include <ctime>
 #include <iostream>
@@ -21,12 +23,69 @@ void Interpreter::interpret(const std::unique_ptr<Program> &program) {
     }
 }
 
-std::any Interpreter::evaluate(Expr &expr) { return expr.accept(*this); }
+unsigned int Interpreter::declare_global(symbol_id name) {
+    auto num_slots = static_cast<unsigned int>(global_slots_.size());
+    auto slot = global_slots_.emplace(name, num_slots).first->second;
+    globals_->resize(slot + 1);
+    reserved_globals_.erase(name);
+
+    return slot;
+}
+
+std::optional<unsigned int>
+Interpreter::lookup_global(symbol_id name) const {
+    auto found = global_slots_.find(name);
+    if (found == global_slots_.end() || reserved_globals_.count(name) != 0) {
+        return std::nullopt;
+    }
+
+    return found->second;
+}
+
+unsigned int Interpreter::reserve_global(symbol_id name) {
+    auto num_slots = static_cast<unsigned int>(global_slots_.size());
+    auto [found, inserted] = global_slots_.emplace(name, num_slots);
+    if (inserted) {
+        globals_->resize(num_slots + 1);
+        reserved_globals_.insert(name);
+    }
+
+    return found->second;
+}
+
+void Interpreter::checkpoint_globals() {
+    checkpoint_num_globals_ = num_globals();
+    checkpoint_reserved_ = reserved_globals_;
+}
+
+void Interpreter::rollback_globals() {
+    // 槽位是连续分配的, 删除之后新增的变量, 后面声明的变量重新使用这些槽位
+    for (auto it = global_slots_.begin(); it != global_slots_.end();) {
+        if (it->second >= checkpoint_num_globals_) {
+            it = global_slots_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    reserved_globals_ = checkpoint_reserved_;
+}
+
+std::vector<symbol_id> Interpreter::global_names() const {
+    std::vector<symbol_id> names(global_slots_.size());
+    for (const auto &[name, slot] : global_slots_) {
+        names[slot] = name;
+    }
+
+    return names;
+}
 
-void Interpreter::execute(Stmt &stmt) { stmt.accept(*this); }
+Value Interpreter::evaluate(Expr &expr) { return expr.accept(*this); }
 
-void Interpreter::execute_block(const std::vector<std::unique_ptr<Stmt>> &stmts,
-                                Environment *env) {
+Completion Interpreter::execute(Stmt &stmt) { return stmt.accept(*this); }
+
+Completion
+Interpreter::execute_block(const std::vector<std::unique_ptr<Stmt>> &stmts,
+                           Environment *env) {
     // expect(this->environment != nullptr);
     // expect(env != nullptr);
     // 保存Env
@@ -46,7 +105,10 @@ void Interpreter::execute_block(const std::vector<std::unique_ptr<Stmt>> &stmts,
     // 在新环境中执行, 执行完后, 恢复之前的环境
     EnviromentGuard guard{this, env};
     for (const auto &stmt : stmts) {
-        execute(*stmt);
+        auto completion = execute(*stmt);
+        if (completion != Completion::NORMAL) {
+            return completion;
+        }
     }
 
     // 恢复Env
@@ -56,50 +118,241 @@ void Interpreter::execute_block(const std::vector<std::unique_ptr<Stmt>> &stmts,
     // expect(env != nullptr);
     // 出block前, 将之前的env恢复 (按照出栈来理解)
     // this->environment = this->environment->get_enclosing();
+    return Completion::NORMAL;
+}
+
+namespace {
+// 按第一次执行时的操作数类型选择特化的节点
+binary_node specialize(token_type op, const Value &left, const Value &right) {
+    if (left.is_int() && right.is_int()) {
+        switch (op) {
+            case token_type::PLUS:
+                return binary_node::INT_ADD;
+            case token_type::MINUS:
+                return binary_node::INT_SUBTRACT;
+            case token_type::STAR:
+                return binary_node::INT_MULTIPLY;
+            case token_type::EQUAL_EQUAL:
+                return binary_node::INT_EQUAL;
+            case token_type::NOT_EQUAL:
+                return binary_node::INT_NOT_EQUAL;
+            case token_type::LESS:
+                return binary_node::INT_LESS;
+            case token_type::LESS_EQUAL:
+                return binary_node::INT_LESS_EQUAL;
+            case token_type::GREATER:
+                return binary_node::INT_GREATER;
+            case token_type::GREATER_EQUAL:
+                return binary_node::INT_GREATER_EQUAL;
+            default:
+                // 整数除法需要检查除数
+                return binary_node::GENERIC;
+        }
+    }
+    if (left.is_double() && right.is_double()) {
+        switch (op) {
+            case token_type::PLUS:
+                return binary_node::DOUBLE_ADD;
+            case token_type::MINUS:
+                return binary_node::DOUBLE_SUBTRACT;
+            case token_type::STAR:
+                return binary_node::DOUBLE_MULTIPLY;
+            case token_type::SLASH:
+                return binary_node::DOUBLE_DIVIDE;
+            case token_type::LESS:
+                return binary_node::DOUBLE_LESS;
+            case token_type::LESS_EQUAL:
+                return binary_node::DOUBLE_LESS_EQUAL;
+            case token_type::GREATER:
+                return binary_node::DOUBLE_GREATER;
+            case token_type::GREATER_EQUAL:
+                return binary_node::DOUBLE_GREATER_EQUAL;
+            default:
+                return binary_node::GENERIC;
+        }
+    }
+    if (left.is_string() && right.is_string() && op == token_type::PLUS) {
+        return binary_node::STRING_CONCAT;
+    }
+    return binary_node::GENERIC;
 }
 
-std::any Interpreter::visit_binary_expr(Binary *expr) {
-    std::any left = evaluate(*expr->left);
-    std::any right = evaluate(*expr->right);
+// 操作数类型是否与节点特化时相同, 未执行过和通用的节点返回false
+inline bool guard(binary_node node, const Value &left, const Value &right) {
+    if (node >= binary_node::INT_ADD
+        && node <= binary_node::INT_GREATER_EQUAL) {
+        return left.is_int() && right.is_int();
+    }
+    if (node >= binary_node::DOUBLE_ADD
+        && node <= binary_node::DOUBLE_GREATER_EQUAL) {
+        return left.is_double() && right.is_double();
+    }
+    if (node == binary_node::STRING_CONCAT) {
+        return left.is_string() && right.is_string();
+    }
+    return false;
+}
 
-    switch (expr->op.type) {
+// 执行特化的节点, 调用者先检查守卫
+inline Value execute_specialized(binary_node node,
+                                 const Value &left,
+                                 const Value &right) {
+    int64_t result;
+    switch (node) {
+        // 溢出时与通用的节点一样转换为浮点数, 不需要改写节点
+        case binary_node::INT_ADD:
+            if (add_overflow(left.as_int(), right.as_int(), &result)) {
+                return add_numbers(left, right);
+            }
+            return result;
+        case binary_node::INT_SUBTRACT:
+            if (subtract_overflow(left.as_int(), right.as_int(), &result)) {
+                return subtract_numbers(left, right);
+            }
+            return result;
+        case binary_node::INT_MULTIPLY:
+            if (multiply_overflow(left.as_int(), right.as_int(), &result)) {
+                return multiply_numbers(left, right);
+            }
+            return result;
+        case binary_node::INT_EQUAL:
+            return left.as_int() == right.as_int();
+        case binary_node::INT_NOT_EQUAL:
+            return left.as_int() != right.as_int();
+        case binary_node::INT_LESS:
+            return left.as_int() < right.as_int();
+        case binary_node::INT_LESS_EQUAL:
+            return left.as_int() <= right.as_int();
+        case binary_node::INT_GREATER:
+            return left.as_int() > right.as_int();
+        case binary_node::INT_GREATER_EQUAL:
+            return left.as_int() >= right.as_int();
+        case binary_node::DOUBLE_ADD:
+            return left.as_double() + right.as_double();
+        case binary_node::DOUBLE_SUBTRACT:
+            return left.as_double() - right.as_double();
+        case binary_node::DOUBLE_MULTIPLY:
+            return left.as_double() * right.as_double();
+        case binary_node::DOUBLE_DIVIDE:
+            return left.as_double() / right.as_double();
+        case binary_node::DOUBLE_LESS:
+            return left.as_double() < right.as_double();
+        case binary_node::DOUBLE_LESS_EQUAL:
+            return left.as_double() <= right.as_double();
+        case binary_node::DOUBLE_GREATER:
+            return left.as_double() > right.as_double();
+        case binary_node::DOUBLE_GREATER_EQUAL:
+            return left.as_double() >= right.as_double();
+        default:
+            return concat(left, right);
+    }
+}
+
+// 第一次执行时改写成特化的节点, 守卫失败后改写成通用的节点
+inline void rewrite(binary_node &node,
+                    token_type op,
+                    const Value &left,
+                    const Value &right) {
+    node = node == binary_node::UNINITIALIZED ? specialize(op, left, right)
+                                              : binary_node::GENERIC;
+}
+
+// 操作数的种类在Resolver之后不再变化, 第一次执行时确定
+operand_node classify(const Expr &expr) {
+    if (const auto *variable = dynamic_cast<const Variable *>(&expr)) {
+        return variable->depth == LOCAL_DEPTH ? operand_node::LOCAL
+                                              : operand_node::EXPR;
+    }
+    if (dynamic_cast<const Literal *>(&expr) != nullptr) {
+        return operand_node::CONSTANT;
+    }
+    return operand_node::EXPR;
+}
+} // namespace
+
+const Value *Interpreter::peek(const Expr &expr, operand_node operand) {
+    switch (operand) {
+        case operand_node::LOCAL:
+            return &environment_->get(static_cast<const Variable &>(expr).slot);
+        case operand_node::CONSTANT:
+            return &static_cast<const Literal &>(expr).value;
+        default:
+            return nullptr;
+    }
+}
+
+Value Interpreter::visit_binary_expr(Binary *expr) {
+    if (expr->node == binary_node::UNINITIALIZED) {
+        expr->left_operand = classify(*expr->left);
+        expr->right_operand = classify(*expr->right);
+    }
+
+    // 右操作数的求值没有副作用时左操作数才能直接读取,
+    // 否则右操作数可能修改左边的变量
+    Value left_value;
+    Value right_value;
+    const Value *left = expr->right_operand == operand_node::EXPR
+                            ? nullptr
+                            : peek(*expr->left, expr->left_operand);
+    if (left == nullptr) {
+        left_value = evaluate(*expr->left);
+        left = &left_value;
+    }
+    const Value *right = peek(*expr->right, expr->right_operand);
+    if (right == nullptr) {
+        right_value = evaluate(*expr->right);
+        right = &right_value;
+    }
+
+    if (guard(expr->node, *left, *right)) {
+        return execute_specialized(expr->node, *left, *right);
+    }
+    rewrite(expr->node, expr->op.type, *left, *right);
+    return binary(expr->op, *left, *right);
+}
+
+Value Interpreter::binary(const Token &op,
+                          const Value &left,
+                          const Value &right) {
+    switch (op.type) {
         case token_type::NOT_EQUAL:
             return !is_equal(left, right);
         case token_type::EQUAL_EQUAL:
             return is_equal(left, right);
         case token_type::GREATER:
-            check_number_operands(expr->op, left, right);
-            return std::any_cast<int>(left) > std::any_cast<int>(right);
+            check_number_operands(op, left, right);
+            return greater_numbers(left, right);
         case token_type::GREATER_EQUAL:
-            check_number_operands(expr->op, left, right);
-            return std::any_cast<int>(left) >= std::any_cast<int>(right);
+            check_number_operands(op, left, right);
+            return greater_equal_numbers(left, right);
         case token_type::LESS:
-            check_number_operands(expr->op, left, right);
-            return std::any_cast<int>(left) < std::any_cast<int>(right);
+            check_number_operands(op, left, right);
+            return less_numbers(left, right);
         case token_type::LESS_EQUAL:
-            check_number_operands(expr->op, left, right);
-            return std::any_cast<int>(left) <= std::any_cast<int>(right);
+            check_number_operands(op, left, right);
+            return less_equal_numbers(left, right);
         case token_type::MINUS:
-            check_number_operands(expr->op, left, right);
-            return std::any_cast<int>(left) - std::any_cast<int>(right);
+            check_number_operands(op, left, right);
+            return subtract_numbers(left, right);
         case token_type::PLUS:
-            if (left.type() == typeid(int) && right.type() == typeid(int)) {
-                return std::any_cast<int>(left) + std::any_cast<int>(right);
+            if (is_number(left) && is_number(right)) {
+                return add_numbers(left, right);
             }
-            if (left.type() == typeid(std::string)
-                && right.type() == typeid(std::string)) {
-                return std::any_cast<std::string>(left)
-                       + std::any_cast<std::string>(right);
+            if (left.is_string() && right.is_string()) {
+                return concat(left, right);
             }
 
-            throw RuntimeError(expr->op,
+            throw RuntimeError(op,
                                "Operands must be two numbers or two strings.");
         case token_type::SLASH:
-            check_number_operands(expr->op, left, right);
-            return std::any_cast<int>(left) / std::any_cast<int>(right);
+            check_number_operands(op, left, right);
+            if (is_integer_division_by_zero(left, right)) {
+                throw RuntimeError(op, "Division by zero.");
+            }
+            return divide_numbers(left, right);
         case token_type::STAR:
-            check_number_operands(expr->op, left, right);
-            return std::any_cast<int>(left) * std::any_cast<int>(right);
+            check_number_operands(op, left, right);
+            return multiply_numbers(left, right);
         default:
             break;
     }
@@ -107,13 +360,13 @@ std::any Interpreter::visit_binary_expr(Binary *expr) {
     return {};
 }
 
-std::any Interpreter::visit_grouping_expr(Grouping *expr) {
+Value Interpreter::visit_grouping_expr(Grouping *expr) {
     return evaluate(*expr->expr);
 }
 
-std::any Interpreter::visit_literal_expr(Literal *expr) { return expr->value; }
+Value Interpreter::visit_literal_expr(Literal *expr) { return expr->value; }
 
-std::any Interpreter::visit_logical_expr(Logical *expr) {
+Value Interpreter::visit_logical_expr(Logical *expr) {
     auto left = evaluate(*expr->left);
 
     if (expr->op.type == token_type::OR) {
@@ -129,15 +382,15 @@ std::any Interpreter::visit_logical_expr(Logical *expr) {
     return evaluate(*expr->right);
 }
 
-std::any Interpreter::visit_unary_expr(Unary *expr) {
-    std::any right = evaluate(*expr->right);
+Value Interpreter::visit_unary_expr(Unary *expr) {
+    Value right = evaluate(*expr->right);
 
     switch (expr->op.type) {
         case token_type::NOT:
             return !is_truthy(right);
         case token_type::MINUS:
             check_number_operand(expr->op, right);
-            return -std::any_cast<int>(right);
+            return negate_number(right);
         default:
             break;
     }
@@ -145,218 +398,365 @@ std::any Interpreter::visit_unary_expr(Unary *expr) {
     return {};
 }
 
-std::any Interpreter::visit_variable_expr(Variable *expr) {
-    return environment_->get(expr->name);
+Value Interpreter::visit_variable_expr(Variable *expr) {
+    return lookup_variable(expr->depth, expr->slot);
 }
 
-std::any Interpreter::visit_assign_expr(Assign *expr) {
-    std::any value = evaluate(*expr->value);
-    environment_->assign(expr->name, value);
+Value Interpreter::visit_assign_expr(Assign *expr) {
+    Value value = evaluate(*expr->value);
+    lookup_variable(expr->depth, expr->slot) = value;
 
     return value;
 }
 
-std::any Interpreter::visit_call_expr(Call *expr) {
-    std::any callee = evaluate(*expr->callee);
-    std::vector<std::any> arguments;
-    // for (const auto &argument : expr->arguments) {
-    //     arguments.push_back(evaluate(argument));
-    // }
+Value Interpreter::visit_call_expr(Call *expr) {
+    Value callee = evaluate(*expr->callee);
     auto num_arguments = expr->arguments.size();
-    arguments.resize(num_arguments);
+
+    if (callee.is_function()) {
+        auto &function = callee.as_function();
+        // 参数直接求值到新栈帧对应的槽位中
+        auto size = std::max<std::size_t>(function.frame_size(), num_arguments);
+        FrameGuard frame{this, size, expr->paren};
+        for (auto i = 0u; i < num_arguments; i++) {
+            frame.slots()[i] = evaluate(*expr->arguments[i]);
+        }
+        if (num_arguments != function.arity()) {
+            throw RuntimeError(expr->paren,
+                               fmt::format("Expected {} arguments but got {}.",
+                                           function.arity(),
+                                           num_arguments));
+        }
+        return function.call(*this, frame.slots());
+    }
+
+    std::vector<Value> arguments(num_arguments);
     for (auto i = 0u; i < num_arguments; i++) {
         arguments[i] = evaluate(*expr->arguments[i]);
     }
 
-    if (callee.type() == typeid(ZeroFunction)) {
-        auto function = std::any_cast<ZeroFunction>(callee);
-        return function.call(*this, std::move(arguments));
+    if (callee.is_native_function()) {
+        return callee.as_native_function().call(*this, std::move(arguments));
     }
+    throw RuntimeError(expr->paren, "Can only call functions and classes.");
+}
 
-    if (callee.type() == typeid(NativeFunction)) {
-        auto function = std::any_cast<NativeFunction>(callee);
-        return function.call(*this, std::move(arguments));
+Value Interpreter::visit_inline_call_expr(InlineCall *expr) {
+    const auto *callee = static_cast<const Variable *>(expr->call->callee.get());
+    const auto &function = globals_->get(callee->slot);
+    if (!function.is_function()
+        || function.as_function().get_declaration() != expr->function) {
+        return evaluate(*expr->call);
     }
-    // TODO
-    throw RuntimeError(Token{token_type::FN, {}, "fn", 0},
-                       "Can only call functions and classes.");
+
+    // 参数求值到新栈帧中, 然后在只包含参数的环境中对返回表达式求值
+    FrameGuard frame{this, expr->num_slots, expr->call->paren};
+    for (auto i = 0u; i < expr->call->arguments.size(); i++) {
+        frame.slots()[i] = evaluate(*expr->call->arguments[i]);
+    }
+    auto env = Environment(frame.slots(), nullptr);
+    EnviromentGuard guard{this, &env};
+
+    return evaluate(*expr->body);
 }
 
-std::any Interpreter::visit_block_stmt(Block *stmt) {
-    // 进入block, 创建一个新的environment
-    // execute_block(stmt->statements, std::make_unique<Environment>());
-    // 进入block前, 创建一个新的env, 需要包含当前env (按照入栈理解)
-    auto env = Environment(environment_);
-    execute_block(stmt->statements, &env);
+Value Interpreter::visit_increment_expr(Increment *expr) {
+    // 直接在变量的槽位上计算, 不再经过Assign和Binary
+    Value &value = lookup_variable(expr->depth, expr->slot);
+    check_number_operand(expr->op, value);
+    value = add_numbers(value, expr->delta);
 
-    return {};
+    return value;
 }
 
-std::any Interpreter::visit_expression_stmt(Expression *stmt) {
+Value Interpreter::visit_compare_expr(Compare *expr) {
+    const Value &left
+        = lookup_variable(expr->variable->depth, expr->variable->slot);
+    Value right = evaluate(*expr->bound);
+
+    if (guard(expr->node, left, right)) {
+        return execute_specialized(expr->node, left, right);
+    }
+    rewrite(expr->node, expr->op.type, left, right);
+    return binary(expr->op, left, right);
+}
+
+Value Interpreter::visit_promote_expr(Promote *expr) {
+    return promote_number(evaluate(*expr->expr));
+}
+
+Value Interpreter::visit_increment_local_expr(IncrementLocal *expr) {
+    // 直接在变量的槽位上计算, 不再经过Assign, Binary和Variable
+    Value &value = environment_->get(expr->original->slot);
+    if (guard(expr->node, value, expr->constant)) {
+        value = execute_specialized(expr->node, value, expr->constant);
+    } else {
+        rewrite(expr->node, expr->op.type, value, expr->constant);
+        value = binary(expr->op, value, expr->constant);
+    }
+
+    return value;
+}
+
+bool Interpreter::compare(LocalComparison &comparison) {
+    const Value &left = environment_->get(comparison.slot);
+    const Value &right = comparison.right == operand_node::LOCAL
+                             ? environment_->get(comparison.right_slot)
+                             : comparison.constant;
+    if (guard(comparison.node, left, right)) {
+        return is_truthy(execute_specialized(comparison.node, left, right));
+    }
+    rewrite(comparison.node, comparison.op.type, left, right);
+    return is_truthy(binary(comparison.op, left, right));
+}
+
+Completion Interpreter::visit_block_stmt(Block *stmt) {
+    // 块中的变量位于所在函数的栈帧中, 直接在当前环境执行
+    if (stmt->num_slots == 0) {
+        auto completion = Completion::NORMAL;
+        for (const auto &s : stmt->statements) {
+            completion = execute(*s);
+            if (completion != Completion::NORMAL) {
+                break;
+            }
+        }
+        // 槽位会被后面的块复用, 被捕获的变量需要搬到堆上
+        // 抛出异常时由函数栈帧统一关闭
+        if (stmt->has_captured) {
+            open_upvalues_.close(&environment_->get(stmt->first_slot));
+        }
+        return completion;
+    }
+
+    // 不在函数中的块使用自己的栈帧
+    FrameGuard frame{this, stmt->num_slots, Token{token_type::END, "", 0}};
+    auto env = Environment(frame.slots(), nullptr);
+    return execute_block(stmt->statements, &env);
+}
+
+Completion Interpreter::visit_expression_stmt(Expression *stmt) {
     evaluate(*stmt->expression);
 
-    return {};
+    return Completion::NORMAL;
 }
 
-// std::any Interpreter::visit_print_stmt(Print *stmt) {
-//     std::any value = evaluate(*stmt->expression);
+// Completion Interpreter::visit_print_stmt(Print *stmt) {
+//     Value value = evaluate(*stmt->expression);
 //     fmt::println("{}", stringify(value));
 //
 //     return {};
 // }
 
-std::any Interpreter::visit_var_stmt(Var *stmt) {
-    std::any value = nullptr;
+Completion Interpreter::visit_var_stmt(Var *stmt) {
+    Value value = nullptr;
     if (stmt->initializer != nullptr) {
         value = evaluate(*stmt->initializer);
     }
 
-    environment_->define(stmt->name.lexeme, std::move(value));
+    define_variable(stmt->depth, stmt->slot, std::move(value));
 
-    return {};
+    return Completion::NORMAL;
 }
 
-std::any Interpreter::visit_if_stmt(If *stmt) {
+Completion Interpreter::visit_if_stmt(If *stmt) {
     if (is_truthy(evaluate(*stmt->condition))) {
-        execute(*stmt->then_branch);
-    } else if (stmt->else_branch != nullptr) {
-        execute(*stmt->else_branch);
+        return execute(*stmt->then_branch);
+    }
+    if (stmt->else_branch != nullptr) {
+        return execute(*stmt->else_branch);
     }
 
-    return {};
+    return Completion::NORMAL;
 }
 
-std::any Interpreter::visit_while_stmt(While *stmt) {
+Completion Interpreter::visit_while_stmt(While *stmt) {
     while (is_truthy(evaluate(*stmt->condition))) {
-        execute(*stmt->body);
+        auto completion = execute(*stmt->body);
+        if (completion != Completion::NORMAL) {
+            return completion;
+        }
     }
 
-    return {};
+    return Completion::NORMAL;
 }
 
-std::any Interpreter::visit_function_stmt(Function *stmt) {
-    auto function = ZeroFunction(stmt);
-    // NOTE: 转std::any需要这个类型有拷贝构造函数
-    environment_->define(stmt->name.lexeme, function);
+Completion Interpreter::visit_if_compare_stmt(IfCompare *stmt) {
+    if (compare(stmt->condition)) {
+        return execute(*stmt->original->then_branch);
+    }
+    if (stmt->original->else_branch != nullptr) {
+        return execute(*stmt->original->else_branch);
+    }
 
-    return {};
+    return Completion::NORMAL;
 }
 
-std::any Interpreter::visit_return_stmt(Return *stmt) {
-    std::any value = nullptr;
-    if (stmt->value != nullptr) {
-        value = evaluate(*stmt->value);
+Completion Interpreter::visit_while_compare_stmt(WhileCompare *stmt) {
+    auto &body = *stmt->original->body;
+    while (compare(stmt->condition)) {
+        auto completion = execute(body);
+        if (completion != Completion::NORMAL) {
+            return completion;
+        }
     }
 
-    // 使用异常-捕获的方式通知函数返回
-    // FIXME: 更好的方式?
-    throw ZeroReturn{value};
+    return Completion::NORMAL;
 }
 
-void Interpreter::check_number_operand(const Token &op,
-                                       const std::any &operand) {
-    if (operand.type() == typeid(int)) {
-        return;
+Completion Interpreter::visit_return_if_stmt(ReturnIf *stmt) {
+    if (!compare(stmt->condition)) {
+        return Completion::NORMAL;
     }
-    throw RuntimeError(op, "Operand must be a number.");
+    return visit_return_stmt(stmt->result);
 }
 
-void Interpreter::check_number_operands(const Token &op,
-                                        const std::any &left,
-                                        const std::any &right) {
-    if (left.type() == typeid(int) && right.type() == typeid(int)) {
-        return;
+Completion Interpreter::visit_function_stmt(Function *stmt) {
+    auto function = ZeroFunction(stmt);
+    for (const auto &capture : stmt->captures) {
+        function.add_upvalue(
+            capture.is_local
+                ? open_upvalues_.capture(&environment_->get(capture.index))
+                : environment_->upvalue(capture.index));
     }
+    define_variable(stmt->depth, stmt->slot, std::move(function));
 
-    throw RuntimeError(op, "Operands must be numbers.");
+    return Completion::NORMAL;
 }
 
-bool Interpreter::is_truthy(const std::any &object) {
-    if (object.type() == typeid(nullptr)) {
-        return false;
+Completion Interpreter::visit_return_stmt(Return *stmt) {
+    if (stmt->tail_call) {
+        auto &call = static_cast<Call &>(*stmt->value);
+        Value callee = evaluate(*call.callee);
+        if (callee.is_function()) {
+            return tail_call(call, std::move(callee));
+        }
     }
-    if (object.type() == typeid(bool)) {
-        return std::any_cast<bool>(object);
+
+    Value value = nullptr;
+    if (stmt->value != nullptr) {
+        value = evaluate(*stmt->value);
     }
 
-    return true;
+    // 返回值暂存在解释器中, 通过Completion::RETURN逐层通知到函数调用处
+    return_value_ = std::move(value);
+    return Completion::RETURN;
 }
 
-bool Interpreter::is_equal(const std::any &a, const std::any &b) {
-    if (a.type() == typeid(nullptr) && b.type() == typeid(nullptr)) {
-        return true;
-    }
-    if (a.type() == typeid(nullptr)) {
-        return false;
-    }
-    if (a.type() == typeid(std::string) && b.type() == typeid(std::string)) {
-        return std::any_cast<std::string>(a) == std::any_cast<std::string>(b);
+Completion Interpreter::tail_call(const Call &call, Value callee) {
+    // 参数依次求值到栈顶之上, 由ZeroFunction::call搬到当前栈帧的开头
+    // 求值出错时由外层函数的FrameGuard清理这些槽位
+    auto num_arguments = call.arguments.size();
+    if (num_arguments > static_cast<std::size_t>(
+            stack_.data() + STACK_MAX - stack_top_)) {
+        throw RuntimeError(call.paren, "Stack overflow.");
     }
-    if (a.type() == typeid(int) && b.type() == typeid(int)) {
-        return std::any_cast<int>(a) == std::any_cast<int>(b);
+    for (const auto &argument : call.arguments) {
+        Value value = evaluate(*argument);
+        *stack_top_++ = std::move(value);
     }
-    if (a.type() == typeid(bool) && b.type() == typeid(bool)) {
-        return std::any_cast<bool>(a) == std::any_cast<bool>(b);
+    auto &function = callee.as_function();
+    if (num_arguments != function.arity()) {
+        throw RuntimeError(call.paren,
+                           fmt::format("Expected {} arguments but got {}.",
+                                       function.arity(),
+                                       num_arguments));
     }
 
-    return false;
+    tail_callee_ = std::move(callee);
+    return Completion::TAIL_CALL;
 }
 
-std::string Interpreter::stringify(const std::any &object) {
-    if (object.type() == typeid(nullptr)) {
-        return "nil";
-    }
-    if (object.type() == typeid(int)) {
-        std::string text = std::to_string(std::any_cast<int>(object));
-        // if (text[text.length() - 2] == '.' && text[text.length() - 1] == '0')
-        // {
-        //     text = text.substr(0, text.length() - 2);
-        // }
+void Interpreter::reuse_frame(Value *frame, std::size_t frame_size) {
+    // 当前函数已经执行完, 栈帧中被捕获的变量先搬到堆上
+    open_upvalues_.close(frame);
 
-        return text;
+    auto num_arguments = tail_callee_.as_function().arity();
+    Value *arguments = stack_top_ - num_arguments;
+    std::move(arguments, stack_top_, frame);
+    for (Value *slot = frame + num_arguments; slot < stack_top_; slot++) {
+        *slot = nullptr;
     }
-    if (object.type() == typeid(double)) {
-        auto num = std::any_cast<double>(object);
-        return std::to_string(num);
+
+    auto available = static_cast<std::size_t>(
+        stack_.data() + STACK_MAX - frame);
+    if (frame_size > available) {
+        throw RuntimeError(tail_callee_.as_function().get_declaration()->name,
+                           "Stack overflow.");
     }
+    stack_top_ = frame + frame_size;
+}
 
-    if (object.type() == typeid(std::string)) {
-        return std::any_cast<std::string>(object);
+Value &Interpreter::lookup_variable(int depth, unsigned int slot) {
+    switch (depth) {
+        case GLOBAL_DEPTH:
+            return globals_->get(slot);
+        case UPVALUE_DEPTH:
+            return environment_->get_upvalue(slot);
+        case SELF_DEPTH:
+            return environment_->self();
+        default:
+            return environment_->get(slot);
     }
-    if (object.type() == typeid(bool)) {
-        return std::any_cast<bool>(object) ? "true" : "false";
+}
+
+void Interpreter::define_variable(int depth, unsigned int slot, Value value) {
+    // 声明语句只会定义全局变量或者当前栈帧中的变量
+    if (depth == GLOBAL_DEPTH) {
+        globals_->define(slot, std::move(value));
+    } else {
+        environment_->define(slot, std::move(value));
     }
-    if (object.type() == typeid(ZeroFunction)) {
-        return std::any_cast<ZeroFunction>(object).to_string();
+}
+
+void Interpreter::check_number_operand(const Token &op,
+                                       const Value &operand) {
+    if (is_number(operand)) {
+        return;
     }
-    if (object.type() == typeid(NativeFunction)) {
-        return std::any_cast<NativeFunction>(object).to_string();
+    throw RuntimeError(op, "Operand must be a number.");
+}
+
+void Interpreter::check_number_operands(const Token &op,
+                                        const Value &left,
+                                        const Value &right) {
+    if (is_number(left) && is_number(right)) {
+        return;
     }
 
-    return "Error in 'stringify': object type not supported.";
+    throw RuntimeError(op, "Operands must be numbers.");
 }
 
 // ---------------------------------------
 //            Native functions
 // ---------------------------------------
 
-void Interpreter::register_functions() {
-    globals_->define("print",
-                     NativeFunction{[](const std::vector<std::any> &arguments) {
-                         fmt::println("{}", stringify(arguments[0]));
-                         return 0;
-                     }});
-
-    globals_->define("clock",
-                     NativeFunction{[](const std::vector<std::any> &arguments) {
-                         assert(arguments.empty());
-                         std::time_t t = std::time(nullptr);
-                         return static_cast<double>(t);
-                     }});
-
+void Interpreter::define_native(const std::string &name,
+                                const NativeFunction &function) {
     globals_->define(
-        "read_file", NativeFunction{[](const std::vector<std::any> &arguments) {
-            auto file_path = std::any_cast<std::string>(arguments[0]);
+        declare_global(SymbolTable::instance().intern(name)), function);
+}
+
+void Interpreter::register_functions() {
+    define_native("print",
+                  NativeFunction{[](const std::vector<Value> &arguments) {
+                      fmt::println("{}", stringify(arguments[0]));
+                      return 0;
+                  }});
+
+    define_native("clock",
+                  NativeFunction{[](const std::vector<Value> &arguments) {
+                      assert(arguments.empty());
+                      std::time_t t = std::time(nullptr);
+                      return static_cast<double>(t);
+                  }});
+
+    define_native(
+        "read_file",
+        NativeFunction{[](const std::vector<Value> &arguments) -> Value {
+            if (!arguments[0].is_string()) {
+                return nullptr;
+            }
+            auto file_path = arguments[0].as_string();
             fmt::println("reading {} ...", file_path);
             // fake
             return std::string{"example text"};
@@ -3,10 +3,18 @@
 #include "ast/stmt.hpp"
 #include "environment.hpp"
 #include "function.hpp"
+#include "jit/code.hpp"
+#include "limits.hpp"
 #include "parser.hpp"
+#include "symbol.hpp"
+#include "utils/native_stack.hpp"
 #include "vm.hpp"
 
+#include <optional>
 #include <system_error>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 namespace zero {
 class VM;
@@ -22,7 +30,10 @@ class Interpreter : public ExprVisitor, public StmtVisitor {
     friend ZeroFunction;
 
 public:
-    Interpreter() {
+    // jit为真时调用次数足够多的函数编译成机器码执行
+    explicit Interpreter(VM *vm, bool jit = false)
+        : vm_{vm}, stack_(STACK_MAX), jit_enabled_{jit && jit::SUPPORTED} {
+        stack_top_ = stack_.data();
         globals_ = std::make_unique<Environment>();
         environment_
             = globals_.get(); // 初始化的时候, environment也就是globals环境
@@ -33,51 +44,131 @@ public:
 
 public:
     void interpret(const std::unique_ptr<Program> &program);
+
+    // 全局变量表, 由Resolver在解析时使用
+    // 声明一个全局变量, 返回它的槽位
+    unsigned int declare_global(symbol_id name);
+    // 查找已声明的全局变量
+    std::optional<unsigned int> lookup_global(symbol_id name) const;
+    // REPL中函数体引用了还没有声明的全局变量, 先为它保留槽位
+    // 之后输入的代码声明它之前, lookup_global找不到这个变量
+    unsigned int reserve_global(symbol_id name);
+    // 记录当前的全局变量, rollback_globals撤销之后的声明和保留
+    // 用于编译失败的代码, 它声明的全局变量不会被定义
+    void checkpoint_globals();
+    void rollback_globals();
+    // 已声明的全局变量个数
+    unsigned int num_globals() const {
+        return static_cast<unsigned int>(global_slots_.size());
+    }
+    // 按槽位排列的全局变量名
+    std::vector<symbol_id> global_names() const;
+    // 全局环境, 字节码虚拟机也使用这里的全局变量
+    auto get_globals() { return globals_.get(); };
+
     // Expr抽象类方法
-    std::any visit_binary_expr(Binary *expr) override;
-    std::any visit_grouping_expr(Grouping *expr) override;
-    std::any visit_literal_expr(Literal *expr) override;
-    std::any visit_logical_expr(Logical *expr) override;
-    std::any visit_unary_expr(Unary *expr) override;
-    std::any visit_variable_expr(Variable *expr) override;
-    std::any visit_assign_expr(Assign *expr) override;
-    std::any visit_call_expr(Call *expr) override;
+    Value visit_binary_expr(Binary *expr) override;
+    Value visit_grouping_expr(Grouping *expr) override;
+    Value visit_literal_expr(Literal *expr) override;
+    Value visit_logical_expr(Logical *expr) override;
+    Value visit_unary_expr(Unary *expr) override;
+    Value visit_variable_expr(Variable *expr) override;
+    Value visit_assign_expr(Assign *expr) override;
+    Value visit_call_expr(Call *expr) override;
+    Value visit_inline_call_expr(InlineCall *expr) override;
+    Value visit_increment_expr(Increment *expr) override;
+    Value visit_compare_expr(Compare *expr) override;
+    Value visit_promote_expr(Promote *expr) override;
+    Value visit_increment_local_expr(IncrementLocal *expr) override;
 
     // Stmt抽象类方法
-    std::any visit_block_stmt(Block *stmt) override;
-    std::any visit_expression_stmt(Expression *stmt) override;
-    // std::any visit_print_stmt(Print *stmt) override;
-    std::any visit_var_stmt(Var *stmt) override;
-    std::any visit_if_stmt(If *stmt) override;
-    std::any visit_while_stmt(While *stmt) override;
-    std::any visit_function_stmt(Function *stmt) override;
-    std::any visit_return_stmt(Return *stmt) override;
+    Completion visit_block_stmt(Block *stmt) override;
+    Completion visit_expression_stmt(Expression *stmt) override;
+    // Completion visit_print_stmt(Print *stmt) override;
+    Completion visit_var_stmt(Var *stmt) override;
+    Completion visit_if_stmt(If *stmt) override;
+    Completion visit_while_stmt(While *stmt) override;
+    Completion visit_function_stmt(Function *stmt) override;
+    Completion visit_return_stmt(Return *stmt) override;
+    Completion visit_if_compare_stmt(IfCompare *stmt) override;
+    Completion visit_while_compare_stmt(WhileCompare *stmt) override;
+    Completion visit_return_if_stmt(ReturnIf *stmt) override;
 
 private:
     // 表达式求值
-    std::any evaluate(Expr &expr);
+    Value evaluate(Expr &expr);
     // 执行语句
-    void execute(Stmt &stmt);
-    void execute_block(const std::vector<std::unique_ptr<Stmt>> &stmts,
-                       Environment *env);
+    Completion execute(Stmt &stmt);
+    Completion execute_block(const std::vector<std::unique_ptr<Stmt>> &stmts,
+                             Environment *env);
 
-    static void check_number_operand(const Token &op, const std::any &operand);
+    static void check_number_operand(const Token &op, const Value &operand);
     static void check_number_operands(const Token &op,
-                                      const std::any &left,
-                                      const std::any &right);
-    static bool is_truthy(const std::any &object);
-    static bool is_equal(const std::any &a, const std::any &b);
-    static std::string stringify(const std::any &object);
+                                      const Value &left,
+                                      const Value &right);
+    // 通用的二元运算, 按操作符分派并检查操作数类型
+    static Value binary(const Token &op, const Value &left, const Value &right);
+    // 直接读取局部变量或常量操作数, 其他表达式返回nullptr
+    const Value *peek(const Expr &expr, operand_node operand);
+    // 合并节点的条件
+    bool compare(LocalComparison &comparison);
+    // 尾调用: 参数求值到栈顶之上, 函数保存在tail_callee_中
+    Completion tail_call(const Call &call, Value callee);
+    // 由ZeroFunction::call调用, 把尾调用的参数搬到frame开头并调整栈帧大小
+    void reuse_frame(Value *frame, std::size_t frame_size);
+    // 根据Resolver计算的位置访问变量
+    Value &lookup_variable(int depth, unsigned int slot);
+    void define_variable(int depth, unsigned int slot, Value value);
+
 
     // helper function
-    auto get_globals() { return globals_.get(); };
+    void define_native(const std::string &name,
+                       const NativeFunction &function);
     void register_functions();
 
 private:
+    // 在解释器栈上分配一个栈帧, 离开作用域时清空并释放其中的槽位
+    class FrameGuard {
+    public:
+        FrameGuard(Interpreter *interpreter,
+                   std::size_t num_slots,
+                   const Token &token)
+            : interpreter{interpreter}, frame{interpreter->stack_top_} {
+            auto available = static_cast<std::size_t>(
+                interpreter->stack_.data() + STACK_MAX - frame);
+            if (num_slots > available
+                || interpreter->call_depth_ == MAX_CALL_DEPTH
+                || utils::native_stack_exhausted()) {
+                throw RuntimeError(token, "Stack overflow.");
+            }
+            interpreter->stack_top_ = frame + num_slots;
+            interpreter->call_depth_++;
+        }
+
+        ~FrameGuard() {
+            // 栈帧中被闭包捕获的变量搬到堆上
+            interpreter->open_upvalues_.close(frame);
+            for (Value *slot = frame; slot < interpreter->stack_top_; slot++) {
+                *slot = nullptr;
+            }
+            interpreter->stack_top_ = frame;
+            interpreter->call_depth_--;
+        }
+
+        FrameGuard(const FrameGuard &) = delete;
+        FrameGuard &operator=(const FrameGuard &) = delete;
+
+        Value *slots() const { return frame; }
+
+    private:
+        Interpreter *interpreter;
+        Value *frame;
+    };
+
     class EnviromentGuard {
     public:
         // This simulates "finally" keyword usage in executeBlock of Java
-        // version "execute" can throw "ReturnException" and we need to unwind
+        // version "execute" can throw "RuntimeError" and we need to unwind
         // the stack and return to previous enviroment on each scope exit
         EnviromentGuard(Interpreter *interpreter, Environment *new_env)
             : interpreter{interpreter}, previous{interpreter->environment_} {
@@ -94,9 +185,24 @@ private:
     };
 
 private:
+    static constexpr std::size_t STACK_MAX = 1 << 16;
+
     VM *vm_;
+    // 函数调用的栈帧依次分配在这里, 调用时不需要分配堆内存
+    std::vector<Value> stack_;
+    Value *stack_top_;
+    unsigned int call_depth_{0};
+    bool jit_enabled_{false};
+    OpenUpvalues open_upvalues_;
     Environment *environment_; // 解释器当前环境
     std::unique_ptr<Environment>
         globals_; // 解释器global环境, 初始化后指针不再改变
+    std::unordered_map<symbol_id, unsigned int> global_slots_; // 变量名 -> 槽位
+    std::unordered_set<symbol_id> reserved_globals_; // 保留了槽位, 还没有声明
+    // checkpoint_globals记录的全局变量个数和保留的变量
+    unsigned int checkpoint_num_globals_{0};
+    std::unordered_set<symbol_id> checkpoint_reserved_;
+    Value return_value_; // return语句的返回值, 由函数调用取走
+    Value tail_callee_;  // 尾调用的函数, 由函数调用取走
 };
 } // namespace zero
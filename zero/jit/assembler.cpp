@@ -0,0 +1,206 @@
+#include "assembler.hpp"
+
+#include <cassert>
+
+namespace zero::jit {
+
+namespace {
+constexpr uint8_t REX_W = 0x48;
+
+uint8_t modrm(uint8_t mod, uint8_t reg_field, uint8_t rm) {
+    return static_cast<uint8_t>(mod << 6 | reg_field << 3 | rm);
+}
+
+uint8_t code_of(reg r) { return static_cast<uint8_t>(r); }
+} // namespace
+
+Label Assembler::new_label() {
+    labels_.push_back(-1);
+    return Label{labels_.size() - 1};
+}
+
+void Assembler::bind(Label label) {
+    labels_[label.id] = static_cast<std::ptrdiff_t>(code_.size());
+}
+
+std::vector<uint8_t> Assembler::finish() {
+    for (const auto &fixup : fixups_) {
+        auto target = labels_[fixup.label];
+        assert(target >= 0 && "jump to unbound label");
+        // rel32相对于跳转指令的末尾
+        auto rel = static_cast<int32_t>(
+            target - static_cast<std::ptrdiff_t>(fixup.position + 4));
+        auto value = static_cast<uint32_t>(rel);
+        for (int i = 0; i < 4; i++) {
+            code_[fixup.position + i] = static_cast<uint8_t>(value >> (8 * i));
+        }
+    }
+    fixups_.clear();
+
+    return std::move(code_);
+}
+
+void Assembler::emit32(uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        emit(static_cast<uint8_t>(value >> (8 * i)));
+    }
+}
+
+void Assembler::emit64(uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+        emit(static_cast<uint8_t>(value >> (8 * i)));
+    }
+}
+
+void Assembler::memory(uint8_t opcode,
+                       uint8_t reg_field,
+                       reg base,
+                       int32_t offset) {
+    emit(opcode);
+    emit(modrm(0b10, reg_field, code_of(base)));
+    // 以rsp为基址时需要SIB字节
+    if (base == reg::RSP) {
+        emit(0x24);
+    }
+    emit32(static_cast<uint32_t>(offset));
+}
+
+void Assembler::registers(uint8_t opcode, reg reg_field, reg rm) {
+    emit(REX_W);
+    emit(opcode);
+    emit(modrm(0b11, code_of(reg_field), code_of(rm)));
+}
+
+void Assembler::push(reg r) { emit(0x50 + code_of(r)); }
+
+void Assembler::pop(reg r) { emit(0x58 + code_of(r)); }
+
+void Assembler::mov(reg dst, reg src) { registers(0x89, src, dst); }
+
+void Assembler::mov(reg dst, int64_t imm) {
+    if (imm >= 0 && imm <= UINT32_MAX) {
+        // 写32位寄存器时高32位清零
+        emit(0xb8 + code_of(dst));
+        emit32(static_cast<uint32_t>(imm));
+    } else if (imm >= INT32_MIN && imm <= INT32_MAX) {
+        emit(REX_W);
+        emit(0xc7);
+        emit(modrm(0b11, 0, code_of(dst)));
+        emit32(static_cast<uint32_t>(imm));
+    } else {
+        emit(REX_W);
+        emit(0xb8 + code_of(dst));
+        emit64(static_cast<uint64_t>(imm));
+    }
+}
+
+void Assembler::load(reg dst, reg base, int32_t offset) {
+    emit(REX_W);
+    memory(0x8b, code_of(dst), base, offset);
+}
+
+void Assembler::store(reg base, int32_t offset, reg src) {
+    emit(REX_W);
+    memory(0x89, code_of(src), base, offset);
+}
+
+void Assembler::store_byte(reg base, int32_t offset, uint8_t imm) {
+    memory(0xc6, 0, base, offset);
+    emit(imm);
+}
+
+void Assembler::compare_byte(reg base, int32_t offset, uint8_t imm) {
+    memory(0x80, 7, base, offset);
+    emit(imm);
+}
+
+void Assembler::add(reg dst, reg src) { registers(0x01, src, dst); }
+
+void Assembler::sub(reg dst, reg src) { registers(0x29, src, dst); }
+
+void Assembler::imul(reg dst, reg src) {
+    emit(REX_W);
+    emit(0x0f);
+    emit(0xaf);
+    emit(modrm(0b11, code_of(dst), code_of(src)));
+}
+
+void Assembler::cmp(reg a, reg b) { registers(0x39, b, a); }
+
+void Assembler::test(reg a, reg b) { registers(0x85, b, a); }
+
+void Assembler::neg(reg r) {
+    emit(REX_W);
+    emit(0xf7);
+    emit(modrm(0b11, 3, code_of(r)));
+}
+
+void Assembler::cqo() {
+    emit(REX_W);
+    emit(0x99);
+}
+
+void Assembler::idiv(reg r) {
+    emit(REX_W);
+    emit(0xf7);
+    emit(modrm(0b11, 7, code_of(r)));
+}
+
+void Assembler::add(reg dst, int32_t imm) {
+    emit(REX_W);
+    emit(0x81);
+    emit(modrm(0b11, 0, code_of(dst)));
+    emit32(static_cast<uint32_t>(imm));
+}
+
+void Assembler::sub(reg dst, int32_t imm) {
+    emit(REX_W);
+    emit(0x81);
+    emit(modrm(0b11, 5, code_of(dst)));
+    emit32(static_cast<uint32_t>(imm));
+}
+
+void Assembler::xor_al(uint8_t imm) {
+    emit(0x34);
+    emit(imm);
+}
+
+void Assembler::set(condition cc) {
+    // setcc al; movzx eax, al
+    emit(0x0f);
+    emit(0x90 + static_cast<uint8_t>(cc));
+    emit(0xc0);
+    emit(0x0f);
+    emit(0xb6);
+    emit(0xc0);
+}
+
+void Assembler::lea(reg dst, reg base, int32_t offset) {
+    emit(REX_W);
+    memory(0x8d, code_of(dst), base, offset);
+}
+
+void Assembler::jump_to(Label label) {
+    fixups_.push_back(Fixup{code_.size(), label.id});
+    emit32(0);
+}
+
+void Assembler::jmp(Label label) {
+    emit(0xe9);
+    jump_to(label);
+}
+
+void Assembler::jump_if(condition cc, Label label) {
+    emit(0x0f);
+    emit(0x80 + static_cast<uint8_t>(cc));
+    jump_to(label);
+}
+
+void Assembler::call(reg r) {
+    emit(0xff);
+    emit(modrm(0b11, 2, code_of(r)));
+}
+
+void Assembler::ret() { emit(0xc3); }
+
+} // namespace zero::jit
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace zero::jit {
+
+// 只用到的通用寄存器, 编号与x86-64指令编码一致, 不需要REX.B/REX.R
+enum class reg : uint8_t {
+    RAX = 0,
+    RCX = 1,
+    RDX = 2,
+    RBX = 3,
+    RSP = 4,
+    RBP = 5,
+    RSI = 6,
+    RDI = 7,
+};
+
+// 条件码, 用于jcc和setcc
+enum class condition : uint8_t {
+    OVERFLOW = 0x0,
+    EQUAL = 0x4,
+    NOT_EQUAL = 0x5,
+    LESS = 0xc,
+    GREATER_EQUAL = 0xd,
+    LESS_EQUAL = 0xe,
+    GREATER = 0xf,
+};
+
+// 跳转目标, 绑定之前的跳转在finish时回填
+struct Label {
+    std::size_t id;
+};
+
+// 生成x86-64机器码, 只包含基线编译器需要的指令
+class Assembler {
+public:
+    Label new_label();
+    void bind(Label label);
+    // 回填所有跳转, 返回生成的代码
+    std::vector<uint8_t> finish();
+
+    void push(reg r);
+    void pop(reg r);
+    void mov(reg dst, reg src);
+    void mov(reg dst, int64_t imm);
+    // 读写[base + offset]处的8字节
+    void load(reg dst, reg base, int32_t offset);
+    void store(reg base, int32_t offset, reg src);
+    // [base + offset]处的1字节
+    void store_byte(reg base, int32_t offset, uint8_t imm);
+    void compare_byte(reg base, int32_t offset, uint8_t imm);
+
+    void add(reg dst, reg src);
+    void sub(reg dst, reg src);
+    void imul(reg dst, reg src);
+    void cmp(reg a, reg b);
+    void test(reg a, reg b);
+    void neg(reg r);
+    // rdx:rax / r, 商在rax中
+    void cqo();
+    void idiv(reg r);
+    void add(reg dst, int32_t imm);
+    void sub(reg dst, int32_t imm);
+    void xor_al(uint8_t imm);
+    // rax = 条件成立 ? 1 : 0
+    void set(condition cc);
+    void lea(reg dst, reg base, int32_t offset);
+
+    void jmp(Label label);
+    void jump_if(condition cc, Label label);
+    void call(reg r);
+    void ret();
+
+private:
+    void emit(uint8_t byte) { code_.push_back(byte); }
+    void emit32(uint32_t value);
+    void emit64(uint64_t value);
+    // REX.W + opcode + ModRM(reg, [base + disp32])
+    void memory(uint8_t opcode, uint8_t reg_field, reg base, int32_t offset);
+    void registers(uint8_t opcode, reg reg_field, reg rm);
+    void jump_to(Label label);
+
+private:
+    struct Fixup {
+        std::size_t position; // rel32所在的位置
+        std::size_t label;
+    };
+
+    std::vector<uint8_t> code_;
+    std::vector<std::ptrdiff_t> labels_; // 未绑定时为-1
+    std::vector<Fixup> fixups_;
+};
+
+} // namespace zero::jit
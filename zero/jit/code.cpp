@@ -0,0 +1,122 @@
+#include "code.hpp"
+
+#include "ast/stmt.hpp"
+#include "compiler.hpp"
+#include "function.hpp"
+#include "limits.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__linux__)
+#    include <sys/mman.h>
+#endif
+
+namespace zero::jit {
+
+ExecutableMemory::ExecutableMemory(const std::vector<uint8_t> &code) {
+#if defined(__linux__)
+    // 先以可写方式映射并复制代码, 再改成只读可执行
+    auto size = code.size();
+    void *address = mmap(nullptr,
+                         size,
+                         PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS,
+                         -1,
+                         0);
+    if (address == MAP_FAILED) {
+        return;
+    }
+    std::memcpy(address, code.data(), size);
+    if (mprotect(address, size, PROT_READ | PROT_EXEC) != 0) {
+        munmap(address, size);
+        return;
+    }
+    address_ = address;
+    size_ = size;
+#else
+    static_cast<void>(code);
+#endif
+}
+
+ExecutableMemory::~ExecutableMemory() {
+#if defined(__linux__)
+    if (address_ != nullptr) {
+        munmap(address_, size_);
+    }
+#endif
+}
+
+JitFunction::JitFunction(const Function &declaration,
+                         const std::vector<uint8_t> &code,
+                         kind result)
+    : arity_{declaration.params.size()},
+      frame_size_{std::max<std::size_t>(declaration.num_slots, arity_)},
+      result_{result}, memory_{code},
+      entry_{reinterpret_cast<Entry>(
+          const_cast<void *>(memory_.address()))} {}
+
+bool JitFunction::call(const Value *arguments,
+                       Value *globals,
+                       std::size_t available,
+                       unsigned int depth,
+                       Value &result) const {
+    if (entry_ == nullptr || deoptimizations_ == MAX_DEOPTIMIZATIONS) {
+        return false;
+    }
+    // 参数个数由调用者检查过, 编译时保证不超过MAX_ARGUMENTS
+    int64_t values[MAX_ARGUMENTS];
+    for (std::size_t i = 0; i < arity_; i++) {
+        if (!arguments[i].is_int()) {
+            return false;
+        }
+        values[i] = arguments[i].as_int();
+    }
+
+    Context context{globals, available, depth, false};
+    auto value = entry_(&context, values);
+    if (context.deoptimize) {
+        deoptimizations_++;
+        return false;
+    }
+
+    if (result_ == kind::INT) {
+        result = value;
+    } else {
+        result = value != 0;
+    }
+    return true;
+}
+
+int64_t JitFunction::call_global(Context *context,
+                                 uint32_t slot,
+                                 const int64_t *arguments,
+                                 uint32_t num_arguments) {
+    // 被调用者必须是能编译的函数, 返回int, 参数个数正确
+    const auto &callee = context->globals[slot];
+    const JitFunction *function = nullptr;
+    if (callee.is_function()) {
+        auto &declaration = *callee.as_function().get_declaration();
+        if (declaration.params.size() == num_arguments) {
+            function = compile(declaration);
+        }
+    }
+    // 超过调用深度上限时退回解释器, 由它报告栈溢出
+    if (function == nullptr || function->entry_ == nullptr
+        || function->result_ != kind::INT
+        || context->depth == MAX_CALL_DEPTH
+        || function->frame_size_ > context->available) {
+        context->deoptimize = true;
+        return 0;
+    }
+
+    context->depth++;
+    context->available -= function->frame_size_;
+    auto result = function->entry_(context, arguments);
+    context->available += function->frame_size_;
+    context->depth--;
+
+    return result;
+}
+
+} // namespace zero::jit
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "value.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace zero {
+struct Function;
+} // namespace zero
+
+namespace zero::jit {
+
+// 生成的代码只在Linux x86-64上可以执行, 其他平台上不编译任何函数
+#if defined(__x86_64__) && defined(__linux__)
+constexpr bool SUPPORTED = true;
+#else
+constexpr bool SUPPORTED = false;
+#endif
+
+// 树遍历解释器执行一个函数的次数达到这个值后编译成机器码
+constexpr unsigned int HOT_THRESHOLD = 64;
+// 执行到一半退回解释器的次数达到这个值后不再执行机器码
+constexpr unsigned int MAX_DEOPTIMIZATIONS = 16;
+// 参数更多的函数不编译
+constexpr std::size_t MAX_ARGUMENTS = 16;
+
+// 机器码执行时的状态, 生成的代码通过rbx访问
+struct Context {
+    Value *globals;        // 查找被调用的全局函数
+    std::size_t available; // 解释器栈上剩余的槽位数, 用于保持栈溢出的行为
+    unsigned int depth;    // 包括解释器中的调用深度
+    bool deoptimize;       // 需要退回解释器重新执行整个调用
+};
+
+// 参数按槽位顺序存放, 返回值是int64_t或者0/1
+using Entry = int64_t (*)(Context *context, const int64_t *arguments);
+
+// 返回值的类型, 在编译时确定
+enum class kind : uint8_t {
+    INT,
+    BOOL,
+};
+
+// 通过mmap分配的可执行内存
+class ExecutableMemory {
+public:
+    explicit ExecutableMemory(const std::vector<uint8_t> &code);
+    ~ExecutableMemory();
+
+    ExecutableMemory(const ExecutableMemory &) = delete;
+    ExecutableMemory &operator=(const ExecutableMemory &) = delete;
+
+    // 分配失败时返回nullptr
+    const void *address() const { return address_; }
+
+private:
+    void *address_{nullptr};
+    std::size_t size_{0};
+};
+
+// 编译成机器码的函数, 参数都是int, 只做整数和bool运算
+// 运算溢出, 除以0, 参数或者被调用者不满足假设时设置Context::deoptimize,
+// 编译的函数没有副作用, 由解释器重新执行整个调用是安全的
+class JitFunction {
+public:
+    JitFunction(const Function &declaration,
+                const std::vector<uint8_t> &code,
+                kind result);
+
+public:
+    // 参数都是int时执行机器码, 结果保存到result中
+    // 需要退回解释器时返回false
+    bool call(const Value *arguments,
+              Value *globals,
+              std::size_t available,
+              unsigned int depth,
+              Value &result) const;
+
+    // 由生成的代码调用globals[slot]中的函数, 参数按顺序存放在arguments中
+    static int64_t call_global(Context *context,
+                               uint32_t slot,
+                               const int64_t *arguments,
+                               uint32_t num_arguments);
+
+private:
+    std::size_t arity_;
+    std::size_t frame_size_;
+    kind result_;
+    ExecutableMemory memory_;
+    Entry entry_;
+    mutable unsigned int deoptimizations_{0};
+};
+
+} // namespace zero::jit
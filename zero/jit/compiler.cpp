@@ -0,0 +1,500 @@
+#include "compiler.hpp"
+
+#include <algorithm>
+#include <cstddef>
+
+namespace zero::jit {
+
+namespace {
+bool is_comparison(token_type op) {
+    return op == token_type::EQUAL_EQUAL || op == token_type::NOT_EQUAL
+        || op == token_type::LESS || op == token_type::LESS_EQUAL
+        || op == token_type::GREATER || op == token_type::GREATER_EQUAL;
+}
+
+condition condition_of(token_type op) {
+    switch (op) {
+        case token_type::EQUAL_EQUAL:
+            return condition::EQUAL;
+        case token_type::NOT_EQUAL:
+            return condition::NOT_EQUAL;
+        case token_type::LESS:
+            return condition::LESS;
+        case token_type::LESS_EQUAL:
+            return condition::LESS_EQUAL;
+        case token_type::GREATER:
+            return condition::GREATER;
+        default:
+            return condition::GREATER_EQUAL;
+    }
+}
+
+// 条件码的最低位取反得到相反的条件
+condition negate(condition cc) {
+    return static_cast<condition>(static_cast<uint8_t>(cc) ^ 1);
+}
+
+bool fits_int32(int64_t value) {
+    return value >= INT32_MIN && value <= INT32_MAX;
+}
+
+// 括号只影响解析
+Expr &unwrap(Expr &expr) {
+    Expr *inner = &expr;
+    while (auto *grouping = dynamic_cast<Grouping *>(inner)) {
+        inner = grouping->expr.get();
+    }
+    return *inner;
+}
+
+constexpr auto DEOPTIMIZE_OFFSET
+    = static_cast<int32_t>(offsetof(Context, deoptimize));
+} // namespace
+
+const JitFunction *compile(Function &declaration) {
+    if (!declaration.jit_compiled) {
+        declaration.jit_compiled = true;
+        declaration.jit = Compiler{declaration}.compile();
+    }
+    return declaration.jit.get();
+}
+
+std::shared_ptr<JitFunction> Compiler::compile() {
+    const auto &function = function_;
+    auto arity = function.params.size();
+    if (!SUPPORTED || !function.captures.empty() || function.memo != nullptr
+        || arity > MAX_ARGUMENTS) {
+        return nullptr;
+    }
+
+    auto num_slots = std::max<std::size_t>(function.num_slots, arity);
+    locals_.assign(num_slots, std::nullopt);
+    for (std::size_t i = 0; i < arity; i++) {
+        locals_[i] = kind::INT;
+    }
+    deoptimize_ = assembler_.new_label();
+    epilogue_ = assembler_.new_label();
+
+    // 入口时rsp按16字节对齐后减8, 压入rbp和rbx之后局部变量区的大小
+    // 需要是8的奇数倍, 才能保证调用其他函数时rsp对齐
+    auto frame_bytes = static_cast<int32_t>(8 * (num_slots | 1));
+    assembler_.push(reg::RBP);
+    assembler_.mov(reg::RBP, reg::RSP);
+    assembler_.push(reg::RBX);
+    assembler_.mov(reg::RBX, reg::RDI);
+    assembler_.sub(reg::RSP, frame_bytes);
+    for (std::size_t i = 0; i < arity; i++) {
+        assembler_.load(reg::RAX, reg::RSI, static_cast<int32_t>(8 * i));
+        assembler_.store(reg::RBP, local(i), reg::RAX);
+    }
+
+    try {
+        compile(function.body);
+    } catch (const Unsupported &) {
+        return nullptr;
+    }
+    if (!result_.has_value()) {
+        return nullptr;
+    }
+
+    // 没有执行到return时解释器返回nil, 退回解释器
+    assembler_.bind(deoptimize_);
+    assembler_.store_byte(reg::RBX, DEOPTIMIZE_OFFSET, 1);
+    assembler_.bind(epilogue_);
+    assembler_.lea(reg::RSP, reg::RBP, -8);
+    assembler_.pop(reg::RBX);
+    assembler_.pop(reg::RBP);
+    assembler_.ret();
+
+    return std::make_shared<JitFunction>(
+        function, assembler_.finish(), *result_);
+}
+
+kind Compiler::compile(Expr &expr) {
+    expr.accept(*this);
+    return kind_;
+}
+
+void Compiler::compile(Stmt &stmt) { stmt.accept(*this); }
+
+void Compiler::compile(const std::vector<std::unique_ptr<Stmt>> &stmts) {
+    for (const auto &stmt : stmts) {
+        compile(*stmt);
+    }
+}
+
+void Compiler::compile_condition(Expr &expr, Label label) {
+    // 整数比较直接跳转, 不需要先得到bool
+    auto &inner = unwrap(expr);
+    const Token *op = nullptr;
+    Expr *left = nullptr;
+    Expr *right = nullptr;
+    if (auto *binary = dynamic_cast<Binary *>(&inner)) {
+        op = &binary->op;
+        left = binary->left.get();
+        right = binary->right.get();
+    } else if (auto *compare = dynamic_cast<Compare *>(&inner)) {
+        op = &compare->op;
+        left = compare->variable.get();
+        right = compare->bound.get();
+    }
+    if (op != nullptr && is_comparison(op->type)) {
+        if (compile_operands(*left, *right) != kind::INT
+            && op->type != token_type::EQUAL_EQUAL
+            && op->type != token_type::NOT_EQUAL) {
+            throw Unsupported{};
+        }
+        assembler_.cmp(reg::RAX, reg::RCX);
+        assembler_.jump_if(negate(condition_of(op->type)), label);
+        return;
+    }
+
+    if (compile(expr) != kind::BOOL) {
+        throw Unsupported{};
+    }
+    assembler_.test(reg::RAX, reg::RAX);
+    assembler_.jump_if(condition::EQUAL, label);
+}
+
+std::optional<kind> Compiler::load(Expr &expr, reg r) {
+    auto &inner = unwrap(expr);
+    if (auto *variable = dynamic_cast<Variable *>(&inner)) {
+        auto type = local_kind(variable->depth, variable->slot);
+        assembler_.load(r, reg::RBP, local(variable->slot));
+        return type;
+    }
+    if (auto *literal = dynamic_cast<Literal *>(&inner)) {
+        const auto &value = literal->value;
+        if (value.is_int()) {
+            assembler_.mov(r, value.as_int());
+            return kind::INT;
+        }
+        if (value.is_bool()) {
+            assembler_.mov(r, int64_t{value.as_bool() ? 1 : 0});
+            return kind::BOOL;
+        }
+        throw Unsupported{};
+    }
+    return std::nullopt;
+}
+
+kind Compiler::compile_operands(Expr &left, Expr &right) {
+    kind types[2];
+    // 右操作数可以直接读取时不需要暂存左操作数
+    types[0] = compile(left);
+    if (auto type = load(right, reg::RCX)) {
+        types[1] = *type;
+    } else {
+        assembler_.push(reg::RAX);
+        pushed_++;
+        types[1] = compile(right);
+        assembler_.mov(reg::RCX, reg::RAX);
+        assembler_.pop(reg::RAX);
+        pushed_--;
+    }
+
+    // 两个操作数类型不同时只有==和!=有意义, 不编译
+    if (types[0] != types[1]) {
+        throw Unsupported{};
+    }
+    return types[0];
+}
+
+kind Compiler::compile_binary(const Token &op, Expr &left, Expr &right) {
+    auto type = compile_operands(left, right);
+    if (is_comparison(op.type)) {
+        if (type != kind::INT && op.type != token_type::EQUAL_EQUAL
+            && op.type != token_type::NOT_EQUAL) {
+            throw Unsupported{};
+        }
+        assembler_.cmp(reg::RAX, reg::RCX);
+        assembler_.set(condition_of(op.type));
+        return kind::BOOL;
+    }
+    if (type != kind::INT) {
+        throw Unsupported{};
+    }
+
+    // 整数运算的结果与解释器不同(提升为double或者报错)时退回解释器
+    switch (op.type) {
+        case token_type::PLUS:
+            assembler_.add(reg::RAX, reg::RCX);
+            assembler_.jump_if(condition::OVERFLOW, deoptimize_);
+            break;
+        case token_type::MINUS:
+            assembler_.sub(reg::RAX, reg::RCX);
+            assembler_.jump_if(condition::OVERFLOW, deoptimize_);
+            break;
+        case token_type::STAR:
+            assembler_.imul(reg::RAX, reg::RCX);
+            assembler_.jump_if(condition::OVERFLOW, deoptimize_);
+            break;
+        case token_type::SLASH: {
+            assembler_.test(reg::RCX, reg::RCX);
+            assembler_.jump_if(condition::EQUAL, deoptimize_);
+            auto divide = assembler_.new_label();
+            assembler_.mov(reg::RDX, INT64_MIN);
+            assembler_.cmp(reg::RAX, reg::RDX);
+            assembler_.jump_if(condition::NOT_EQUAL, divide);
+            assembler_.mov(reg::RDX, int64_t{-1});
+            assembler_.cmp(reg::RCX, reg::RDX);
+            assembler_.jump_if(condition::EQUAL, deoptimize_);
+            assembler_.bind(divide);
+            assembler_.cqo();
+            assembler_.idiv(reg::RCX);
+            break;
+        }
+        default:
+            throw Unsupported{};
+    }
+    return kind::INT;
+}
+
+kind Compiler::compile_call(Call &call) {
+    // 只能调用全局函数, 执行时检查被调用者
+    auto *variable = dynamic_cast<Variable *>(call.callee.get());
+    auto num_arguments = call.arguments.size();
+    if (variable == nullptr || variable->depth != GLOBAL_DEPTH
+        || num_arguments > MAX_ARGUMENTS) {
+        throw Unsupported{};
+    }
+
+    // 参数按顺序存放在栈上, 保持调用时rsp按16字节对齐
+    auto words = static_cast<unsigned int>(num_arguments);
+    words += (pushed_ + words) % 2;
+    if (words != 0) {
+        assembler_.sub(reg::RSP, static_cast<int32_t>(8 * words));
+        pushed_ += words;
+    }
+    for (std::size_t i = 0; i < num_arguments; i++) {
+        if (compile(*call.arguments[i]) != kind::INT) {
+            throw Unsupported{};
+        }
+        assembler_.store(reg::RSP, static_cast<int32_t>(8 * i), reg::RAX);
+    }
+
+    assembler_.mov(reg::RDI, reg::RBX);
+    assembler_.mov(reg::RSI, int64_t{variable->slot});
+    assembler_.mov(reg::RDX, reg::RSP);
+    assembler_.mov(reg::RCX, static_cast<int64_t>(num_arguments));
+    assembler_.mov(reg::RAX,
+                   reinterpret_cast<int64_t>(&JitFunction::call_global));
+    assembler_.call(reg::RAX);
+    if (words != 0) {
+        assembler_.add(reg::RSP, static_cast<int32_t>(8 * words));
+        pushed_ -= words;
+    }
+
+    // 被调用者已经设置了标志, 直接返回
+    assembler_.compare_byte(reg::RBX, DEOPTIMIZE_OFFSET, 0);
+    assembler_.jump_if(condition::NOT_EQUAL, epilogue_);
+
+    return kind::INT;
+}
+
+kind Compiler::local_kind(int depth, unsigned int slot) {
+    // 只能访问局部变量, 全局变量和捕获的变量在执行期间可能改变类型
+    if (depth != LOCAL_DEPTH || !locals_[slot].has_value()) {
+        throw Unsupported{};
+    }
+
+    return *locals_[slot];
+}
+
+int32_t Compiler::local(unsigned int slot) {
+    // rbp之下是保存的rbx, 然后依次是各个槽位
+    return -16 - 8 * static_cast<int32_t>(slot);
+}
+
+Value Compiler::visit_binary_expr(Binary *expr) {
+    kind_ = compile_binary(expr->op, *expr->left, *expr->right);
+
+    return {};
+}
+
+Value Compiler::visit_grouping_expr(Grouping *expr) {
+    kind_ = compile(*expr->expr);
+
+    return {};
+}
+
+Value Compiler::visit_literal_expr(Literal *expr) {
+    kind_ = *load(*expr, reg::RAX);
+
+    return {};
+}
+
+Value Compiler::visit_logical_expr(Logical *expr) {
+    // 两边都是bool时结果与解释器相同
+    auto end = assembler_.new_label();
+    if (compile(*expr->left) != kind::BOOL) {
+        throw Unsupported{};
+    }
+    assembler_.test(reg::RAX, reg::RAX);
+    assembler_.jump_if(expr->op.type == token_type::OR ? condition::NOT_EQUAL
+                                                       : condition::EQUAL,
+                       end);
+    if (compile(*expr->right) != kind::BOOL) {
+        throw Unsupported{};
+    }
+    assembler_.bind(end);
+    kind_ = kind::BOOL;
+
+    return {};
+}
+
+Value Compiler::visit_unary_expr(Unary *expr) {
+    auto type = compile(*expr->right);
+    if (expr->op.type == token_type::NOT) {
+        if (type != kind::BOOL) {
+            throw Unsupported{};
+        }
+        assembler_.xor_al(1);
+    } else {
+        if (type != kind::INT) {
+            throw Unsupported{};
+        }
+        assembler_.neg(reg::RAX);
+        assembler_.jump_if(condition::OVERFLOW, deoptimize_);
+    }
+    kind_ = type;
+
+    return {};
+}
+
+Value Compiler::visit_variable_expr(Variable *expr) {
+    kind_ = *load(*expr, reg::RAX);
+
+    return {};
+}
+
+Value Compiler::visit_assign_expr(Assign *expr) {
+    auto type = local_kind(expr->depth, expr->slot);
+    if (compile(*expr->value) != type) {
+        throw Unsupported{};
+    }
+    assembler_.store(reg::RBP, local(expr->slot), reg::RAX);
+    kind_ = type;
+
+    return {};
+}
+
+Value Compiler::visit_call_expr(Call *expr) {
+    kind_ = compile_call(*expr);
+
+    return {};
+}
+
+Value Compiler::visit_inline_call_expr(InlineCall *expr) {
+    // 编译后的调用已经足够快, 按原来的调用执行
+    kind_ = compile_call(*expr->call);
+
+    return {};
+}
+
+Value Compiler::visit_increment_expr(Increment *expr) {
+    if (local_kind(expr->depth, expr->slot) != kind::INT
+        || !fits_int32(expr->delta)) {
+        throw Unsupported{};
+    }
+    assembler_.load(reg::RAX, reg::RBP, local(expr->slot));
+    assembler_.add(reg::RAX, static_cast<int32_t>(expr->delta));
+    assembler_.jump_if(condition::OVERFLOW, deoptimize_);
+    assembler_.store(reg::RBP, local(expr->slot), reg::RAX);
+    kind_ = kind::INT;
+
+    return {};
+}
+
+Value Compiler::visit_compare_expr(Compare *expr) {
+    kind_ = compile_binary(expr->op, *expr->variable, *expr->bound);
+
+    return {};
+}
+
+Value Compiler::visit_promote_expr([[maybe_unused]] Promote *expr) {
+    // 机器码中只有整数和bool
+    throw Unsupported{};
+}
+
+Completion Compiler::visit_block_stmt(Block *stmt) {
+    // 函数中的块使用函数的栈帧, 被捕获的变量需要关闭, 不编译
+    if (stmt->num_slots != 0 || stmt->has_captured) {
+        throw Unsupported{};
+    }
+    compile(stmt->statements);
+
+    return Completion::NORMAL;
+}
+
+Completion Compiler::visit_expression_stmt(Expression *stmt) {
+    compile(*stmt->expression);
+
+    return Completion::NORMAL;
+}
+
+Completion Compiler::visit_var_stmt(Var *stmt) {
+    if (stmt->depth != LOCAL_DEPTH || stmt->initializer == nullptr) {
+        throw Unsupported{};
+    }
+    auto type = compile(*stmt->initializer);
+    auto annotated = type == kind::INT ? static_type::INT : static_type::BOOL;
+    if (stmt->type != static_type::ANY && stmt->type != annotated) {
+        throw Unsupported{};
+    }
+    assembler_.store(reg::RBP, local(stmt->slot), reg::RAX);
+    locals_[stmt->slot] = type;
+
+    return Completion::NORMAL;
+}
+
+Completion Compiler::visit_if_stmt(If *stmt) {
+    auto otherwise = assembler_.new_label();
+    compile_condition(*stmt->condition, otherwise);
+    compile(*stmt->then_branch);
+    if (stmt->else_branch == nullptr) {
+        assembler_.bind(otherwise);
+        return Completion::NORMAL;
+    }
+
+    auto end = assembler_.new_label();
+    assembler_.jmp(end);
+    assembler_.bind(otherwise);
+    compile(*stmt->else_branch);
+    assembler_.bind(end);
+
+    return Completion::NORMAL;
+}
+
+Completion Compiler::visit_while_stmt(While *stmt) {
+    auto start = assembler_.new_label();
+    auto end = assembler_.new_label();
+    assembler_.bind(start);
+    compile_condition(*stmt->condition, end);
+    compile(*stmt->body);
+    assembler_.jmp(start);
+    assembler_.bind(end);
+
+    return Completion::NORMAL;
+}
+
+Completion Compiler::visit_function_stmt([[maybe_unused]] Function *stmt) {
+    throw Unsupported{};
+}
+
+Completion Compiler::visit_return_stmt(Return *stmt) {
+    // 尾调用按普通调用执行, 调用深度超过限制时退回解释器
+    if (stmt->value == nullptr) {
+        throw Unsupported{};
+    }
+    auto type = compile(*stmt->value);
+    if (result_.has_value() && *result_ != type) {
+        throw Unsupported{};
+    }
+    result_ = type;
+    assembler_.jmp(epilogue_);
+
+    return Completion::NORMAL;
+}
+
+} // namespace zero::jit
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "assembler.hpp"
+#include "ast/expr.hpp"
+#include "ast/stmt.hpp"
+#include "code.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+namespace zero::jit {
+
+// 第一次调用时编译函数, 结果保存在Function::jit中, 不能编译时返回nullptr
+const JitFunction *compile(Function &declaration);
+
+// 把函数体从语法树直接编译成x86-64机器码, 没有中间表示和寄存器分配:
+// 表达式的结果在rax中, 二元运算的左操作数暂存在栈上, 局部变量在栈帧中
+// 只支持局部变量, int和bool运算, 调用全局函数, 遇到其他代码时不编译
+class Compiler : public ExprVisitor, public StmtVisitor {
+public:
+    explicit Compiler(const Function &function) : function_{function} {}
+
+public:
+    // 不能编译时返回nullptr
+    std::shared_ptr<JitFunction> compile();
+
+public:
+    // Expr抽象类方法, 表达式的类型保存在kind_中
+    Value visit_binary_expr(Binary *expr) override;
+    Value visit_grouping_expr(Grouping *expr) override;
+    Value visit_literal_expr(Literal *expr) override;
+    Value visit_logical_expr(Logical *expr) override;
+    Value visit_unary_expr(Unary *expr) override;
+    Value visit_variable_expr(Variable *expr) override;
+    Value visit_assign_expr(Assign *expr) override;
+    Value visit_call_expr(Call *expr) override;
+    Value visit_inline_call_expr(InlineCall *expr) override;
+    Value visit_increment_expr(Increment *expr) override;
+    Value visit_compare_expr(Compare *expr) override;
+    Value visit_promote_expr(Promote *expr) override;
+
+    // Stmt抽象类方法
+    Completion visit_block_stmt(Block *stmt) override;
+    Completion visit_expression_stmt(Expression *stmt) override;
+    Completion visit_var_stmt(Var *stmt) override;
+    Completion visit_if_stmt(If *stmt) override;
+    Completion visit_while_stmt(While *stmt) override;
+    Completion visit_function_stmt(Function *stmt) override;
+    Completion visit_return_stmt(Return *stmt) override;
+
+private:
+    // 遇到不能编译的代码时抛出
+    struct Unsupported {};
+
+    kind compile(Expr &expr);
+    void compile(Stmt &stmt);
+    void compile(const std::vector<std::unique_ptr<Stmt>> &stmts);
+    // 条件为false时跳转到label, 条件必须是bool
+    void compile_condition(Expr &expr, Label label);
+    // 左操作数在rax中, 右操作数在rcx中
+    kind compile_operands(Expr &left, Expr &right);
+    kind compile_binary(const Token &op, Expr &left, Expr &right);
+    kind compile_call(Call &call);
+    // 局部变量或常量直接读到寄存器中, 其他表达式返回std::nullopt
+    std::optional<kind> load(Expr &expr, reg r);
+    kind local_kind(int depth, unsigned int slot);
+    static int32_t local(unsigned int slot);
+
+private:
+    const Function &function_;
+    Assembler assembler_;
+    std::vector<std::optional<kind>> locals_;
+    std::optional<kind> result_; // return语句的返回值类型
+    kind kind_{kind::INT};
+    unsigned int pushed_{0}; // 栈帧之下暂存的8字节个数, 用于对齐调用
+    Label deoptimize_{};
+    Label epilogue_{};
+};
+
+} // namespace zero::jit
@@ -2,6 +2,9 @@
 
 #include "fmt/core.h"
 
+#include <charconv>
+#include <system_error>
+
 namespace zero {
 std::vector<Token> Lexer::scan_tokens() {
     while (!is_at_end()) {
@@ -9,8 +12,7 @@ std::vector<Token> Lexer::scan_tokens() {
         scan_token();
     }
 
-    Token token(token_type::END, "", std::string(""), line);
-    tokens.push_back(token);
+    tokens.push_back(Token{token_type::END, "", line});
 
     return tokens;
 }
@@ -45,12 +47,18 @@ void Lexer::scan_token() {
         case '+':
             add_token(token_type::PLUS);
             break;
+        case ':':
+            add_token(token_type::COLON);
+            break;
         case ';':
             add_token(token_type::SEMICOLON);
             break;
         case '*':
             add_token(token_type::STAR);
             break;
+        case '@':
+            add_token(token_type::AT);
+            break;
         case '!':
             add_token(match('=') ? token_type::NOT_EQUAL : token_type::NOT);
             break;
@@ -95,21 +103,30 @@ void Lexer::scan_token() {
     }
 }
 
-char Lexer::advance() { return source.at(current++); }
+char Lexer::advance() { return source[current++]; }
 
-void Lexer::add_token(token_type type) { add_token(type, std::string("")); }
+void Lexer::add_token(token_type type) { add_token(type, 0); }
+
+void Lexer::add_token(token_type type, int64_t number) {
+    auto text = source.substr(start, current - start);
+    tokens.push_back(Token{type, text, line, number});
+}
+
+void Lexer::add_decimal_token(double decimal) {
+    auto text = source.substr(start, current - start);
+    tokens.push_back(Token{token_type::DECIMAL, text, line, 0, 0, decimal});
+}
 
-void Lexer::add_token(token_type type, const std::any &literal) {
+void Lexer::add_symbol_token(token_type type, symbol_id symbol) {
     auto text = source.substr(start, current - start);
-    Token token(type, literal, text, line);
-    tokens.push_back(token);
+    tokens.push_back(Token{type, text, line, 0, symbol});
 }
 
 bool Lexer::match(char expected) {
     if (is_at_end()) {
         return false;
     }
-    if (source.at(current) != expected) {
+    if (source[current] != expected) {
         return false;
     }
     current++;
@@ -122,7 +139,7 @@ char Lexer::peek() {
         return '\0';
     }
 
-    return source.at(current);
+    return source[current];
 }
 
 void Lexer::parse_string() {
@@ -140,9 +157,9 @@ void Lexer::parse_string() {
 
     // Advance until closing quote
     advance();
-    // Remove quotes from string
-    auto value = source.substr(start + 1, current - start - 2);
-    add_token(token_type::STRING, value);
+    // 词位包括引号, 驻留的是去掉引号后的内容
+    auto text = source.substr(start + 1, current - start - 2);
+    add_symbol_token(token_type::STRING, symbols.intern(text));
 }
 
 void Lexer::parse_number() {
@@ -150,25 +167,38 @@ void Lexer::parse_number() {
         advance();
     }
 
-    // if (peek() == '.' && is_digit(peek_next())) {
-    //     advance();
-    //     while (is_digit(peek())) {
-    //         advance();
-    //     }
-    // }
+    bool is_decimal = false;
+    if (peek() == '.' && is_digit(peek_next())) {
+        is_decimal = true;
+        advance();
+        while (is_digit(peek())) {
+            advance();
+        }
+    }
 
-    auto number = std::stoi(source.substr(start, current - start));
-    add_token(token_type::NUMBER, number);
+    const char *first = source.data() + start;
+    const char *last = source.data() + current;
+    int64_t number{};
+    // 超出int64范围的整数按浮点数处理
+    if (!is_decimal
+        && std::from_chars(first, last, number).ec == std::errc{}) {
+        add_token(token_type::NUMBER, number);
+        return;
+    }
+
+    double decimal{};
+    std::from_chars(first, last, decimal);
+    add_decimal_token(decimal);
 }
 
 bool Lexer::is_digit(const char c) { return c >= '0' && c <= '9'; }
 
 char Lexer::peek_next() {
-    if (current - 1 >= source.size()) {
+    if (current + 1 >= source.size()) {
         return '\0';
     }
 
-    return source.at(current + 1);
+    return source[current + 1];
 }
 
 void Lexer::identifier() {
@@ -176,16 +206,8 @@ void Lexer::identifier() {
         advance();
     }
     auto text = source.substr(start, current - start);
-    auto found = keywords.find(text);
-    token_type type{};
-
-    if (found != keywords.end()) {
-        type = found->second;
-    } else {
-        type = token_type::IDENTIFIER;
-    }
-
-    add_token(type);
+    auto symbol = symbols.intern(text);
+    add_symbol_token(symbols.keyword_type(symbol), symbol);
 }
 
 bool Lexer::is_alpha(const char c) {
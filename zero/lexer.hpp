@@ -1,14 +1,16 @@
+#include "symbol.hpp"
 #include "token.hpp"
 
-#include <map>
+#include <cstdint>
 #include <string>
-#include <utility>
+#include <string_view>
 #include <vector>
 
 namespace zero {
 class Lexer {
 public:
-    explicit Lexer(std::string source) : source(std::move(source)) {};
+    // 不拷贝源码, 调用者需要保证source在tokens使用期间有效
+    explicit Lexer(std::string_view source) : source(source) {};
     std::vector<Token> scan_tokens();
 
 private:
@@ -16,7 +18,9 @@ private:
     void scan_token();
     char advance();
     void add_token(token_type type);
-    void add_token(token_type type, const std::any &literal);
+    void add_token(token_type type, int64_t number);
+    void add_decimal_token(double decimal);
+    void add_symbol_token(token_type type, symbol_id symbol);
     bool match(char expected);
     char peek();
     void parse_string();
@@ -32,24 +36,7 @@ private:
     unsigned int start = 0;
     unsigned int current = 0;
     unsigned int line = 1;
-    std::string source;
-    const std::map<std::string, token_type> keywords = {
-        {"and", token_type::AND},
-        {"or", token_type::OR},
-        {"not", token_type::NOT},
-        {"class", token_type::CLASS},
-        {"else", token_type::ELSE},
-        {"false", token_type::FALSE},
-        {"for", token_type::FOR},
-        {"fn", token_type::FN},
-        {"if", token_type::IF},
-        {"nil", token_type::NIL},
-        {"or", token_type::OR},
-        // {"print", token_type::PRINT},
-        {"return", token_type::RETURN},
-        {"true", token_type::TRUE},
-        {"let", token_type::LET},
-        {"while", token_type::WHILE},
-    };
+    std::string_view source;
+    SymbolTable &symbols = SymbolTable::instance();
 };
 } // namespace zero
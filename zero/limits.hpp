@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstddef>
+
+// 所有执行方式共用的调用限制
+namespace zero {
+
+// 函数调用深度的上限, 更深的调用报告栈溢出
+constexpr unsigned int MAX_CALL_DEPTH = 4096;
+
+// 执行程序的线程的C++栈大小, 每层调用可以使用64KB
+// 调试构建中函数体嵌套较深时, 达到调用深度上限之前C++栈也不会用完
+constexpr std::size_t NATIVE_STACK_SIZE = std::size_t{MAX_CALL_DEPTH} << 16;
+
+// C++栈底保留的空间, 剩余空间少于它时同样报告栈溢出
+constexpr std::size_t NATIVE_STACK_RESERVE = std::size_t{1} << 20;
+
+} // namespace zero
@@ -5,18 +5,47 @@
 using namespace zero;
 
 void usage() {
-    fmt::println("./zero [file] [--help] [--verbose]");
+    fmt::println("./zero [file] [--help] [--verbose] "
+                 "[--engine=tree|bytecode|flat|closure] [--memoize] "
+                 "[--no-jit] [--emit-cpp out.cpp] [--no-cache] "
+                 "[--cache-dir dir]");
     fmt::println("positions:");
     fmt::println("    file           parse and execute this file, optional");
     fmt::println("options:");
     fmt::println("    --help         print usage");
     fmt::println("    --verbose      verbose message");
+    fmt::println("    --engine       execution engine, tree(default), "
+                 "bytecode, flat or closure");
+    fmt::println("    --memoize      memoize all pure functions, not only "
+                 "@memoize ones");
+    fmt::println("    --no-jit       do not compile hot functions to machine "
+                 "code (tree engine)");
+    fmt::println("    --emit-cpp     translate file to a standalone C++ "
+                 "program instead of running it");
+    fmt::println("    --no-cache     do not load or save precompiled "
+                 "programs");
+    fmt::println("    --cache-dir    directory of precompiled programs, "
+                 "default $ZERO_CACHE_DIR or ~/.cache/zero");
 }
 
 int main(int argc, char *argv[]) {
     bool verbose{};
+    bool memoize{};
+    bool no_jit{};
+    bool no_cache{};
+    std::string engine{};
+    std::string emit_cpp{};
+    std::string cache_dir{};
     std::string file{};
     CmdLine::BoolOpt(&verbose, "verbose");
+    CmdLine::BoolOpt(&memoize, "memoize");
+    CmdLine::BoolOpt(&no_jit, "no-jit");
+    CmdLine::StrOpt(&engine, "engine", "tree");
+    CmdLine::StrOpt(&emit_cpp, "emit-cpp", "");
+    CmdLine::BoolOpt(&no_cache, "no-cache");
+    CmdLine::StrOpt(&cache_dir,
+                    "cache-dir",
+                    cache::ProgramCache::default_directory());
     CmdLine::StrPositional(&file);
     CmdLine::SetUsage(usage);
     int res = CmdLine::Parse(argc, argv);
@@ -26,10 +55,37 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
-    VM vm;
+    engine_type engine_kind{};
+    if (engine == "tree") {
+        engine_kind = engine_type::TREE;
+    } else if (engine == "bytecode") {
+        engine_kind = engine_type::BYTECODE;
+    } else if (engine == "flat") {
+        engine_kind = engine_type::FLAT;
+    } else if (engine == "closure") {
+        engine_kind = engine_type::CLOSURE;
+    } else {
+        fmt::println("Unknown engine `{}`", engine);
+        return 1;
+    }
+
+    // 缓存目录为空时不使用预编译程序
+    VM vm{engine_kind,
+          verbose,
+          memoize,
+          !no_jit,
+          no_cache ? std::string{} : cache_dir};
+    if (!emit_cpp.empty()) {
+        if (file.empty()) {
+            fmt::println("--emit-cpp requires a file");
+            return 1;
+        }
+        return vm.emit_cpp(file, emit_cpp) ? 0 : 1;
+    }
     if (file.empty()) {
         vm.run_REPL();
-    } else {
-        vm.run_file(file);
+        return 0;
     }
+    // 运行时出错时返回非0, 测试据此判断执行失败
+    return vm.run_file(file) ? 0 : 1;
 }
@@ -0,0 +1,154 @@
+#include "memo.hpp"
+
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <string_view>
+
+namespace zero {
+
+namespace {
+std::size_t combine(std::size_t seed, std::size_t value) {
+    return seed ^ (value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2));
+}
+
+uint64_t bits_of(double number) {
+    uint64_t bits{};
+    std::memcpy(&bits, &number, sizeof(bits));
+    return bits;
+}
+} // namespace
+
+const Value *MemoTable::find(const Value *arguments) {
+    std::size_t key{};
+    if (!hash(arguments, key)) {
+        return nullptr;
+    }
+
+    auto found = lookup(arguments, key);
+    if (found == entries_.end()) {
+        misses_++;
+        return nullptr;
+    }
+    hits_++;
+    entries_.splice(entries_.begin(), entries_, found);
+
+    return &found->result;
+}
+
+void MemoTable::insert(const Value *arguments, Value result) {
+    std::size_t key{};
+    if (!hash(arguments, key)) {
+        return;
+    }
+
+    auto found = lookup(arguments, key);
+    if (found != entries_.end()) {
+        found->result = std::move(result);
+        entries_.splice(entries_.begin(), entries_, found);
+        return;
+    }
+
+    if (entries_.size() == CAPACITY) {
+        // 淘汰最久没有使用的调用
+        auto oldest = std::prev(entries_.end());
+        auto [first, last] = index_.equal_range(oldest->hash);
+        for (auto it = first; it != last; ++it) {
+            if (it->second == oldest) {
+                index_.erase(it);
+                break;
+            }
+        }
+        entries_.pop_back();
+    }
+
+    std::vector<Value> key_arguments(arguments, arguments + arity_);
+    entries_.push_front(
+        Entry{std::move(key_arguments), std::move(result), key});
+    index_.emplace(key, entries_.begin());
+}
+
+bool MemoTable::hash(const Value *arguments, std::size_t &result) const {
+    std::size_t seed = arity_;
+    for (std::size_t i = 0; i < arity_; i++) {
+        const Value &argument = arguments[i];
+        std::size_t value{};
+        switch (argument.type()) {
+            case value_type::NIL:
+                break;
+            case value_type::BOOL:
+                value = argument.as_bool() ? 1 : 0;
+                break;
+            case value_type::INT:
+                value = std::hash<int64_t>{}(argument.as_int());
+                break;
+            case value_type::DOUBLE:
+                value = std::hash<uint64_t>{}(bits_of(argument.as_double()));
+                break;
+            case value_type::SHORT_STRING:
+            case value_type::STRING:
+                value = std::hash<std::string_view>{}(argument.as_string());
+                break;
+            default:
+                return false;
+        }
+        // 长短字符串的内容相同时是同一个参数, 使用相同的类型标记
+        auto type = argument.is_string() ? value_type::STRING : argument.type();
+        seed = combine(seed, static_cast<std::size_t>(type));
+        seed = combine(seed, value);
+    }
+    result = seed;
+
+    return true;
+}
+
+bool MemoTable::matches(const Entry &entry, const Value *arguments) const {
+    for (std::size_t i = 0; i < arity_; i++) {
+        const Value &a = entry.arguments[i];
+        const Value &b = arguments[i];
+        if (a.is_string() && b.is_string()) {
+            if (a.as_string() != b.as_string()) {
+                return false;
+            }
+            continue;
+        }
+        if (a.type() != b.type()) {
+            return false;
+        }
+        switch (a.type()) {
+            case value_type::BOOL:
+                if (a.as_bool() != b.as_bool()) {
+                    return false;
+                }
+                break;
+            case value_type::INT:
+                if (a.as_int() != b.as_int()) {
+                    return false;
+                }
+                break;
+            case value_type::DOUBLE:
+                if (bits_of(a.as_double()) != bits_of(b.as_double())) {
+                    return false;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    return true;
+}
+
+MemoTable::Iterator MemoTable::lookup(const Value *arguments,
+                                      std::size_t hash) {
+    auto [first, last] = index_.equal_range(hash);
+    for (auto it = first; it != last; ++it) {
+        if (matches(*it->second, arguments)) {
+            return it->second;
+        }
+    }
+
+    return entries_.end();
+}
+
+} // namespace zero
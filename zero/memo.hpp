@@ -0,0 +1,57 @@
+#pragma once
+
+#include "value.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+namespace zero {
+
+// 纯函数的记忆表: 参数 -> 返回值, 按最近使用的顺序淘汰(LRU)
+// 只记录参数都是值类型(nil, bool, 数值, 字符串)的调用,
+// 函数等引用类型的参数直接跳过记忆表
+class MemoTable {
+public:
+    // 每个函数最多记录的调用个数
+    static constexpr std::size_t CAPACITY = 1 << 12;
+
+    explicit MemoTable(std::size_t arity) : arity_{arity} {}
+
+public:
+    std::size_t arity() const { return arity_; }
+    // 查找之前的结果, 找不到或者参数不能作为键时返回nullptr
+    // 返回的指针在下一次insert之前有效
+    const Value *find(const Value *arguments);
+    // 记录调用结果, 参数不能作为键时忽略
+    void insert(const Value *arguments, Value result);
+
+    uint64_t hits() const { return hits_; }
+    uint64_t misses() const { return misses_; }
+    std::size_t size() const { return entries_.size(); }
+
+private:
+    struct Entry {
+        std::vector<Value> arguments;
+        Value result;
+        std::size_t hash;
+    };
+    using Iterator = std::list<Entry>::iterator;
+
+    // 参数都是值类型时返回true, 同时计算参数的哈希值
+    bool hash(const Value *arguments, std::size_t &result) const;
+    // 类型相同并且值相同, 浮点数按二进制位比较, 不把1和1.0当成同一个参数
+    bool matches(const Entry &entry, const Value *arguments) const;
+    Iterator lookup(const Value *arguments, std::size_t hash);
+
+private:
+    std::size_t arity_;
+    std::list<Entry> entries_; // 最近使用的在前面
+    std::unordered_multimap<std::size_t, Iterator> index_;
+    uint64_t hits_{0};
+    uint64_t misses_{0};
+};
+
+} // namespace zero
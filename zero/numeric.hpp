@@ -0,0 +1,150 @@
+#pragma once
+
+#include "value.hpp"
+
+#include <cstdint>
+
+// 两个引擎共用的数值运算
+// 调用前需要保证操作数都是数值, 两个整数运算时走快速路径,
+// 溢出时提升为double, 不会发生回绕; 其他情况按double计算
+namespace zero {
+
+inline bool is_number(const Value &value) {
+    return value.is_int() || value.is_double();
+}
+
+inline double as_number(const Value &value) {
+    return value.is_int() ? static_cast<double>(value.as_int())
+                          : value.as_double();
+}
+
+#if defined(__GNUC__)
+#    define ZERO_ADD_OVERFLOW(a, b, result) __builtin_add_overflow(a, b, result)
+#    define ZERO_SUB_OVERFLOW(a, b, result) __builtin_sub_overflow(a, b, result)
+#    define ZERO_MUL_OVERFLOW(a, b, result) __builtin_mul_overflow(a, b, result)
+#else
+namespace detail {
+inline bool add_overflow(int64_t a, int64_t b, int64_t *result) {
+    if ((b > 0 && a > INT64_MAX - b) || (b < 0 && a < INT64_MIN - b)) {
+        return true;
+    }
+    *result = a + b;
+    return false;
+}
+
+inline bool sub_overflow(int64_t a, int64_t b, int64_t *result) {
+    if ((b < 0 && a > INT64_MAX + b) || (b > 0 && a < INT64_MIN + b)) {
+        return true;
+    }
+    *result = a - b;
+    return false;
+}
+
+inline bool mul_overflow(int64_t a, int64_t b, int64_t *result) {
+    bool overflow = false;
+    if (a > 0) {
+        overflow = b > 0 ? a > INT64_MAX / b : b < INT64_MIN / a;
+    } else if (a < 0) {
+        overflow = b > 0 ? a < INT64_MIN / b : b < INT64_MAX / a;
+    }
+    if (overflow) {
+        return true;
+    }
+    *result = a * b;
+    return false;
+}
+} // namespace detail
+
+#    define ZERO_ADD_OVERFLOW(a, b, result) detail::add_overflow(a, b, result)
+#    define ZERO_SUB_OVERFLOW(a, b, result) detail::sub_overflow(a, b, result)
+#    define ZERO_MUL_OVERFLOW(a, b, result) detail::mul_overflow(a, b, result)
+#endif
+
+// 整数运算, 溢出时返回true, 类型特化的代码直接使用
+inline bool add_overflow(int64_t a, int64_t b, int64_t *result) {
+    return ZERO_ADD_OVERFLOW(a, b, result);
+}
+
+inline bool subtract_overflow(int64_t a, int64_t b, int64_t *result) {
+    return ZERO_SUB_OVERFLOW(a, b, result);
+}
+
+inline bool multiply_overflow(int64_t a, int64_t b, int64_t *result) {
+    return ZERO_MUL_OVERFLOW(a, b, result);
+}
+
+inline Value add_numbers(const Value &a, const Value &b) {
+    int64_t result;
+    if (a.is_int() && b.is_int()
+        && !ZERO_ADD_OVERFLOW(a.as_int(), b.as_int(), &result)) {
+        return result;
+    }
+    return as_number(a) + as_number(b);
+}
+
+inline Value subtract_numbers(const Value &a, const Value &b) {
+    int64_t result;
+    if (a.is_int() && b.is_int()
+        && !ZERO_SUB_OVERFLOW(a.as_int(), b.as_int(), &result)) {
+        return result;
+    }
+    return as_number(a) - as_number(b);
+}
+
+inline Value multiply_numbers(const Value &a, const Value &b) {
+    int64_t result;
+    if (a.is_int() && b.is_int()
+        && !ZERO_MUL_OVERFLOW(a.as_int(), b.as_int(), &result)) {
+        return result;
+    }
+    return as_number(a) * as_number(b);
+}
+
+// 整数除法向零取整, 调用者需要先检查除数为0的情况
+inline Value divide_numbers(const Value &a, const Value &b) {
+    if (a.is_int() && b.is_int()
+        && !(a.as_int() == INT64_MIN && b.as_int() == -1)) {
+        return a.as_int() / b.as_int();
+    }
+    return as_number(a) / as_number(b);
+}
+
+inline Value negate_number(const Value &a) {
+    if (a.is_int() && a.as_int() != INT64_MIN) {
+        return -a.as_int();
+    }
+    return -as_number(a);
+}
+
+// 注解为double的位置, 整数转换为double, 其他值不变
+inline Value promote_number(const Value &a) {
+    if (a.is_int()) {
+        return static_cast<double>(a.as_int());
+    }
+    return a;
+}
+
+// 整数除以整数0是错误, 浮点数除以0得到inf
+inline bool is_integer_division_by_zero(const Value &a, const Value &b) {
+    return a.is_int() && b.is_int() && b.as_int() == 0;
+}
+
+#undef ZERO_ADD_OVERFLOW
+#undef ZERO_SUB_OVERFLOW
+#undef ZERO_MUL_OVERFLOW
+
+// 比较两个数值, 都是整数时按整数比较
+#define ZERO_COMPARE_NUMBERS(name, op)                                         \
+    inline bool name(const Value &a, const Value &b) {                         \
+        if (a.is_int() && b.is_int()) {                                        \
+            return a.as_int() op b.as_int();                                   \
+        }                                                                      \
+        return as_number(a) op as_number(b);                                   \
+    }
+ZERO_COMPARE_NUMBERS(less_numbers, <)
+ZERO_COMPARE_NUMBERS(less_equal_numbers, <=)
+ZERO_COMPARE_NUMBERS(greater_numbers, >)
+ZERO_COMPARE_NUMBERS(greater_equal_numbers, >=)
+#undef ZERO_COMPARE_NUMBERS
+
+} // namespace zero
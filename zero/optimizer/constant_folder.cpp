@@ -0,0 +1,278 @@
+#include "constant_folder.hpp"
+
+#include "interpreter.hpp"
+
+namespace zero::optimizer {
+
+namespace {
+bool is_literal(const std::unique_ptr<Expr> &expr) {
+    return dynamic_cast<const Literal *>(expr.get()) != nullptr;
+}
+
+const Value &literal_value(const std::unique_ptr<Expr> &expr) {
+    return static_cast<const Literal *>(expr.get())->value;
+}
+} // namespace
+
+unsigned int ConstantFolder::fold(const std::unique_ptr<Program> &program) {
+    // 先找出所有被重新赋值的局部变量, 变量可能在声明之后的循环中才被赋值
+    reassigned_.clear();
+    analyzing_ = true;
+    auto before = walk(program);
+
+    analyzing_ = false;
+    constants_.clear();
+    fold(program->get_statements());
+
+    analyzing_ = true;
+    auto after = walk(program);
+
+    return before - after;
+}
+
+unsigned int ConstantFolder::walk(const std::unique_ptr<Program> &program) {
+    num_nodes_ = 0;
+    fold(program->get_statements());
+
+    return num_nodes_;
+}
+
+void ConstantFolder::fold(std::unique_ptr<Expr> &expr) {
+    num_nodes_++;
+    expr->accept(*this);
+    if (replacement_ != nullptr) {
+        expr = std::move(replacement_);
+    }
+}
+
+void ConstantFolder::fold(std::unique_ptr<Stmt> &stmt) {
+    num_nodes_++;
+    stmt->accept(*this);
+}
+
+void ConstantFolder::fold(std::vector<std::unique_ptr<Stmt>> &stmts) {
+    std::size_t kept = 0;
+    for (std::size_t i = 0; i < stmts.size(); i++) {
+        fold(stmts[i]);
+        if (remove_statement_) {
+            remove_statement_ = false;
+            continue;
+        }
+        if (kept != i) {
+            stmts[kept] = std::move(stmts[i]);
+        }
+        kept++;
+    }
+    stmts.resize(kept);
+}
+
+void ConstantFolder::evaluate(Expr &expr) {
+    try {
+        replacement_ = std::make_unique<Literal>(expr.accept(interpreter_));
+    } catch (const RuntimeError &) {
+        replacement_ = nullptr;
+    }
+}
+
+void ConstantFolder::declare(const Token &name, Var *declaration) {
+    if (scopes_.empty()) {
+        return;
+    }
+
+    // 同一作用域中重复声明的变量共用一个槽位, 相当于重新赋值
+    auto [found, inserted] = scopes_.back().emplace(name.symbol, declaration);
+    if (!inserted) {
+        if (analyzing_) {
+            reassigned_.insert(found->second);
+            reassigned_.insert(declaration);
+        }
+        found->second = declaration;
+    }
+}
+
+Var *ConstantFolder::lookup(const Token &name) const {
+    for (auto scope = scopes_.rbegin(); scope != scopes_.rend(); ++scope) {
+        auto found = scope->find(name.symbol);
+        if (found != scope->end()) {
+            return found->second;
+        }
+    }
+
+    return nullptr;
+}
+
+Value ConstantFolder::visit_binary_expr(Binary *expr) {
+    fold(expr->left);
+    fold(expr->right);
+    if (!analyzing_ && is_literal(expr->left) && is_literal(expr->right)) {
+        evaluate(*expr);
+    }
+
+    return {};
+}
+
+Value ConstantFolder::visit_grouping_expr(Grouping *expr) {
+    // 括号只影响解析, 语法树中不再需要
+    fold(expr->expr);
+    if (!analyzing_) {
+        replacement_ = std::move(expr->expr);
+    }
+
+    return {};
+}
+
+Value ConstantFolder::visit_literal_expr([[maybe_unused]] Literal *expr) {
+    return {};
+}
+
+Value ConstantFolder::visit_logical_expr(Logical *expr) {
+    fold(expr->left);
+    fold(expr->right);
+    if (analyzing_ || !is_literal(expr->left)) {
+        return {};
+    }
+
+    // 左操作数决定结果时不再计算右操作数, 否则结果就是右操作数
+    bool truthy = is_truthy(literal_value(expr->left));
+    bool short_circuit
+        = expr->op.type == token_type::OR ? truthy : !truthy;
+    replacement_ = std::move(short_circuit ? expr->left : expr->right);
+
+    return {};
+}
+
+Value ConstantFolder::visit_unary_expr(Unary *expr) {
+    fold(expr->right);
+    if (!analyzing_ && is_literal(expr->right)) {
+        evaluate(*expr);
+    }
+
+    return {};
+}
+
+Value ConstantFolder::visit_variable_expr(Variable *expr) {
+    if (analyzing_) {
+        return {};
+    }
+
+    auto found = constants_.find(lookup(expr->name));
+    if (found != constants_.end()) {
+        replacement_ = std::make_unique<Literal>(found->second);
+    }
+
+    return {};
+}
+
+Value ConstantFolder::visit_assign_expr(Assign *expr) {
+    fold(expr->value);
+    if (analyzing_) {
+        reassigned_.insert(lookup(expr->name));
+    }
+
+    return {};
+}
+
+Value ConstantFolder::visit_call_expr(Call *expr) {
+    fold(expr->callee);
+    for (auto &argument : expr->arguments) {
+        fold(argument);
+    }
+
+    return {};
+}
+
+Value ConstantFolder::visit_inline_call_expr(InlineCall *expr) {
+    // 内联在常量折叠之后进行, 这里只处理参数
+    for (auto &argument : expr->call->arguments) {
+        fold(argument);
+    }
+
+    return {};
+}
+
+// 循环优化在常量折叠之后进行, 不会遇到以下节点
+Value ConstantFolder::visit_increment_expr([[maybe_unused]] Increment *expr) {
+    return {};
+}
+
+Value ConstantFolder::visit_compare_expr([[maybe_unused]] Compare *expr) {
+    return {};
+}
+
+Value ConstantFolder::visit_promote_expr(Promote *expr) {
+    fold(expr->expr);
+
+    return {};
+}
+
+Completion ConstantFolder::visit_block_stmt(Block *stmt) {
+    begin_scope();
+    fold(stmt->statements);
+    end_scope();
+
+    return Completion::NORMAL;
+}
+
+Completion ConstantFolder::visit_expression_stmt(Expression *stmt) {
+    fold(stmt->expression);
+
+    return Completion::NORMAL;
+}
+
+Completion ConstantFolder::visit_var_stmt(Var *stmt) {
+    if (stmt->initializer != nullptr) {
+        fold(stmt->initializer);
+    }
+    declare(stmt->name, stmt);
+
+    // 全局变量可能被之后输入的代码修改, 只传播局部变量
+    // 有类型注解的变量保留给类型检查
+    if (!analyzing_ && !scopes_.empty() && stmt->initializer != nullptr
+        && is_literal(stmt->initializer) && reassigned_.count(stmt) == 0
+        && stmt->type == static_type::ANY) {
+        constants_.emplace(stmt, literal_value(stmt->initializer));
+        remove_statement_ = true;
+    }
+
+    return Completion::NORMAL;
+}
+
+Completion ConstantFolder::visit_if_stmt(If *stmt) {
+    fold(stmt->condition);
+    fold(stmt->then_branch);
+    if (stmt->else_branch != nullptr) {
+        fold(stmt->else_branch);
+    }
+
+    return Completion::NORMAL;
+}
+
+Completion ConstantFolder::visit_while_stmt(While *stmt) {
+    fold(stmt->condition);
+    fold(stmt->body);
+
+    return Completion::NORMAL;
+}
+
+Completion ConstantFolder::visit_function_stmt(Function *stmt) {
+    declare(stmt->name, nullptr);
+
+    begin_scope();
+    for (const auto &param : stmt->params) {
+        declare(param, nullptr);
+    }
+    fold(stmt->body);
+    end_scope();
+
+    return Completion::NORMAL;
+}
+
+Completion ConstantFolder::visit_return_stmt(Return *stmt) {
+    if (stmt->value != nullptr) {
+        fold(stmt->value);
+    }
+
+    return Completion::NORMAL;
+}
+
+} // namespace zero::optimizer
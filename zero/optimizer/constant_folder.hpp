@@ -0,0 +1,87 @@
+#pragma once
+
+#include "ast/expr.hpp"
+#include "ast/program.hpp"
+#include "ast/stmt.hpp"
+#include "symbol.hpp"
+
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace zero {
+class Interpreter;
+} // namespace zero
+
+namespace zero::optimizer {
+
+// 常量折叠和常量传播, 在Resolver之前运行
+// 操作数都是常量的表达式折叠成Literal, 从未重新赋值且初始值为常量的局部变量
+// 直接替换成它的值, 操作数为常量的and/or化简成其中一个操作数
+class ConstantFolder : public ExprVisitor, public StmtVisitor {
+public:
+    explicit ConstantFolder(Interpreter &interpreter)
+        : interpreter_{interpreter} {}
+
+public:
+    // 返回删除的节点数
+    unsigned int fold(const std::unique_ptr<Program> &program);
+
+public:
+    // Expr抽象类方法
+    Value visit_binary_expr(Binary *expr) override;
+    Value visit_grouping_expr(Grouping *expr) override;
+    Value visit_literal_expr(Literal *expr) override;
+    Value visit_logical_expr(Logical *expr) override;
+    Value visit_unary_expr(Unary *expr) override;
+    Value visit_variable_expr(Variable *expr) override;
+    Value visit_assign_expr(Assign *expr) override;
+    Value visit_call_expr(Call *expr) override;
+    Value visit_inline_call_expr(InlineCall *expr) override;
+    Value visit_increment_expr(Increment *expr) override;
+    Value visit_compare_expr(Compare *expr) override;
+    Value visit_promote_expr(Promote *expr) override;
+
+    // Stmt抽象类方法
+    Completion visit_block_stmt(Block *stmt) override;
+    Completion visit_expression_stmt(Expression *stmt) override;
+    Completion visit_var_stmt(Var *stmt) override;
+    Completion visit_if_stmt(If *stmt) override;
+    Completion visit_while_stmt(While *stmt) override;
+    Completion visit_function_stmt(Function *stmt) override;
+    Completion visit_return_stmt(Return *stmt) override;
+
+private:
+    // 访问子节点, 访问结束后用replacement_替换该节点
+    void fold(std::unique_ptr<Expr> &expr);
+    void fold(std::unique_ptr<Stmt> &stmt);
+    // 常量传播后不再需要的声明语句从列表中删除
+    void fold(std::vector<std::unique_ptr<Stmt>> &stmts);
+    // 遍历整个程序, 返回节点数
+    unsigned int walk(const std::unique_ptr<Program> &program);
+
+    // 用解释器对操作数都是Literal的表达式求值
+    // 运行时会出错的表达式(比如除以0)保持原样, 留到运行时报错
+    void evaluate(Expr &expr);
+
+    void begin_scope() { scopes_.emplace_back(); }
+    void end_scope() { scopes_.pop_back(); }
+    // 参数和函数名的declaration为nullptr, 它们不参与常量传播
+    void declare(const Token &name, Var *declaration);
+    // 查找局部变量的声明, 全局变量和参数返回nullptr
+    Var *lookup(const Token &name) const;
+
+private:
+    Interpreter &interpreter_;
+    // 分析阶段只记录被赋值的变量, 不修改语法树
+    bool analyzing_{false};
+    unsigned int num_nodes_{0};
+    std::vector<std::unordered_map<symbol_id, Var *>> scopes_;
+    std::unordered_set<const Var *> reassigned_;
+    std::unordered_map<const Var *, Value> constants_;
+    std::unique_ptr<Expr> replacement_;
+    bool remove_statement_{false};
+};
+
+} // namespace zero::optimizer
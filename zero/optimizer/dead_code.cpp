@@ -0,0 +1,304 @@
+#include "dead_code.hpp"
+
+namespace zero::optimizer {
+
+unsigned int
+DeadCodeEliminator::eliminate(const std::unique_ptr<Program> &program) {
+    counting_ = true;
+    auto before = walk(program);
+
+    counting_ = false;
+    roots_.clear();
+    function_references_.clear();
+    references_ = &roots_;
+    visit(program->get_statements());
+    references_ = nullptr;
+    if (remove_unused_functions_) {
+        remove_unused_functions(program->get_statements());
+    }
+
+    counting_ = true;
+    auto after = walk(program);
+
+    return before - after;
+}
+
+unsigned int DeadCodeEliminator::walk(const std::unique_ptr<Program> &program) {
+    num_nodes_ = 0;
+    visit(program->get_statements());
+
+    return num_nodes_;
+}
+
+void DeadCodeEliminator::visit(Expr &expr) {
+    num_nodes_++;
+    expr.accept(*this);
+}
+
+Completion DeadCodeEliminator::visit(std::unique_ptr<Stmt> &stmt) {
+    num_nodes_++;
+    auto completion = stmt->accept(*this);
+    if (replacement_ != nullptr) {
+        stmt = std::move(replacement_);
+    }
+
+    return completion;
+}
+
+Completion
+DeadCodeEliminator::visit(std::vector<std::unique_ptr<Stmt>> &stmts) {
+    auto completion = Completion::NORMAL;
+    std::size_t kept = 0;
+    for (std::size_t i = 0; i < stmts.size(); i++) {
+        auto result = visit(stmts[i]);
+        if (remove_statement_) {
+            remove_statement_ = false;
+            continue;
+        }
+        if (kept != i) {
+            stmts[kept] = std::move(stmts[i]);
+        }
+        kept++;
+
+        // 之后的语句不会被执行, 也不再收集其中的引用
+        if (result == Completion::RETURN && !counting_) {
+            completion = Completion::RETURN;
+            break;
+        }
+    }
+    stmts.resize(kept);
+
+    return completion;
+}
+
+Completion DeadCodeEliminator::visit_branch(std::unique_ptr<Stmt> &stmt) {
+    auto completion = visit(stmt);
+    // 分支只能是一条语句, 被删除时用空块代替
+    if (remove_statement_) {
+        remove_statement_ = false;
+        stmt = std::make_unique<Block>(std::vector<std::unique_ptr<Stmt>>{});
+    }
+
+    return completion;
+}
+
+void DeadCodeEliminator::remove_unused_functions(
+    std::vector<std::unique_ptr<Stmt>> &stmts) {
+    std::unordered_map<symbol_id, std::vector<const Function *>> functions;
+    for (const auto &stmt : stmts) {
+        if (auto *function = dynamic_cast<const Function *>(stmt.get())) {
+            functions[function->name.symbol].push_back(function);
+        }
+    }
+
+    // 从顶层代码引用的变量名出发, 找出所有可能被调用的全局函数
+    std::unordered_set<symbol_id> live = roots_;
+    std::vector<symbol_id> worklist(live.begin(), live.end());
+    while (!worklist.empty()) {
+        auto name = worklist.back();
+        worklist.pop_back();
+        auto found = functions.find(name);
+        if (found == functions.end()) {
+            continue;
+        }
+        for (const auto *function : found->second) {
+            for (auto reference : function_references_[function]) {
+                if (live.insert(reference).second) {
+                    worklist.push_back(reference);
+                }
+            }
+        }
+    }
+
+    std::size_t kept = 0;
+    for (auto &stmt : stmts) {
+        auto *function = dynamic_cast<const Function *>(stmt.get());
+        if (function != nullptr && live.count(function->name.symbol) == 0) {
+            continue;
+        }
+        stmts[kept++] = std::move(stmt);
+    }
+    stmts.resize(kept);
+}
+
+Value DeadCodeEliminator::visit_binary_expr(Binary *expr) {
+    visit(*expr->left);
+    visit(*expr->right);
+
+    return {};
+}
+
+Value DeadCodeEliminator::visit_grouping_expr(Grouping *expr) {
+    visit(*expr->expr);
+
+    return {};
+}
+
+Value DeadCodeEliminator::visit_literal_expr([[maybe_unused]] Literal *expr) {
+    return {};
+}
+
+Value DeadCodeEliminator::visit_logical_expr(Logical *expr) {
+    visit(*expr->left);
+    visit(*expr->right);
+
+    return {};
+}
+
+Value DeadCodeEliminator::visit_unary_expr(Unary *expr) {
+    visit(*expr->right);
+
+    return {};
+}
+
+Value DeadCodeEliminator::visit_variable_expr(Variable *expr) {
+    if (references_ != nullptr) {
+        references_->insert(expr->name.symbol);
+    }
+
+    return {};
+}
+
+Value DeadCodeEliminator::visit_assign_expr(Assign *expr) {
+    visit(*expr->value);
+    if (references_ != nullptr) {
+        references_->insert(expr->name.symbol);
+    }
+
+    return {};
+}
+
+Value DeadCodeEliminator::visit_call_expr(Call *expr) {
+    visit(*expr->callee);
+    for (const auto &argument : expr->arguments) {
+        visit(*argument);
+    }
+
+    return {};
+}
+
+Value DeadCodeEliminator::visit_inline_call_expr(InlineCall *expr) {
+    // 回退用的调用引用了被内联的函数, 函数不会被删除
+    visit(*expr->call);
+    visit(*expr->body);
+
+    return {};
+}
+
+Value DeadCodeEliminator::visit_increment_expr(Increment *expr) {
+    if (references_ != nullptr) {
+        references_->insert(expr->name.symbol);
+    }
+
+    return {};
+}
+
+Value DeadCodeEliminator::visit_compare_expr(Compare *expr) {
+    visit(*expr->variable);
+    visit(*expr->bound);
+
+    return {};
+}
+
+Value DeadCodeEliminator::visit_promote_expr(Promote *expr) {
+    visit(*expr->expr);
+
+    return {};
+}
+
+Completion DeadCodeEliminator::visit_block_stmt(Block *stmt) {
+    depth_++;
+    auto completion = visit(stmt->statements);
+    depth_--;
+    if (!counting_ && stmt->statements.empty()) {
+        remove_statement_ = true;
+    }
+
+    return completion;
+}
+
+Completion DeadCodeEliminator::visit_expression_stmt(Expression *stmt) {
+    visit(*stmt->expression);
+    // 单独的常量没有副作用
+    if (!counting_ && dynamic_cast<Literal *>(stmt->expression.get())) {
+        remove_statement_ = true;
+    }
+
+    return Completion::NORMAL;
+}
+
+Completion DeadCodeEliminator::visit_var_stmt(Var *stmt) {
+    if (stmt->initializer != nullptr) {
+        visit(*stmt->initializer);
+    }
+
+    return Completion::NORMAL;
+}
+
+Completion DeadCodeEliminator::visit_if_stmt(If *stmt) {
+    visit(*stmt->condition);
+
+    auto *condition = dynamic_cast<Literal *>(stmt->condition.get());
+    if (counting_ || condition == nullptr) {
+        auto then_completion = visit_branch(stmt->then_branch);
+        if (stmt->else_branch == nullptr) {
+            return Completion::NORMAL;
+        }
+        auto else_completion = visit_branch(stmt->else_branch);
+        return then_completion == Completion::RETURN
+                       && else_completion == Completion::RETURN
+                   ? Completion::RETURN
+                   : Completion::NORMAL;
+    }
+
+    // 条件为常量时只保留会执行的分支
+    auto &branch = is_truthy(condition->value) ? stmt->then_branch
+                                               : stmt->else_branch;
+    if (branch == nullptr) {
+        remove_statement_ = true;
+        return Completion::NORMAL;
+    }
+    auto completion = visit_branch(branch);
+    replacement_ = std::move(branch);
+
+    return completion;
+}
+
+Completion DeadCodeEliminator::visit_while_stmt(While *stmt) {
+    visit(*stmt->condition);
+
+    auto *condition = dynamic_cast<Literal *>(stmt->condition.get());
+    if (!counting_ && condition != nullptr && !is_truthy(condition->value)) {
+        remove_statement_ = true;
+        return Completion::NORMAL;
+    }
+    // 循环体可能一次也不执行
+    visit_branch(stmt->body);
+
+    return Completion::NORMAL;
+}
+
+Completion DeadCodeEliminator::visit_function_stmt(Function *stmt) {
+    // 全局函数体中的引用只有在函数可能被调用时才算数
+    auto *enclosing = references_;
+    if (depth_ == 0 && references_ != nullptr) {
+        references_ = &function_references_[stmt];
+    }
+
+    depth_++;
+    visit(stmt->body);
+    depth_--;
+    references_ = enclosing;
+
+    return Completion::NORMAL;
+}
+
+Completion DeadCodeEliminator::visit_return_stmt(Return *stmt) {
+    if (stmt->value != nullptr) {
+        visit(*stmt->value);
+    }
+
+    return Completion::RETURN;
+}
+
+} // namespace zero::optimizer
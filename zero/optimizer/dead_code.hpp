@@ -0,0 +1,80 @@
+#pragma once
+
+#include "ast/expr.hpp"
+#include "ast/program.hpp"
+#include "ast/stmt.hpp"
+#include "symbol.hpp"
+
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace zero::optimizer {
+
+// 死代码消除, 在常量折叠之后运行
+// 删除条件为常量的if/while中不会执行的分支, return之后的语句,
+// 以及没有被引用的全局函数
+class DeadCodeEliminator : public ExprVisitor, public StmtVisitor {
+public:
+    // REPL中之后输入的代码还可能调用全局函数, 此时不能删除它们
+    explicit DeadCodeEliminator(bool remove_unused_functions)
+        : remove_unused_functions_{remove_unused_functions} {}
+
+public:
+    // 返回删除的节点数
+    unsigned int eliminate(const std::unique_ptr<Program> &program);
+
+public:
+    // Expr抽象类方法, 只收集引用的变量名
+    Value visit_binary_expr(Binary *expr) override;
+    Value visit_grouping_expr(Grouping *expr) override;
+    Value visit_literal_expr(Literal *expr) override;
+    Value visit_logical_expr(Logical *expr) override;
+    Value visit_unary_expr(Unary *expr) override;
+    Value visit_variable_expr(Variable *expr) override;
+    Value visit_assign_expr(Assign *expr) override;
+    Value visit_call_expr(Call *expr) override;
+    Value visit_inline_call_expr(InlineCall *expr) override;
+    Value visit_increment_expr(Increment *expr) override;
+    Value visit_compare_expr(Compare *expr) override;
+    Value visit_promote_expr(Promote *expr) override;
+
+    // Stmt抽象类方法, 语句一定会执行return时返回Completion::RETURN
+    Completion visit_block_stmt(Block *stmt) override;
+    Completion visit_expression_stmt(Expression *stmt) override;
+    Completion visit_var_stmt(Var *stmt) override;
+    Completion visit_if_stmt(If *stmt) override;
+    Completion visit_while_stmt(While *stmt) override;
+    Completion visit_function_stmt(Function *stmt) override;
+    Completion visit_return_stmt(Return *stmt) override;
+
+private:
+    void visit(Expr &expr);
+    // 访问结束后用replacement_替换该语句
+    Completion visit(std::unique_ptr<Stmt> &stmt);
+    // 删除被标记的语句, 以及一定会return的语句之后的语句
+    Completion visit(std::vector<std::unique_ptr<Stmt>> &stmts);
+    // if/while的分支被删除时替换成空块
+    Completion visit_branch(std::unique_ptr<Stmt> &stmt);
+    // 遍历整个程序, 返回节点数
+    unsigned int walk(const std::unique_ptr<Program> &program);
+    // 删除从顶层代码出发无法到达的全局函数
+    void remove_unused_functions(std::vector<std::unique_ptr<Stmt>> &stmts);
+
+private:
+    bool remove_unused_functions_;
+    // 统计阶段只计数, 不修改语法树
+    bool counting_{false};
+    unsigned int num_nodes_{0};
+    unsigned int depth_{0}; // 块和函数的嵌套层数, 为0时是顶层代码
+    std::unique_ptr<Stmt> replacement_;
+    bool remove_statement_{false};
+    // 当前代码引用的变量名: 顶层代码记录到roots_, 全局函数记录到各自的集合
+    std::unordered_set<symbol_id> *references_{nullptr};
+    std::unordered_set<symbol_id> roots_;
+    std::unordered_map<const Function *, std::unordered_set<symbol_id>>
+        function_references_;
+};
+
+} // namespace zero::optimizer
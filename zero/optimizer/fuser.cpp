@@ -0,0 +1,281 @@
+#include "fuser.hpp"
+
+namespace zero::optimizer {
+
+namespace {
+bool is_comparison(token_type type) {
+    switch (type) {
+        case token_type::LESS:
+        case token_type::LESS_EQUAL:
+        case token_type::GREATER:
+        case token_type::GREATER_EQUAL:
+        case token_type::EQUAL_EQUAL:
+        case token_type::NOT_EQUAL:
+            return true;
+        default:
+            return false;
+    }
+}
+
+const Variable *local_variable(const Expr &expr) {
+    const auto *variable = dynamic_cast<const Variable *>(&expr);
+    return variable != nullptr && variable->depth == LOCAL_DEPTH ? variable
+                                                                 : nullptr;
+}
+
+// 释放基类指针的所有权, 调用者保证类型正确
+template <typename T, typename Base>
+std::unique_ptr<T> downcast(std::unique_ptr<Base> &node) {
+    return std::unique_ptr<T>{static_cast<T *>(node.release())};
+}
+} // namespace
+
+unsigned int Fuser::fuse(const std::unique_ptr<Program> &program) {
+    num_fused_ = 0;
+    visit(program->get_statements());
+
+    return num_fused_;
+}
+
+void Fuser::visit(std::unique_ptr<Expr> &expr) {
+    expr->accept(*this);
+    if (dynamic_cast<Assign *>(expr.get()) != nullptr) {
+        auto assign = downcast<Assign>(expr);
+        expr = fuse(std::move(assign));
+    }
+}
+
+void Fuser::visit(std::unique_ptr<Stmt> &stmt) {
+    stmt->accept(*this);
+    if (dynamic_cast<If *>(stmt.get()) != nullptr) {
+        auto if_stmt = downcast<If>(stmt);
+        stmt = fuse(std::move(if_stmt));
+    } else if (dynamic_cast<While *>(stmt.get()) != nullptr) {
+        auto loop = downcast<While>(stmt);
+        stmt = fuse(std::move(loop));
+    }
+}
+
+void Fuser::visit(std::vector<std::unique_ptr<Stmt>> &stmts) {
+    for (auto &stmt : stmts) {
+        visit(stmt);
+    }
+}
+
+std::optional<LocalComparison> Fuser::local_comparison(const Expr &expr) {
+    const Variable *left = nullptr;
+    const Expr *right = nullptr;
+    const Token *op = nullptr;
+    if (const auto *binary = dynamic_cast<const Binary *>(&expr)) {
+        if (!is_comparison(binary->op.type)) {
+            return std::nullopt;
+        }
+        left = local_variable(*binary->left);
+        right = binary->right.get();
+        op = &binary->op;
+    } else if (const auto *compare = dynamic_cast<const Compare *>(&expr)) {
+        left = local_variable(*compare->variable);
+        right = compare->bound.get();
+        op = &compare->op;
+    }
+    if (left == nullptr) {
+        return std::nullopt;
+    }
+
+    if (const auto *variable = local_variable(*right)) {
+        return LocalComparison{
+            left->slot, *op, operand_node::LOCAL, variable->slot, {}};
+    }
+    if (const auto *literal = dynamic_cast<const Literal *>(right)) {
+        return LocalComparison{
+            left->slot, *op, operand_node::CONSTANT, 0, literal->value};
+    }
+    return std::nullopt;
+}
+
+Return *Fuser::single_return(Stmt &stmt) {
+    if (auto *result = dynamic_cast<Return *>(&stmt)) {
+        return result;
+    }
+    // 使用所在函数栈帧的块, 没有需要关闭的捕获
+    auto *block = dynamic_cast<Block *>(&stmt);
+    if (block == nullptr || block->num_slots != 0 || block->has_captured
+        || block->statements.size() != 1) {
+        return nullptr;
+    }
+    return dynamic_cast<Return *>(block->statements[0].get());
+}
+
+std::unique_ptr<Expr> Fuser::fuse(std::unique_ptr<Assign> assign) {
+    const auto *binary = dynamic_cast<const Binary *>(assign->value.get());
+    if (assign->depth != LOCAL_DEPTH || binary == nullptr
+        || (binary->op.type != token_type::PLUS
+            && binary->op.type != token_type::MINUS)) {
+        return assign;
+    }
+    const auto *variable = local_variable(*binary->left);
+    const auto *literal = dynamic_cast<const Literal *>(binary->right.get());
+    if (variable == nullptr || variable->slot != assign->slot
+        || literal == nullptr) {
+        return assign;
+    }
+
+    num_fused_++;
+    auto op = binary->op;
+    auto constant = literal->value;
+    return std::make_unique<IncrementLocal>(
+        std::move(assign), std::move(op), std::move(constant));
+}
+
+std::unique_ptr<Stmt> Fuser::fuse(std::unique_ptr<If> stmt) {
+    auto condition = local_comparison(*stmt->condition);
+    if (!condition.has_value()) {
+        return stmt;
+    }
+
+    num_fused_++;
+    if (stmt->else_branch == nullptr) {
+        if (auto *result = single_return(*stmt->then_branch)) {
+            return std::make_unique<ReturnIf>(
+                std::move(stmt), std::move(*condition), result);
+        }
+    }
+    return std::make_unique<IfCompare>(std::move(stmt), std::move(*condition));
+}
+
+std::unique_ptr<Stmt> Fuser::fuse(std::unique_ptr<While> stmt) {
+    auto condition = local_comparison(*stmt->condition);
+    if (!condition.has_value()) {
+        return stmt;
+    }
+
+    num_fused_++;
+    return std::make_unique<WhileCompare>(std::move(stmt),
+                                          std::move(*condition));
+}
+
+Value Fuser::visit_binary_expr(Binary *expr) {
+    visit(expr->left);
+    visit(expr->right);
+
+    return {};
+}
+
+Value Fuser::visit_grouping_expr(Grouping *expr) {
+    visit(expr->expr);
+
+    return {};
+}
+
+Value Fuser::visit_literal_expr([[maybe_unused]] Literal *expr) { return {}; }
+
+Value Fuser::visit_logical_expr(Logical *expr) {
+    visit(expr->left);
+    visit(expr->right);
+
+    return {};
+}
+
+Value Fuser::visit_unary_expr(Unary *expr) {
+    visit(expr->right);
+
+    return {};
+}
+
+Value Fuser::visit_variable_expr([[maybe_unused]] Variable *expr) {
+    return {};
+}
+
+Value Fuser::visit_assign_expr(Assign *expr) {
+    visit(expr->value);
+
+    return {};
+}
+
+Value Fuser::visit_call_expr(Call *expr) {
+    visit(expr->callee);
+    for (auto &argument : expr->arguments) {
+        visit(argument);
+    }
+
+    return {};
+}
+
+Value Fuser::visit_inline_call_expr(InlineCall *expr) {
+    // 全局函数被重新赋值时执行原来的调用
+    for (auto &argument : expr->call->arguments) {
+        visit(argument);
+    }
+    visit(expr->body);
+
+    return {};
+}
+
+Value Fuser::visit_increment_expr([[maybe_unused]] Increment *expr) {
+    return {};
+}
+
+Value Fuser::visit_compare_expr(Compare *expr) {
+    visit(expr->bound);
+
+    return {};
+}
+
+Value Fuser::visit_promote_expr(Promote *expr) {
+    visit(expr->expr);
+
+    return {};
+}
+
+Completion Fuser::visit_block_stmt(Block *stmt) {
+    visit(stmt->statements);
+
+    return Completion::NORMAL;
+}
+
+Completion Fuser::visit_expression_stmt(Expression *stmt) {
+    visit(stmt->expression);
+
+    return Completion::NORMAL;
+}
+
+Completion Fuser::visit_var_stmt(Var *stmt) {
+    if (stmt->initializer != nullptr) {
+        visit(stmt->initializer);
+    }
+
+    return Completion::NORMAL;
+}
+
+Completion Fuser::visit_if_stmt(If *stmt) {
+    visit(stmt->condition);
+    visit(stmt->then_branch);
+    if (stmt->else_branch != nullptr) {
+        visit(stmt->else_branch);
+    }
+
+    return Completion::NORMAL;
+}
+
+Completion Fuser::visit_while_stmt(While *stmt) {
+    visit(stmt->condition);
+    visit(stmt->body);
+
+    return Completion::NORMAL;
+}
+
+Completion Fuser::visit_function_stmt(Function *stmt) {
+    visit(stmt->body);
+
+    return Completion::NORMAL;
+}
+
+Completion Fuser::visit_return_stmt(Return *stmt) {
+    if (stmt->value != nullptr) {
+        visit(stmt->value);
+    }
+
+    return Completion::NORMAL;
+}
+
+} // namespace zero::optimizer
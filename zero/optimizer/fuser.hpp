@@ -0,0 +1,66 @@
+#pragma once
+
+#include "ast/expr.hpp"
+#include "ast/program.hpp"
+#include "ast/stmt.hpp"
+
+#include <memory>
+#include <optional>
+#include <vector>
+
+namespace zero::optimizer {
+
+// 节点合并, 在所有优化之后, 只为树遍历解释器运行
+// 把常见的语句形状合并成一个节点, 由解释器的一个visit方法执行:
+// 1. 条件是局部变量与常量或局部变量比较的if/while -> IfCompare/WhileCompare
+// 2. 只有一条return语句的上述if -> ReturnIf
+// 3. x = x +/- 常量, x是局部变量 -> IncrementLocal
+// 需要Resolver计算的槽位
+class Fuser : public ExprVisitor, public StmtVisitor {
+public:
+    // 返回合并生成的节点个数
+    unsigned int fuse(const std::unique_ptr<Program> &program);
+
+public:
+    // Expr抽象类方法
+    Value visit_binary_expr(Binary *expr) override;
+    Value visit_grouping_expr(Grouping *expr) override;
+    Value visit_literal_expr(Literal *expr) override;
+    Value visit_logical_expr(Logical *expr) override;
+    Value visit_unary_expr(Unary *expr) override;
+    Value visit_variable_expr(Variable *expr) override;
+    Value visit_assign_expr(Assign *expr) override;
+    Value visit_call_expr(Call *expr) override;
+    Value visit_inline_call_expr(InlineCall *expr) override;
+    Value visit_increment_expr(Increment *expr) override;
+    Value visit_compare_expr(Compare *expr) override;
+    Value visit_promote_expr(Promote *expr) override;
+
+    // Stmt抽象类方法
+    Completion visit_block_stmt(Block *stmt) override;
+    Completion visit_expression_stmt(Expression *stmt) override;
+    Completion visit_var_stmt(Var *stmt) override;
+    Completion visit_if_stmt(If *stmt) override;
+    Completion visit_while_stmt(While *stmt) override;
+    Completion visit_function_stmt(Function *stmt) override;
+    Completion visit_return_stmt(Return *stmt) override;
+
+private:
+    // 先合并子节点, 再检查节点本身的形状
+    void visit(std::unique_ptr<Expr> &expr);
+    void visit(std::unique_ptr<Stmt> &stmt);
+    void visit(std::vector<std::unique_ptr<Stmt>> &stmts);
+
+    // 条件是局部变量与常量或局部变量的比较时返回比较的操作数
+    static std::optional<LocalComparison> local_comparison(const Expr &expr);
+    // 分支只有一条return语句时返回它
+    static Return *single_return(Stmt &stmt);
+    std::unique_ptr<Expr> fuse(std::unique_ptr<Assign> assign);
+    std::unique_ptr<Stmt> fuse(std::unique_ptr<If> stmt);
+    std::unique_ptr<Stmt> fuse(std::unique_ptr<While> stmt);
+
+private:
+    unsigned int num_fused_{0};
+};
+
+} // namespace zero::optimizer
@@ -0,0 +1,340 @@
+#include "inliner.hpp"
+
+#include <cstdint>
+
+namespace zero::optimizer {
+
+unsigned int Inliner::inline_calls(const std::unique_ptr<Program> &program) {
+    candidates_.clear();
+    num_inlined_ = 0;
+    find_candidates(program->get_statements());
+    if (!candidates_.empty()) {
+        visit(program->get_statements());
+    }
+
+    return num_inlined_;
+}
+
+void Inliner::find_candidates(std::vector<std::unique_ptr<Stmt>> &stmts) {
+    // 同名的全局变量或函数声明了不止一次时, 调用的是哪个要到运行时才知道
+    std::unordered_map<symbol_id, unsigned int> num_declarations;
+    for (const auto &stmt : stmts) {
+        if (auto *var = dynamic_cast<const Var *>(stmt.get())) {
+            num_declarations[var->name.symbol]++;
+        } else if (auto *function = dynamic_cast<const Function *>(stmt.get())) {
+            num_declarations[function->name.symbol]++;
+        }
+    }
+
+    // 带@memoize注解的函数不内联, 否则调用不再经过记忆表
+    for (const auto &stmt : stmts) {
+        auto *function = dynamic_cast<Function *>(stmt.get());
+        if (function == nullptr || function->body.size() != 1
+            || function->memoize || function->params.size() > UINT8_MAX
+            || num_declarations[function->name.symbol] != 1) {
+            continue;
+        }
+        auto *ret = dynamic_cast<Return *>(function->body.front().get());
+        if (ret == nullptr || ret->value == nullptr) {
+            continue;
+        }
+
+        cloning_ = true;
+        num_nodes_ = 0;
+        references_.clear();
+        double_params_.clear();
+        for (std::size_t i = 0; i < function->params.size(); i++) {
+            if (function->param_types[i] == static_type::DOUBLE) {
+                double_params_.insert(function->params[i].symbol);
+            }
+        }
+        auto body = clone(*ret->value);
+        double_params_.clear();
+        cloning_ = false;
+        // 与调用函数时相同, 注解为double的返回值转换成浮点数
+        if (function->return_type == static_type::DOUBLE) {
+            body = std::make_unique<Promote>(std::move(body));
+        }
+
+        // 引用了自己的函数可能是递归的
+        if (num_nodes_ > MAX_INLINE_NODES
+            || references_.count(function->name.symbol) != 0) {
+            continue;
+        }
+        candidates_.emplace(function->name.symbol,
+                            Candidate{function, std::move(body)});
+    }
+}
+
+std::unique_ptr<Expr> Inliner::clone(Expr &expr) {
+    num_nodes_++;
+    expr.accept(*this);
+
+    return std::move(result_);
+}
+
+void Inliner::visit(std::unique_ptr<Expr> &expr) {
+    expr->accept(*this);
+    if (inlining_ == nullptr) {
+        return;
+    }
+
+    // visit_call_expr发现可以内联时, 在这里接管原来的Call节点
+    const auto *candidate = inlining_;
+    inlining_ = nullptr;
+    std::unique_ptr<Call> call{static_cast<Call *>(expr.release())};
+    cloning_ = true;
+    auto body = clone(*candidate->body);
+    cloning_ = false;
+    expr = std::make_unique<InlineCall>(
+        std::move(call), candidate->function, std::move(body));
+    num_inlined_++;
+}
+
+void Inliner::visit(std::vector<std::unique_ptr<Stmt>> &stmts) {
+    for (auto &stmt : stmts) {
+        stmt->accept(*this);
+    }
+}
+
+const Inliner::Candidate *Inliner::find_candidate(const Call &call) const {
+    const auto *callee = dynamic_cast<const Variable *>(call.callee.get());
+    if (callee == nullptr) {
+        return nullptr;
+    }
+    for (const auto &scope : scopes_) {
+        if (scope.count(callee->name.symbol) != 0) {
+            return nullptr;
+        }
+    }
+
+    auto found = candidates_.find(callee->name.symbol);
+    if (found == candidates_.end()
+        || found->second.function->params.size() != call.arguments.size()) {
+        return nullptr;
+    }
+
+    return &found->second;
+}
+
+void Inliner::declare(const Token &name) {
+    if (!scopes_.empty()) {
+        scopes_.back().insert(name.symbol);
+    }
+}
+
+Value Inliner::visit_binary_expr(Binary *expr) {
+    if (cloning_) {
+        auto left = clone(*expr->left);
+        auto right = clone(*expr->right);
+        result_ = std::make_unique<Binary>(
+            std::move(left), expr->op, std::move(right));
+        return {};
+    }
+
+    visit(expr->left);
+    visit(expr->right);
+
+    return {};
+}
+
+Value Inliner::visit_grouping_expr(Grouping *expr) {
+    if (cloning_) {
+        result_ = std::make_unique<Grouping>(clone(*expr->expr));
+        return {};
+    }
+
+    visit(expr->expr);
+
+    return {};
+}
+
+Value Inliner::visit_literal_expr(Literal *expr) {
+    if (cloning_) {
+        result_ = std::make_unique<Literal>(expr->value);
+    }
+
+    return {};
+}
+
+Value Inliner::visit_logical_expr(Logical *expr) {
+    if (cloning_) {
+        auto left = clone(*expr->left);
+        auto right = clone(*expr->right);
+        result_ = std::make_unique<Logical>(
+            std::move(left), expr->op, std::move(right));
+        return {};
+    }
+
+    visit(expr->left);
+    visit(expr->right);
+
+    return {};
+}
+
+Value Inliner::visit_unary_expr(Unary *expr) {
+    if (cloning_) {
+        result_ = std::make_unique<Unary>(expr->op, clone(*expr->right));
+        return {};
+    }
+
+    visit(expr->right);
+
+    return {};
+}
+
+Value Inliner::visit_variable_expr(Variable *expr) {
+    if (cloning_) {
+        references_.insert(expr->name.symbol);
+        result_ = std::make_unique<Variable>(expr->name);
+        if (double_params_.count(expr->name.symbol) != 0) {
+            result_ = std::make_unique<Promote>(std::move(result_));
+        }
+    }
+
+    return {};
+}
+
+Value Inliner::visit_assign_expr(Assign *expr) {
+    if (cloning_) {
+        references_.insert(expr->name.symbol);
+        result_ = std::make_unique<Assign>(expr->name, clone(*expr->value));
+        return {};
+    }
+
+    visit(expr->value);
+
+    return {};
+}
+
+Value Inliner::visit_call_expr(Call *expr) {
+    if (cloning_) {
+        auto callee = clone(*expr->callee);
+        std::vector<std::unique_ptr<Expr>> arguments;
+        for (const auto &argument : expr->arguments) {
+            arguments.push_back(clone(*argument));
+        }
+        result_ = std::make_unique<Call>(
+            std::move(callee), expr->paren, std::move(arguments));
+        return {};
+    }
+
+    visit(expr->callee);
+    for (auto &argument : expr->arguments) {
+        visit(argument);
+    }
+    inlining_ = find_candidate(*expr);
+
+    return {};
+}
+
+Value Inliner::visit_inline_call_expr(InlineCall *expr) {
+    if (cloning_) {
+        std::unique_ptr<Call> call{
+            static_cast<Call *>(clone(*expr->call).release())};
+        auto body = clone(*expr->body);
+        result_ = std::make_unique<InlineCall>(
+            std::move(call), expr->function, std::move(body));
+        return {};
+    }
+
+    for (auto &argument : expr->call->arguments) {
+        visit(argument);
+    }
+
+    return {};
+}
+
+// 循环优化在内联之后进行, 只有复制时需要处理以下节点
+Value Inliner::visit_increment_expr(Increment *expr) {
+    if (cloning_) {
+        references_.insert(expr->name.symbol);
+        result_ = std::make_unique<Increment>(expr->name, expr->op, expr->delta);
+    }
+
+    return {};
+}
+
+Value Inliner::visit_compare_expr(Compare *expr) {
+    if (cloning_) {
+        references_.insert(expr->variable->name.symbol);
+        auto variable = std::make_unique<Variable>(expr->variable->name);
+        result_ = std::make_unique<Compare>(
+            std::move(variable), expr->op, clone(*expr->bound));
+    }
+
+    return {};
+}
+
+Value Inliner::visit_promote_expr(Promote *expr) {
+    if (cloning_) {
+        result_ = std::make_unique<Promote>(clone(*expr->expr));
+    } else {
+        visit(expr->expr);
+    }
+
+    return {};
+}
+
+Completion Inliner::visit_block_stmt(Block *stmt) {
+    begin_scope();
+    visit(stmt->statements);
+    end_scope();
+
+    return Completion::NORMAL;
+}
+
+Completion Inliner::visit_expression_stmt(Expression *stmt) {
+    visit(stmt->expression);
+
+    return Completion::NORMAL;
+}
+
+Completion Inliner::visit_var_stmt(Var *stmt) {
+    if (stmt->initializer != nullptr) {
+        visit(stmt->initializer);
+    }
+    declare(stmt->name);
+
+    return Completion::NORMAL;
+}
+
+Completion Inliner::visit_if_stmt(If *stmt) {
+    visit(stmt->condition);
+    stmt->then_branch->accept(*this);
+    if (stmt->else_branch != nullptr) {
+        stmt->else_branch->accept(*this);
+    }
+
+    return Completion::NORMAL;
+}
+
+Completion Inliner::visit_while_stmt(While *stmt) {
+    visit(stmt->condition);
+    stmt->body->accept(*this);
+
+    return Completion::NORMAL;
+}
+
+Completion Inliner::visit_function_stmt(Function *stmt) {
+    declare(stmt->name);
+
+    begin_scope();
+    for (const auto &param : stmt->params) {
+        declare(param);
+    }
+    visit(stmt->body);
+    end_scope();
+
+    return Completion::NORMAL;
+}
+
+Completion Inliner::visit_return_stmt(Return *stmt) {
+    if (stmt->value != nullptr) {
+        visit(stmt->value);
+    }
+
+    return Completion::NORMAL;
+}
+
+} // namespace zero::optimizer
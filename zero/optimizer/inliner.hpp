@@ -0,0 +1,86 @@
+#pragma once
+
+#include "ast/expr.hpp"
+#include "ast/program.hpp"
+#include "ast/stmt.hpp"
+#include "symbol.hpp"
+
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace zero::optimizer {
+
+// 函数内联, 在常量折叠之后, Resolver之前运行
+// 函数体只有一条return语句, 返回表达式不超过MAX_INLINE_NODES个节点,
+// 并且没有引用自己的全局函数, 在调用处展开成InlineCall
+class Inliner : public ExprVisitor, public StmtVisitor {
+public:
+    // 返回内联的调用个数
+    unsigned int inline_calls(const std::unique_ptr<Program> &program);
+
+public:
+    // Expr抽象类方法, 复制表达式时结果保存在result_中
+    Value visit_binary_expr(Binary *expr) override;
+    Value visit_grouping_expr(Grouping *expr) override;
+    Value visit_literal_expr(Literal *expr) override;
+    Value visit_logical_expr(Logical *expr) override;
+    Value visit_unary_expr(Unary *expr) override;
+    Value visit_variable_expr(Variable *expr) override;
+    Value visit_assign_expr(Assign *expr) override;
+    Value visit_call_expr(Call *expr) override;
+    Value visit_inline_call_expr(InlineCall *expr) override;
+    Value visit_increment_expr(Increment *expr) override;
+    Value visit_compare_expr(Compare *expr) override;
+    Value visit_promote_expr(Promote *expr) override;
+
+    // Stmt抽象类方法
+    Completion visit_block_stmt(Block *stmt) override;
+    Completion visit_expression_stmt(Expression *stmt) override;
+    Completion visit_var_stmt(Var *stmt) override;
+    Completion visit_if_stmt(If *stmt) override;
+    Completion visit_while_stmt(While *stmt) override;
+    Completion visit_function_stmt(Function *stmt) override;
+    Completion visit_return_stmt(Return *stmt) override;
+
+private:
+    static constexpr unsigned int MAX_INLINE_NODES = 16;
+
+    // 可以内联的函数
+    struct Candidate {
+        Function *function;
+        // 函数体被改写之前复制的返回表达式, 每个调用处再复制一份
+        std::unique_ptr<Expr> body;
+    };
+
+    void find_candidates(std::vector<std::unique_ptr<Stmt>> &stmts);
+    // 复制表达式, 同时统计节点数和引用的变量名
+    std::unique_ptr<Expr> clone(Expr &expr);
+
+    void visit(std::unique_ptr<Expr> &expr);
+    void visit(std::vector<std::unique_ptr<Stmt>> &stmts);
+    // 调用的是没有被局部变量遮蔽的候选函数时返回它
+    const Candidate *find_candidate(const Call &call) const;
+
+    void begin_scope() { scopes_.emplace_back(); }
+    void end_scope() { scopes_.pop_back(); }
+    void declare(const Token &name);
+
+private:
+    std::unordered_map<symbol_id, Candidate> candidates_;
+    std::vector<std::unordered_set<symbol_id>> scopes_; // 局部变量名
+    unsigned int num_inlined_{0};
+
+    // 复制表达式时使用
+    bool cloning_{false};
+    std::unique_ptr<Expr> result_;
+    unsigned int num_nodes_{0};
+    std::unordered_set<symbol_id> references_;
+    // 注解为double的参数, 复制返回表达式时引用处转换成浮点数
+    std::unordered_set<symbol_id> double_params_;
+    // 改写调用时使用: visit_call_expr找到的可以内联的函数
+    const Candidate *inlining_{nullptr};
+};
+
+} // namespace zero::optimizer
@@ -0,0 +1,622 @@
+#include "loop_optimizer.hpp"
+
+#include <string>
+
+namespace zero::optimizer {
+
+namespace {
+bool is_comparison(token_type type) {
+    return type == token_type::LESS || type == token_type::LESS_EQUAL
+           || type == token_type::GREATER || type == token_type::GREATER_EQUAL;
+}
+
+// 交换操作数后的比较运算符
+Token flip_comparison(Token op) {
+    switch (op.type) {
+        case token_type::LESS:
+            op.type = token_type::GREATER;
+            op.lexeme = ">";
+            break;
+        case token_type::LESS_EQUAL:
+            op.type = token_type::GREATER_EQUAL;
+            op.lexeme = ">=";
+            break;
+        case token_type::GREATER:
+            op.type = token_type::LESS;
+            op.lexeme = "<";
+            break;
+        default:
+            op.type = token_type::LESS_EQUAL;
+            op.lexeme = "<=";
+            break;
+    }
+
+    return op;
+}
+
+// 外提的表达式中一定有运算符, 用它的行号作为临时变量的行号
+unsigned int line_of(const Expr &expr) {
+    if (const auto *binary = dynamic_cast<const Binary *>(&expr)) {
+        return binary->op.line;
+    }
+    if (const auto *logical = dynamic_cast<const Logical *>(&expr)) {
+        return logical->op.line;
+    }
+    if (const auto *unary = dynamic_cast<const Unary *>(&expr)) {
+        return unary->op.line;
+    }
+    if (const auto *grouping = dynamic_cast<const Grouping *>(&expr)) {
+        return line_of(*grouping->expr);
+    }
+    return 0;
+}
+} // namespace
+
+unsigned int LoopOptimizer::optimize(const std::unique_ptr<Program> &program) {
+    vars_.clear();
+    aliases_.clear();
+    resolved_.clear();
+    num_hoisted_ = 0;
+    num_specialized_ = 0;
+
+    mode_ = Mode::ANALYZE;
+    visit(program->get_statements());
+    infer_numeric();
+
+    mode_ = Mode::OPTIMIZE;
+    visit(program->get_statements());
+
+    return num_hoisted_;
+}
+
+void LoopOptimizer::visit(std::unique_ptr<Expr> &expr) {
+    if (mode_ == Mode::HOIST && hoist(expr)) {
+        return;
+    }
+    expr->accept(*this);
+    if (replacement_ != nullptr) {
+        expr = std::move(replacement_);
+    }
+}
+
+void LoopOptimizer::visit(std::unique_ptr<Stmt> &stmt) {
+    stmt->accept(*this);
+    if (mode_ != Mode::OPTIMIZE || hoisted_.empty()) {
+        return;
+    }
+
+    // 外提的变量在循环之前声明, 和循环一起放到新的块中
+    auto statements = std::move(hoisted_);
+    hoisted_.clear();
+    statements.push_back(std::move(stmt));
+    stmt = std::make_unique<Block>(std::move(statements));
+}
+
+void LoopOptimizer::visit(std::vector<std::unique_ptr<Stmt>> &stmts) {
+    for (auto &stmt : stmts) {
+        visit(stmt);
+    }
+}
+
+void LoopOptimizer::declare(const Token &name, const Expr *value) {
+    if (scopes_.empty()) {
+        return;
+    }
+
+    // 同一作用域中重复声明的变量共用一个槽位, 相当于对之前的变量赋值
+    auto [found, inserted] = scopes_.back().emplace(name.symbol, &name);
+    if (inserted) {
+        vars_.emplace(&name, VarInfo{function_, {}});
+    } else {
+        aliases_.emplace(&name, found->second);
+    }
+    info(found->second)->values.push_back(value);
+}
+
+LoopOptimizer::Name LoopOptimizer::lookup(const Token &name) const {
+    for (auto scope = scopes_.rbegin(); scope != scopes_.rend(); ++scope) {
+        auto found = scope->find(name.symbol);
+        if (found != scope->end()) {
+            return found->second;
+        }
+    }
+
+    return nullptr;
+}
+
+LoopOptimizer::Name LoopOptimizer::resolved(const Expr &expr) const {
+    auto found = resolved_.find(&expr);
+    return found != resolved_.end() ? found->second : nullptr;
+}
+
+LoopOptimizer::VarInfo *LoopOptimizer::info(Name name) {
+    auto found = vars_.find(name);
+    return found != vars_.end() ? &found->second : nullptr;
+}
+
+LoopOptimizer::Name LoopOptimizer::canonical(Name name) const {
+    auto found = aliases_.find(name);
+    return found != aliases_.end() ? found->second : name;
+}
+
+void LoopOptimizer::infer_numeric() {
+    // 先假设所有变量都是数值, 再不断排除有非数值赋值的变量, 直到不再变化
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (auto &[var, info] : vars_) {
+            if (!info.numeric) {
+                continue;
+            }
+            for (const auto *value : info.values) {
+                if (value == nullptr || !is_numeric(*value)) {
+                    info.numeric = false;
+                    changed = true;
+                    break;
+                }
+            }
+        }
+    }
+}
+
+bool LoopOptimizer::is_numeric(const Expr &expr) {
+    if (const auto *literal = dynamic_cast<const Literal *>(&expr)) {
+        return literal->value.is_int() || literal->value.is_double();
+    }
+    if (dynamic_cast<const Variable *>(&expr) != nullptr) {
+        auto *var_info = info(resolved(expr));
+        return var_info != nullptr && var_info->numeric;
+    }
+    if (const auto *grouping = dynamic_cast<const Grouping *>(&expr)) {
+        return is_numeric(*grouping->expr);
+    }
+    if (const auto *unary = dynamic_cast<const Unary *>(&expr)) {
+        return unary->op.type == token_type::MINUS;
+    }
+    if (const auto *binary = dynamic_cast<const Binary *>(&expr)) {
+        switch (binary->op.type) {
+            case token_type::MINUS:
+            case token_type::STAR:
+            case token_type::SLASH:
+                return true;
+            case token_type::PLUS:
+                // 两个字符串相加得到字符串
+                return is_numeric(*binary->left) && is_numeric(*binary->right);
+            default:
+                return false;
+        }
+    }
+
+    return false;
+}
+
+bool LoopOptimizer::never_throws(const Expr &expr) {
+    if (dynamic_cast<const Literal *>(&expr) != nullptr
+        || dynamic_cast<const Variable *>(&expr) != nullptr) {
+        return true;
+    }
+    if (const auto *grouping = dynamic_cast<const Grouping *>(&expr)) {
+        return never_throws(*grouping->expr);
+    }
+    if (const auto *logical = dynamic_cast<const Logical *>(&expr)) {
+        return never_throws(*logical->left) && never_throws(*logical->right);
+    }
+    if (const auto *unary = dynamic_cast<const Unary *>(&expr)) {
+        return never_throws(*unary->right)
+               && (unary->op.type == token_type::NOT
+                   || is_numeric(*unary->right));
+    }
+    if (const auto *binary = dynamic_cast<const Binary *>(&expr)) {
+        if (!never_throws(*binary->left) || !never_throws(*binary->right)) {
+            return false;
+        }
+        switch (binary->op.type) {
+            case token_type::EQUAL_EQUAL:
+            case token_type::NOT_EQUAL:
+                return true;
+            case token_type::SLASH:
+                // 整数除以0会出错
+                return false;
+            default:
+                return is_numeric(*binary->left)
+                       && is_numeric(*binary->right);
+        }
+    }
+
+    return false;
+}
+
+bool LoopOptimizer::is_invariant(const Expr &expr) {
+    if (dynamic_cast<const Literal *>(&expr) != nullptr) {
+        return true;
+    }
+    if (dynamic_cast<const Variable *>(&expr) != nullptr) {
+        // 循环中的调用可能执行在其他函数中对变量的赋值
+        auto name = resolved(expr);
+        auto *var_info = info(name);
+        return var_info != nullptr && assigned_.count(name) == 0
+               && (!has_call_ || !var_info->assigned_in_closure);
+    }
+    if (const auto *grouping = dynamic_cast<const Grouping *>(&expr)) {
+        return is_invariant(*grouping->expr);
+    }
+    if (const auto *logical = dynamic_cast<const Logical *>(&expr)) {
+        return is_invariant(*logical->left) && is_invariant(*logical->right);
+    }
+    if (const auto *unary = dynamic_cast<const Unary *>(&expr)) {
+        return is_invariant(*unary->right);
+    }
+    if (const auto *binary = dynamic_cast<const Binary *>(&expr)) {
+        return is_invariant(*binary->left) && is_invariant(*binary->right);
+    }
+
+    return false;
+}
+
+bool LoopOptimizer::is_worth_hoisting(const Expr &expr) {
+    if (const auto *grouping = dynamic_cast<const Grouping *>(&expr)) {
+        return is_worth_hoisting(*grouping->expr);
+    }
+    return dynamic_cast<const Binary *>(&expr) != nullptr
+           || dynamic_cast<const Logical *>(&expr) != nullptr
+           || dynamic_cast<const Unary *>(&expr) != nullptr;
+}
+
+std::optional<int64_t>
+LoopOptimizer::increment_delta(const Assign &assign) const {
+    const auto *binary = dynamic_cast<const Binary *>(assign.value.get());
+    if (binary == nullptr
+        || (binary->op.type != token_type::PLUS
+            && binary->op.type != token_type::MINUS)) {
+        return std::nullopt;
+    }
+    const auto *variable = dynamic_cast<const Variable *>(binary->left.get());
+    const auto *literal = dynamic_cast<const Literal *>(binary->right.get());
+    if (variable == nullptr || resolved(*variable) != resolved(assign)
+        || literal == nullptr || !literal->value.is_int()) {
+        return std::nullopt;
+    }
+
+    auto step = literal->value.as_int();
+    if (binary->op.type == token_type::PLUS) {
+        return step;
+    }
+    if (step == INT64_MIN) {
+        return std::nullopt;
+    }
+    return -step;
+}
+
+void LoopOptimizer::optimize_loop(While &loop) {
+    // 条件中没有调用和赋值时, 第一次求值之前不会发生任何可见的事情
+    mode_ = Mode::COLLECT;
+    assigned_.clear();
+    updates_.clear();
+    has_call_ = false;
+    visit(loop.condition);
+    condition_may_throw_ = has_call_ || !assigned_.empty();
+    visit(loop.body);
+
+    // 可能出错的表达式只能从条件中外提, 条件至少会被求值一次
+    mode_ = Mode::HOIST;
+    in_condition_ = true;
+    visit(loop.condition);
+    in_condition_ = false;
+    visit(loop.body);
+
+    induction_.clear();
+    for (const auto &[name, increments_only] : updates_) {
+        const auto *var_info = info(name);
+        if (increments_only && var_info->function == function_
+            && var_info->numeric && !var_info->assigned_in_closure) {
+            induction_.insert(name);
+        }
+    }
+    if (!induction_.empty()) {
+        mode_ = Mode::SPECIALIZE;
+        in_condition_ = true;
+        visit(loop.condition);
+        in_condition_ = false;
+        visit(loop.body);
+    }
+
+    mode_ = Mode::OPTIMIZE;
+}
+
+bool LoopOptimizer::hoist(std::unique_ptr<Expr> &expr) {
+    if (hoisted_.size() == MAX_HOISTED || !is_worth_hoisting(*expr)
+        || !is_invariant(*expr)) {
+        return false;
+    }
+    if (!never_throws(*expr) && (!in_condition_ || condition_may_throw_)) {
+        return false;
+    }
+
+    // 临时变量名以$开头, 不会和源码中的标识符冲突
+    auto &symbols = SymbolTable::instance();
+    auto symbol = symbols.intern("$" + std::to_string(num_hoisted_++));
+    Token name{token_type::IDENTIFIER, symbols.name(symbol), line_of(*expr)};
+    name.symbol = symbol;
+
+    auto variable = std::make_unique<Variable>(name);
+    auto declaration = std::make_unique<Var>(name, std::move(expr));
+    const auto *initializer = declaration->initializer.get();
+    vars_.emplace(&declaration->name,
+                  VarInfo{function_, {initializer}, is_numeric(*initializer)});
+    resolved_.emplace(variable.get(), &declaration->name);
+
+    expr = std::move(variable);
+    hoisted_.push_back(std::move(declaration));
+    return true;
+}
+
+std::unique_ptr<Expr> LoopOptimizer::specialize_compare(Binary &expr) {
+    auto is_induction = [this](const std::unique_ptr<Expr> &operand) {
+        return dynamic_cast<const Variable *>(operand.get()) != nullptr
+               && induction_.count(resolved(*operand)) != 0;
+    };
+    auto is_bound = [](const std::unique_ptr<Expr> &operand) {
+        return dynamic_cast<const Literal *>(operand.get()) != nullptr
+               || dynamic_cast<const Variable *>(operand.get()) != nullptr;
+    };
+
+    // 两个操作数都没有副作用, 交换求值顺序不影响结果
+    if (is_induction(expr.left) && is_bound(expr.right)) {
+        std::unique_ptr<Variable> variable{
+            static_cast<Variable *>(expr.left.release())};
+        return std::make_unique<Compare>(
+            std::move(variable), expr.op, std::move(expr.right));
+    }
+    if (is_induction(expr.right) && is_bound(expr.left)) {
+        std::unique_ptr<Variable> variable{
+            static_cast<Variable *>(expr.right.release())};
+        return std::make_unique<Compare>(
+            std::move(variable), flip_comparison(expr.op), std::move(expr.left));
+    }
+
+    return nullptr;
+}
+
+Value LoopOptimizer::visit_binary_expr(Binary *expr) {
+    visit(expr->left);
+    visit(expr->right);
+
+    if (mode_ == Mode::HOIST && in_condition_ && !never_throws(*expr)) {
+        condition_may_throw_ = true;
+    } else if (mode_ == Mode::SPECIALIZE && in_condition_
+               && is_comparison(expr->op.type)) {
+        replacement_ = specialize_compare(*expr);
+        if (replacement_ != nullptr) {
+            num_specialized_++;
+        }
+    }
+
+    return {};
+}
+
+Value LoopOptimizer::visit_grouping_expr(Grouping *expr) {
+    visit(expr->expr);
+
+    return {};
+}
+
+Value LoopOptimizer::visit_literal_expr([[maybe_unused]] Literal *expr) {
+    return {};
+}
+
+Value LoopOptimizer::visit_logical_expr(Logical *expr) {
+    visit(expr->left);
+    // 右操作数不一定会被求值
+    if (mode_ == Mode::HOIST && in_condition_) {
+        condition_may_throw_ = true;
+    }
+    visit(expr->right);
+
+    return {};
+}
+
+Value LoopOptimizer::visit_unary_expr(Unary *expr) {
+    visit(expr->right);
+
+    if (mode_ == Mode::HOIST && in_condition_ && !never_throws(*expr)) {
+        condition_may_throw_ = true;
+    }
+
+    return {};
+}
+
+Value LoopOptimizer::visit_variable_expr(Variable *expr) {
+    if (mode_ == Mode::ANALYZE) {
+        resolved_.emplace(expr, lookup(expr->name));
+    }
+
+    return {};
+}
+
+Value LoopOptimizer::visit_assign_expr(Assign *expr) {
+    visit(expr->value);
+
+    if (mode_ == Mode::ANALYZE) {
+        auto name = lookup(expr->name);
+        resolved_.emplace(expr, name);
+        if (auto *var_info = info(name)) {
+            var_info->values.push_back(expr->value.get());
+            if (var_info->function != function_) {
+                var_info->assigned_in_closure = true;
+            }
+        }
+    } else if (mode_ == Mode::COLLECT) {
+        auto name = resolved(*expr);
+        if (name != nullptr) {
+            assigned_.insert(name);
+            bool increment = increment_delta(*expr).has_value();
+            auto [found, inserted] = updates_.emplace(name, increment);
+            found->second = found->second && increment;
+        }
+    } else if (mode_ == Mode::SPECIALIZE) {
+        auto name = resolved(*expr);
+        auto delta = increment_delta(*expr);
+        if (induction_.count(name) != 0 && delta.has_value()) {
+            const auto &op = static_cast<const Binary &>(*expr->value).op;
+            auto increment
+                = std::make_unique<Increment>(expr->name, op, *delta);
+            resolved_.emplace(increment.get(), name);
+            replacement_ = std::move(increment);
+            num_specialized_++;
+        }
+    }
+
+    return {};
+}
+
+Value LoopOptimizer::visit_call_expr(Call *expr) {
+    if (mode_ == Mode::COLLECT) {
+        has_call_ = true;
+    }
+    visit(expr->callee);
+    for (auto &argument : expr->arguments) {
+        visit(argument);
+    }
+
+    return {};
+}
+
+Value LoopOptimizer::visit_inline_call_expr(InlineCall *expr) {
+    // 全局函数被重新赋值时会执行原来的调用
+    // 返回表达式中只有参数和全局变量, 不需要处理
+    if (mode_ == Mode::COLLECT) {
+        has_call_ = true;
+    }
+    for (auto &argument : expr->call->arguments) {
+        visit(argument);
+    }
+
+    return {};
+}
+
+Value LoopOptimizer::visit_increment_expr(Increment *expr) {
+    // 外层循环已经改写过的归纳变量
+    if (mode_ == Mode::COLLECT) {
+        auto name = resolved(*expr);
+        assigned_.insert(name);
+        updates_.emplace(name, true);
+    }
+
+    return {};
+}
+
+Value LoopOptimizer::visit_compare_expr(Compare *expr) {
+    visit(expr->bound);
+
+    return {};
+}
+
+Value LoopOptimizer::visit_promote_expr(Promote *expr) {
+    visit(expr->expr);
+
+    return {};
+}
+
+Completion LoopOptimizer::visit_block_stmt(Block *stmt) {
+    if (mode_ == Mode::ANALYZE) {
+        begin_scope();
+        visit(stmt->statements);
+        end_scope();
+    } else {
+        visit(stmt->statements);
+    }
+
+    return Completion::NORMAL;
+}
+
+Completion LoopOptimizer::visit_expression_stmt(Expression *stmt) {
+    if (mode_ != Mode::OPTIMIZE) {
+        visit(stmt->expression);
+    }
+
+    return Completion::NORMAL;
+}
+
+Completion LoopOptimizer::visit_var_stmt(Var *stmt) {
+    if (mode_ != Mode::OPTIMIZE && stmt->initializer != nullptr) {
+        visit(stmt->initializer);
+    }
+
+    if (mode_ == Mode::ANALYZE) {
+        declare(stmt->name, stmt->initializer.get());
+    } else if (mode_ == Mode::COLLECT) {
+        // 循环中声明的变量每次迭代都会重新赋值
+        auto name = canonical(&stmt->name);
+        if (info(name) != nullptr) {
+            assigned_.insert(name);
+            updates_[name] = false;
+        }
+    }
+
+    return Completion::NORMAL;
+}
+
+Completion LoopOptimizer::visit_if_stmt(If *stmt) {
+    if (mode_ != Mode::OPTIMIZE) {
+        visit(stmt->condition);
+    }
+    visit(stmt->then_branch);
+    if (stmt->else_branch != nullptr) {
+        visit(stmt->else_branch);
+    }
+
+    return Completion::NORMAL;
+}
+
+Completion LoopOptimizer::visit_while_stmt(While *stmt) {
+    if (mode_ != Mode::OPTIMIZE) {
+        visit(stmt->condition);
+        visit(stmt->body);
+        return Completion::NORMAL;
+    }
+
+    // 先处理外层循环, 内层循环中对外层不变的表达式可以一次提到最外面
+    optimize_loop(*stmt);
+    auto hoisted = std::move(hoisted_);
+    hoisted_.clear();
+    visit(stmt->body);
+    hoisted_ = std::move(hoisted);
+
+    return Completion::NORMAL;
+}
+
+Completion LoopOptimizer::visit_function_stmt(Function *stmt) {
+    // 函数体不在循环的每次迭代中执行, 但是其中的赋值可能在调用时执行
+    if (mode_ == Mode::HOIST || mode_ == Mode::SPECIALIZE) {
+        return Completion::NORMAL;
+    }
+
+    if (mode_ == Mode::ANALYZE) {
+        declare(stmt->name, nullptr);
+        begin_scope();
+    }
+    const auto *enclosing = function_;
+    function_ = stmt;
+    if (mode_ == Mode::ANALYZE) {
+        for (const auto &param : stmt->params) {
+            declare(param, nullptr);
+        }
+    }
+    visit(stmt->body);
+    function_ = enclosing;
+    if (mode_ == Mode::ANALYZE) {
+        end_scope();
+    }
+
+    return Completion::NORMAL;
+}
+
+Completion LoopOptimizer::visit_return_stmt(Return *stmt) {
+    if (mode_ != Mode::OPTIMIZE && stmt->value != nullptr) {
+        visit(stmt->value);
+    }
+
+    return Completion::NORMAL;
+}
+
+} // namespace zero::optimizer
@@ -0,0 +1,134 @@
+#pragma once
+
+#include "ast/expr.hpp"
+#include "ast/program.hpp"
+#include "ast/stmt.hpp"
+#include "symbol.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace zero::optimizer {
+
+// 循环优化, 在内联之后, Resolver之前运行
+// 1. 循环不变量外提: 循环中不会改变的表达式在循环之前计算一次,
+//    保存在新的局部变量中, 循环用Block包起来声明这些变量
+// 2. 归纳变量: 循环中只以 i = i + 整数 的形式更新的数值局部变量,
+//    更新改写成Increment, 循环条件中与它的比较改写成Compare
+// 全局变量可能被其他代码修改, 只处理局部变量
+class LoopOptimizer : public ExprVisitor, public StmtVisitor {
+public:
+    // 返回外提的表达式个数
+    unsigned int optimize(const std::unique_ptr<Program> &program);
+    // 改写成Increment和Compare的节点个数
+    unsigned int num_specialized() const { return num_specialized_; }
+
+public:
+    // Expr抽象类方法
+    Value visit_binary_expr(Binary *expr) override;
+    Value visit_grouping_expr(Grouping *expr) override;
+    Value visit_literal_expr(Literal *expr) override;
+    Value visit_logical_expr(Logical *expr) override;
+    Value visit_unary_expr(Unary *expr) override;
+    Value visit_variable_expr(Variable *expr) override;
+    Value visit_assign_expr(Assign *expr) override;
+    Value visit_call_expr(Call *expr) override;
+    Value visit_inline_call_expr(InlineCall *expr) override;
+    Value visit_increment_expr(Increment *expr) override;
+    Value visit_compare_expr(Compare *expr) override;
+    Value visit_promote_expr(Promote *expr) override;
+
+    // Stmt抽象类方法
+    Completion visit_block_stmt(Block *stmt) override;
+    Completion visit_expression_stmt(Expression *stmt) override;
+    Completion visit_var_stmt(Var *stmt) override;
+    Completion visit_if_stmt(If *stmt) override;
+    Completion visit_while_stmt(While *stmt) override;
+    Completion visit_function_stmt(Function *stmt) override;
+    Completion visit_return_stmt(Return *stmt) override;
+
+private:
+    // 每个循环最多外提的表达式个数, 避免占用太多局部变量槽位
+    static constexpr std::size_t MAX_HOISTED = 8;
+
+    enum class Mode {
+        ANALYZE,    // 解析变量, 记录每个局部变量的所有赋值
+        OPTIMIZE,   // 查找循环
+        COLLECT,    // 收集当前循环中被赋值的变量和调用
+        HOIST,      // 外提循环不变量
+        SPECIALIZE, // 改写归纳变量的更新和比较
+    };
+
+    // 局部变量用声明它的Token的地址标识, 包括参数和函数名
+    using Name = const Token *;
+
+    // 局部变量的分析结果
+    struct VarInfo {
+        const Function *function; // 声明所在的函数, 顶层代码为nullptr
+        // 初始值和所有赋值的右侧表达式, 值未知(参数, 函数等)时为nullptr
+        std::vector<const Expr *> values;
+        bool numeric{true};               // 值始终是数值
+        bool assigned_in_closure{false}; // 在其他函数中被赋值
+    };
+
+    void visit(std::unique_ptr<Expr> &expr);
+    void visit(std::unique_ptr<Stmt> &stmt);
+    void visit(std::vector<std::unique_ptr<Stmt>> &stmts);
+
+    void begin_scope() { scopes_.emplace_back(); }
+    void end_scope() { scopes_.pop_back(); }
+    // 声明局部变量并记录它的初始值
+    void declare(const Token &name, const Expr *value);
+    Name lookup(const Token &name) const;
+    // 表达式引用的局部变量, 全局变量返回nullptr
+    Name resolved(const Expr &expr) const;
+    VarInfo *info(Name name);
+    // 重复声明的变量对应第一次声明
+    Name canonical(Name name) const;
+    void infer_numeric();
+
+    // 求值成功时结果一定是数值
+    bool is_numeric(const Expr &expr);
+    // 求值不会出错
+    bool never_throws(const Expr &expr);
+    bool is_invariant(const Expr &expr);
+    // 单独的变量和常量不需要外提
+    static bool is_worth_hoisting(const Expr &expr);
+    // i = i + 整数 的增量, 不是这种形式时返回nullopt
+    std::optional<int64_t> increment_delta(const Assign &assign) const;
+
+    void optimize_loop(While &loop);
+    bool hoist(std::unique_ptr<Expr> &expr);
+    // 把归纳变量与Literal或Variable的比较改写成Compare
+    std::unique_ptr<Expr> specialize_compare(Binary &expr);
+
+private:
+    Mode mode_{Mode::ANALYZE};
+    std::vector<std::unordered_map<symbol_id, Name>> scopes_;
+    const Function *function_{nullptr}; // 正在访问的函数
+    std::unordered_map<Name, VarInfo> vars_;
+    // 同一作用域中重复声明的变量共用一个槽位, 指向第一次声明
+    std::unordered_map<Name, Name> aliases_;
+    std::unordered_map<const Expr *, Name> resolved_;
+
+    // 当前循环的信息
+    std::unordered_set<Name> assigned_;
+    // 循环中被赋值的变量 -> 是否只以 i = i + 整数 的形式更新
+    std::unordered_map<Name, bool> updates_;
+    std::unordered_set<Name> induction_;
+    bool has_call_{false};
+    bool in_condition_{false};
+    // 条件中之前的计算可能出错或者有副作用, 可能出错的表达式不能再外提
+    bool condition_may_throw_{false};
+    std::vector<std::unique_ptr<Stmt>> hoisted_;
+
+    std::unique_ptr<Expr> replacement_;
+    unsigned int num_hoisted_{0};
+    unsigned int num_specialized_{0};
+};
+
+} // namespace zero::optimizer
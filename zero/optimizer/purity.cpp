@@ -0,0 +1,246 @@
+#include "purity.hpp"
+
+#include "memo.hpp"
+
+namespace zero::optimizer {
+
+std::vector<Function *>
+PurityAnalyzer::memoize(const std::unique_ptr<Program> &program) {
+    functions_.clear();
+    candidates_.clear();
+    assigned_globals_.clear();
+    rejected_.clear();
+    current_ = nullptr;
+    visit(program->get_statements());
+
+    // 同名的全局变量或函数声明了不止一次时, 引用的是哪个要到运行时才知道
+    std::unordered_map<symbol_id, unsigned int> num_declarations;
+    for (const auto &stmt : program->get_statements()) {
+        if (auto *var = dynamic_cast<const Var *>(stmt.get())) {
+            num_declarations[var->name.symbol]++;
+        } else if (auto *function = dynamic_cast<const Function *>(stmt.get())) {
+            num_declarations[function->name.symbol]++;
+        }
+    }
+    for (const auto &info : functions_) {
+        const auto &name = info.function->name;
+        if (!interactive_ && info.function->depth == GLOBAL_DEPTH
+            && num_declarations[name.symbol] == 1
+            && assigned_globals_.count(name.symbol) == 0) {
+            candidates_.emplace(name.symbol, &info);
+        }
+    }
+    propagate();
+
+    std::vector<Function *> memoized;
+    num_pure_ = 0;
+    for (auto &info : functions_) {
+        if (!info.pure) {
+            if (info.function->memoize) {
+                rejected_.push_back(info.function);
+            }
+            continue;
+        }
+        num_pure_++;
+        if (memoize_all_ || info.function->memoize) {
+            info.function->memo
+                = std::make_shared<MemoTable>(info.function->params.size());
+            memoized.push_back(info.function);
+        }
+    }
+
+    return memoized;
+}
+
+void PurityAnalyzer::visit(std::vector<std::unique_ptr<Stmt>> &stmts) {
+    for (auto &stmt : stmts) {
+        stmt->accept(*this);
+    }
+}
+
+void PurityAnalyzer::reference(const Token &name, int depth) {
+    if (current_ == nullptr || depth == LOCAL_DEPTH) {
+        return;
+    }
+    if (depth == GLOBAL_DEPTH) {
+        current_->references.push_back(name.symbol);
+    } else {
+        // 捕获的变量可能被外层函数修改
+        mark_impure();
+    }
+}
+
+void PurityAnalyzer::assign(const Token &name, int depth) {
+    if (depth == GLOBAL_DEPTH) {
+        assigned_globals_.insert(name.symbol);
+    }
+    if (depth != LOCAL_DEPTH) {
+        mark_impure();
+    }
+}
+
+void PurityAnalyzer::mark_impure() {
+    if (current_ != nullptr) {
+        current_->pure = false;
+    }
+}
+
+void PurityAnalyzer::propagate() {
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (auto &info : functions_) {
+            if (!info.pure) {
+                continue;
+            }
+            for (auto symbol : info.references) {
+                auto found = candidates_.find(symbol);
+                if (found == candidates_.end() || !found->second->pure) {
+                    info.pure = false;
+                    changed = true;
+                    break;
+                }
+            }
+        }
+    }
+}
+
+Value PurityAnalyzer::visit_binary_expr(Binary *expr) {
+    expr->left->accept(*this);
+    expr->right->accept(*this);
+
+    return {};
+}
+
+Value PurityAnalyzer::visit_grouping_expr(Grouping *expr) {
+    expr->expr->accept(*this);
+
+    return {};
+}
+
+Value PurityAnalyzer::visit_literal_expr([[maybe_unused]] Literal *expr) {
+    return {};
+}
+
+Value PurityAnalyzer::visit_logical_expr(Logical *expr) {
+    expr->left->accept(*this);
+    expr->right->accept(*this);
+
+    return {};
+}
+
+Value PurityAnalyzer::visit_unary_expr(Unary *expr) {
+    expr->right->accept(*this);
+
+    return {};
+}
+
+Value PurityAnalyzer::visit_variable_expr(Variable *expr) {
+    reference(expr->name, expr->depth);
+
+    return {};
+}
+
+Value PurityAnalyzer::visit_assign_expr(Assign *expr) {
+    expr->value->accept(*this);
+    assign(expr->name, expr->depth);
+
+    return {};
+}
+
+Value PurityAnalyzer::visit_call_expr(Call *expr) {
+    // 只能调用全局函数, 局部变量中的函数是哪个要到运行时才知道
+    const auto *callee = dynamic_cast<const Variable *>(expr->callee.get());
+    if (callee == nullptr || callee->depth != GLOBAL_DEPTH) {
+        mark_impure();
+    }
+    expr->callee->accept(*this);
+    for (const auto &argument : expr->arguments) {
+        argument->accept(*this);
+    }
+
+    return {};
+}
+
+Value PurityAnalyzer::visit_inline_call_expr(InlineCall *expr) {
+    // 展开的返回表达式来自被调用的函数, 与调用一起检查被调用的函数即可
+    return expr->call->accept(*this);
+}
+
+Value PurityAnalyzer::visit_increment_expr(Increment *expr) {
+    assign(expr->name, expr->depth);
+
+    return {};
+}
+
+Value PurityAnalyzer::visit_compare_expr(Compare *expr) {
+    expr->variable->accept(*this);
+    expr->bound->accept(*this);
+
+    return {};
+}
+
+Value PurityAnalyzer::visit_promote_expr(Promote *expr) {
+    expr->expr->accept(*this);
+
+    return {};
+}
+
+Completion PurityAnalyzer::visit_block_stmt(Block *stmt) {
+    visit(stmt->statements);
+
+    return Completion::NORMAL;
+}
+
+Completion PurityAnalyzer::visit_expression_stmt(Expression *stmt) {
+    stmt->expression->accept(*this);
+
+    return Completion::NORMAL;
+}
+
+Completion PurityAnalyzer::visit_var_stmt(Var *stmt) {
+    if (stmt->initializer != nullptr) {
+        stmt->initializer->accept(*this);
+    }
+
+    return Completion::NORMAL;
+}
+
+Completion PurityAnalyzer::visit_if_stmt(If *stmt) {
+    stmt->condition->accept(*this);
+    stmt->then_branch->accept(*this);
+    if (stmt->else_branch != nullptr) {
+        stmt->else_branch->accept(*this);
+    }
+
+    return Completion::NORMAL;
+}
+
+Completion PurityAnalyzer::visit_while_stmt(While *stmt) {
+    stmt->condition->accept(*this);
+    stmt->body->accept(*this);
+
+    return Completion::NORMAL;
+}
+
+Completion PurityAnalyzer::visit_function_stmt(Function *stmt) {
+    // 每次执行都创建新的闭包, 外层函数不是纯函数
+    mark_impure();
+
+    auto *enclosing = current_;
+    current_ = &functions_.emplace_back(FunctionInfo{stmt, true, {}});
+    visit(stmt->body);
+    current_ = enclosing;
+
+    return Completion::NORMAL;
+}
+
+Completion PurityAnalyzer::visit_return_stmt(Return *stmt) {
+    if (stmt->value != nullptr) {
+        stmt->value->accept(*this);
+    }
+
+    return Completion::NORMAL;
+}
+
+} // namespace zero::optimizer
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "ast/expr.hpp"
+#include "ast/program.hpp"
+#include "ast/stmt.hpp"
+#include "symbol.hpp"
+
+#include <deque>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace zero::optimizer {
+
+// 纯函数分析, 在Resolver之后运行, 需要变量的depth
+// 纯函数: 只给局部变量赋值, 不读取捕获的变量, 不创建闭包,
+// 引用的全局变量只能是同样是纯函数的全局函数(原生函数都有副作用)
+// 通过@memoize注解或者--memoize参数启用的纯函数会创建记忆表,
+// 参数不全是值类型的调用在运行时跳过记忆表
+class PurityAnalyzer : public ExprVisitor, public StmtVisitor {
+public:
+    // memoize_all: 记忆化所有纯函数, 而不只是带注解的
+    // interactive: REPL中全局函数之后可能被重新定义, 不允许引用全局变量
+    PurityAnalyzer(bool memoize_all, bool interactive)
+        : memoize_all_{memoize_all}, interactive_{interactive} {}
+
+public:
+    // 返回创建了记忆表的函数
+    std::vector<Function *> memoize(const std::unique_ptr<Program> &program);
+    unsigned int num_pure() const { return num_pure_; }
+    // 带@memoize注解但不是纯函数的函数
+    const std::vector<Function *> &rejected() const { return rejected_; }
+
+public:
+    // Expr抽象类方法
+    Value visit_binary_expr(Binary *expr) override;
+    Value visit_grouping_expr(Grouping *expr) override;
+    Value visit_literal_expr(Literal *expr) override;
+    Value visit_logical_expr(Logical *expr) override;
+    Value visit_unary_expr(Unary *expr) override;
+    Value visit_variable_expr(Variable *expr) override;
+    Value visit_assign_expr(Assign *expr) override;
+    Value visit_call_expr(Call *expr) override;
+    Value visit_inline_call_expr(InlineCall *expr) override;
+    Value visit_increment_expr(Increment *expr) override;
+    Value visit_compare_expr(Compare *expr) override;
+    Value visit_promote_expr(Promote *expr) override;
+
+    // Stmt抽象类方法
+    Completion visit_block_stmt(Block *stmt) override;
+    Completion visit_expression_stmt(Expression *stmt) override;
+    Completion visit_var_stmt(Var *stmt) override;
+    Completion visit_if_stmt(If *stmt) override;
+    Completion visit_while_stmt(While *stmt) override;
+    Completion visit_function_stmt(Function *stmt) override;
+    Completion visit_return_stmt(Return *stmt) override;
+
+private:
+    // 函数体的分析结果
+    struct FunctionInfo {
+        Function *function;
+        bool pure{true};
+        // 引用的全局变量, 全部分析完之后才知道它们是不是纯函数
+        std::vector<symbol_id> references;
+    };
+
+    void visit(std::vector<std::unique_ptr<Stmt>> &stmts);
+    // 访问变量, 顶层代码中的访问不需要检查
+    void reference(const Token &name, int depth);
+    void assign(const Token &name, int depth);
+    void mark_impure();
+    // 从所有函数都是纯函数开始, 不断排除引用了非纯函数的函数
+    void propagate();
+
+private:
+    bool memoize_all_;
+    bool interactive_;
+    std::deque<FunctionInfo> functions_; // 添加元素时已有的指针仍然有效
+    FunctionInfo *current_{nullptr}; // 正在分析的函数, 顶层代码为nullptr
+    // 只声明了一次并且没有被重新赋值的顶层函数
+    std::unordered_map<symbol_id, const FunctionInfo *> candidates_;
+    std::unordered_set<symbol_id> assigned_globals_;
+    unsigned int num_pure_{0};
+    std::vector<Function *> rejected_;
+};
+
+} // namespace zero::optimizer
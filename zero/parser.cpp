@@ -1,5 +1,6 @@
 #include "parser.hpp"
 
+#include "symbol.hpp"
 #include "token.hpp"
 
 #include <cassert>
@@ -32,7 +33,7 @@ void Parser::parse_error(const Token &token, const std::string &msg) {
     if (token.type == token_type::END) {
         report(token.line, "at end", msg);
     } else {
-        report(token.line, "at `" + token.lexeme + "`", msg);
+        report(token.line, "at `" + std::string(token.lexeme) + "`", msg);
     }
     has_parse_error_ = true;
 }
@@ -43,11 +44,15 @@ std::unique_ptr<Expr> Parser::expression() {
 }
 
 std::unique_ptr<Stmt> Parser::declaration() {
-    // declaration -> var_declaration | func_declaration | statement
+    // declaration -> var_declaration | annotation? func_declaration
+    //                | statement
     // try {
     if (match(token_type::LET)) {
         return var_declaration();
     }
+    if (match(token_type::AT)) {
+        return annotated_declaration();
+    }
     if (match(token_type::FN)) {
         return func_declaration();
     }
@@ -171,8 +176,12 @@ std::unique_ptr<Stmt> Parser::while_statement() {
 // }
 
 std::unique_ptr<Stmt> Parser::var_declaration() {
-    // var_declaration -> "let" IDENTIFIER ("=" expression)? ";"
+    // var_declaration -> "let" IDENTIFIER (":" type)? ("=" expression)? ";"
     Token name = consume(token_type::IDENTIFIER, "Expect variable name.");
+    auto type = static_type::ANY;
+    if (match(token_type::COLON)) {
+        type = type_annotation();
+    }
     std::unique_ptr<Expr> initializer = nullptr;
 
     if (match(token_type::EQUAL)) {
@@ -181,7 +190,9 @@ std::unique_ptr<Stmt> Parser::var_declaration() {
 
     consume(token_type::SEMICOLON, "Expect ';' after variable declaration.");
 
-    return std::make_unique<Var>(std::move(name), std::move(initializer));
+    auto var = std::make_unique<Var>(std::move(name), std::move(initializer));
+    var->type = type;
+    return var;
 }
 
 std::unique_ptr<Stmt> Parser::expr_statement() {
@@ -356,9 +367,11 @@ std::unique_ptr<Expr> Parser::finish_call(std::unique_ptr<Expr> callee) {
         }
     }
 
-    consume(token_type::RIGHT_PAREN, "Expect `)` after arguments.");
+    Token paren
+        = consume(token_type::RIGHT_PAREN, "Expect `)` after arguments.");
 
-    return std::make_unique<Call>(std::move(callee), std::move(arguments));
+    return std::make_unique<Call>(
+        std::move(callee), std::move(paren), std::move(arguments));
 }
 
 std::unique_ptr<Expr> Parser::primary() {
@@ -373,8 +386,16 @@ std::unique_ptr<Expr> Parser::primary() {
     if (match(token_type::NIL)) {
         return std::make_unique<Literal>(nullptr);
     }
-    if (match(token_type::NUMBER, token_type::STRING)) {
-        return std::make_unique<Literal>(previous().literal);
+    if (match(token_type::NUMBER)) {
+        return std::make_unique<Literal>(previous().number);
+    }
+    if (match(token_type::DECIMAL)) {
+        return std::make_unique<Literal>(previous().decimal);
+    }
+    if (match(token_type::STRING)) {
+        // 相同的字符串常量共享同一个堆对象
+        return std::make_unique<Literal>(
+            SymbolTable::instance().string_value(previous().symbol));
     }
     if (match(token_type::IDENTIFIER)) {
         return std::make_unique<Variable>(previous());
@@ -389,28 +410,65 @@ std::unique_ptr<Expr> Parser::primary() {
 }
 
 std::unique_ptr<Function> Parser::func_declaration() {
-    // function -> "fn" IDENTIFIER "(" parameters? ")" block
+    // function -> "fn" IDENTIFIER "(" parameters? ")" (":" type)? block
     Token name = consume(token_type::IDENTIFIER, "Expect function name.");
     consume(token_type::LEFT_PAREN, "Expection `(` after function name.");
     std::vector<Token> parameters;
+    std::vector<static_type> parameter_types;
     if (!check(token_type::RIGHT_PAREN)) {
         while (true) {
             parameters.push_back(
                 consume(token_type::IDENTIFIER, "Expect parameter name."));
+            parameter_types.push_back(match(token_type::COLON)
+                                          ? type_annotation()
+                                          : static_type::ANY);
             if (!match(token_type::COMMA)) {
                 break;
             }
         }
     }
     consume(token_type::RIGHT_PAREN, "Expect `)` after parameters.");
+    auto return_type = static_type::ANY;
+    if (match(token_type::COLON)) {
+        return_type = type_annotation();
+    }
     consume(token_type::LEFT_BRACE, "Expect `{` before function body.");
     std::vector<std::unique_ptr<Stmt>> body = block();
 
-    return std::make_unique<Function>(
+    auto function = std::make_unique<Function>(
         std::move(name), std::move(parameters), std::move(body));
+    function->param_types = std::move(parameter_types);
+    function->return_type = return_type;
+    return function;
+}
+
+static_type Parser::type_annotation() {
+    // type -> "int" | "double" | "bool" | "string"
+    const Token &name
+        = consume(token_type::IDENTIFIER, "Expect type name after `:`.");
+    auto type = lookup_type(name.lexeme);
+    if (!type) {
+        throw ParseError(name, "Unknown type.");
+    }
+
+    return *type;
+}
+
+std::unique_ptr<Function> Parser::annotated_declaration() {
+    // annotation -> "@" "memoize"
+    const Token &name = consume(token_type::IDENTIFIER,
+                                "Expect annotation name after `@`.");
+    if (name.lexeme != "memoize") {
+        throw ParseError(name, "Unknown annotation.");
+    }
+    consume(token_type::FN, "Expect function declaration after annotation.");
+    auto function = func_declaration();
+    function->memoize = true;
+
+    return function;
 }
 
-Token Parser::consume(token_type type, const std::string &msg) {
+const Token &Parser::consume(token_type type, const std::string &msg) {
     if (check(type)) {
         return advance();
     }
@@ -426,7 +484,7 @@ bool Parser::check(token_type type) {
     return peek().type == type;
 }
 
-Token Parser::advance() {
+const Token &Parser::advance() {
     if (!is_at_end()) {
         ++current;
     }
@@ -436,9 +494,9 @@ Token Parser::advance() {
 
 bool Parser::is_at_end() { return peek().type == token_type::END; }
 
-Token Parser::peek() { return tokens.at(current); }
+const Token &Parser::peek() { return tokens[current]; }
 
-Token Parser::previous() { return tokens.at(current - 1); }
+const Token &Parser::previous() { return tokens[current - 1]; }
 
 // void Parser::synchronize() {
 //     advance();
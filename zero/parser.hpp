@@ -58,6 +58,10 @@ private:
 
     // 函数
     std::unique_ptr<Function> func_declaration();
+    // 带注解的函数声明, 目前只有@memoize
+    std::unique_ptr<Function> annotated_declaration();
+    // 变量, 参数和返回值的类型注解
+    static_type type_annotation();
 
     template <class... T>
     bool match(T... type) {
@@ -70,10 +74,10 @@ private:
 
         return false;
     }
-    Token consume(token_type type, const std::string &msg);
-    Token advance();
-    Token peek();
-    Token previous();
+    const Token &consume(token_type type, const std::string &msg);
+    const Token &advance();
+    const Token &peek();
+    const Token &previous();
     bool is_at_end();
     bool check(token_type type);
     // void synchronize();
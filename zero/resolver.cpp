@@ -0,0 +1,468 @@
+#include "resolver.hpp"
+
+#include "interpreter.hpp"
+
+#include <fmt/base.h>
+
+#include <algorithm>
+
+namespace zero {
+
+void Resolver::resolve(const std::unique_ptr<Program> &program) {
+    pending_globals_.clear();
+    resolve(program->get_statements());
+
+    for (const auto &pending : pending_globals_) {
+        auto slot = interpreter_.lookup_global(pending.name->symbol);
+        if (!slot.has_value() && interactive_) {
+            // 执行到这里时变量可能仍未定义, 和未赋值的全局变量一样是nil
+            *pending.slot = interpreter_.reserve_global(pending.name->symbol);
+            continue;
+        }
+        if (!slot.has_value()) {
+            resolve_error(*pending.name,
+                          "Undefined variable `"
+                              + std::string(pending.name->lexeme) + "`");
+            continue;
+        }
+        *pending.slot = *slot;
+    }
+}
+
+void Resolver::resolve(Expr &expr) { expr.accept(*this); }
+
+void Resolver::resolve(Stmt &stmt) { stmt.accept(*this); }
+
+void Resolver::resolve(const std::vector<std::unique_ptr<Stmt>> &stmts) {
+    for (const auto &stmt : stmts) {
+        resolve(*stmt);
+    }
+}
+
+void Resolver::begin_frame(Function *function) {
+    frames_.push_back(Frame{function, scopes_.size(), 0, 0});
+}
+
+unsigned int Resolver::end_frame() {
+    auto num_slots = frames_.back().num_slots;
+    frames_.pop_back();
+
+    return num_slots;
+}
+
+void Resolver::begin_scope() {
+    scopes_.push_back(Scope{{}, frames_.back().next_slot, 0, false});
+}
+
+bool Resolver::end_scope() {
+    // 函数名被重新绑定时, 函数体中引用的不一定是函数自身, 改为捕获
+    auto scope = scopes_.size() - 1;
+    while (!local_functions_.empty()
+           && local_functions_.back().scope == scope) {
+        auto &local = local_functions_.back();
+        auto *function = local.function;
+        function->rebound = local.rebound;
+        if (local.rebound && !local.references.empty()) {
+            auto &captures = function->captures;
+            auto index = static_cast<unsigned int>(captures.size());
+            for (auto i = 0u; i < captures.size(); i++) {
+                if (captures[i].is_local
+                    && captures[i].index == function->slot) {
+                    index = i;
+                    break;
+                }
+            }
+            if (index == captures.size()) {
+                captures.push_back(
+                    Capture{true, function->slot, function->name.symbol});
+            }
+            for (auto *reference : local.references) {
+                reference->depth = UPVALUE_DEPTH;
+                reference->slot = index;
+            }
+            scopes_.back().has_captured = true;
+        }
+        local_functions_.pop_back();
+    }
+
+    // 离开块作用域后, 它占用的槽位可以给后面的兄弟块复用
+    auto &frame = frames_.back();
+    frame.next_slot -= static_cast<unsigned int>(scopes_.back().slots.size());
+    auto has_captured = scopes_.back().has_captured;
+    scopes_.pop_back();
+
+    return has_captured;
+}
+
+void Resolver::declare(const Token &name, int &depth, unsigned int &slot) {
+    if (frames_.empty()) {
+        depth = GLOBAL_DEPTH;
+        slot = interpreter_.declare_global(name.symbol);
+        return;
+    }
+
+    // 同一作用域中重复声明的变量复用原来的槽位, 参数不能重复声明
+    auto &frame = frames_.back();
+    auto &scope = scopes_.back();
+    auto [found, inserted] = scope.slots.emplace(name.symbol, frame.next_slot);
+    if (inserted) {
+        frame.next_slot++;
+        frame.num_slots = std::max(frame.num_slots, frame.next_slot);
+    } else if (found->second - scope.first_slot < scope.num_params) {
+        resolve_error(name,
+                      "Redeclared parameter `" + std::string(name.lexeme)
+                          + "`");
+    } else {
+        rebind(scopes_.size() - 1, found->second);
+    }
+    depth = LOCAL_DEPTH;
+    slot = found->second;
+}
+
+void Resolver::declare_params(const std::vector<Token> &params) {
+    // 参数依次占用栈帧开头的槽位
+    for (const auto &param : params) {
+        int depth{};
+        unsigned int slot{};
+        declare(param, depth, slot);
+        auto &scope = scopes_.back();
+        scope.num_params = static_cast<unsigned int>(scope.slots.size());
+    }
+}
+
+void Resolver::resolve_variable(const Token &name,
+                                int &depth,
+                                unsigned int &slot) {
+    // 先在当前栈帧中查找, 再到外层函数中查找并捕获, 最后是全局变量
+    if (!frames_.empty()) {
+        auto current = frames_.size() - 1;
+        if (find_local(current, name.symbol, slot) != nullptr) {
+            depth = LOCAL_DEPTH;
+            return;
+        }
+        if (resolve_upvalue(current, name.symbol, slot)) {
+            depth = UPVALUE_DEPTH;
+            return;
+        }
+    }
+
+    depth = GLOBAL_DEPTH;
+    auto global = interpreter_.lookup_global(name.symbol);
+    if (global.has_value()) {
+        slot = *global;
+    } else if (function_depth_ > 0) {
+        pending_globals_.push_back(PendingGlobal{&name, &slot});
+    } else {
+        resolve_error(name,
+                      "Undefined variable `" + std::string(name.lexeme) + "`");
+    }
+}
+
+Resolver::Scope *
+Resolver::find_local(std::size_t frame_index, symbol_id name, unsigned &slot) {
+    auto first = frames_[frame_index].first_scope;
+    auto last = frame_index + 1 < frames_.size()
+                    ? frames_[frame_index + 1].first_scope
+                    : scopes_.size();
+    // 由内向外查找
+    for (auto i = last; i > first; i--) {
+        auto &scope = scopes_[i - 1];
+        auto found = scope.slots.find(name);
+        if (found != scope.slots.end()) {
+            slot = found->second;
+            return &scope;
+        }
+    }
+
+    return nullptr;
+}
+
+bool Resolver::resolve_upvalue(std::size_t frame_index,
+                               symbol_id name,
+                               unsigned int &index) {
+    auto *function = frames_[frame_index].function;
+    if (frame_index == 0 || function == nullptr) {
+        return false;
+    }
+
+    Capture capture{true, 0, name};
+    auto *scope = find_local(frame_index - 1, name, capture.index);
+    if (scope != nullptr) {
+        // 被捕获的局部变量在离开作用域时需要搬到堆上
+        scope->has_captured = true;
+    } else if (resolve_upvalue(frame_index - 1, name, capture.index)) {
+        // 外层函数已经捕获了这个变量, 逐层传递
+        capture.is_local = false;
+    } else {
+        return false;
+    }
+
+    // 同一个变量只捕获一次
+    auto &captures = function->captures;
+    for (auto i = 0u; i < captures.size(); i++) {
+        if (captures[i].is_local == capture.is_local
+            && captures[i].index == capture.index) {
+            index = i;
+            return true;
+        }
+    }
+    captures.push_back(capture);
+    index = static_cast<unsigned int>(captures.size() - 1);
+
+    return true;
+}
+
+bool Resolver::resolve_self(Variable &expr) {
+    if (frames_.empty()) {
+        return false;
+    }
+    auto current = frames_.size() - 1;
+    auto *function = frames_[current].function;
+    unsigned int slot{};
+    if (function == nullptr || function->depth != LOCAL_DEPTH
+        || function->name.symbol != expr.name.symbol
+        || find_local(current, expr.name.symbol, slot) != nullptr) {
+        return false;
+    }
+
+    for (auto &local : local_functions_) {
+        if (local.function == function) {
+            local.references.push_back(&expr);
+            expr.depth = SELF_DEPTH;
+            expr.slot = 0;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void Resolver::rebind(std::size_t scope, unsigned int slot) {
+    for (auto &local : local_functions_) {
+        if (local.scope == scope && local.function->slot == slot) {
+            local.rebound = true;
+        }
+    }
+}
+
+void Resolver::rebind(symbol_id name) {
+    // 由内向外找到变量所在的作用域, 可能在外层函数中
+    for (auto i = frames_.size(); i > 0; i--) {
+        unsigned int slot{};
+        if (auto *scope = find_local(i - 1, name, slot)) {
+            rebind(static_cast<std::size_t>(scope - scopes_.data()), slot);
+            return;
+        }
+    }
+}
+
+void Resolver::resolve_error(const Token &token, const std::string &msg) {
+    fmt::println("[Line {}] Error at `{}`: {}", token.line, token.lexeme, msg);
+    has_resolve_error_ = true;
+}
+
+Value Resolver::visit_binary_expr(Binary *expr) {
+    resolve(*expr->left);
+    resolve(*expr->right);
+
+    return {};
+}
+
+Value Resolver::visit_grouping_expr(Grouping *expr) {
+    resolve(*expr->expr);
+
+    return {};
+}
+
+Value Resolver::visit_literal_expr([[maybe_unused]] Literal *expr) {
+    return {};
+}
+
+Value Resolver::visit_logical_expr(Logical *expr) {
+    resolve(*expr->left);
+    resolve(*expr->right);
+
+    return {};
+}
+
+Value Resolver::visit_unary_expr(Unary *expr) {
+    resolve(*expr->right);
+
+    return {};
+}
+
+Value Resolver::visit_variable_expr(Variable *expr) {
+    if (resolve_self(*expr)) {
+        return {};
+    }
+    resolve_variable(expr->name, expr->depth, expr->slot);
+
+    return {};
+}
+
+Value Resolver::visit_assign_expr(Assign *expr) {
+    resolve(*expr->value);
+    resolve_variable(expr->name, expr->depth, expr->slot);
+    rebind(expr->name.symbol);
+
+    return {};
+}
+
+Value Resolver::visit_call_expr(Call *expr) {
+    resolve(*expr->callee);
+    for (const auto &argument : expr->arguments) {
+        resolve(*argument);
+    }
+
+    return {};
+}
+
+Value Resolver::visit_inline_call_expr(InlineCall *expr) {
+    resolve(*expr->call);
+
+    // 返回表达式在只包含参数的栈帧中解析, 其他变量都是全局变量
+    // 和函数体一样, 引用的全局变量可以在后面才声明
+    function_depth_++;
+    begin_frame(nullptr);
+    begin_scope();
+    // 参数重名的错误已经在函数声明处报告
+    for (const auto &param : expr->function->params) {
+        int depth{};
+        unsigned int slot{};
+        declare(param, depth, slot);
+    }
+    resolve(*expr->body);
+    end_scope();
+    expr->num_slots = end_frame();
+    function_depth_--;
+
+    return {};
+}
+
+Value Resolver::visit_increment_expr(Increment *expr) {
+    resolve_variable(expr->name, expr->depth, expr->slot);
+    rebind(expr->name.symbol);
+
+    return {};
+}
+
+Value Resolver::visit_compare_expr(Compare *expr) {
+    resolve(*expr->variable);
+    resolve(*expr->bound);
+
+    return {};
+}
+
+Value Resolver::visit_promote_expr(Promote *expr) {
+    resolve(*expr->expr);
+
+    return {};
+}
+
+Completion Resolver::visit_block_stmt(Block *stmt) {
+    // 块中没有声明语句时, 不需要新的作用域
+    bool has_declaration = false;
+    for (const auto &s : stmt->statements) {
+        if (dynamic_cast<Var *>(s.get()) != nullptr
+            || dynamic_cast<Function *>(s.get()) != nullptr) {
+            has_declaration = true;
+            break;
+        }
+    }
+
+    if (!has_declaration) {
+        resolve(stmt->statements);
+        return Completion::NORMAL;
+    }
+
+    if (!frames_.empty()) {
+        begin_scope();
+        stmt->first_slot = scopes_.back().first_slot;
+        resolve(stmt->statements);
+        stmt->has_captured = end_scope();
+        return Completion::NORMAL;
+    }
+
+    // 不在函数或其他块中的块, 运行时需要自己的栈帧
+    begin_frame(nullptr);
+    begin_scope();
+    resolve(stmt->statements);
+    end_scope();
+    stmt->num_slots = end_frame();
+
+    return Completion::NORMAL;
+}
+
+Completion Resolver::visit_expression_stmt(Expression *stmt) {
+    resolve(*stmt->expression);
+
+    return Completion::NORMAL;
+}
+
+Completion Resolver::visit_var_stmt(Var *stmt) {
+    // 先解析初始化表达式, `let a = a;` 中右边的a指向外层变量
+    if (stmt->initializer != nullptr) {
+        resolve(*stmt->initializer);
+    }
+    declare(stmt->name, stmt->depth, stmt->slot);
+
+    return Completion::NORMAL;
+}
+
+Completion Resolver::visit_if_stmt(If *stmt) {
+    resolve(*stmt->condition);
+    resolve(*stmt->then_branch);
+    if (stmt->else_branch != nullptr) {
+        resolve(*stmt->else_branch);
+    }
+
+    return Completion::NORMAL;
+}
+
+Completion Resolver::visit_while_stmt(While *stmt) {
+    resolve(*stmt->condition);
+    resolve(*stmt->body);
+
+    return Completion::NORMAL;
+}
+
+Completion Resolver::visit_function_stmt(Function *stmt) {
+    declare(stmt->name, stmt->depth, stmt->slot);
+    if (stmt->depth == LOCAL_DEPTH) {
+        local_functions_.push_back(
+            LocalFunction{stmt, scopes_.size() - 1, false, {}});
+    }
+
+    stmt->captures.clear();
+    function_depth_++;
+    begin_frame(stmt);
+    begin_scope();
+    declare_params(stmt->params);
+    // 函数体和参数在同一个作用域中
+    resolve(stmt->body);
+    end_scope();
+    stmt->num_slots = end_frame();
+    function_depth_--;
+
+    return Completion::NORMAL;
+}
+
+Completion Resolver::visit_return_stmt(Return *stmt) {
+    if (function_depth_ == 0) {
+        resolve_error(stmt->keyword, "Can't return from top-level code.");
+    }
+    if (stmt->value != nullptr) {
+        resolve(*stmt->value);
+    }
+    // 被调用的是变量时, 运行时可以先求出函数再决定是否复用栈帧
+    if (function_depth_ > 0) {
+        auto *call = dynamic_cast<const Call *>(stmt->value.get());
+        stmt->tail_call
+            = call != nullptr
+              && dynamic_cast<const Variable *>(call->callee.get()) != nullptr;
+    }
+
+    return Completion::NORMAL;
+}
+
+} // namespace zero
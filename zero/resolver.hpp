@@ -0,0 +1,129 @@
+#pragma once
+
+#include "ast/expr.hpp"
+#include "ast/program.hpp"
+#include "ast/stmt.hpp"
+#include "symbol.hpp"
+#include "token.hpp"
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace zero {
+class Interpreter;
+
+// 静态解析: 在执行前为每个变量计算 (depth, slot), 并检查未定义的变量
+class Resolver : public ExprVisitor, public StmtVisitor {
+public:
+    // interactive为真时, 函数体中引用的全局变量可以在之后输入的代码中声明
+    explicit Resolver(Interpreter &interpreter, bool interactive = false)
+        : interpreter_{interpreter}, interactive_{interactive} {}
+
+public:
+    void resolve(const std::unique_ptr<Program> &program);
+
+    bool has_error() const { return has_resolve_error_; }
+
+public:
+    // Expr抽象类方法
+    Value visit_binary_expr(Binary *expr) override;
+    Value visit_grouping_expr(Grouping *expr) override;
+    Value visit_literal_expr(Literal *expr) override;
+    Value visit_logical_expr(Logical *expr) override;
+    Value visit_unary_expr(Unary *expr) override;
+    Value visit_variable_expr(Variable *expr) override;
+    Value visit_assign_expr(Assign *expr) override;
+    Value visit_call_expr(Call *expr) override;
+    Value visit_inline_call_expr(InlineCall *expr) override;
+    Value visit_increment_expr(Increment *expr) override;
+    Value visit_compare_expr(Compare *expr) override;
+    Value visit_promote_expr(Promote *expr) override;
+
+    // Stmt抽象类方法
+    Completion visit_block_stmt(Block *stmt) override;
+    Completion visit_expression_stmt(Expression *stmt) override;
+    Completion visit_var_stmt(Var *stmt) override;
+    Completion visit_if_stmt(If *stmt) override;
+    Completion visit_while_stmt(While *stmt) override;
+    Completion visit_function_stmt(Function *stmt) override;
+    Completion visit_return_stmt(Return *stmt) override;
+
+private:
+    // 作用域只在解析时存在, 运行时每个函数调用只有一个栈帧
+    // 函数中嵌套的块作用域依次占用栈帧中后面的槽位
+    struct Scope {
+        std::unordered_map<symbol_id, unsigned int> slots; // 变量名 -> 槽位
+        unsigned int first_slot; // 作用域中第一个变量的槽位
+        unsigned int num_params; // 开头的几个槽位是函数参数
+        bool has_captured;       // 是否有变量被闭包捕获
+    };
+
+    // 正在分配槽位的栈帧: 函数体, 或者不在函数中的最外层块
+    struct Frame {
+        Function *function;      // 最外层块的栈帧为nullptr
+        std::size_t first_scope; // 栈帧中最外层作用域在scopes_中的下标
+        unsigned int next_slot;  // 下一个可用的槽位
+        unsigned int num_slots;  // 栈帧需要的槽位总数
+    };
+
+    // 函数体中引用的全局变量可能在后面才声明, 整个程序解析完后再检查
+    struct PendingGlobal {
+        const Token *name;
+        unsigned int *slot;
+    };
+
+    // 局部函数, 函数体中对自身名字的引用解析为SELF_DEPTH
+    // 函数名在作用域结束前被重新赋值或者重复声明时, 这些引用退回捕获
+    // 嵌套函数中引用外层函数的名字仍然通过捕获访问
+    struct LocalFunction {
+        Function *function;
+        std::size_t scope; // 函数名所在的作用域在scopes_中的下标
+        bool rebound;      // 函数名是否被重新绑定
+        std::vector<Variable *> references;
+    };
+
+    void resolve(Expr &expr);
+    void resolve(Stmt &stmt);
+    void resolve(const std::vector<std::unique_ptr<Stmt>> &stmts);
+
+    void begin_frame(Function *function);
+    // 返回栈帧需要的槽位数
+    unsigned int end_frame();
+    void begin_scope();
+    // 返回作用域中是否有变量被闭包捕获
+    bool end_scope();
+    // 在当前作用域声明一个变量
+    void declare(const Token &name, int &depth, unsigned int &slot);
+    // 在函数的最外层作用域依次声明参数
+    void declare_params(const std::vector<Token> &params);
+    // 查找变量所在的作用域
+    void resolve_variable(const Token &name, int &depth, unsigned int &slot);
+    // 在第frame_index个栈帧中查找局部变量, 找到时返回它的作用域
+    Scope *find_local(std::size_t frame_index, symbol_id name, unsigned &slot);
+    // 在外层栈帧中查找变量, 找到时为第frame_index个栈帧的函数添加捕获
+    bool resolve_upvalue(std::size_t frame_index,
+                         symbol_id name,
+                         unsigned int &index);
+    // 当前函数引用自己的名字时解析为SELF_DEPTH
+    bool resolve_self(Variable &expr);
+    // 第scope个作用域中slot处的变量被重新绑定
+    void rebind(std::size_t scope, unsigned int slot);
+    // 赋值语句修改的变量被重新绑定
+    void rebind(symbol_id name);
+
+    void resolve_error(const Token &token, const std::string &msg);
+
+private:
+    Interpreter &interpreter_;
+    std::vector<Scope> scopes_;
+    std::vector<Frame> frames_;
+    std::vector<PendingGlobal> pending_globals_;
+    std::vector<LocalFunction> local_functions_;
+    unsigned int function_depth_{0}; // 当前所在函数的嵌套层数
+    bool interactive_;
+    bool has_resolve_error_{false};
+};
+
+} // namespace zero
@@ -0,0 +1,60 @@
+#include "symbol.hpp"
+
+namespace zero {
+
+SymbolTable &SymbolTable::instance() {
+    static SymbolTable table;
+    return table;
+}
+
+SymbolTable::SymbolTable() {
+    const std::pair<std::string_view, token_type> keywords[] = {
+        {"and", token_type::AND},
+        {"or", token_type::OR},
+        {"not", token_type::NOT},
+        {"class", token_type::CLASS},
+        {"else", token_type::ELSE},
+        {"false", token_type::FALSE},
+        {"for", token_type::FOR},
+        {"fn", token_type::FN},
+        {"if", token_type::IF},
+        {"nil", token_type::NIL},
+        // {"print", token_type::PRINT},
+        {"return", token_type::RETURN},
+        {"true", token_type::TRUE},
+        {"let", token_type::LET},
+        {"while", token_type::WHILE},
+    };
+
+    for (const auto &[name, type] : keywords) {
+        intern(name);
+        keyword_types_.push_back(type);
+    }
+}
+
+symbol_id SymbolTable::intern(std::string_view name) {
+    auto found = ids_.find(name);
+    if (found != ids_.end()) {
+        return found->second;
+    }
+
+    auto id = static_cast<symbol_id>(names_.size());
+    const auto &stored = names_.emplace_back(name);
+    ids_.emplace(stored, id);
+
+    return id;
+}
+
+const Value &SymbolTable::string_value(symbol_id id) {
+    if (strings_.size() <= id) {
+        strings_.resize(names_.size());
+    }
+    auto &value = strings_[id];
+    if (value.is_nil()) {
+        value = names_[id];
+    }
+
+    return value;
+}
+
+} // namespace zero
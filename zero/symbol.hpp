@@ -0,0 +1,49 @@
+#pragma once
+
+#include "token.hpp"
+#include "value.hpp"
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace zero {
+
+// 驻留后的符号, 同名的标识符和字符串常量拥有相同的id
+using symbol_id = uint32_t;
+
+// 全局符号表, 在词法分析时驻留标识符和字符串常量
+// 关键字最先驻留, 占据最小的几个id, 判断关键字只需要比较整数
+class SymbolTable {
+public:
+    static SymbolTable &instance();
+
+    SymbolTable(const SymbolTable &) = delete;
+    SymbolTable &operator=(const SymbolTable &) = delete;
+
+public:
+    symbol_id intern(std::string_view name);
+    std::string_view name(symbol_id id) const { return names_[id]; }
+    // 不是关键字时返回IDENTIFIER
+    token_type keyword_type(symbol_id id) const {
+        return id < keyword_types_.size() ? keyword_types_[id]
+                                          : token_type::IDENTIFIER;
+    }
+    // 字符串常量对应的值, 相同的常量共享同一个堆对象
+    const Value &string_value(symbol_id id);
+
+private:
+    SymbolTable();
+
+private:
+    // deque追加元素时不移动已有元素, 保证ids_中的string_view有效
+    std::deque<std::string> names_;
+    std::unordered_map<std::string_view, symbol_id> ids_;
+    std::vector<token_type> keyword_types_; // 下标即关键字的id
+    std::vector<Value> strings_;            // 按需创建的字符串常量
+};
+
+} // namespace zero
@@ -11,11 +11,10 @@ std::string Token::to_string() const {
             literal_str = "id";
             break;
         case (token_type::STRING):
-            // literal_str = std::any_cast<std::string>(literal);
             literal_str = "string";
             break;
         case (token_type::NUMBER):
-            // literal_str = std::to_string(std::any_cast<int>(literal));
+        case (token_type::DECIMAL):
             literal_str = "number";
             break;
         case (token_type::TRUE):
@@ -1,7 +1,8 @@
 #pragma once
 
-#include <any>
+#include <cstdint>
 #include <string>
+#include <string_view>
 
 namespace zero {
 
@@ -19,6 +20,7 @@ enum class token_type {
     SEMICOLON,   // ;
     SLASH,       // /
     STAR,        // *
+    AT,          // @
     // Single or two characters tokens(i.e., !=, ==, >=, etc.)
     EQUAL,
     EQUAL_EQUAL,
@@ -32,6 +34,7 @@ enum class token_type {
     IDENTIFIER,
     STRING,
     NUMBER,
+    DECIMAL,
     // Builtin keywords(fn, if, else, etc.)
     AND,
     CLASS,
@@ -51,22 +54,16 @@ enum class token_type {
     END
 };
 
-class Token {
-public:
-    Token(token_type type,
-          std::any literal,
-          std::string lexeme,
-          unsigned int line)
-        : type{type}, literal{std::move(literal)}, lexeme{std::move(lexeme)},
-          line{line} {}
-
-public:
+// 词法单元, 不持有字符串, 词位指向源码缓冲区
+// 源码缓冲区由Program持有, 与AST的生命周期相同
+struct Token {
     std::string to_string() const;
 
-public:
-    const token_type type;
-    const std::any literal;   // 字面量, 字符串/数字/true/...
-    const std::string lexeme; // 词位
-    const unsigned int line;
+    token_type type;
+    std::string_view lexeme; // 词位
+    unsigned int line;
+    int64_t number{0};  // NUMBER类型预先解析好的数值
+    uint32_t symbol{0}; // IDENTIFIER和STRING类型在符号表中的id
+    double decimal{0};  // DECIMAL类型预先解析好的数值
 };
 } // namespace zero
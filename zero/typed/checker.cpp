@@ -0,0 +1,443 @@
+#include "checker.hpp"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+
+namespace zero::typed {
+
+namespace {
+static_type type_of(const Value &value) {
+    if (value.is_nil()) {
+        return static_type::NIL;
+    }
+    if (value.is_bool()) {
+        return static_type::BOOL;
+    }
+    if (value.is_int()) {
+        return static_type::INT;
+    }
+    if (value.is_double()) {
+        return static_type::DOUBLE;
+    }
+    if (value.is_string()) {
+        return static_type::STRING;
+    }
+    return static_type::ANY;
+}
+
+bool is_numeric(static_type type) {
+    return type == static_type::INT || type == static_type::DOUBLE;
+}
+
+// 语句的每条执行路径都以return结束
+bool always_returns(const Stmt &stmt);
+
+bool always_returns(const std::vector<std::unique_ptr<Stmt>> &stmts) {
+    return std::any_of(stmts.begin(), stmts.end(), [](const auto &stmt) {
+        return always_returns(*stmt);
+    });
+}
+
+bool always_returns(const Stmt &stmt) {
+    if (dynamic_cast<const Return *>(&stmt) != nullptr) {
+        return true;
+    }
+    if (const auto *block = dynamic_cast<const Block *>(&stmt)) {
+        return always_returns(block->statements);
+    }
+    if (const auto *branch = dynamic_cast<const If *>(&stmt)) {
+        return branch->else_branch != nullptr
+            && always_returns(*branch->then_branch)
+            && always_returns(*branch->else_branch);
+    }
+    // 没有break, 条件恒为真的循环只能通过return离开
+    if (const auto *loop = dynamic_cast<const While *>(&stmt)) {
+        const auto *literal = dynamic_cast<const Literal *>(
+            loop->condition.get());
+        return literal != nullptr && is_truthy(literal->value);
+    }
+    return false;
+}
+} // namespace
+
+void TypeChecker::check(const std::unique_ptr<Program> &program) {
+    scopes_.push_back(Scope{{}, static_type::ANY, nullptr, {}});
+    check(program->get_statements());
+    scopes_.pop_back();
+
+    for (const auto &call : global_calls_) {
+        if (call.slot < global_functions_.size()
+            && global_functions_[call.slot] != nullptr
+            && global_bindings_[call.slot] == 1) {
+            check_arguments(
+                *call.call, *global_functions_[call.slot], call.arguments);
+        }
+    }
+    global_calls_.clear();
+}
+
+static_type TypeChecker::check(Expr &expr) {
+    expr.accept(*this);
+    return type_;
+}
+
+void TypeChecker::check(Stmt &stmt) { stmt.accept(*this); }
+
+void TypeChecker::check(const std::vector<std::unique_ptr<Stmt>> &stmts) {
+    for (const auto &stmt : stmts) {
+        check(*stmt);
+    }
+}
+
+static_type &TypeChecker::variable(int depth, unsigned int slot) {
+    switch (depth) {
+        case GLOBAL_DEPTH:
+            if (slot >= globals_.size()) {
+                globals_.resize(slot + 1, static_type::ANY);
+            }
+            return globals_[slot];
+        case UPVALUE_DEPTH:
+        case SELF_DEPTH:
+            unknown_ = static_type::ANY;
+            return unknown_;
+        default: {
+            auto &locals = scopes_.back().locals;
+            if (slot >= locals.size()) {
+                locals.resize(slot + 1, static_type::ANY);
+            }
+            return locals[slot];
+        }
+    }
+}
+
+void TypeChecker::bind(int depth, unsigned int slot, Function *function) {
+    if (depth == GLOBAL_DEPTH) {
+        if (slot >= global_functions_.size()) {
+            global_functions_.resize(slot + 1, nullptr);
+            global_bindings_.resize(slot + 1, 0);
+        }
+        global_functions_[slot] = function;
+        global_bindings_[slot]++;
+    } else if (depth == LOCAL_DEPTH) {
+        // 被重新赋值的局部函数名, 调用时不一定是这个函数
+        auto &functions = scopes_.back().functions;
+        if (slot >= functions.size()) {
+            functions.resize(slot + 1, nullptr);
+        }
+        functions[slot]
+            = function != nullptr && !function->rebound ? function : nullptr;
+    }
+}
+
+void TypeChecker::check_arguments(const Call &call,
+                                  const Function &function,
+                                  const std::vector<static_type> &arguments) {
+    // 参数个数不一致由执行时报告
+    if (function.params.size() != arguments.size()) {
+        return;
+    }
+    for (std::size_t i = 0; i < arguments.size(); i++) {
+        expect(function.param_types[i], arguments[i], call.paren);
+    }
+}
+
+void TypeChecker::promote(std::unique_ptr<Expr> &expr, static_type actual) {
+    if (actual != static_type::INT && actual != static_type::ANY) {
+        return;
+    }
+    // 整数常量直接换成浮点数常量
+    if (const auto *literal = dynamic_cast<const Literal *>(expr.get());
+        literal != nullptr && literal->value.is_int()) {
+        expr = std::make_unique<Literal>(
+            Value{static_cast<double>(literal->value.as_int())});
+        return;
+    }
+    expr = std::make_unique<Promote>(std::move(expr));
+}
+
+void TypeChecker::expect(static_type expected,
+                         static_type actual,
+                         const Token &token) {
+    if (expected == static_type::ANY || actual == static_type::ANY
+        || expected == actual
+        || (expected == static_type::DOUBLE && actual == static_type::INT)) {
+        return;
+    }
+
+    type_error(token,
+               fmt::format("Type mismatch: expect `{}` but got `{}`.",
+                           type_name(expected),
+                           type_name(actual)));
+}
+
+void TypeChecker::type_error(const Token &token, const std::string &msg) {
+    fmt::println("[Line {}] Error at `{}`: {}", token.line, token.lexeme, msg);
+    has_type_error_ = true;
+}
+
+Value TypeChecker::visit_binary_expr(Binary *expr) {
+    auto left = check(*expr->left);
+    auto right = check(*expr->right);
+
+    switch (expr->op.type) {
+        case token_type::PLUS:
+            if (left == static_type::STRING && right == static_type::STRING) {
+                type_ = static_type::STRING;
+                break;
+            }
+            [[fallthrough]];
+        case token_type::MINUS:
+        case token_type::STAR:
+        case token_type::SLASH:
+            // 两个整数的运算结果是整数, 有一个是浮点数时按浮点数计算
+            if (!is_numeric(left) || !is_numeric(right)) {
+                type_ = static_type::ANY;
+            } else if (left == static_type::INT && right == static_type::INT) {
+                type_ = static_type::INT;
+            } else {
+                type_ = static_type::DOUBLE;
+            }
+            break;
+        default:
+            type_ = static_type::BOOL;
+            break;
+    }
+
+    return {};
+}
+
+Value TypeChecker::visit_grouping_expr(Grouping *expr) {
+    check(*expr->expr);
+
+    return {};
+}
+
+Value TypeChecker::visit_literal_expr(Literal *expr) {
+    type_ = type_of(expr->value);
+
+    return {};
+}
+
+Value TypeChecker::visit_logical_expr(Logical *expr) {
+    // 结果是其中一个操作数
+    auto left = check(*expr->left);
+    auto right = check(*expr->right);
+    type_ = left == right ? left : static_type::ANY;
+
+    return {};
+}
+
+Value TypeChecker::visit_unary_expr(Unary *expr) {
+    auto right = check(*expr->right);
+    if (expr->op.type == token_type::NOT) {
+        type_ = static_type::BOOL;
+    } else {
+        type_ = is_numeric(right) ? right : static_type::ANY;
+    }
+
+    return {};
+}
+
+Value TypeChecker::visit_variable_expr(Variable *expr) {
+    type_ = variable(expr->depth, expr->slot);
+
+    return {};
+}
+
+Value TypeChecker::visit_assign_expr(Assign *expr) {
+    auto value = check(*expr->value);
+    auto type = variable(expr->depth, expr->slot);
+    expect(type, value, expr->name);
+    if (type == static_type::DOUBLE) {
+        promote(expr->value, value);
+        value = type;
+    }
+    bind(expr->depth, expr->slot, nullptr);
+    type_ = value;
+
+    return {};
+}
+
+Value TypeChecker::visit_call_expr(Call *expr) {
+    // 全局函数可能被重新赋值, 调用的返回值类型无法确定
+    check(*expr->callee);
+    std::vector<static_type> arguments;
+    for (const auto &argument : expr->arguments) {
+        arguments.push_back(check(*argument));
+    }
+    type_ = static_type::ANY;
+
+    // 被调用的是确定的函数时, 按参数注解检查实参
+    const auto *callee = dynamic_cast<const Variable *>(expr->callee.get());
+    if (callee == nullptr) {
+        return {};
+    }
+    const Function *function = nullptr;
+    switch (callee->depth) {
+        case GLOBAL_DEPTH:
+            global_calls_.push_back(
+                GlobalCall{expr, callee->slot, std::move(arguments)});
+            return {};
+        case LOCAL_DEPTH: {
+            const auto &functions = scopes_.back().functions;
+            if (callee->slot < functions.size()) {
+                function = functions[callee->slot];
+            }
+            break;
+        }
+        case SELF_DEPTH:
+            function = scopes_.back().function;
+            break;
+        default:
+            break;
+    }
+    if (function != nullptr) {
+        check_arguments(*expr, *function, arguments);
+    }
+
+    return {};
+}
+
+Value TypeChecker::visit_inline_call_expr(InlineCall *expr) {
+    // 返回表达式中的槽位属于内联的栈帧, 只检查原来的调用
+    check(*expr->call);
+
+    return {};
+}
+
+Value TypeChecker::visit_increment_expr(Increment *expr) {
+    auto type = variable(expr->depth, expr->slot);
+    type_ = is_numeric(type) ? type : static_type::ANY;
+
+    return {};
+}
+
+Value TypeChecker::visit_compare_expr(Compare *expr) {
+    check(*expr->variable);
+    check(*expr->bound);
+    type_ = static_type::BOOL;
+
+    return {};
+}
+
+Value TypeChecker::visit_promote_expr(Promote *expr) {
+    check(*expr->expr);
+    if (type_ == static_type::INT) {
+        type_ = static_type::DOUBLE;
+    }
+
+    return {};
+}
+
+Completion TypeChecker::visit_block_stmt(Block *stmt) {
+    check(stmt->statements);
+
+    return Completion::NORMAL;
+}
+
+Completion TypeChecker::visit_expression_stmt(Expression *stmt) {
+    check(*stmt->expression);
+
+    return Completion::NORMAL;
+}
+
+Completion TypeChecker::visit_var_stmt(Var *stmt) {
+    // 没有初始值的变量是nil
+    auto value = static_type::NIL;
+    if (stmt->initializer != nullptr) {
+        value = check(*stmt->initializer);
+    }
+    if (stmt->type != static_type::ANY) {
+        expect(stmt->type, value, stmt->name);
+    }
+    if (stmt->type == static_type::DOUBLE && stmt->initializer != nullptr) {
+        promote(stmt->initializer, value);
+    }
+    variable(stmt->depth, stmt->slot) = stmt->type;
+    bind(stmt->depth, stmt->slot, nullptr);
+
+    return Completion::NORMAL;
+}
+
+Completion TypeChecker::visit_if_stmt(If *stmt) {
+    check(*stmt->condition);
+    check(*stmt->then_branch);
+    if (stmt->else_branch != nullptr) {
+        check(*stmt->else_branch);
+    }
+
+    return Completion::NORMAL;
+}
+
+Completion TypeChecker::visit_while_stmt(While *stmt) {
+    check(*stmt->condition);
+    check(*stmt->body);
+
+    return Completion::NORMAL;
+}
+
+Completion TypeChecker::visit_function_stmt(Function *stmt) {
+    // 函数名绑定的是函数对象, 先定义再检查函数体, 函数体中可以递归调用
+    variable(stmt->depth, stmt->slot) = static_type::ANY;
+    bind(stmt->depth, stmt->slot, stmt);
+
+    // 注解为double的参数可能传入整数, 进入函数体时先转换
+    std::vector<std::unique_ptr<Stmt>> prologue;
+    for (std::size_t i = 0; i < stmt->params.size(); i++) {
+        if (stmt->param_types[i] != static_type::DOUBLE) {
+            continue;
+        }
+        auto param = std::make_unique<Variable>(stmt->params[i]);
+        param->depth = LOCAL_DEPTH;
+        param->slot = static_cast<unsigned int>(i);
+        auto assign = std::make_unique<Assign>(
+            stmt->params[i], std::make_unique<Promote>(std::move(param)));
+        assign->depth = LOCAL_DEPTH;
+        assign->slot = static_cast<unsigned int>(i);
+        prologue.push_back(std::make_unique<Expression>(std::move(assign)));
+    }
+    stmt->body.insert(stmt->body.begin(),
+                      std::make_move_iterator(prologue.begin()),
+                      std::make_move_iterator(prologue.end()));
+
+    auto num_slots = std::max<std::size_t>(stmt->num_slots,
+                                           stmt->params.size());
+    scopes_.push_back(Scope{std::vector<static_type>(num_slots,
+                                                     static_type::ANY),
+                            stmt->return_type,
+                            stmt,
+                            {}});
+    std::copy(stmt->param_types.begin(),
+              stmt->param_types.end(),
+              scopes_.back().locals.begin());
+    check(stmt->body);
+    scopes_.pop_back();
+
+    if (stmt->return_type != static_type::ANY && !always_returns(stmt->body)) {
+        type_error(stmt->name,
+                   fmt::format("Missing return in function returning `{}`.",
+                               type_name(stmt->return_type)));
+    }
+
+    return Completion::NORMAL;
+}
+
+Completion TypeChecker::visit_return_stmt(Return *stmt) {
+    auto value = static_type::NIL;
+    if (stmt->value != nullptr) {
+        value = check(*stmt->value);
+    }
+    auto return_type = scopes_.back().return_type;
+    expect(return_type, value, stmt->keyword);
+    // 转换之后返回值不再是调用, 不能复用栈帧
+    if (return_type == static_type::DOUBLE && stmt->value != nullptr
+        && value != static_type::DOUBLE) {
+        promote(stmt->value, value);
+        stmt->tail_call = false;
+    }
+
+    return Completion::NORMAL;
+}
+
+} // namespace zero::typed
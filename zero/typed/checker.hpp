@@ -0,0 +1,93 @@
+#pragma once
+
+#include "ast/expr.hpp"
+#include "ast/program.hpp"
+#include "ast/stmt.hpp"
+#include "ast/type.hpp"
+#include "token.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace zero::typed {
+
+// 类型检查, 在Resolver之后运行, 变量按槽位记录类型
+// 只检查有注解的变量声明, 赋值, 返回值和确定的函数的调用参数,
+// 没有注解或者类型无法确定时不报错; 有返回值注解的函数必须在每条路径上返回
+// int可以赋值给double, 在这些位置插入Promote节点, 执行时转换成浮点数
+class TypeChecker : public ExprVisitor, public StmtVisitor {
+public:
+    void check(const std::unique_ptr<Program> &program);
+
+    bool has_error() const { return has_type_error_; }
+
+public:
+    // Expr抽象类方法, 表达式的类型保存在type_中
+    Value visit_binary_expr(Binary *expr) override;
+    Value visit_grouping_expr(Grouping *expr) override;
+    Value visit_literal_expr(Literal *expr) override;
+    Value visit_logical_expr(Logical *expr) override;
+    Value visit_unary_expr(Unary *expr) override;
+    Value visit_variable_expr(Variable *expr) override;
+    Value visit_assign_expr(Assign *expr) override;
+    Value visit_call_expr(Call *expr) override;
+    Value visit_inline_call_expr(InlineCall *expr) override;
+    Value visit_increment_expr(Increment *expr) override;
+    Value visit_compare_expr(Compare *expr) override;
+    Value visit_promote_expr(Promote *expr) override;
+
+    // Stmt抽象类方法
+    Completion visit_block_stmt(Block *stmt) override;
+    Completion visit_expression_stmt(Expression *stmt) override;
+    Completion visit_var_stmt(Var *stmt) override;
+    Completion visit_if_stmt(If *stmt) override;
+    Completion visit_while_stmt(While *stmt) override;
+    Completion visit_function_stmt(Function *stmt) override;
+    Completion visit_return_stmt(Return *stmt) override;
+
+private:
+    static_type check(Expr &expr);
+    void check(Stmt &stmt);
+    void check(const std::vector<std::unique_ptr<Stmt>> &stmts);
+    // 变量当前的类型, 全局变量和局部变量按槽位记录
+    static_type &variable(int depth, unsigned int slot);
+    // 记录变量绑定的函数, 不是函数声明时function为nullptr
+    void bind(int depth, unsigned int slot, Function *function);
+    void check_arguments(const Call &call,
+                         const Function &function,
+                         const std::vector<static_type> &arguments);
+    // 类型为actual的值存入注解为double的位置时, 整数转换成浮点数
+    static void promote(std::unique_ptr<Expr> &expr, static_type actual);
+    void expect(static_type expected, static_type actual, const Token &token);
+    void type_error(const Token &token, const std::string &msg);
+
+private:
+    // 函数中局部变量的类型和返回值类型, 顶层代码也使用一个
+    // functions记录局部变量当前绑定的没有被重新赋值的局部函数
+    struct Scope {
+        std::vector<static_type> locals;
+        static_type return_type;
+        Function *function; // 顶层代码为nullptr
+        std::vector<Function *> functions;
+    };
+
+    // 全局函数可以在声明之前的函数体中调用, 检查完整个程序后再检查参数
+    struct GlobalCall {
+        const Call *call;
+        unsigned int slot;
+        std::vector<static_type> arguments;
+    };
+
+    std::vector<Scope> scopes_;
+    std::vector<static_type> globals_;
+    // 全局变量只由一个函数声明绑定, 没有其他声明和赋值时才是确定的函数
+    std::vector<Function *> global_functions_;
+    std::vector<unsigned int> global_bindings_;
+    std::vector<GlobalCall> global_calls_;
+    static_type type_{static_type::ANY};
+    static_type unknown_{static_type::ANY}; // 捕获的变量不记录类型
+    bool has_type_error_{false};
+};
+
+} // namespace zero::typed
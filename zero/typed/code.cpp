@@ -0,0 +1,107 @@
+#include "code.hpp"
+
+#include "limits.hpp"
+#include "numeric.hpp"
+
+#include <algorithm>
+
+namespace zero::typed {
+
+namespace {
+constexpr std::size_t STACK_MAX = 1 << 16;
+
+// 特化的函数不会调用普通函数, 执行期间不会重入, 所有调用共用一个栈
+Slot *stack() {
+    thread_local std::vector<Slot> stack(STACK_MAX);
+    return stack.data();
+}
+} // namespace
+
+Slot Context::call(const TypedFunction &function,
+                   const std::vector<ExprCode> &arguments,
+                   Slot *frame) {
+    // 超过调用深度上限时退回普通执行方式, 由它报告栈溢出
+    if (depth == MAX_CALL_DEPTH
+        || function.frame_size() > static_cast<std::size_t>(end - top)) {
+        throw Deoptimize{};
+    }
+    // 参数直接求值到新栈帧中, 嵌套的调用在它之上分配
+    Slot *callee = top;
+    top += function.frame_size();
+    depth++;
+    for (std::size_t i = 0; i < arguments.size(); i++) {
+        callee[i] = arguments[i](*this, frame);
+    }
+    // 没有执行到return时普通执行方式返回nil
+    if (function.body()(*this, callee) != Completion::RETURN) {
+        throw Deoptimize{};
+    }
+    top = callee;
+    depth--;
+
+    return result;
+}
+
+TypedFunction::TypedFunction(const Function &declaration, StmtCode body)
+    : param_types_{declaration.param_types},
+      return_type_{declaration.return_type},
+      frame_size_{std::max<std::size_t>(declaration.num_slots,
+                                        declaration.params.size())},
+      body_{std::move(body)} {}
+
+bool TypedFunction::call(const Value *arguments,
+                         Value *globals,
+                         Value &result) const {
+    if (frame_size_ > STACK_MAX) {
+        return false;
+    }
+    Slot *frame = stack();
+    for (std::size_t i = 0; i < param_types_.size(); i++) {
+        const auto &argument = arguments[i];
+        switch (param_types_[i]) {
+            case static_type::INT:
+                if (!argument.is_int()) {
+                    return false;
+                }
+                frame[i] = argument.as_int();
+                break;
+            case static_type::DOUBLE:
+                // 注解为double的参数可以传入整数
+                if (!is_number(argument)) {
+                    return false;
+                }
+                frame[i] = as_number(argument);
+                break;
+            default:
+                if (!argument.is_bool()) {
+                    return false;
+                }
+                frame[i] = argument.as_bool();
+                break;
+        }
+    }
+
+    Context context{globals, frame + frame_size_, frame + STACK_MAX, 0, {}};
+    try {
+        if (body_(context, frame) != Completion::RETURN) {
+            return false;
+        }
+    } catch (const Deoptimize &) {
+        return false;
+    }
+
+    switch (return_type_) {
+        case static_type::INT:
+            result = context.result.i;
+            break;
+        case static_type::DOUBLE:
+            result = context.result.d;
+            break;
+        default:
+            result = context.result.i != 0;
+            break;
+    }
+    return true;
+}
+
+} // namespace zero::typed
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "ast/stmt.hpp"
+#include "ast/type.hpp"
+#include "value.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace zero::typed {
+
+// 没有类型标签的值, 按编译时确定的类型读取, bool保存为0或1
+union Slot {
+    Slot() : i{0} {}
+    Slot(int64_t i) : i{i} {}
+    Slot(double d) : d{d} {}
+    Slot(bool b) : i{b ? 1 : 0} {}
+
+    int64_t i;
+    double d;
+};
+
+class TypedFunction;
+struct Context;
+
+using ExprCode = std::function<Slot(Context &, Slot *)>;
+using StmtCode = std::function<Completion(Context &, Slot *)>;
+
+// 整数溢出, 除以0, 被调用的全局函数被重新赋值等情况下抛出,
+// 回到普通的执行方式重新执行整个调用, 特化的函数没有副作用, 重新执行是安全的
+struct Deoptimize {};
+
+// 特化代码执行时的状态
+struct Context {
+    // 调用另一个特化的函数, 在栈顶分配栈帧
+    Slot call(const TypedFunction &function,
+              const std::vector<ExprCode> &arguments,
+              Slot *frame);
+
+    Value *globals; // 检查被调用的全局函数
+    Slot *top;
+    Slot *end;
+    unsigned int depth;
+    Slot result; // return语句的返回值
+};
+
+// 参数和返回值都有int, double或bool注解的函数的特化版本
+class TypedFunction {
+public:
+    TypedFunction(const Function &declaration, StmtCode body);
+
+public:
+    // 参数的类型都与注解一致时执行特化的函数体, 结果保存到result中
+    // 类型不一致或者需要退回普通执行方式时返回false
+    bool call(const Value *arguments, Value *globals, Value &result) const;
+
+    std::size_t frame_size() const { return frame_size_; }
+    const StmtCode &body() const { return body_; }
+
+private:
+    std::vector<static_type> param_types_;
+    static_type return_type_;
+    std::size_t frame_size_;
+    StmtCode body_;
+};
+
+} // namespace zero::typed
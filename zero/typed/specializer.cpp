@@ -0,0 +1,704 @@
+#include "specializer.hpp"
+
+#include "function.hpp"
+#include "numeric.hpp"
+
+#include <algorithm>
+#include <utility>
+
+namespace zero::typed {
+
+namespace {
+bool is_specializable(static_type type) {
+    return type == static_type::INT || type == static_type::DOUBLE
+        || type == static_type::BOOL;
+}
+
+bool is_numeric(static_type type) {
+    return type == static_type::INT || type == static_type::DOUBLE;
+}
+
+// 二元运算操作数的读取方式, 局部变量和常量不需要再调用一层闭包
+struct LocalOperand {
+    Slot operator()(Context &, Slot *frame) const { return frame[slot]; }
+    unsigned int slot;
+};
+
+struct ConstantOperand {
+    Slot operator()(Context &, Slot *) const { return value; }
+    Slot value;
+};
+
+struct CodeOperand {
+    Slot operator()(Context &context, Slot *frame) const {
+        return code(context, frame);
+    }
+    ExprCode code;
+};
+
+enum class operand_kind { LOCAL, CONSTANT, CODE };
+
+struct Operand {
+    operand_kind kind;
+    unsigned int slot; // LOCAL
+    Slot value;        // CONSTANT
+    ExprCode code;     // 所有操作数都编译一份, 不能直接读取时使用
+};
+
+template <typename Operation, typename Left, typename Right>
+ExprCode binary_code(Left left, Right right, Operation operation) {
+    return [left = std::move(left), right = std::move(right), operation](
+               Context &context, Slot *frame) {
+        Slot a = left(context, frame);
+        Slot b = right(context, frame);
+        return operation(a, b);
+    };
+}
+
+template <typename Operation, typename Left>
+ExprCode
+binary_code(Left left, const Operand &right, Operation operation) {
+    switch (right.kind) {
+        case operand_kind::LOCAL:
+            return binary_code(
+                std::move(left), LocalOperand{right.slot}, operation);
+        case operand_kind::CONSTANT:
+            return binary_code(
+                std::move(left), ConstantOperand{right.value}, operation);
+        default:
+            return binary_code(
+                std::move(left), CodeOperand{right.code}, operation);
+    }
+}
+
+template <typename Operation>
+ExprCode binary_code(const Operand &left,
+                     const Operand &right,
+                     Operation operation) {
+    if (left.kind == operand_kind::LOCAL) {
+        return binary_code(LocalOperand{left.slot}, right, operation);
+    }
+    return binary_code(CodeOperand{left.code}, right, operation);
+}
+
+// 整数运算的结果与普通执行方式不同(提升为double或者报错)时退回普通执行方式
+ExprCode int_arithmetic(token_type op, const Operand &l, const Operand &r) {
+    switch (op) {
+        case token_type::PLUS:
+            return binary_code(l, r, [](Slot a, Slot b) {
+                int64_t result;
+                if (add_overflow(a.i, b.i, &result)) {
+                    throw Deoptimize{};
+                }
+                return Slot{result};
+            });
+        case token_type::MINUS:
+            return binary_code(l, r, [](Slot a, Slot b) {
+                int64_t result;
+                if (subtract_overflow(a.i, b.i, &result)) {
+                    throw Deoptimize{};
+                }
+                return Slot{result};
+            });
+        case token_type::STAR:
+            return binary_code(l, r, [](Slot a, Slot b) {
+                int64_t result;
+                if (multiply_overflow(a.i, b.i, &result)) {
+                    throw Deoptimize{};
+                }
+                return Slot{result};
+            });
+        default:
+            return binary_code(l, r, [](Slot a, Slot b) {
+                if (b.i == 0 || (a.i == INT64_MIN && b.i == -1)) {
+                    throw Deoptimize{};
+                }
+                return Slot{a.i / b.i};
+            });
+    }
+}
+
+ExprCode int_comparison(token_type op, const Operand &l, const Operand &r) {
+    switch (op) {
+        case token_type::EQUAL_EQUAL:
+            return binary_code(
+                l, r, [](Slot a, Slot b) { return Slot{a.i == b.i}; });
+        case token_type::NOT_EQUAL:
+            return binary_code(
+                l, r, [](Slot a, Slot b) { return Slot{a.i != b.i}; });
+        case token_type::GREATER:
+            return binary_code(
+                l, r, [](Slot a, Slot b) { return Slot{a.i > b.i}; });
+        case token_type::GREATER_EQUAL:
+            return binary_code(
+                l, r, [](Slot a, Slot b) { return Slot{a.i >= b.i}; });
+        case token_type::LESS:
+            return binary_code(
+                l, r, [](Slot a, Slot b) { return Slot{a.i < b.i}; });
+        default:
+            return binary_code(
+                l, r, [](Slot a, Slot b) { return Slot{a.i <= b.i}; });
+    }
+}
+
+ExprCode double_operation(token_type op, const Operand &l, const Operand &r) {
+    switch (op) {
+        case token_type::PLUS:
+            return binary_code(
+                l, r, [](Slot a, Slot b) { return Slot{a.d + b.d}; });
+        case token_type::MINUS:
+            return binary_code(
+                l, r, [](Slot a, Slot b) { return Slot{a.d - b.d}; });
+        case token_type::STAR:
+            return binary_code(
+                l, r, [](Slot a, Slot b) { return Slot{a.d * b.d}; });
+        case token_type::SLASH:
+            return binary_code(
+                l, r, [](Slot a, Slot b) { return Slot{a.d / b.d}; });
+        case token_type::EQUAL_EQUAL:
+            return binary_code(
+                l, r, [](Slot a, Slot b) { return Slot{a.d == b.d}; });
+        case token_type::NOT_EQUAL:
+            return binary_code(
+                l, r, [](Slot a, Slot b) { return Slot{a.d != b.d}; });
+        case token_type::GREATER:
+            return binary_code(
+                l, r, [](Slot a, Slot b) { return Slot{a.d > b.d}; });
+        case token_type::GREATER_EQUAL:
+            return binary_code(
+                l, r, [](Slot a, Slot b) { return Slot{a.d >= b.d}; });
+        case token_type::LESS:
+            return binary_code(
+                l, r, [](Slot a, Slot b) { return Slot{a.d < b.d}; });
+        default:
+            return binary_code(
+                l, r, [](Slot a, Slot b) { return Slot{a.d <= b.d}; });
+    }
+}
+
+// 整数和浮点数运算时整数先转换成浮点数, 与as_number相同
+Operand to_double(Operand operand) {
+    if (operand.kind == operand_kind::CONSTANT) {
+        operand.value = Slot{static_cast<double>(operand.value.i)};
+    } else {
+        operand.kind = operand_kind::CODE;
+        operand.code = [code = std::move(operand.code)](Context &context,
+                                                        Slot *frame) {
+            return Slot{static_cast<double>(code(context, frame).i)};
+        };
+    }
+    return operand;
+}
+
+Slot to_slot(const Value &value) {
+    if (value.is_int()) {
+        return Slot{value.as_int()};
+    }
+    if (value.is_double()) {
+        return Slot{value.as_double()};
+    }
+    return Slot{value.as_bool()};
+}
+
+// 括号只影响解析
+Expr &unwrap(Expr &expr) {
+    Expr *inner = &expr;
+    while (auto *grouping = dynamic_cast<Grouping *>(inner)) {
+        inner = grouping->expr.get();
+    }
+    return *inner;
+}
+} // namespace
+
+std::size_t Specializer::specialize(const std::unique_ptr<Program> &program) {
+    // 参数和返回值都有可以特化的注解的顶层函数
+    std::vector<Candidate> candidates;
+    for (const auto &stmt : program->get_statements()) {
+        auto *function = dynamic_cast<Function *>(stmt.get());
+        if (function == nullptr || function->depth != GLOBAL_DEPTH) {
+            continue;
+        }
+        bool annotated = is_specializable(function->return_type)
+                      && std::all_of(function->param_types.begin(),
+                                     function->param_types.end(),
+                                     is_specializable);
+        if (!annotated) {
+            continue;
+        }
+        if (!function->captures.empty() || function->memo != nullptr) {
+            rejected_.push_back(function);
+            continue;
+        }
+        candidates.push_back(Candidate{function, {}, {}, true});
+        candidates_[function->slot] = function;
+    }
+
+    for (auto &candidate : candidates) {
+        compile(candidate);
+    }
+
+    // 调用了不能特化的函数的函数也不能特化, 直到没有变化为止
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (auto &candidate : candidates) {
+            if (!candidate.specialized) {
+                continue;
+            }
+            for (const auto *callee : candidate.callees) {
+                auto found = std::find_if(
+                    candidates.begin(),
+                    candidates.end(),
+                    [callee](const Candidate &c) {
+                        return c.function == callee;
+                    });
+                if (!found->specialized) {
+                    candidate.specialized = false;
+                    changed = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    std::size_t num_specialized = 0;
+    for (auto &candidate : candidates) {
+        if (!candidate.specialized) {
+            rejected_.push_back(candidate.function);
+            continue;
+        }
+        candidate.function->typed = std::make_shared<TypedFunction>(
+            *candidate.function, std::move(candidate.body));
+        num_specialized++;
+    }
+
+    return num_specialized;
+}
+
+void Specializer::compile(Candidate &candidate) {
+    auto *function = candidate.function;
+    function_ = function;
+    locals_.assign(std::max<std::size_t>(function->num_slots,
+                                         function->params.size()),
+                   static_type::ANY);
+    std::copy(function->param_types.begin(),
+              function->param_types.end(),
+              locals_.begin());
+    callees_.clear();
+
+    try {
+        candidate.body = compile(function->body);
+        candidate.callees = callees_;
+    } catch (const Unsupported &) {
+        candidate.specialized = false;
+    }
+}
+
+Specializer::Typed Specializer::compile(Expr &expr) {
+    expr.accept(*this);
+    return std::move(result_);
+}
+
+StmtCode Specializer::compile(Stmt &stmt) {
+    stmt.accept(*this);
+    return std::move(stmt_code_);
+}
+
+StmtCode
+Specializer::compile(const std::vector<std::unique_ptr<Stmt>> &stmts) {
+    if (stmts.size() == 1) {
+        return compile(*stmts.front());
+    }
+
+    std::vector<StmtCode> codes;
+    codes.reserve(stmts.size());
+    for (const auto &stmt : stmts) {
+        codes.push_back(compile(*stmt));
+    }
+    return [codes = std::move(codes)](Context &context, Slot *frame) {
+        for (const auto &code : codes) {
+            auto completion = code(context, frame);
+            if (completion != Completion::NORMAL) {
+                return completion;
+            }
+        }
+        return Completion::NORMAL;
+    };
+}
+
+ExprCode Specializer::compile_condition(Expr &expr) {
+    auto condition = compile(expr);
+    if (condition.type != static_type::BOOL) {
+        throw Unsupported{};
+    }
+
+    return std::move(condition.code);
+}
+
+static_type Specializer::local_type(int depth, unsigned int slot) {
+    // 只能访问局部变量, 全局变量和捕获的变量在执行期间可能改变类型
+    if (depth != LOCAL_DEPTH || !is_specializable(locals_[slot])) {
+        throw Unsupported{};
+    }
+
+    return locals_[slot];
+}
+
+Specializer::Typed Specializer::compile_call(Call &call) {
+    // 只能调用特化的全局函数, 参数类型与注解完全相同
+    auto *variable = dynamic_cast<Variable *>(call.callee.get());
+    if (variable == nullptr || variable->depth != GLOBAL_DEPTH) {
+        throw Unsupported{};
+    }
+    auto found = candidates_.find(variable->slot);
+    if (found == candidates_.end()
+        || found->second->params.size() != call.arguments.size()) {
+        throw Unsupported{};
+    }
+    const auto *callee = found->second;
+
+    std::vector<ExprCode> arguments;
+    for (std::size_t i = 0; i < call.arguments.size(); i++) {
+        auto argument = compile(*call.arguments[i]);
+        if (argument.type != callee->param_types[i]) {
+            throw Unsupported{};
+        }
+        arguments.push_back(std::move(argument.code));
+    }
+    callees_.push_back(callee);
+
+    // 全局变量被重新赋值时退回普通执行方式
+    return Typed{callee->return_type,
+                 [callee, slot = variable->slot, arguments = std::move(
+                                                     arguments)](
+                     Context &context, Slot *frame) {
+                     const auto &function = context.globals[slot];
+                     if (!function.is_function()
+                         || function.as_function().get_declaration()
+                                != callee) {
+                         throw Deoptimize{};
+                     }
+                     return context.call(*callee->typed, arguments, frame);
+                 }};
+}
+
+Specializer::Typed
+Specializer::compile_binary(token_type op, Expr &left, Expr &right) {
+    Operand operands[2];
+    static_type types[2];
+    Expr *exprs[2] = {&left, &right};
+    for (auto i = 0; i < 2; i++) {
+        auto &expr = unwrap(*exprs[i]);
+        auto compiled = compile(expr);
+        auto &operand = operands[i];
+        types[i] = compiled.type;
+        operand.kind = operand_kind::CODE;
+        operand.code = std::move(compiled.code);
+        if (auto *variable = dynamic_cast<Variable *>(&expr)) {
+            operand.kind = operand_kind::LOCAL;
+            operand.slot = variable->slot;
+        } else if (auto *literal = dynamic_cast<Literal *>(&expr)) {
+            operand.kind = operand_kind::CONSTANT;
+            operand.value = to_slot(literal->value);
+        }
+    }
+
+    bool comparison = op != token_type::PLUS && op != token_type::MINUS
+                   && op != token_type::STAR && op != token_type::SLASH;
+    if (types[0] == static_type::BOOL && types[1] == static_type::BOOL
+        && (op == token_type::EQUAL_EQUAL || op == token_type::NOT_EQUAL)) {
+        return Typed{static_type::BOOL, int_comparison(op, operands[0],
+                                                       operands[1])};
+    }
+    if (!is_numeric(types[0]) || !is_numeric(types[1])) {
+        throw Unsupported{};
+    }
+    if (types[0] == static_type::INT && types[1] == static_type::INT) {
+        if (comparison) {
+            return Typed{static_type::BOOL,
+                         int_comparison(op, operands[0], operands[1])};
+        }
+        return Typed{static_type::INT,
+                     int_arithmetic(op, operands[0], operands[1])};
+    }
+
+    for (auto i = 0; i < 2; i++) {
+        if (types[i] == static_type::INT) {
+            operands[i] = to_double(std::move(operands[i]));
+        }
+    }
+    return Typed{comparison ? static_type::BOOL : static_type::DOUBLE,
+                 double_operation(op, operands[0], operands[1])};
+}
+
+Value Specializer::visit_binary_expr(Binary *expr) {
+    result_ = compile_binary(expr->op.type, *expr->left, *expr->right);
+
+    return {};
+}
+
+Value Specializer::visit_grouping_expr(Grouping *expr) {
+    result_ = compile(*expr->expr);
+
+    return {};
+}
+
+Value Specializer::visit_literal_expr(Literal *expr) {
+    const auto &value = expr->value;
+    if (!value.is_int() && !value.is_double() && !value.is_bool()) {
+        throw Unsupported{};
+    }
+    auto type = value.is_int()      ? static_type::INT
+              : value.is_double() ? static_type::DOUBLE
+                                  : static_type::BOOL;
+    result_ = Typed{type, [slot = to_slot(value)](Context &, Slot *) {
+                        return slot;
+                    }};
+
+    return {};
+}
+
+Value Specializer::visit_logical_expr(Logical *expr) {
+    auto left = compile_condition(*expr->left);
+    auto right = compile_condition(*expr->right);
+    if (expr->op.type == token_type::OR) {
+        result_.code = [left = std::move(left), right = std::move(right)](
+                           Context &context, Slot *frame) {
+            return left(context, frame).i != 0 ? Slot{true}
+                                               : right(context, frame);
+        };
+    } else {
+        result_.code = [left = std::move(left), right = std::move(right)](
+                           Context &context, Slot *frame) {
+            return left(context, frame).i == 0 ? Slot{false}
+                                               : right(context, frame);
+        };
+    }
+    result_.type = static_type::BOOL;
+
+    return {};
+}
+
+Value Specializer::visit_unary_expr(Unary *expr) {
+    auto right = compile(*expr->right);
+    if (expr->op.type == token_type::NOT) {
+        if (right.type != static_type::BOOL) {
+            throw Unsupported{};
+        }
+        result_.code = [right = std::move(right.code)](Context &context,
+                                                       Slot *frame) {
+            return Slot{right(context, frame).i == 0};
+        };
+    } else if (right.type == static_type::INT) {
+        result_.code = [right = std::move(right.code)](Context &context,
+                                                       Slot *frame) {
+            auto value = right(context, frame).i;
+            if (value == INT64_MIN) {
+                throw Deoptimize{};
+            }
+            return Slot{-value};
+        };
+    } else if (right.type == static_type::DOUBLE) {
+        result_.code = [right = std::move(right.code)](Context &context,
+                                                       Slot *frame) {
+            return Slot{-right(context, frame).d};
+        };
+    } else {
+        throw Unsupported{};
+    }
+    result_.type = right.type;
+
+    return {};
+}
+
+Value Specializer::visit_variable_expr(Variable *expr) {
+    result_ = Typed{local_type(expr->depth, expr->slot),
+                    [slot = expr->slot](Context &, Slot *frame) {
+                        return frame[slot];
+                    }};
+
+    return {};
+}
+
+Value Specializer::visit_assign_expr(Assign *expr) {
+    auto type = local_type(expr->depth, expr->slot);
+    auto value = compile(*expr->value);
+    if (value.type != type) {
+        throw Unsupported{};
+    }
+    result_ = Typed{type,
+                    [slot = expr->slot, value = std::move(value.code)](
+                        Context &context, Slot *frame) {
+                        return frame[slot] = value(context, frame);
+                    }};
+
+    return {};
+}
+
+Value Specializer::visit_call_expr(Call *expr) {
+    result_ = compile_call(*expr);
+
+    return {};
+}
+
+Value Specializer::visit_inline_call_expr(InlineCall *expr) {
+    // 特化的调用已经足够快, 按原来的调用执行
+    result_ = compile_call(*expr->call);
+
+    return {};
+}
+
+Value Specializer::visit_increment_expr(Increment *expr) {
+    auto type = local_type(expr->depth, expr->slot);
+    if (type == static_type::INT) {
+        result_.code = [slot = expr->slot, delta = expr->delta](Context &,
+                                                                Slot *frame) {
+            int64_t result;
+            if (add_overflow(frame[slot].i, delta, &result)) {
+                throw Deoptimize{};
+            }
+            return frame[slot] = Slot{result};
+        };
+    } else if (type == static_type::DOUBLE) {
+        result_.code = [slot = expr->slot,
+                        delta = static_cast<double>(expr->delta)](
+                           Context &, Slot *frame) {
+            return frame[slot] = Slot{frame[slot].d + delta};
+        };
+    } else {
+        throw Unsupported{};
+    }
+    result_.type = type;
+
+    return {};
+}
+
+Value Specializer::visit_compare_expr(Compare *expr) {
+    result_ = compile_binary(expr->op.type, *expr->variable, *expr->bound);
+
+    return {};
+}
+
+Value Specializer::visit_promote_expr(Promote *expr) {
+    auto operand = compile(*expr->expr);
+    if (operand.type == static_type::INT) {
+        operand.code = [code = std::move(operand.code)](Context &context,
+                                                        Slot *frame) {
+            return Slot{static_cast<double>(code(context, frame).i)};
+        };
+        operand.type = static_type::DOUBLE;
+    } else if (operand.type != static_type::DOUBLE) {
+        throw Unsupported{};
+    }
+    result_ = std::move(operand);
+
+    return {};
+}
+
+Completion Specializer::visit_block_stmt(Block *stmt) {
+    // 函数中的块使用函数的栈帧, 特化的函数中也没有被捕获的变量
+    if (stmt->num_slots != 0 || stmt->has_captured) {
+        throw Unsupported{};
+    }
+    stmt_code_ = compile(stmt->statements);
+
+    return Completion::NORMAL;
+}
+
+Completion Specializer::visit_expression_stmt(Expression *stmt) {
+    stmt_code_ = [expression = compile(*stmt->expression).code](
+                     Context &context, Slot *frame) {
+        expression(context, frame);
+        return Completion::NORMAL;
+    };
+
+    return Completion::NORMAL;
+}
+
+Completion Specializer::visit_var_stmt(Var *stmt) {
+    // 变量的类型由注解或者初始值确定
+    if (stmt->depth != LOCAL_DEPTH || stmt->initializer == nullptr) {
+        throw Unsupported{};
+    }
+    auto initializer = compile(*stmt->initializer);
+    auto type = stmt->type == static_type::ANY ? initializer.type : stmt->type;
+    if (!is_specializable(type) || initializer.type != type) {
+        throw Unsupported{};
+    }
+    locals_[stmt->slot] = type;
+
+    stmt_code_ = [slot = stmt->slot, initializer = std::move(
+                                         initializer.code)](Context &context,
+                                                            Slot *frame) {
+        frame[slot] = initializer(context, frame);
+        return Completion::NORMAL;
+    };
+
+    return Completion::NORMAL;
+}
+
+Completion Specializer::visit_if_stmt(If *stmt) {
+    auto condition = compile_condition(*stmt->condition);
+    auto then_branch = compile(*stmt->then_branch);
+    if (stmt->else_branch == nullptr) {
+        stmt_code_ = [condition = std::move(condition),
+                      then_branch = std::move(then_branch)](
+                         Context &context, Slot *frame) {
+            if (condition(context, frame).i != 0) {
+                return then_branch(context, frame);
+            }
+            return Completion::NORMAL;
+        };
+        return Completion::NORMAL;
+    }
+
+    stmt_code_ = [condition = std::move(condition),
+                  then_branch = std::move(then_branch),
+                  else_branch = compile(*stmt->else_branch)](Context &context,
+                                                             Slot *frame) {
+        if (condition(context, frame).i != 0) {
+            return then_branch(context, frame);
+        }
+        return else_branch(context, frame);
+    };
+
+    return Completion::NORMAL;
+}
+
+Completion Specializer::visit_while_stmt(While *stmt) {
+    stmt_code_ = [condition = compile_condition(*stmt->condition),
+                  body = compile(*stmt->body)](Context &context, Slot *frame) {
+        while (condition(context, frame).i != 0) {
+            auto completion = body(context, frame);
+            if (completion != Completion::NORMAL) {
+                return completion;
+            }
+        }
+        return Completion::NORMAL;
+    };
+
+    return Completion::NORMAL;
+}
+
+Completion Specializer::visit_function_stmt([[maybe_unused]] Function *stmt) {
+    throw Unsupported{};
+}
+
+Completion Specializer::visit_return_stmt(Return *stmt) {
+    if (stmt->value == nullptr) {
+        throw Unsupported{};
+    }
+    auto value = compile(*stmt->value);
+    if (value.type != function_->return_type) {
+        throw Unsupported{};
+    }
+    stmt_code_ = [value = std::move(value.code)](Context &context,
+                                                 Slot *frame) {
+        context.result = value(context, frame);
+        return Completion::RETURN;
+    };
+
+    return Completion::NORMAL;
+}
+
+} // namespace zero::typed
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "ast/expr.hpp"
+#include "ast/program.hpp"
+#include "ast/stmt.hpp"
+#include "ast/type.hpp"
+#include "code.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace zero::typed {
+
+// 为参数和返回值都有int, double或bool注解的顶层函数生成特化版本
+// 特化的函数只能使用局部变量, 数值和bool运算, 调用其他特化的全局函数,
+// 值直接以int64_t或double保存, 运算时不需要检查类型标签;
+// 局部变量没有注解时按初始值推导类型, 之后的赋值类型必须相同
+// 在PurityAnalyzer之后运行, 记忆化的函数不特化
+class Specializer : public ExprVisitor, public StmtVisitor {
+public:
+    // 返回特化的函数个数
+    std::size_t specialize(const std::unique_ptr<Program> &program);
+    // 有注解但是没有特化的函数
+    const std::vector<const Function *> &rejected() const {
+        return rejected_;
+    }
+
+public:
+    // Expr抽象类方法, 编译结果保存在result_中
+    Value visit_binary_expr(Binary *expr) override;
+    Value visit_grouping_expr(Grouping *expr) override;
+    Value visit_literal_expr(Literal *expr) override;
+    Value visit_logical_expr(Logical *expr) override;
+    Value visit_unary_expr(Unary *expr) override;
+    Value visit_variable_expr(Variable *expr) override;
+    Value visit_assign_expr(Assign *expr) override;
+    Value visit_call_expr(Call *expr) override;
+    Value visit_inline_call_expr(InlineCall *expr) override;
+    Value visit_increment_expr(Increment *expr) override;
+    Value visit_compare_expr(Compare *expr) override;
+    Value visit_promote_expr(Promote *expr) override;
+
+    // Stmt抽象类方法, 编译结果保存在stmt_code_中
+    Completion visit_block_stmt(Block *stmt) override;
+    Completion visit_expression_stmt(Expression *stmt) override;
+    Completion visit_var_stmt(Var *stmt) override;
+    Completion visit_if_stmt(If *stmt) override;
+    Completion visit_while_stmt(While *stmt) override;
+    Completion visit_function_stmt(Function *stmt) override;
+    Completion visit_return_stmt(Return *stmt) override;
+
+private:
+    // 遇到不能特化的代码时抛出
+    struct Unsupported {};
+
+    // 编译好的表达式和它的类型
+    struct Typed {
+        static_type type;
+        ExprCode code;
+    };
+
+    struct Candidate {
+        Function *function;
+        StmtCode body;
+        std::vector<const Function *> callees;
+        bool specialized;
+    };
+
+    void compile(Candidate &candidate);
+    Typed compile(Expr &expr);
+    StmtCode compile(Stmt &stmt);
+    StmtCode compile(const std::vector<std::unique_ptr<Stmt>> &stmts);
+    Typed compile_call(Call &call);
+    Typed compile_binary(token_type op, Expr &left, Expr &right);
+    // 条件必须是bool
+    ExprCode compile_condition(Expr &expr);
+    static_type local_type(int depth, unsigned int slot);
+
+private:
+    std::unordered_map<unsigned int, Function *> candidates_; // 全局槽位
+    std::vector<const Function *> rejected_;
+    // 当前函数的局部变量类型和调用的特化函数
+    const Function *function_{nullptr};
+    std::vector<static_type> locals_;
+    std::vector<const Function *> callees_;
+    Typed result_;
+    StmtCode stmt_code_;
+};
+
+} // namespace zero::typed
@@ -15,7 +15,6 @@ namespace CmdLine {
 using Usage = std::function<void()>;
 // 可选参数
 void BoolOpt(bool *value, std::string name);
-void IntOpt(int *value, std::string name, int default_value);
 void StrOpt(std::string *value, std::string name, std::string default_value);
 // 位置参数, 不需要 '--', 也属于可选
 void StrPositional(std::string *value);
@@ -72,6 +71,7 @@ public:
     }
 
     bool IsRequired() const { return m_required; }
+    bool IsBool() const { return m_type == OptType::BOOL; }
 
 private:
     OptType m_type;
@@ -94,6 +94,10 @@ void BoolOpt(bool *value, std::string name) {
     g_opts[std::move(name)] = Opt(value, false, false);
 }
 
+void StrOpt(std::string *value, std::string name, std::string default_value) {
+    g_opts[std::move(name)] = Opt(value, std::move(default_value), false);
+}
+
 void StrPositional(std::string *value) {
     Opt opt{value, "", false};
     g_positional.emplace_back(opt);
@@ -145,14 +149,14 @@ ParseOpt(int argc, char *argv[], int &parse_index, int &positional_index) {
         fmt::print("option provided but not defined: {}\n", opt_name);
         return -1;
     }
-    // FIXME: 可选, 但是传入了参数
-    if (not iter->second.IsRequired()) {
+    // bool类型的可选参数不需要值
+    if (iter->second.IsBool()) {
         iter->second.SetValue(true);
         parse_index++;
         return 0;
     }
 
-    // 必选参数
+    // 需要值的参数
     if (has_argument) {
         parse_index++;
     } else if (parse_index + 1 < argc) {
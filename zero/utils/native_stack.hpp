@@ -0,0 +1,78 @@
+#pragma once
+#include <pthread.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+
+namespace utils {
+
+// 当前线程的C++栈可以使用到的最低地址, 为0时不检查
+inline thread_local std::uintptr_t native_stack_limit = 0;
+
+// 当前线程的C++栈是否快要用完, 栈向低地址增长
+inline auto native_stack_exhausted() -> bool {
+    char marker{};
+    return reinterpret_cast<std::uintptr_t>(&marker) < native_stack_limit;
+}
+
+// 根据当前线程的栈范围设置native_stack_limit, 栈底保留reserve字节
+// 检查到栈快用完之后, 抛出和报告错误仍然需要使用C++栈
+inline void limit_native_stack(std::size_t reserve) {
+#if defined(__linux__)
+    pthread_attr_t attr;
+    if (pthread_getattr_np(pthread_self(), &attr) != 0) {
+        return;
+    }
+    void *low = nullptr;
+    std::size_t size = 0;
+    if (pthread_attr_getstack(&attr, &low, &size) == 0 && size > reserve) {
+        native_stack_limit = reinterpret_cast<std::uintptr_t>(low) + reserve;
+    }
+    pthread_attr_destroy(&attr);
+#else
+    (void) reserve;
+#endif
+}
+
+// 在C++栈大小为stack_size的新线程中执行function, 等待它结束
+// function抛出的异常在当前线程重新抛出, 创建线程失败时直接在当前线程执行
+template <typename F>
+void run_with_native_stack(std::size_t stack_size,
+                           std::size_t reserve,
+                           F &&function) {
+    struct Task {
+        F *function;
+        std::size_t reserve;
+        std::exception_ptr error;
+    };
+    Task task{&function, reserve, nullptr};
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, stack_size);
+    pthread_t thread;
+    auto entry = [](void *arg) -> void * {
+        auto *task = static_cast<Task *>(arg);
+        limit_native_stack(task->reserve);
+        try {
+            (*task->function)();
+        } catch (...) {
+            task->error = std::current_exception();
+        }
+        return nullptr;
+    };
+    int res = pthread_create(&thread, &attr, entry, &task);
+    pthread_attr_destroy(&attr);
+    if (res != 0) {
+        limit_native_stack(reserve);
+        function();
+        return;
+    }
+    pthread_join(thread, nullptr);
+    if (task.error) {
+        std::rethrow_exception(task.error);
+    }
+}
+
+} // namespace utils
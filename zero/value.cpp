@@ -0,0 +1,206 @@
+#include "value.hpp"
+
+#include "function.hpp"
+
+#include <fmt/format.h>
+
+#include <cstring>
+#include <vector>
+
+namespace zero {
+Value::Value(std::string_view str) {
+    if (str.size() <= SHORT_STRING_MAX) {
+        init_short_string(str);
+    } else {
+        adopt(value_type::STRING, new StringObject{std::string{str}});
+    }
+}
+
+Value::Value(std::string &&str) {
+    if (str.size() <= SHORT_STRING_MAX) {
+        init_short_string(str);
+    } else {
+        adopt(value_type::STRING, new StringObject{std::move(str)});
+    }
+}
+
+Value::Value(const ZeroFunction &function) {
+    adopt(value_type::FUNCTION, new ZeroFunction{function});
+}
+
+Value::Value(const ZeroFunction *function) {
+    adopt(value_type::FUNCTION, const_cast<ZeroFunction *>(function));
+}
+
+Value::Value(const NativeFunction &function) {
+    adopt(value_type::NATIVE_FUNCTION, new NativeFunction{function});
+}
+
+void Value::init_short_string(std::string_view str) {
+    data_.short_string.type = value_type::SHORT_STRING;
+    data_.short_string.length = static_cast<uint8_t>(str.size());
+    std::memcpy(data_.short_string.chars, str.data(), str.size());
+}
+
+ZeroFunction &Value::as_function() const {
+    return *static_cast<ZeroFunction *>(data_.scalar.as.object);
+}
+
+NativeFunction &Value::as_native_function() const {
+    return *static_cast<NativeFunction *>(data_.scalar.as.object);
+}
+
+Value::Value(Upvalue *upvalue) { adopt(value_type::UPVALUE, upvalue); }
+
+Upvalue &Value::as_upvalue() const {
+    return *static_cast<Upvalue *>(data_.scalar.as.object);
+}
+
+StringObject::StringObject(Value left, Value right)
+    : length_{length_of(left) + length_of(right)}, left_{std::move(left)},
+      right_{std::move(right)} {}
+
+StringObject::~StringObject() {
+    if (is_rope()) {
+        release_parts();
+    }
+}
+
+std::size_t StringObject::length_of(const Value &string) {
+    if (string.type() == value_type::STRING) {
+        return static_cast<const StringObject *>(string.as_object())->length_;
+    }
+    return string.as_string().size();
+}
+
+void StringObject::flatten() const {
+    flat_.reserve(length_);
+    // 用显式的栈按从左到右的顺序遍历, 循环拼接得到的rope可能非常深
+    std::vector<const Value *> parts{&right_, &left_};
+    while (!parts.empty()) {
+        const Value *part = parts.back();
+        parts.pop_back();
+        if (part->type() == value_type::STRING) {
+            const auto *string
+                = static_cast<const StringObject *>(part->as_object());
+            if (string->is_rope()) {
+                parts.push_back(&string->right_);
+                parts.push_back(&string->left_);
+                continue;
+            }
+        }
+        flat_ += part->as_string();
+    }
+
+    release_parts();
+}
+
+void StringObject::release_parts() const {
+    // 逐层拆开只被当前节点引用的子rope, 避免析构时递归过深
+    std::vector<Value> parts;
+    parts.push_back(std::move(left_));
+    parts.push_back(std::move(right_));
+    while (!parts.empty()) {
+        Value part = std::move(parts.back());
+        parts.pop_back();
+        if (part.type() == value_type::STRING
+            && part.as_object()->refcount == 1) {
+            auto *string = static_cast<StringObject *>(part.as_object());
+            if (string->is_rope()) {
+                parts.push_back(std::move(string->left_));
+                parts.push_back(std::move(string->right_));
+            }
+        }
+    }
+}
+
+Value concat(const Value &a, const Value &b) {
+    // 结果较短时直接复制, 比分配rope节点更划算
+    constexpr std::size_t ROPE_MIN = 64;
+
+    auto length = StringObject::length_of(a) + StringObject::length_of(b);
+    if (length < ROPE_MIN) {
+        std::string result;
+        result.reserve(length);
+        result += a.as_string();
+        result += b.as_string();
+        return result;
+    }
+
+    Value result;
+    result.adopt(value_type::STRING, new StringObject{a, b});
+    return result;
+}
+
+bool is_equal(const Value &a, const Value &b) {
+    if (a.type() != b.type()) {
+        // 整数和浮点数按数值比较
+        if (a.is_int() && b.is_double()) {
+            return static_cast<double>(a.as_int()) == b.as_double();
+        }
+        if (a.is_double() && b.is_int()) {
+            return a.as_double() == static_cast<double>(b.as_int());
+        }
+        return false;
+    }
+
+    switch (a.type()) {
+        case value_type::NIL:
+            return true;
+        case value_type::BOOL:
+            return a.as_bool() == b.as_bool();
+        case value_type::INT:
+            return a.as_int() == b.as_int();
+        case value_type::DOUBLE:
+            return a.as_double() == b.as_double();
+        case value_type::SHORT_STRING:
+            return a.as_string() == b.as_string();
+        case value_type::STRING:
+            // 字符串常量是驻留的, 相同的常量指向同一个对象
+            return a.as_object() == b.as_object()
+                || (StringObject::length_of(a) == StringObject::length_of(b)
+                    && a.as_string() == b.as_string());
+        default:
+            // 函数按引用比较
+            return a.as_object() == b.as_object();
+    }
+}
+
+std::string stringify(const Value &object) {
+    if (object.is_nil()) {
+        return "nil";
+    }
+    if (object.is_int()) {
+        std::string text = std::to_string(object.as_int());
+        // if (text[text.length() - 2] == '.' && text[text.length() - 1] == '0')
+        // {
+        //     text = text.substr(0, text.length() - 2);
+        // }
+
+        return text;
+    }
+    if (object.is_double()) {
+        // 最短的能还原出原值的表示, 整数值的浮点数带上".0"以区分整数
+        auto text = fmt::format("{}", object.as_double());
+        if (text.find_first_of(".eEn") == std::string::npos) {
+            text += ".0";
+        }
+        return text;
+    }
+
+    if (object.is_string()) {
+        return std::string{object.as_string()};
+    }
+    if (object.is_bool()) {
+        return object.as_bool() ? "true" : "false";
+    }
+    if (object.is_function()) {
+        return object.as_function().to_string();
+    }
+    if (object.is_native_function()) {
+        return object.as_native_function().to_string();
+    }
+
+    return "Error in 'stringify': object type not supported.";
+}
+} // namespace zero
@@ -0,0 +1,232 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace zero {
+
+// 前置声明
+class ZeroFunction;
+class NativeFunction;
+class Upvalue;
+
+enum class value_type : uint8_t {
+    NIL,
+    BOOL,
+    INT,
+    DOUBLE,
+    SHORT_STRING, // 不超过14字节的字符串直接存放在Value内部
+    // 以下类型的值存放在堆上, 通过引用计数管理
+    STRING,
+    FUNCTION,
+    NATIVE_FUNCTION,
+    UPVALUE, // 闭包捕获的变量, 只在解释器内部使用
+};
+
+// 堆对象基类, 侵入式引用计数
+class Object {
+public:
+    Object() = default;
+    // 拷贝对象时不拷贝引用计数
+    Object(const Object & /*other*/) {}
+    Object &operator=(const Object & /*other*/) { return *this; }
+    virtual ~Object() = default;
+
+public:
+    uint32_t refcount{0};
+};
+
+// 解释器中的值: 1字节类型标签 + 8字节数据, 共16字节
+// 数值分为64位整数和double两种, 运算规则见numeric.hpp
+// nil/bool/int/double和短字符串直接存放在Value内部, 不会分配堆内存
+class Value {
+public:
+    static constexpr std::size_t SHORT_STRING_MAX = 14;
+
+public:
+    Value() { data_.scalar = Scalar{value_type::NIL, {nullptr}}; }
+    // 以下构造函数允许隐式转换, 方便直接返回C++值
+    Value(std::nullptr_t) : Value() {}
+    Value(bool boolean) {
+        data_.scalar.type = value_type::BOOL;
+        data_.scalar.as.boolean = boolean;
+    }
+    Value(int64_t integer) {
+        data_.scalar.type = value_type::INT;
+        data_.scalar.as.integer = integer;
+    }
+    Value(int integer) : Value(static_cast<int64_t>(integer)) {}
+    Value(double number) {
+        data_.scalar.type = value_type::DOUBLE;
+        data_.scalar.as.number = number;
+    }
+    Value(std::string_view str);
+    Value(const std::string &str) : Value(std::string_view{str}) {}
+    Value(std::string &&str);
+    Value(const char *str) : Value(std::string_view{str}) {}
+    Value(const ZeroFunction &function);
+    // 引用一个已经由Value持有的函数对象, 不复制
+    explicit Value(const ZeroFunction *function);
+    Value(const NativeFunction &function);
+    // 接管新分配的捕获变量
+    explicit Value(Upvalue *upvalue);
+
+    // 按字节复制整个union, 短字符串和其他类型的值都适用
+    Value(const Value &other) : data_{other.data_} { retain(); }
+    Value(Value &&other) noexcept : data_{other.data_} {
+        other.data_.scalar.type = value_type::NIL;
+    }
+    Value &operator=(const Value &other) {
+        // 先增加引用计数再释放, 自我赋值也是安全的
+        other.retain();
+        release();
+        data_ = other.data_;
+        return *this;
+    }
+    Value &operator=(Value &&other) noexcept {
+        if (this != &other) {
+            release();
+            data_ = other.data_;
+            other.data_.scalar.type = value_type::NIL;
+        }
+        return *this;
+    }
+    ~Value() { release(); }
+
+public:
+    value_type type() const { return data_.scalar.type; }
+    bool is_nil() const { return type() == value_type::NIL; }
+    bool is_bool() const { return type() == value_type::BOOL; }
+    bool is_int() const { return type() == value_type::INT; }
+    bool is_double() const { return type() == value_type::DOUBLE; }
+    bool is_string() const {
+        return type() == value_type::SHORT_STRING
+            || type() == value_type::STRING;
+    }
+    bool is_function() const { return type() == value_type::FUNCTION; }
+    bool is_native_function() const {
+        return type() == value_type::NATIVE_FUNCTION;
+    }
+    bool is_object() const { return type() >= value_type::STRING; }
+
+    bool as_bool() const { return data_.scalar.as.boolean; }
+    int64_t as_int() const { return data_.scalar.as.integer; }
+    double as_double() const { return data_.scalar.as.number; }
+    // 返回的视图在Value被修改或销毁前有效
+    std::string_view as_string() const;
+    Object *as_object() const { return data_.scalar.as.object; }
+    ZeroFunction &as_function() const;
+    NativeFunction &as_native_function() const;
+    Upvalue &as_upvalue() const;
+
+private:
+    void retain() const {
+        if (is_object()) {
+            ++data_.scalar.as.object->refcount;
+        }
+    }
+    void release() {
+        if (is_object() && --data_.scalar.as.object->refcount == 0) {
+            delete data_.scalar.as.object;
+        }
+    }
+    void init_short_string(std::string_view str);
+    // 接管一个新分配的堆对象
+    void adopt(value_type type, Object *object) {
+        data_.scalar.type = type;
+        data_.scalar.as.object = object;
+        retain();
+    }
+
+private:
+    friend Value concat(const Value &a, const Value &b);
+
+    // 两个结构体的第一个成员都是类型标签, 可以通过任意一个读取
+    struct Scalar {
+        value_type type;
+        union {
+            Object *object;
+            bool boolean;
+            int64_t integer;
+            double number;
+        } as;
+    };
+    struct ShortString {
+        value_type type;
+        uint8_t length;
+        char chars[SHORT_STRING_MAX];
+    };
+
+    union Data {
+        Scalar scalar;
+        ShortString short_string;
+    } data_;
+};
+
+static_assert(sizeof(Value) == 16, "Value should be 16 bytes");
+
+// 不可变的字符串, 通过引用计数共享, 传递时不拷贝内容
+// 拼接得到的字符串是rope节点, 只记录左右两部分, 第一次读取内容时才展开
+class StringObject : public Object {
+public:
+    explicit StringObject(std::string value)
+        : length_{value.size()}, flat_{std::move(value)} {}
+    StringObject(Value left, Value right);
+    ~StringObject() override;
+
+public:
+    std::size_t length() const { return length_; }
+    std::string_view view() const {
+        if (is_rope()) {
+            flatten();
+        }
+        return flat_;
+    }
+
+    // 不展开rope, 直接得到字符串的长度
+    static std::size_t length_of(const Value &string);
+
+private:
+    bool is_rope() const { return !left_.is_nil(); }
+    void flatten() const;
+    void release_parts() const;
+
+private:
+    std::size_t length_;
+    // 展开前为空, 展开后释放left_和right_
+    mutable std::string flat_;
+    mutable Value left_;
+    mutable Value right_;
+};
+
+inline std::string_view Value::as_string() const {
+    if (type() == value_type::SHORT_STRING) {
+        return {data_.short_string.chars, data_.short_string.length};
+    }
+    return static_cast<StringObject *>(data_.scalar.as.object)->view();
+}
+
+// nil和false为假, 其余的值都为真
+inline bool is_truthy(const Value &object) {
+    if (object.is_nil()) {
+        return false;
+    }
+    if (object.is_bool()) {
+        return object.as_bool();
+    }
+
+    return true;
+}
+
+// 判断两个值是否相等, 整数和浮点数按数值比较
+// 其他不同类型的值总是不相等
+bool is_equal(const Value &a, const Value &b);
+// 拼接两个字符串, 较长的结果不复制内容而是生成rope
+Value concat(const Value &a, const Value &b);
+// 转换为打印输出的字符串
+std::string stringify(const Value &object);
+
+} // namespace zero
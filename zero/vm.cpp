@@ -1,54 +1,312 @@
 #include "vm.hpp"
 
+#include "aot/emitter.hpp"
+#include "bytecode/compiler.hpp"
+#include "closure/compiler.hpp"
+#include "flat/flattener.hpp"
 #include "fmt/core.h"
 #include "interpreter.hpp"
 #include "lexer.hpp"
+#include "memo.hpp"
+#include "optimizer/constant_folder.hpp"
+#include "optimizer/dead_code.hpp"
+#include "optimizer/fuser.hpp"
+#include "optimizer/inliner.hpp"
+#include "optimizer/loop_optimizer.hpp"
+#include "optimizer/purity.hpp"
 #include "parser.hpp"
+#include "resolver.hpp"
 #include "token.hpp"
+#include "typed/checker.hpp"
+#include "typed/specializer.hpp"
 #include "utils/file_utils.hpp"
+#include "utils/native_stack.hpp"
 
 #include <csignal>
+#include <fstream>
 #include <iostream>
 #include <string>
 
 using namespace zero;
 
-void VM::run(std::string source) {
-    // 词法解析
-    auto lexer = Lexer(std::move(source));
+std::unique_ptr<Program> VM::analyze(const std::string &source) {
+    // 源码和解析, 优化过程中创建的AST节点都分配在这个程序的内存池中
+    auto arena = std::make_unique<Arena>();
+    Arena::Scope arena_scope{*arena};
+
+    // 词法解析, Token直接引用内存池中的源码
+    auto lexer = Lexer(arena->copy(source));
     auto tokens = lexer.scan_tokens();
 
     // 语法解析
     Parser parser{tokens};
     auto program = parser.parse_program();
+    program->set_arena(std::move(arena));
 
     if (parser.has_error()) {
         fmt::println("parse error");
-        return;
+        return nullptr;
     }
 
-    // 解释器
-    // TODO: 暂时是每一次执行都新创建一个解释器, 在REPL模式下不能利用上下文
-    // Interpreter interpreter{};
-    interpreter_->interpret(program);
+    // 常量折叠和常量传播, 在静态解析之前进行, 被传播的变量不再占用槽位
+    optimizer::ConstantFolder folder{*interpreter_};
+    auto removed = folder.fold(program);
+    if (verbose_) {
+        fmt::println("constant folding: removed {} nodes", removed);
+    }
+    optimizer::Inliner inliner;
+    auto inlined = inliner.inline_calls(program);
+    if (verbose_) {
+        fmt::println("inlining: inlined {} calls", inlined);
+    }
+    optimizer::LoopOptimizer loop_optimizer;
+    auto hoisted = loop_optimizer.optimize(program);
+    if (verbose_) {
+        fmt::println("loop optimization: hoisted {} expressions, "
+                     "specialized {} operations",
+                     hoisted,
+                     loop_optimizer.num_specialized());
+    }
 
-    if (has_runtime_error_) {
-        return;
+    // 静态解析
+    Resolver resolver{*interpreter_, interactive_};
+    resolver.resolve(program);
+
+    if (resolver.has_error()) {
+        fmt::println("resolve error");
+        return nullptr;
+    }
+
+    // 类型检查, 需要Resolver计算的槽位
+    typed::TypeChecker checker;
+    checker.check(program);
+    if (checker.has_error()) {
+        fmt::println("type error");
+        return nullptr;
+    }
+
+    // 死代码消除放在静态解析之后, 不会执行的代码中的错误仍然会被报告
+    // REPL中之后输入的代码可能调用当前还没有被引用的全局函数
+    optimizer::DeadCodeEliminator eliminator{!interactive_};
+    removed = eliminator.eliminate(program);
+    if (verbose_) {
+        fmt::println("dead code elimination: removed {} nodes", removed);
+        fmt::println("arena: {} bytes in {} chunks",
+                     program->get_arena().used(),
+                     program->get_arena().num_chunks());
+    }
+
+    return program;
+}
+
+std::unique_ptr<Program> VM::compile(const std::string &source) {
+    // 预编译程序只在文件模式下使用, REPL中每次输入都依赖之前声明的全局变量
+    std::unique_ptr<Program> program;
+    if (!interactive_) {
+        program = cache_->load(source, *interpreter_);
+    }
+    if (program != nullptr) {
+        if (verbose_) {
+            fmt::println("program cache: loaded {}", cache_->path(source));
+        }
+    } else {
+        // 出错的代码不会执行, 撤销它声明的全局变量
+        interpreter_->checkpoint_globals();
+        program = analyze(source);
+        if (program == nullptr) {
+            interpreter_->rollback_globals();
+            return nullptr;
+        }
+        if (!interactive_ && cache_->store(source, program, *interpreter_)
+            && verbose_) {
+            fmt::println("program cache: saved {}", cache_->path(source));
+        }
+    }
+
+    // 纯函数分析和类型特化的结果引用运行时对象, 不缓存, 每次重新计算
+    Arena::Scope arena_scope{program->get_arena()};
+
+    // 纯函数分析, 需要Resolver计算的变量位置
+    optimizer::PurityAnalyzer purity{memoize_, interactive_};
+    memoized_ = purity.memoize(program);
+    if (verbose_) {
+        fmt::println("purity analysis: {} pure functions, memoized {}",
+                     purity.num_pure(),
+                     memoized_.size());
+        for (const auto *function : purity.rejected()) {
+            fmt::println("purity analysis: `{}` is not pure, not memoized",
+                         function->name.lexeme);
+        }
+    }
+
+    // 类型特化, 记忆化的函数不特化
+    typed::Specializer specializer;
+    auto specialized = specializer.specialize(program);
+    if (verbose_) {
+        fmt::println("type specialization: specialized {} functions",
+                     specialized);
+        for (const auto *function : specializer.rejected()) {
+            fmt::println("type specialization: `{}` is not specialized",
+                         function->name.lexeme);
+        }
+    }
+
+    return program;
+}
+
+bool VM::run(const std::string &source) {
+    // 解析和执行都在C++栈大小已知的线程中进行, 各个执行方式检查剩余的栈空间
+    bool ok = false;
+    utils::run_with_native_stack(NATIVE_STACK_SIZE,
+                                 NATIVE_STACK_RESERVE,
+                                 [&] { ok = execute(source); });
+    return ok;
+}
+
+bool VM::execute(const std::string &source) {
+    has_error_ = false;
+    auto program = compile(source);
+    if (program == nullptr) {
+        return false;
+    }
+
+    // 合并的节点只有树遍历解释器专门执行, 其他执行方式不需要
+    // Fuser创建的节点也分配在程序的内存池中
+    if (engine_ == engine_type::TREE) {
+        Arena::Scope arena_scope{program->get_arena()};
+        optimizer::Fuser fuser;
+        auto fused = fuser.fuse(program);
+        if (verbose_) {
+            fmt::println("node fusion: fused {} nodes", fused);
+        }
+    }
+
+    if (engine_ == engine_type::BYTECODE) {
+        run_bytecode(program);
+    } else if (engine_ == engine_type::FLAT) {
+        run_flat(program);
+    } else if (engine_ == engine_type::CLOSURE) {
+        run_closure(program);
+    } else {
+        // 解释器
+        interpreter_->interpret(program);
+    }
+    if (verbose_) {
+        for (const auto *function : memoized_) {
+            fmt::println("memoization: `{}` hits {} misses {} entries {}",
+                         function->name.lexeme,
+                         function->memo->hits(),
+                         function->memo->misses(),
+                         function->memo->size());
+        }
     }
+    // 函数对象引用了AST中的节点, REPL模式下需要一直保留
+    programs_.push_back(std::move(program));
+
+    return !has_error_;
 }
 
-void VM::run_file(const std::string &file_path) {
+bool VM::emit_cpp(const std::string &file_path,
+                  const std::string &output_path) {
     if (!utils::file_exists(file_path)) {
         fmt::println("File `{}` not exist", file_path);
+        return false;
+    }
+
+    auto program = compile(utils::read_file(file_path));
+    if (program == nullptr) {
+        return false;
+    }
+
+    // 全局变量的槽位由解释器分配, 生成的代码使用相同的槽位
+    aot::Emitter emitter{*interpreter_};
+    auto code = emitter.emit(program, file_path);
+    std::ofstream output{output_path, std::ios::out | std::ios::binary};
+    output << code;
+    if (!output) {
+        fmt::println("Cannot write `{}`", output_path);
+        return false;
+    }
+    if (verbose_) {
+        fmt::println("emit cpp: {} functions, {} specialized",
+                     emitter.num_functions(),
+                     emitter.num_specialized());
+    }
+
+    return true;
+}
+
+void VM::run_bytecode(const std::unique_ptr<Program> &program) {
+    // 编译成字节码
+    bytecode::Compiler compiler;
+    auto script = compiler.compile(program);
+
+    if (compiler.has_error()) {
+        fmt::println("compile error");
+        has_error_ = true;
         return;
     }
+    if (verbose_) {
+        script->disassemble();
+    }
+
+    try {
+        machine_->run(*script);
+    } catch (const RuntimeError &err) {
+        runtime_error(err);
+    }
+    // 函数对象引用了字节码, REPL模式下需要一直保留
+    chunks_.push_back(std::move(script));
+}
+
+void VM::run_flat(const std::unique_ptr<Program> &program) {
+    // 转换成扁平语法树, 追加到求值器的树中
+    auto &tree = evaluator_->tree();
+    auto num_nodes = tree.nodes.size();
+    flat::Flattener flattener{tree};
+    auto script = flattener.flatten(program);
+    if (verbose_) {
+        fmt::println("flat tree: {} nodes, {} bytes in total",
+                     tree.nodes.size() - num_nodes,
+                     tree.bytes());
+    }
+
+    try {
+        evaluator_->run(script.statements, script.size);
+    } catch (const RuntimeError &err) {
+        runtime_error(err);
+    }
+}
+
+void VM::run_closure(const std::unique_ptr<Program> &program) {
+    // 编译成闭包, 函数体追加到运行时的函数表中
+    closure::Compiler compiler{runtime_->functions()};
+    auto script = compiler.compile(program);
+    if (verbose_) {
+        fmt::println("closure compilation: {} functions in total",
+                     runtime_->functions().size());
+    }
+
+    try {
+        runtime_->run(script);
+    } catch (const RuntimeError &err) {
+        runtime_error(err);
+    }
+}
+
+bool VM::run_file(const std::string &file_path) {
+    if (!utils::file_exists(file_path)) {
+        fmt::println("File `{}` not exist", file_path);
+        return false;
+    }
 
     auto source = utils::read_file(file_path);
-    run(source);
+    return run(source);
 }
 
 void VM::run_REPL() {
     std::string user_input;
+    interactive_ = true;
 
     // 注册信号处理函数
     signal(SIGINT, [](int signal) {
@@ -77,5 +335,5 @@ void VM::run_REPL() {
 
 void VM::runtime_error(const RuntimeError &err) {
     fmt::println("[Line {}] {}", err.token.line, err.what());
-    has_runtime_error_ = true;
+    has_error_ = true;
 }
@@ -1,32 +1,90 @@
 #pragma once
+#include "bytecode/chunk.hpp"
+#include "cache/program_cache.hpp"
+#include "bytecode/machine.hpp"
+#include "closure/runtime.hpp"
+#include "flat/evaluator.hpp"
 #include "interpreter.hpp"
 #include "token.hpp"
 
 #include <memory>
 #include <string>
+#include <vector>
 
 namespace zero {
 struct RuntimeError;
 
+// 执行引擎
+enum class engine_type {
+    TREE,     // 树遍历解释器
+    BYTECODE, // 字节码虚拟机
+    FLAT,     // 扁平语法树求值器
+    CLOSURE,  // 闭包编译
+};
+
 class VM {
 public:
-    VM() { interpreter_ = std::make_unique<Interpreter>(); }
+    explicit VM(engine_type engine = engine_type::TREE,
+                bool verbose = false,
+                bool memoize = false,
+                bool jit = true,
+                std::string cache_directory = "")
+        : engine_{engine}, verbose_{verbose}, memoize_{memoize},
+          cache_{std::make_unique<cache::ProgramCache>(
+              std::move(cache_directory))} {
+        // 只有树遍历解释器把调用次数多的函数编译成机器码
+        interpreter_ = std::make_unique<Interpreter>(
+            this, jit && engine_ == engine_type::TREE);
+        if (engine_ == engine_type::BYTECODE) {
+            machine_ = std::make_unique<bytecode::Machine>(*interpreter_);
+        } else if (engine_ == engine_type::FLAT) {
+            evaluator_ = std::make_unique<flat::Evaluator>(*interpreter_);
+        } else if (engine_ == engine_type::CLOSURE) {
+            runtime_ = std::make_unique<closure::Runtime>(*interpreter_);
+        }
+    }
 
 public:
     void run_REPL();
-    void run_file(const std::string &file_path);
+    // 执行文件, 文件不存在, 编译出错或者运行时出错时返回false
+    bool run_file(const std::string &file_path);
+    // 把源文件翻译成独立的C++程序, 写入output_path
+    bool emit_cpp(const std::string &file_path,
+                  const std::string &output_path);
     // static void parse_error(unsigned int line, const std::string &msg);
     void parse_error(const Token &token, const std::string &msg);
     void runtime_error(const RuntimeError &err);
 
 private:
-    void run(std::string source);
+    // 解析, 优化和静态检查, 文件模式下先查找预编译程序的缓存
+    // 出错时返回nullptr
+    std::unique_ptr<Program> compile(const std::string &source);
+    // 从源码开始解析, 优化和静态检查, 得到可以缓存的程序
+    std::unique_ptr<Program> analyze(const std::string &source);
+    // 编译并执行一段源码, 出错时返回false
+    bool run(const std::string &source);
+    // 在当前线程中编译并执行, 由run在新线程中调用
+    bool execute(const std::string &source);
+    void run_bytecode(const std::unique_ptr<Program> &program);
+    void run_flat(const std::unique_ptr<Program> &program);
+    void run_closure(const std::unique_ptr<Program> &program);
     void report(unsigned int line,
                 const std::string &pos,
                 const std::string &reason);
 
 private:
+    engine_type engine_;
+    bool verbose_;
+    bool memoize_; // 记忆化所有纯函数, 而不只是带@memoize注解的
+    bool interactive_{false}; // 是否运行在REPL中
     std::unique_ptr<Interpreter> interpreter_;
-    bool has_runtime_error_;
+    std::unique_ptr<bytecode::Machine> machine_;
+    std::unique_ptr<flat::Evaluator> evaluator_;
+    std::unique_ptr<closure::Runtime> runtime_;
+    std::unique_ptr<cache::ProgramCache> cache_;
+    std::vector<std::unique_ptr<Program>> programs_;
+    std::vector<Function *> memoized_; // 最近一次编译中记忆化的函数
+    std::vector<std::unique_ptr<bytecode::Chunk>> chunks_;
+    bool has_error_{false}; // 当前执行的源码是否出错
 };
 } // namespace zero